@@ -38,9 +38,24 @@
 
 #include <xf86drm.h>
 
+#include "xf86atomic.h"
 #include "exynos_drm.h"
 #include "exynos_drmif.h"
 
+struct exynos_bo_block;
+
+/* library-private wrapper of a buffer object */
+struct exynos_bo_priv {
+	struct exynos_bo	base;
+	struct exynos_bo_block	*block;
+};
+
+/* storage shared by the buffers created by exynos_bo_create_array() */
+struct exynos_bo_block {
+	atomic_t		refcount;
+	struct exynos_bo_priv	bos[];
+};
+
 /*
  * Create exynos drm device object.
  *
@@ -101,7 +116,7 @@ struct exynos_bo * exynos_bo_create(struct exynos_device *dev,
 		goto fail;
 	}
 
-	bo = calloc(sizeof(*bo), 1);
+	bo = calloc(sizeof(struct exynos_bo_priv), 1);
 	if (!bo) {
 		fprintf(stderr, "failed to create bo[%s].\n",
 				strerror(errno));
@@ -128,6 +143,80 @@ fail:
 	return NULL;
 }
 
+/*
+ * Create several exynos buffer objects at once.
+ *
+ * @dev: exynos drm device object.
+ * @count: number of buffer objects to create.
+ * @sizes: user-desired size of each of them.
+ * @flags: user-desired memory type, as for exynos_bo_create.
+ * @bos: returns the new buffer objects.
+ *
+ * the buffer objects share a single host allocation and are destroyed
+ * one by one with exynos_bo_destroy as usual.
+ *
+ * if true, return 0 else negative, with no buffer object left created.
+ */
+int exynos_bo_create_array(struct exynos_device *dev, int count,
+			const size_t *sizes, uint32_t flags,
+			struct exynos_bo **bos)
+{
+	struct exynos_bo_block *block;
+	int i, ret = 0;
+
+	if (count < 0)
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		if (sizes[i] == 0) {
+			fprintf(stderr, "invalid size.\n");
+			return -EINVAL;
+		}
+	}
+
+	if (count == 0)
+		return 0;
+
+	block = calloc(sizeof(*block) + count * sizeof(block->bos[0]), 1);
+	if (!block) {
+		fprintf(stderr, "failed to create bo[%s].\n",
+				strerror(errno));
+		return -ENOMEM;
+	}
+	atomic_set(&block->refcount, 1);
+
+	for (i = 0; i < count; i++) {
+		struct exynos_bo *bo = &block->bos[i].base;
+		struct drm_exynos_gem_create req = {
+			.size = sizes[i],
+			.flags = flags,
+		};
+
+		if (drmIoctl(dev->fd, DRM_IOCTL_EXYNOS_GEM_CREATE, &req)) {
+			ret = -errno;
+			fprintf(stderr, "failed to create gem object[%s].\n",
+					strerror(errno));
+			while (i--)
+				exynos_bo_destroy(bos[i]);
+			break;
+		}
+
+		bo->dev = dev;
+		bo->handle = req.handle;
+		bo->size = sizes[i];
+		bo->flags = flags;
+
+		block->bos[i].block = block;
+		atomic_inc(&block->refcount);
+		bos[i] = bo;
+	}
+
+	if (atomic_dec_and_test(&block->refcount))
+		free(block);
+
+	return ret;
+}
+
 /*
  * Get information to gem region allocated.
  *
@@ -169,21 +258,22 @@ int exynos_bo_get_info(struct exynos_device *dev, uint32_t handle,
  */
 void exynos_bo_destroy(struct exynos_bo *bo)
 {
+	struct exynos_bo_block *block;
+
 	if (!bo)
 		return;
 
 	if (bo->vaddr)
 		munmap(bo->vaddr, bo->size);
 
-	if (bo->handle) {
-		struct drm_gem_close req = {
-			.handle = bo->handle,
-		};
-
-		drmIoctl(bo->dev->fd, DRM_IOCTL_GEM_CLOSE, &req);
-	}
+	if (bo->handle)
+		drmCloseBufferHandle(bo->dev->fd, bo->handle);
 
-	free(bo);
+	block = ((struct exynos_bo_priv *)bo)->block;
+	if (!block)
+		free(bo);
+	else if (atomic_dec_and_test(&block->refcount))
+		free(block);
 }
 
 
@@ -206,7 +296,7 @@ struct exynos_bo * exynos_bo_from_name(struct exynos_device *dev, uint32_t name)
 		.name = name,
 	};
 
-	bo = calloc(sizeof(*bo), 1);
+	bo = calloc(sizeof(struct exynos_bo_priv), 1);
 	if (!bo) {
 		fprintf(stderr, "failed to allocate bo[%s].\n",
 				strerror(errno));
@@ -345,18 +435,14 @@ int exynos_prime_handle_to_fd(struct exynos_device *dev, uint32_t handle,
 					int *fd)
 {
 	int ret;
-	struct drm_prime_handle req = {
-		.handle	= handle,
-	};
 
-	ret = drmIoctl(dev->fd, DRM_IOCTL_PRIME_HANDLE_TO_FD, &req);
+	ret = drmPrimeHandleToFD(dev->fd, handle, 0, fd);
 	if (ret) {
 		fprintf(stderr, "failed to mmap[%s].\n",
 			strerror(errno));
 		return ret;
 	}
 
-	*fd = req.fd;
 	return 0;
 }
 
@@ -374,18 +460,14 @@ int exynos_prime_fd_to_handle(struct exynos_device *dev, int fd,
 					uint32_t *handle)
 {
 	int ret;
-	struct drm_prime_handle req = {
-		.fd	= fd,
-	};
 
-	ret = drmIoctl(dev->fd, DRM_IOCTL_PRIME_FD_TO_HANDLE, &req);
+	ret = drmPrimeFDToHandle(dev->fd, fd, handle);
 	if (ret) {
 		fprintf(stderr, "failed to mmap[%s].\n",
 			strerror(errno));
 		return ret;
 	}
 
-	*handle = req.handle;
 	return 0;
 }
 
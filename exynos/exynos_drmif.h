@@ -67,6 +67,8 @@ void exynos_device_destroy(struct exynos_device *dev);
  */
 struct exynos_bo * exynos_bo_create(struct exynos_device *dev,
 		size_t size, uint32_t flags);
+int exynos_bo_create_array(struct exynos_device *dev, int count,
+		const size_t *sizes, uint32_t flags, struct exynos_bo **bos);
 int exynos_bo_get_info(struct exynos_device *dev, uint32_t handle,
 			size_t *size, uint32_t *flags);
 void exynos_bo_destroy(struct exynos_bo *bo);
@@ -69,6 +69,66 @@ drm_intel_bo_alloc_tiled(drm_intel_bufmgr *bufmgr, const char *name,
 				      tiling_mode, pitch, flags);
 }
 
+int
+drm_intel_bo_alloc_array(drm_intel_bufmgr *bufmgr, const char *name,
+			 int count, const unsigned long *sizes,
+			 unsigned int alignment, drm_intel_bo **bos)
+{
+	int i;
+
+	if (count < 0)
+		return -EINVAL;
+
+	if (bufmgr->bo_alloc_array)
+		return bufmgr->bo_alloc_array(bufmgr, name, count, sizes,
+					      alignment, bos);
+
+	for (i = 0; i < count; i++) {
+		bos[i] = bufmgr->bo_alloc(bufmgr, name, sizes[i], alignment);
+		if (bos[i] == NULL) {
+			while (i--)
+				drm_intel_bo_unreference(bos[i]);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Returns a buffer object for \p size bytes of client memory at \p addr,
+ * both of which must be page aligned.
+ *
+ * Where the kernel supports it, the buffer uses the memory itself: the
+ * GPU reads and writes it directly, and mapping the buffer returns \p addr.
+ * The memory must stay allocated until the buffer is freed.  \p flags are
+ * the I915_USERPTR_* flags.
+ *
+ * Otherwise, or if the kernel refuses to wrap this particular memory, the
+ * buffer returned is a regular one holding a copy of the memory as it is
+ * at the time of the call, and drm_intel_bo_is_userptr() returns false for
+ * it.
+ */
+drm_intel_bo *
+drm_intel_bo_alloc_userptr(drm_intel_bufmgr *bufmgr, const char *name,
+			   void *addr, unsigned long size, unsigned long flags)
+{
+	drm_intel_bo *bo = NULL;
+
+	if (bufmgr->bo_alloc_userptr)
+		bo = bufmgr->bo_alloc_userptr(bufmgr, name, addr, size, flags);
+	if (bo != NULL)
+		return bo;
+
+	bo = bufmgr->bo_alloc(bufmgr, name, size, 4096);
+	if (bo != NULL && drm_intel_bo_subdata(bo, 0, size, addr) != 0) {
+		drm_intel_bo_unreference(bo);
+		bo = NULL;
+	}
+
+	return bo;
+}
+
 void drm_intel_bo_reference(drm_intel_bo *bo)
 {
 	bo->bufmgr->bo_reference(bo);
@@ -118,6 +178,101 @@ drm_intel_bo_get_subdata(drm_intel_bo *bo, unsigned long offset,
 	return 0;
 }
 
+/**
+ * Writes \c count ranges of a buffer object at once.
+ *
+ * Consecutive regions that are adjacent in the buffer are written
+ * together, and if the buffer is already mapped and idle, the data may be
+ * copied through the mapping instead.
+ *
+ * Returns the number of write ioctls that were needed, 0 if the data was
+ * copied through the mapping, or a negative errno.
+ */
+int
+drm_intel_bo_subdata_v(drm_intel_bo *bo, const drm_intel_bo_region *regions,
+		       int count)
+{
+	int i, ret;
+
+	if (count < 0)
+		return -EINVAL;
+
+	if (bo->bufmgr->bo_subdata_v)
+		return bo->bufmgr->bo_subdata_v(bo, regions, count);
+
+	for (i = 0; i < count; i++) {
+		ret = drm_intel_bo_subdata(bo, regions[i].offset,
+					   regions[i].size, regions[i].data);
+		if (ret)
+			return ret;
+	}
+	return count;
+}
+
+/**
+ * Reads \c count ranges of a buffer object at once, the same way as
+ * drm_intel_bo_subdata_v() writes them.
+ */
+int
+drm_intel_bo_get_subdata_v(drm_intel_bo *bo,
+			   const drm_intel_bo_region *regions, int count)
+{
+	int i, ret;
+
+	if (count < 0)
+		return -EINVAL;
+
+	if (bo->bufmgr->bo_get_subdata_v)
+		return bo->bufmgr->bo_get_subdata_v(bo, regions, count);
+
+	for (i = 0; i < count; i++) {
+		ret = drm_intel_bo_get_subdata(bo, regions[i].offset,
+					       regions[i].size,
+					       regions[i].data);
+		if (ret)
+			return ret;
+	}
+	return count;
+}
+
+/**
+ * Writes a rectangle of a tiled buffer object from linear data, laying it
+ * out in X or Y tiles with the bit 6 swizzling of the buffer on the CPU,
+ * so it doesn't need a fenced GTT mapping.
+ *
+ * \c x and \c width are in bytes, \c y and \c height in rows, and
+ * \c pitch is the distance between rows of \c data.
+ *
+ * Returns -EINVAL for an untiled buffer or a rectangle outside it, and
+ * -ENODEV if the layout isn't known, as for swizzling that depends on
+ * physical addresses.
+ */
+int
+drm_intel_bo_upload_tiled(drm_intel_bo *bo, uint32_t x, uint32_t y,
+			  uint32_t width, uint32_t height,
+			  const void *data, uint32_t pitch)
+{
+	if (bo->bufmgr->bo_upload_tiled)
+		return bo->bufmgr->bo_upload_tiled(bo, x, y, width, height,
+						   data, pitch);
+	return -ENODEV;
+}
+
+/**
+ * Reads a rectangle of a tiled buffer object into linear memory, the
+ * reverse of drm_intel_bo_upload_tiled().
+ */
+int
+drm_intel_bo_readback_tiled(drm_intel_bo *bo, uint32_t x, uint32_t y,
+			    uint32_t width, uint32_t height,
+			    void *data, uint32_t pitch)
+{
+	if (bo->bufmgr->bo_readback_tiled)
+		return bo->bufmgr->bo_readback_tiled(bo, x, y, width, height,
+						     data, pitch);
+	return -ENODEV;
+}
+
 void drm_intel_bo_wait_rendering(drm_intel_bo *bo)
 {
 	bo->bufmgr->bo_wait_rendering(bo);
@@ -246,6 +401,13 @@ int drm_intel_bo_is_reusable(drm_intel_bo *bo)
 	return 0;
 }
 
+int drm_intel_bo_is_userptr(drm_intel_bo *bo)
+{
+	if (bo->bufmgr->bo_is_userptr)
+		return bo->bufmgr->bo_is_userptr(bo);
+	return 0;
+}
+
 int drm_intel_bo_busy(drm_intel_bo *bo)
 {
 	if (bo->bufmgr->bo_busy)
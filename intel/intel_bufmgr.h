@@ -42,6 +42,7 @@ struct drm_clip_rect;
 
 typedef struct _drm_intel_bufmgr drm_intel_bufmgr;
 typedef struct _drm_intel_bo drm_intel_bo;
+typedef struct _drm_intel_upload_ring drm_intel_upload_ring;
 
 struct _drm_intel_bo {
 	/**
@@ -98,6 +99,76 @@ typedef struct _drm_intel_aub_annotation {
 	uint32_t ending_offset;
 } drm_intel_aub_annotation;
 
+/**
+ * A range of a buffer object and the memory it is copied from or to, see
+ * drm_intel_bo_subdata_v().
+ */
+typedef struct _drm_intel_bo_region {
+	unsigned long offset;
+	unsigned long size;
+	void *data;
+} drm_intel_bo_region;
+
+/**
+ * Buffer object cache counters, see drm_intel_bufmgr_gem_get_cache_stats().
+ */
+typedef struct _drm_intel_bo_cache_stats {
+	/** Allocations served from the calling thread's own cache */
+	unsigned long hits;
+	/** Allocations that had to create a new buffer object */
+	unsigned long misses;
+	/** Allocations served from the shared, locked bucket lists */
+	unsigned long steals;
+	/** Buffers moved from a thread cache to the shared lists */
+	unsigned long flushes;
+	/** Cached buffers freed to stay under the cache size limit */
+	unsigned long evictions;
+	/** Bytes currently held in the shared lists */
+	uint64_t cached_bytes;
+	/** Reused buffers that already had the requested tiling and stride */
+	unsigned long set_tiling_avoided;
+	/** Reused buffers that needed a SET_TILING */
+	unsigned long set_tiling_needed;
+} drm_intel_bo_cache_stats;
+
+/**
+ * Mapping cache counters, see drm_intel_bufmgr_gem_get_vma_stats().
+ */
+typedef struct _drm_intel_bo_vma_stats {
+	/** Maps that found the buffer already mapped */
+	unsigned long hits;
+	/** Maps that had to create a new mapping */
+	unsigned long misses;
+	/** Mappings dropped, to stay under the limits or with their buffer */
+	unsigned long munmaps;
+	/** Address space taken by CPU mappings */
+	uint64_t cpu_bytes;
+	/** Address space taken by GTT mappings */
+	uint64_t gtt_bytes;
+	/** Part of cpu_bytes kept for buffers that aren't mapped any more */
+	uint64_t cached_cpu_bytes;
+	/** Part of gtt_bytes kept for buffers that aren't mapped any more */
+	uint64_t cached_gtt_bytes;
+} drm_intel_bo_vma_stats;
+
+/**
+ * Submission counters, see drm_intel_bufmgr_gem_get_exec_stats().
+ */
+typedef struct _drm_intel_bo_exec_stats {
+	/** Batches submitted */
+	unsigned long execs;
+	/** Batches whose relocation processing the kernel skipped */
+	unsigned long no_reloc_execs;
+	/** Relocation entries submitted */
+	unsigned long relocs;
+	/** Relocations whose target had moved since they were written */
+	unsigned long relocs_needed;
+	/** Relocations in batches whose relocation processing was skipped */
+	unsigned long relocs_skipped;
+	/** Heap memory allocated for relocation lists, which is kept for reuse */
+	uint64_t reloc_bytes;
+} drm_intel_bo_exec_stats;
+
 #define BO_ALLOC_FOR_RENDER (1<<0)
 
 drm_intel_bo *drm_intel_bo_alloc(drm_intel_bufmgr *bufmgr, const char *name,
@@ -112,6 +183,13 @@ drm_intel_bo *drm_intel_bo_alloc_tiled(drm_intel_bufmgr *bufmgr,
 				       uint32_t *tiling_mode,
 				       unsigned long *pitch,
 				       unsigned long flags);
+int drm_intel_bo_alloc_array(drm_intel_bufmgr *bufmgr, const char *name,
+			     int count, const unsigned long *sizes,
+			     unsigned int alignment, drm_intel_bo **bos);
+drm_intel_bo *drm_intel_bo_alloc_userptr(drm_intel_bufmgr *bufmgr,
+					 const char *name, void *addr,
+					 unsigned long size,
+					 unsigned long flags);
 void drm_intel_bo_reference(drm_intel_bo *bo);
 void drm_intel_bo_unreference(drm_intel_bo *bo);
 int drm_intel_bo_map(drm_intel_bo *bo, int write_enable);
@@ -121,6 +199,16 @@ int drm_intel_bo_subdata(drm_intel_bo *bo, unsigned long offset,
 			 unsigned long size, const void *data);
 int drm_intel_bo_get_subdata(drm_intel_bo *bo, unsigned long offset,
 			     unsigned long size, void *data);
+int drm_intel_bo_subdata_v(drm_intel_bo *bo,
+			   const drm_intel_bo_region *regions, int count);
+int drm_intel_bo_get_subdata_v(drm_intel_bo *bo,
+			       const drm_intel_bo_region *regions, int count);
+int drm_intel_bo_upload_tiled(drm_intel_bo *bo, uint32_t x, uint32_t y,
+			      uint32_t width, uint32_t height,
+			      const void *data, uint32_t pitch);
+int drm_intel_bo_readback_tiled(drm_intel_bo *bo, uint32_t x, uint32_t y,
+				uint32_t width, uint32_t height,
+				void *data, uint32_t pitch);
 void drm_intel_bo_wait_rendering(drm_intel_bo *bo);
 
 void drm_intel_bufmgr_set_debug(drm_intel_bufmgr *bufmgr, int enable_debug);
@@ -151,6 +239,7 @@ int drm_intel_bo_madvise(drm_intel_bo *bo, int madv);
 
 int drm_intel_bo_disable_reuse(drm_intel_bo *bo);
 int drm_intel_bo_is_reusable(drm_intel_bo *bo);
+int drm_intel_bo_is_userptr(drm_intel_bo *bo);
 int drm_intel_bo_references(drm_intel_bo *bo, drm_intel_bo *target_bo);
 
 /* drm_intel_bufmgr_gem.c */
@@ -158,17 +247,54 @@ drm_intel_bufmgr *drm_intel_bufmgr_gem_init(int fd, int batch_size);
 drm_intel_bo *drm_intel_bo_gem_create_from_name(drm_intel_bufmgr *bufmgr,
 						const char *name,
 						unsigned int handle);
+drm_intel_bo *drm_intel_bo_gem_create_from_prime(drm_intel_bufmgr *bufmgr,
+						 int prime_fd, int size);
+int drm_intel_bo_gem_export_to_prime(drm_intel_bo *bo, int *prime_fd);
 void drm_intel_bufmgr_gem_enable_reuse(drm_intel_bufmgr *bufmgr);
 void drm_intel_bufmgr_gem_enable_fenced_relocs(drm_intel_bufmgr *bufmgr);
+void drm_intel_bufmgr_gem_enable_suballoc(drm_intel_bufmgr *bufmgr);
+void drm_intel_bufmgr_gem_enable_no_reloc(drm_intel_bufmgr *bufmgr);
 void drm_intel_bufmgr_gem_set_vma_cache_size(drm_intel_bufmgr *bufmgr,
 					     int limit);
+void drm_intel_bufmgr_gem_set_vma_cache_bytes(drm_intel_bufmgr *bufmgr,
+					      uint64_t max_bytes);
+void drm_intel_bufmgr_gem_get_vma_stats(drm_intel_bufmgr *bufmgr,
+					drm_intel_bo_vma_stats *stats);
+void drm_intel_bufmgr_gem_get_cache_stats(drm_intel_bufmgr *bufmgr,
+					  drm_intel_bo_cache_stats *stats);
+void drm_intel_bufmgr_gem_get_exec_stats(drm_intel_bufmgr *bufmgr,
+					 drm_intel_bo_exec_stats *stats);
+int drm_intel_bufmgr_gem_enable_async_exec(drm_intel_bufmgr *bufmgr,
+					   unsigned int depth,
+					   void (*callback)(drm_intel_bo *batch,
+							    int ret,
+							    void *data),
+					   void *data);
+uint64_t drm_intel_bufmgr_gem_get_exec_fence(drm_intel_bufmgr *bufmgr);
+int drm_intel_bufmgr_gem_wait_exec_fence(drm_intel_bufmgr *bufmgr,
+					 uint64_t fence);
+int drm_intel_bufmgr_gem_set_cache_classes(drm_intel_bufmgr *bufmgr,
+					   int classes, unsigned long max_size);
+void drm_intel_bufmgr_gem_set_cache_max_bytes(drm_intel_bufmgr *bufmgr,
+					      uint64_t max_bytes);
 int drm_intel_gem_bo_map_unsynchronized(drm_intel_bo *bo);
 int drm_intel_gem_bo_map_gtt(drm_intel_bo *bo);
 int drm_intel_gem_bo_unmap_gtt(drm_intel_bo *bo);
 
+drm_intel_upload_ring *
+drm_intel_gem_upload_ring_create(drm_intel_bufmgr *bufmgr, const char *name,
+				 unsigned long size, int regions);
+void drm_intel_gem_upload_ring_destroy(drm_intel_upload_ring *ring);
+void *drm_intel_gem_upload_ring_alloc(drm_intel_upload_ring *ring,
+				      unsigned long size,
+				      unsigned int alignment,
+				      uint32_t *offset);
+drm_intel_bo *drm_intel_gem_upload_ring_get_bo(drm_intel_upload_ring *ring);
+
 int drm_intel_gem_bo_get_reloc_count(drm_intel_bo *bo);
 void drm_intel_gem_bo_clear_relocs(drm_intel_bo *bo, int start);
 void drm_intel_gem_bo_start_gtt_access(drm_intel_bo *bo, int write_enable);
+int drm_intel_gem_bo_wait(drm_intel_bo *bo, int64_t timeout_ns);
 
 void drm_intel_bufmgr_gem_set_aub_dump(drm_intel_bufmgr *bufmgr, int enable);
 void drm_intel_gem_bo_aub_dump_bmp(drm_intel_bo *bo,
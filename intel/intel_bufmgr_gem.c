@@ -47,6 +47,7 @@
 #include <unistd.h>
 #include <assert.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -82,17 +83,94 @@
 
 typedef struct _drm_intel_bo_gem drm_intel_bo_gem;
 
+/*
+ * Each bucket keeps a list per tiling mode, so that a tiled allocation can
+ * usually be served by a buffer that needs no SET_TILING.
+ */
+#define TILING_LISTS		(I915_TILING_Y + 1)
+/* How far to look down a list for a buffer with the right stride */
+#define TILING_SCAN		8
+
 struct drm_intel_gem_bo_bucket {
-	drmMMListHead head;
+	drmMMListHead head[TILING_LISTS];
 	unsigned long size;
 };
 
+/*
+ * Small buffers can be carved out of larger "slab" objects, in power of two
+ * chunk sizes from SLAB_MIN_SIZE up to SLAB_MAX_SIZE, SLAB_CHUNKS per slab.
+ */
+#define SLAB_MIN_SHIFT		6
+#define SLAB_MAX_SHIFT		11
+#define SLAB_CLASSES		(SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_MAX_SIZE		(1UL << SLAB_MAX_SHIFT)
+#define SLAB_CHUNKS		64
+
+/*
+ * Relocation lists start with RELOC_MIN_ENTRIES entries and double as they
+ * fill up, to at most max_relocs.  Lists of each capacity are recycled
+ * through a free list in the bufmgr, and the smaller ones are carved out
+ * of RELOC_CHUNK_SIZE chunks.
+ */
+#define RELOC_MIN_SHIFT		4
+#define RELOC_MIN_ENTRIES	(1 << RELOC_MIN_SHIFT)
+#define RELOC_CLASSES		24
+#define RELOC_CHUNK_SIZE	(64 * 1024)
+#define RELOC_ENTRY_SIZE	(sizeof(struct drm_i915_gem_relocation_entry) + \
+				 sizeof(drm_intel_reloc_target))
+
+struct drm_intel_gem_walk_frame {
+	drm_intel_bo *bo;
+	int reloc;
+};
+
+/** A batch handed over to the submission thread */
+struct drm_intel_gem_exec_job {
+	struct drm_i915_gem_execbuffer2 execbuf;
+	/** Copy of the validation list, holding a reference on each buffer */
+	struct drm_i915_gem_exec_object2 *objects;
+	drm_intel_bo **bos;
+	int size;
+	drm_intel_bo *batch;
+	unsigned long relocs;
+	bool no_reloc;
+	int ret;
+};
+
+/**
+ * Bounded ring of jobs between the thread calling exec, which queues them
+ * and later reaps them, and the submission thread.  Each index is only
+ * ever written by one side; the semaphores hand the slots over.
+ */
+struct drm_intel_gem_exec_queue {
+	pthread_t thread;
+	sem_t queued;
+	sem_t completed;
+	struct drm_intel_gem_exec_job *jobs;
+	unsigned int depth;
+	/** Jobs queued, reaped, and taken by the thread so far */
+	uint64_t head;
+	uint64_t reaped;
+	uint64_t tail;
+	bool stop;
+	/** First failure reaped since the last wait */
+	int error;
+	void (*callback)(drm_intel_bo *batch, int ret, void *data);
+	void *callback_data;
+};
+
 typedef struct _drm_intel_bufmgr_gem {
 	drm_intel_bufmgr bufmgr;
 
 	int fd;
 
 	int max_relocs;
+	/** Free relocation lists by capacity, linked through their first word */
+	void *reloc_free[RELOC_CLASSES];
+	/** Chunks the smaller relocation lists are carved from */
+	void *reloc_chunks;
+	char *reloc_chunk_next;
+	char *reloc_chunk_end;
 
 	pthread_mutex_t lock;
 
@@ -101,15 +179,62 @@ typedef struct _drm_intel_bufmgr_gem {
 	drm_intel_bo **exec_bos;
 	int exec_size;
 	int exec_count;
-
-	/** Array of lists of cached gem objects of power-of-two sizes */
-	struct drm_intel_gem_bo_bucket cache_bucket[14 * 4];
+	/**
+	 * Bumped after every submission, which empties the validation list
+	 * without touching the buffers that were on it.
+	 */
+	uint64_t exec_gen;
+	/** Explicit stack for walking relocation trees */
+	struct drm_intel_gem_walk_frame *walk_stack;
+	int walk_size;
+	/** Last identifier handed out to a relocation tree, see aperture_tag */
+	uint64_t aperture_epoch;
+	/** Submission thread, see drm_intel_bufmgr_gem_enable_async_exec() */
+	struct drm_intel_gem_exec_queue *exec_queue;
+	/** Live drm_intel_upload_rings, fenced by every batch using them */
+	drmMMListHead upload_rings;
+
+	/** Array of lists of cached gem objects, one per size class */
+	struct drm_intel_gem_bo_bucket *cache_bucket;
 	int num_buckets;
+	/** Size classes per power of two, and the largest class size */
+	int cache_classes;
+	unsigned long cache_max_size;
+	/** All cached gem objects, least recently freed first */
+	drmMMListHead cache_lru;
+	uint64_t cache_bytes;
+	/** Limit on cache_bytes, or 0 for only time-based expiry */
+	uint64_t cache_max_bytes;
+	unsigned long cache_evictions;
 	time_t time;
 
+	/**
+	 * Per-thread caches sitting in front of the first tcache_bins
+	 * entries of cache_bucket[], see struct drm_intel_gem_bo_tcache.
+	 */
+	pthread_key_t tcache_key;
+	int tcache_bins;
+	drmMMListHead tcache_list;
+	/** Counters of the thread caches that have already been released */
+	drm_intel_bo_cache_stats tcache_retired;
+
+	/**
+	 * Slabs of each chunk size, the ones with free chunks first.
+	 * Only used once enabled by drm_intel_bufmgr_gem_enable_suballoc().
+	 */
+	drmMMListHead slabs[SLAB_CLASSES];
+	bool suballoc;
+
+	/** Buffers shared through flink or PRIME */
 	drmMMListHead named;
+	/** Shared buffers by global_name, and by gem_handle */
+	void *name_table;
+	void *handle_table;
 	drmMMListHead vma_cache;
 	int vma_count, vma_open, vma_max;
+	/** Limit on the address space taken by mappings, 0 if none */
+	uint64_t vma_max_bytes;
+	drm_intel_bo_vma_stats vma_stats;
 
 	uint64_t gtt_size;
 	int available_fences;
@@ -119,14 +244,47 @@ typedef struct _drm_intel_bufmgr_gem {
 	unsigned int has_blt : 1;
 	unsigned int has_relaxed_fencing : 1;
 	unsigned int has_llc : 1;
+	unsigned int has_exec_no_reloc : 1;
+	unsigned int has_wait_timeout : 1;
 	unsigned int bo_reuse : 1;
 	unsigned int no_exec : 1;
 	bool fenced_relocs;
+	bool no_reloc;
+
+	/** Submission counters, see drm_intel_bufmgr_gem_get_exec_stats() */
+	drm_intel_bo_exec_stats exec_stats;
 
 	FILE *aub_file;
 	uint32_t aub_offset;
 } drm_intel_bufmgr_gem;
 
+/*
+ * Each thread keeps a small stack of its recently freed buffers for every
+ * bucket size up to TCACHE_MAX_SIZE.  Those can be handed out again without
+ * taking bufmgr_gem->lock; only when a stack overflows or runs dry do we fall
+ * back to the shared cache_bucket[] lists.
+ *
+ * Buffers are marked purgeable on the way into a thread cache, as they are
+ * for the shared one, so the kernel can still reclaim them.  They are not
+ * counted against cache_max_bytes nor expired with the shared cache though,
+ * which is why the stacks are kept short and limited to the smaller sizes.
+ */
+#define TCACHE_DEPTH		8
+#define TCACHE_MAX_SIZE		(1024 * 1024)
+
+struct drm_intel_gem_bo_tcache_bin {
+	int count;
+	/** Oldest first */
+	drm_intel_bo_gem *bos[TCACHE_DEPTH];
+};
+
+struct drm_intel_gem_bo_tcache {
+	drm_intel_bufmgr_gem *bufmgr_gem;
+	drmMMListHead link;
+	drm_intel_bo_cache_stats stats;
+	struct drm_intel_gem_bo_tcache_bin bin[];
+};
+
 #define DRM_INTEL_RELOC_FENCE (1<<0)
 
 typedef struct _drm_intel_reloc_target_info {
@@ -149,9 +307,15 @@ struct _drm_intel_bo_gem {
 
 	/**
 	 * Index of the buffer within the validation list while preparing a
-	 * batchbuffer execution.
+	 * batchbuffer execution, valid only when validate_gen matches the
+	 * bufmgr's exec_gen.
 	 */
 	int validate_index;
+	uint64_t validate_gen;
+	/** exec_gen of the last relocation tree walk that entered this buffer */
+	uint64_t walk_gen;
+	/** Queued submissions using this buffer that haven't been reaped */
+	atomic_t exec_pending;
 
 	/**
 	 * Current tiling mode
@@ -170,15 +334,24 @@ struct _drm_intel_bo_gem {
 	drm_intel_reloc_target *reloc_target_info;
 	/** Number of entries in relocs */
 	int reloc_count;
+	/** Capacity of relocs, see drm_intel_gem_reloc_capacity() */
+	int reloc_class;
 	/** Mapped address for the buffer, saved across map/unmap cycles */
 	void *mem_virtual;
 	/** GTT virtual address for the buffer, saved across map/unmap cycles */
 	void *gtt_virtual;
+	/**
+	 * Client memory this buffer wraps, see drm_intel_bo_alloc_userptr().
+	 * It serves as the CPU mapping, and isn't ours to unmap.
+	 */
+	void *user_virtual;
 	int map_count;
 	drmMMListHead vma_list;
 
 	/** BO cache list */
 	drmMMListHead head;
+	/** Link in bufmgr_gem->cache_lru while on a bucket list */
+	drmMMListHead lru;
 
 	/**
 	 * Boolean of whether this BO and its children have been included in
@@ -203,14 +376,33 @@ struct _drm_intel_bo_gem {
 	 */
 	bool reusable;
 
+	/**
+	 * Boolean of whether this buffer has been shared with other processes
+	 * or devices, through flink or PRIME, and is in the bufmgr's
+	 * handle_table.
+	 */
+	bool shared;
+
 	/**
 	 * Size in bytes of this buffer and its relocation descendents.
 	 *
 	 * Used to avoid costly tree walking in
-	 * drm_intel_bufmgr_check_aperture in the common case.
+	 * drm_intel_bufmgr_check_aperture in the common case.  Buffers
+	 * reachable through several relocations are only counted once.
 	 */
 	int reloc_tree_size;
 
+	/** Space this buffer alone needs in the aperture */
+	int aperture_size;
+
+	/**
+	 * Identifier of the relocation tree rooted at this buffer, allocated
+	 * on its first relocation, and of the last tree whose
+	 * reloc_tree_size this buffer has been counted in.
+	 */
+	uint64_t aperture_root;
+	uint64_t aperture_tag;
+
 	/**
 	 * Number of potential fence registers required by this buffer and its
 	 * relocations.
@@ -224,6 +416,74 @@ struct _drm_intel_bo_gem {
 
 	drm_intel_aub_annotation *aub_annotations;
 	unsigned aub_annotation_count;
+
+	/** Shared allocation this struct is part of, if any */
+	struct drm_intel_gem_bo_block *block;
+
+	/**
+	 * Slab this buffer was carved out of, if any, and where.  Such a
+	 * buffer shares the gem_handle of the slab's buffer.
+	 */
+	struct drm_intel_gem_slab *slab;
+	uint32_t slab_offset;
+	/** Slab that this buffer provides the storage for, if any */
+	struct drm_intel_gem_slab *backing_slab;
+};
+
+/**
+ * Storage for the structs of buffers allocated together by
+ * drm_intel_gem_bo_alloc_array(), released with the last of them.
+ */
+struct drm_intel_gem_bo_block {
+	atomic_t refcount;
+	drm_intel_bo_gem bos[];
+};
+
+/**
+ * A buffer object split into SLAB_CHUNKS equally sized sub-allocations.
+ *
+ * Relocations to a chunk are emitted against the slab's buffer, so the
+ * validation list and aperture checks only ever see the latter.  The
+ * slab holds a reference on its buffer until it is released, and is
+ * protected by bufmgr_gem->lock.
+ */
+struct drm_intel_gem_slab {
+	drmMMListHead link;
+	drm_intel_bo *bo;
+	unsigned long chunk_size;
+	/** Bitmask of the chunks that are not in use */
+	uint64_t free;
+	drm_intel_bo_gem chunk[SLAB_CHUNKS];
+};
+
+/**
+ * A persistently mapped buffer handed out in pieces, see
+ * drm_intel_gem_upload_ring_create().
+ *
+ * The buffer is split into regions which are filled one after the other.
+ * The fill position is packed with the index of the region being filled
+ * into head, as region * (region_size + 1) + fill, so allocations can
+ * claim space with a single compare-and-swap.  Moving to the next region
+ * takes the bufmgr lock.
+ */
+struct _drm_intel_upload_ring {
+	drm_intel_bufmgr_gem *bufmgr_gem;
+	drmMMListHead link;
+	drm_intel_bo *bo;
+	char *virtual;
+	unsigned long region_size;
+	int region_count;
+	atomic_t head;
+	/** Region being filled */
+	int current;
+	/**
+	 * First region that may have been written to since the last batch
+	 * using the ring, and head when that batch was submitted.
+	 */
+	int unfenced;
+	int fenced_head;
+	/** Last batch that may read from each region, or NULL */
+	drm_intel_bo **fence;
 };
 
 static unsigned int
@@ -246,8 +506,29 @@ static void drm_intel_gem_bo_unreference_locked_timed(drm_intel_bo *bo,
 
 static void drm_intel_gem_bo_unreference(drm_intel_bo *bo);
 
+static void drm_intel_gem_exec_reap_locked(drm_intel_bufmgr_gem *bufmgr_gem,
+					   uint64_t until);
+
+static void drm_intel_gem_bo_exec_sync(drm_intel_bo *bo, bool locked);
+
+static void drm_intel_gem_exec_queue_destroy(drm_intel_bufmgr_gem *bufmgr_gem);
+
 static void drm_intel_gem_bo_free(drm_intel_bo *bo);
 
+static void drm_intel_gem_bo_unmap_vmas(drm_intel_bufmgr_gem *bufmgr_gem,
+					drm_intel_bo_gem *bo_gem);
+
+static void drm_intel_gem_upload_rings_fence(drm_intel_bufmgr_gem *bufmgr_gem,
+					     drm_intel_bo *batch);
+
+static drm_intel_bo *
+drm_intel_gem_bo_alloc_internal(drm_intel_bufmgr *bufmgr,
+				const char *name,
+				unsigned long size,
+				unsigned long flags,
+				uint32_t tiling_mode,
+				unsigned long stride);
+
 static unsigned long
 drm_intel_gem_bo_tile_size(drm_intel_bufmgr_gem *bufmgr_gem, unsigned long size,
 			   uint32_t *tiling_mode)
@@ -334,17 +615,22 @@ static struct drm_intel_gem_bo_bucket *
 drm_intel_gem_bo_bucket_for_size(drm_intel_bufmgr_gem *bufmgr_gem,
 				 unsigned long size)
 {
-	int i;
+	int lo = 0, hi = bufmgr_gem->num_buckets;
 
-	for (i = 0; i < bufmgr_gem->num_buckets; i++) {
-		struct drm_intel_gem_bo_bucket *bucket =
-		    &bufmgr_gem->cache_bucket[i];
-		if (bucket->size >= size) {
-			return bucket;
-		}
+	/* Find the smallest size class that fits */
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (bufmgr_gem->cache_bucket[mid].size < size)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	return NULL;
+	if (lo == bufmgr_gem->num_buckets)
+		return NULL;
+
+	return &bufmgr_gem->cache_bucket[lo];
 }
 
 static void
@@ -388,6 +674,59 @@ drm_intel_gem_bo_reference(drm_intel_bo *bo)
 	atomic_inc(&bo_gem->refcount);
 }
 
+/**
+ * Returns the buffer that holds the storage of bo, which is bo itself
+ * unless it was carved out of a slab.
+ */
+static inline drm_intel_bo *
+drm_intel_gem_bo_storage(drm_intel_bo *bo)
+{
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+
+	return bo_gem->slab ? bo_gem->slab->bo : bo;
+}
+
+/**
+ * Grows the validation arrays, which are kept across submissions so that
+ * they only ever get reallocated when a batch references more buffers than
+ * any batch before it.
+ */
+static int
+drm_intel_gem_grow_validate_list(drm_intel_bufmgr_gem *bufmgr_gem)
+{
+	struct drm_i915_gem_exec_object *exec_objects;
+	struct drm_i915_gem_exec_object2 *exec2_objects;
+	drm_intel_bo **exec_bos;
+	int new_size = bufmgr_gem->exec_size * 2;
+
+	if (new_size == 0)
+		new_size = 64;
+
+	exec_bos = realloc(bufmgr_gem->exec_bos,
+			   sizeof(*exec_bos) * new_size);
+	if (exec_bos == NULL)
+		return -ENOMEM;
+	bufmgr_gem->exec_bos = exec_bos;
+
+	/* Both flavours of the array follow exec_size, as a context may
+	 * use either submission ioctl.
+	 */
+	exec_objects = realloc(bufmgr_gem->exec_objects,
+			       sizeof(*exec_objects) * new_size);
+	if (exec_objects == NULL)
+		return -ENOMEM;
+	bufmgr_gem->exec_objects = exec_objects;
+
+	exec2_objects = realloc(bufmgr_gem->exec2_objects,
+				sizeof(*exec2_objects) * new_size);
+	if (exec2_objects == NULL)
+		return -ENOMEM;
+	bufmgr_gem->exec2_objects = exec2_objects;
+
+	bufmgr_gem->exec_size = new_size;
+	return 0;
+}
+
 /**
  * Adds the given buffer to the list of buffers to be validated (moved into the
  * appropriate memory type) with the next batch submission.
@@ -396,34 +735,24 @@ drm_intel_gem_bo_reference(drm_intel_bo *bo)
  * with the intersection of the memory type flags and the union of the
  * access flags.
  */
-static void
+static int
 drm_intel_add_validate_buffer(drm_intel_bo *bo)
 {
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
 	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
 	int index;
 
-	if (bo_gem->validate_index != -1)
-		return;
+	if (bo_gem->validate_gen == bufmgr_gem->exec_gen)
+		return 0;
 
 	/* Extend the array of validation entries as necessary. */
-	if (bufmgr_gem->exec_count == bufmgr_gem->exec_size) {
-		int new_size = bufmgr_gem->exec_size * 2;
-
-		if (new_size == 0)
-			new_size = 5;
-
-		bufmgr_gem->exec_objects =
-		    realloc(bufmgr_gem->exec_objects,
-			    sizeof(*bufmgr_gem->exec_objects) * new_size);
-		bufmgr_gem->exec_bos =
-		    realloc(bufmgr_gem->exec_bos,
-			    sizeof(*bufmgr_gem->exec_bos) * new_size);
-		bufmgr_gem->exec_size = new_size;
-	}
+	if (bufmgr_gem->exec_count == bufmgr_gem->exec_size &&
+	    drm_intel_gem_grow_validate_list(bufmgr_gem))
+		return -ENOMEM;
 
 	index = bufmgr_gem->exec_count;
 	bo_gem->validate_index = index;
+	bo_gem->validate_gen = bufmgr_gem->exec_gen;
 	/* Fill in array entry */
 	bufmgr_gem->exec_objects[index].handle = bo_gem->gem_handle;
 	bufmgr_gem->exec_objects[index].relocation_count = bo_gem->reloc_count;
@@ -432,55 +761,45 @@ drm_intel_add_validate_buffer(drm_intel_bo *bo)
 	bufmgr_gem->exec_objects[index].offset = 0;
 	bufmgr_gem->exec_bos[index] = bo;
 	bufmgr_gem->exec_count++;
+	return 0;
 }
 
-static void
-drm_intel_add_validate_buffer2(drm_intel_bo *bo, int need_fence)
+static int
+drm_intel_add_validate_buffer2(drm_intel_bo *bo, uint64_t flags)
 {
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bo->bufmgr;
 	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *)bo;
 	int index;
 
-	if (bo_gem->validate_index != -1) {
-		if (need_fence)
-			bufmgr_gem->exec2_objects[bo_gem->validate_index].flags |=
-				EXEC_OBJECT_NEEDS_FENCE;
-		return;
+	if (bo_gem->validate_gen == bufmgr_gem->exec_gen) {
+		bufmgr_gem->exec2_objects[bo_gem->validate_index].flags |= flags;
+		return 0;
 	}
 
 	/* Extend the array of validation entries as necessary. */
-	if (bufmgr_gem->exec_count == bufmgr_gem->exec_size) {
-		int new_size = bufmgr_gem->exec_size * 2;
-
-		if (new_size == 0)
-			new_size = 5;
-
-		bufmgr_gem->exec2_objects =
-			realloc(bufmgr_gem->exec2_objects,
-				sizeof(*bufmgr_gem->exec2_objects) * new_size);
-		bufmgr_gem->exec_bos =
-			realloc(bufmgr_gem->exec_bos,
-				sizeof(*bufmgr_gem->exec_bos) * new_size);
-		bufmgr_gem->exec_size = new_size;
-	}
+	if (bufmgr_gem->exec_count == bufmgr_gem->exec_size &&
+	    drm_intel_gem_grow_validate_list(bufmgr_gem))
+		return -ENOMEM;
 
 	index = bufmgr_gem->exec_count;
 	bo_gem->validate_index = index;
+	bo_gem->validate_gen = bufmgr_gem->exec_gen;
 	/* Fill in array entry */
 	bufmgr_gem->exec2_objects[index].handle = bo_gem->gem_handle;
 	bufmgr_gem->exec2_objects[index].relocation_count = bo_gem->reloc_count;
 	bufmgr_gem->exec2_objects[index].relocs_ptr = (uintptr_t)bo_gem->relocs;
 	bufmgr_gem->exec2_objects[index].alignment = 0;
-	bufmgr_gem->exec2_objects[index].offset = 0;
+	/* Tell the kernel where we believe the buffer is, so that it can
+	 * skip the relocations if it is still there.
+	 */
+	bufmgr_gem->exec2_objects[index].offset =
+		bufmgr_gem->no_reloc ? bo->offset : 0;
 	bufmgr_gem->exec_bos[index] = bo;
-	bufmgr_gem->exec2_objects[index].flags = 0;
+	bufmgr_gem->exec2_objects[index].flags = flags;
 	bufmgr_gem->exec2_objects[index].rsvd1 = 0;
 	bufmgr_gem->exec2_objects[index].rsvd2 = 0;
-	if (need_fence) {
-		bufmgr_gem->exec2_objects[index].flags |=
-			EXEC_OBJECT_NEEDS_FENCE;
-	}
 	bufmgr_gem->exec_count++;
+	return 0;
 }
 
 #define RELOC_BUF_SIZE(x) ((I915_RELOC_HEADER + x * I915_RELOC0_STRIDE) * \
@@ -519,46 +838,174 @@ drm_intel_bo_gem_set_in_aperture_size(drm_intel_bufmgr_gem *bufmgr_gem,
 		size = 2 * min_size;
 	}
 
-	bo_gem->reloc_tree_size = size;
+	bo_gem->reloc_tree_size += size - bo_gem->aperture_size;
+	bo_gem->aperture_size = size;
+}
+
+static int
+drm_intel_gem_reloc_capacity(drm_intel_bufmgr_gem *bufmgr_gem, int class)
+{
+	if (class + RELOC_MIN_SHIFT >= 31 ||
+	    1 << (class + RELOC_MIN_SHIFT) > bufmgr_gem->max_relocs)
+		return bufmgr_gem->max_relocs;
+
+	return 1 << (class + RELOC_MIN_SHIFT);
+}
+
+/**
+ * Takes a relocation list of the given class off its free list, or makes
+ * a new one.  Called with bufmgr_gem->lock held.
+ */
+static void *
+drm_intel_gem_reloc_alloc_locked(drm_intel_bufmgr_gem *bufmgr_gem, int class)
+{
+	size_t size = drm_intel_gem_reloc_capacity(bufmgr_gem, class) *
+		RELOC_ENTRY_SIZE;
+	void *list = bufmgr_gem->reloc_free[class];
+	char *chunk;
+
+	if (list != NULL) {
+		bufmgr_gem->reloc_free[class] = *(void **) list;
+		return list;
+	}
+
+	if (size > RELOC_CHUNK_SIZE / 4) {
+		list = malloc(size);
+		if (list != NULL)
+			bufmgr_gem->exec_stats.reloc_bytes += size;
+		return list;
+	}
+
+	if (bufmgr_gem->reloc_chunk_next == NULL ||
+	    bufmgr_gem->reloc_chunk_end - bufmgr_gem->reloc_chunk_next <
+	    (ptrdiff_t) size) {
+		chunk = malloc(RELOC_CHUNK_SIZE);
+		if (chunk == NULL)
+			return NULL;
+		bufmgr_gem->exec_stats.reloc_bytes += RELOC_CHUNK_SIZE;
+
+		/* Keep the entries 8 byte aligned after the link */
+		*(void **) chunk = bufmgr_gem->reloc_chunks;
+		bufmgr_gem->reloc_chunks = chunk;
+		bufmgr_gem->reloc_chunk_next = chunk + 16;
+		bufmgr_gem->reloc_chunk_end = chunk + RELOC_CHUNK_SIZE;
+	}
+
+	list = bufmgr_gem->reloc_chunk_next;
+	bufmgr_gem->reloc_chunk_next += size;
+	return list;
+}
+
+/**
+ * Puts the relocation list of a buffer that is being closed back on its
+ * free list.  Called with bufmgr_gem->lock held.
+ */
+static void
+drm_intel_gem_reloc_release_locked(drm_intel_bufmgr_gem *bufmgr_gem,
+				   drm_intel_bo_gem *bo_gem)
+{
+	if (bo_gem->relocs == NULL)
+		return;
+
+	*(void **) bo_gem->relocs = bufmgr_gem->reloc_free[bo_gem->reloc_class];
+	bufmgr_gem->reloc_free[bo_gem->reloc_class] = bo_gem->relocs;
+	bo_gem->relocs = NULL;
+	bo_gem->reloc_target_info = NULL;
+}
+
+static void
+drm_intel_gem_reloc_arena_destroy(drm_intel_bufmgr_gem *bufmgr_gem)
+{
+	int i;
+
+	for (i = 0; i < RELOC_CLASSES; i++) {
+		size_t size = drm_intel_gem_reloc_capacity(bufmgr_gem, i) *
+			RELOC_ENTRY_SIZE;
+
+		if (size <= RELOC_CHUNK_SIZE / 4)
+			continue;
+
+		while (bufmgr_gem->reloc_free[i] != NULL) {
+			void *list = bufmgr_gem->reloc_free[i];
+
+			bufmgr_gem->reloc_free[i] = *(void **) list;
+			free(list);
+		}
+	}
+
+	while (bufmgr_gem->reloc_chunks != NULL) {
+		void *chunk = bufmgr_gem->reloc_chunks;
+
+		bufmgr_gem->reloc_chunks = *(void **) chunk;
+		free(chunk);
+	}
 }
 
+/**
+ * Gives bo a relocation list, or moves its entries to one twice as large.
+ */
 static int
 drm_intel_setup_reloc_list(drm_intel_bo *bo)
 {
 	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
-	unsigned int max_relocs = bufmgr_gem->max_relocs;
+	int class = bo_gem->relocs ? bo_gem->reloc_class + 1 : 0;
+	int capacity = drm_intel_gem_reloc_capacity(bufmgr_gem, class);
+	struct drm_i915_gem_relocation_entry *relocs;
+	drm_intel_reloc_target *target_info;
 
-	if (bo->size / 4 < max_relocs)
-		max_relocs = bo->size / 4;
+	/* A queued batch may still be about to hand the old list over */
+	if (bo_gem->relocs != NULL)
+		drm_intel_gem_bo_exec_sync(bo, false);
 
-	bo_gem->relocs = malloc(max_relocs *
-				sizeof(struct drm_i915_gem_relocation_entry));
-	bo_gem->reloc_target_info = malloc(max_relocs *
-					   sizeof(drm_intel_reloc_target));
-	if (bo_gem->relocs == NULL || bo_gem->reloc_target_info == NULL) {
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	relocs = drm_intel_gem_reloc_alloc_locked(bufmgr_gem, class);
+	if (relocs == NULL) {
+		pthread_mutex_unlock(&bufmgr_gem->lock);
 		bo_gem->has_error = true;
-
-		free (bo_gem->relocs);
-		bo_gem->relocs = NULL;
-
-		free (bo_gem->reloc_target_info);
-		bo_gem->reloc_target_info = NULL;
-
 		return 1;
 	}
+	target_info = (drm_intel_reloc_target *) (relocs + capacity);
+
+	if (bo_gem->relocs != NULL) {
+		memcpy(relocs, bo_gem->relocs,
+		       bo_gem->reloc_count * sizeof(*relocs));
+		memcpy(target_info, bo_gem->reloc_target_info,
+		       bo_gem->reloc_count * sizeof(*target_info));
+		drm_intel_gem_reloc_release_locked(bufmgr_gem, bo_gem);
+	}
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	bo_gem->relocs = relocs;
+	bo_gem->reloc_target_info = target_info;
+	bo_gem->reloc_class = class;
 
 	return 0;
 }
 
+/**
+ * drm_intel_gem_bo_busy() for callers holding the bufmgr lock.
+ */
 static int
-drm_intel_gem_bo_busy(drm_intel_bo *bo)
+drm_intel_gem_bo_busy_locked(drm_intel_bo *bo)
 {
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
 	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	drm_intel_bo_gem *storage_gem =
+		(drm_intel_bo_gem *) drm_intel_gem_bo_storage(bo);
 	struct drm_i915_gem_busy busy;
 	int ret;
 
+	/* A batch that hasn't reached the kernel yet keeps the buffer busy,
+	 * but pick up the submissions that have so polling terminates.
+	 */
+	if (atomic_read(&storage_gem->exec_pending)) {
+		drm_intel_gem_exec_reap_locked(bufmgr_gem,
+					       bufmgr_gem->exec_queue->reaped);
+		if (atomic_read(&storage_gem->exec_pending))
+			return 1;
+	}
+
 	VG_CLEAR(busy);
 	busy.handle = bo_gem->gem_handle;
 
@@ -567,6 +1014,24 @@ drm_intel_gem_bo_busy(drm_intel_bo *bo)
 	return (ret == 0 && busy.busy);
 }
 
+static int
+drm_intel_gem_bo_busy(drm_intel_bo *bo)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *storage_gem =
+		(drm_intel_bo_gem *) drm_intel_gem_bo_storage(bo);
+	int ret;
+
+	if (atomic_read(&storage_gem->exec_pending)) {
+		pthread_mutex_lock(&bufmgr_gem->lock);
+		ret = drm_intel_gem_bo_busy_locked(bo);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return ret;
+	}
+
+	return drm_intel_gem_bo_busy_locked(bo);
+}
+
 static int
 drm_intel_gem_bo_madvise_internal(drm_intel_bufmgr_gem *bufmgr_gem,
 				  drm_intel_bo_gem *bo_gem, int state)
@@ -585,78 +1050,192 @@ drm_intel_gem_bo_madvise_internal(drm_intel_bufmgr_gem *bufmgr_gem,
 static int
 drm_intel_gem_bo_madvise(drm_intel_bo *bo, int madv)
 {
+	/* The slab's buffer is purgeable only as a whole */
+	if (((drm_intel_bo_gem *) bo)->slab != NULL)
+		return 1;
+
 	return drm_intel_gem_bo_madvise_internal
 		((drm_intel_bufmgr_gem *) bo->bufmgr,
 		 (drm_intel_bo_gem *) bo,
 		 madv);
 }
 
-/* drop the oldest entries that have been purged by the kernel */
+/** Removes a buffer from the cache.  Called with bufmgr_gem->lock held. */
 static void
-drm_intel_gem_bo_cache_purge_bucket(drm_intel_bufmgr_gem *bufmgr_gem,
-				    struct drm_intel_gem_bo_bucket *bucket)
+drm_intel_gem_bo_cache_del(drm_intel_bufmgr_gem *bufmgr_gem,
+			   drm_intel_bo_gem *bo_gem)
 {
-	while (!DRMLISTEMPTY(&bucket->head)) {
+	DRMLISTDEL(&bo_gem->head);
+	DRMLISTDEL(&bo_gem->lru);
+	bufmgr_gem->cache_bytes -= bo_gem->bo.size;
+}
+
+/**
+ * Frees the least recently cached buffers until we are back under the
+ * cache_max_bytes limit.  Called with bufmgr_gem->lock held.
+ */
+static void
+drm_intel_gem_bo_cache_trim(drm_intel_bufmgr_gem *bufmgr_gem)
+{
+	if (bufmgr_gem->cache_max_bytes == 0)
+		return;
+
+	while (bufmgr_gem->cache_bytes > bufmgr_gem->cache_max_bytes) {
 		drm_intel_bo_gem *bo_gem;
 
 		bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
-				      bucket->head.next, head);
-		if (drm_intel_gem_bo_madvise_internal
-		    (bufmgr_gem, bo_gem, I915_MADV_DONTNEED))
-			break;
-
-		DRMLISTDEL(&bo_gem->head);
+				      bufmgr_gem->cache_lru.next, lru);
+		drm_intel_gem_bo_cache_del(bufmgr_gem, bo_gem);
 		drm_intel_gem_bo_free(&bo_gem->bo);
+		bufmgr_gem->cache_evictions++;
 	}
 }
 
-static drm_intel_bo *
-drm_intel_gem_bo_alloc_internal(drm_intel_bufmgr *bufmgr,
-				const char *name,
-				unsigned long size,
-				unsigned long flags,
-				uint32_t tiling_mode,
-				unsigned long stride)
+/**
+ * Puts an unused, purgeable buffer on its bucket list.  Called with
+ * bufmgr_gem->lock held.
+ */
+static void
+drm_intel_gem_bo_cache_add(drm_intel_bufmgr_gem *bufmgr_gem,
+			   struct drm_intel_gem_bo_bucket *bucket,
+			   drm_intel_bo_gem *bo_gem, time_t time)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
-	drm_intel_bo_gem *bo_gem;
-	unsigned int page_size = getpagesize();
-	int ret;
-	struct drm_intel_gem_bo_bucket *bucket;
-	bool alloc_from_cache;
-	unsigned long bo_size;
-	bool for_render = false;
+	bo_gem->free_time = time;
+	DRMLISTADDTAIL(&bo_gem->head, &bucket->head[bo_gem->tiling_mode]);
+	DRMLISTADDTAIL(&bo_gem->lru, &bufmgr_gem->cache_lru);
+	bufmgr_gem->cache_bytes += bo_gem->bo.size;
 
-	if (flags & BO_ALLOC_FOR_RENDER)
-		for_render = true;
+	drm_intel_gem_bo_cache_trim(bufmgr_gem);
+}
 
-	/* Round the allocated size up to a power of two number of pages. */
-	bucket = drm_intel_gem_bo_bucket_for_size(bufmgr_gem, size);
+/** Frees all buffers of the shared cache. */
+static void
+drm_intel_gem_bo_cache_empty(drm_intel_bufmgr_gem *bufmgr_gem)
+{
+	while (!DRMLISTEMPTY(&bufmgr_gem->cache_lru)) {
+		drm_intel_bo_gem *bo_gem;
 
-	/* If we don't have caching at this size, don't actually round the
-	 * allocation up.
-	 */
-	if (bucket == NULL) {
-		bo_size = size;
-		if (bo_size < page_size)
-			bo_size = page_size;
-	} else {
-		bo_size = bucket->size;
-	}
+		bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
+				      bufmgr_gem->cache_lru.next, lru);
+		drm_intel_gem_bo_cache_del(bufmgr_gem, bo_gem);
+		drm_intel_gem_bo_free(&bo_gem->bo);
+	}
+}
+
+/* drop the oldest entries that have been purged by the kernel */
+static void
+drm_intel_gem_bo_cache_purge_bucket(drm_intel_bufmgr_gem *bufmgr_gem,
+				    struct drm_intel_gem_bo_bucket *bucket)
+{
+	int i;
+
+	for (i = 0; i < TILING_LISTS; i++) {
+		while (!DRMLISTEMPTY(&bucket->head[i])) {
+			drm_intel_bo_gem *bo_gem;
+
+			bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
+					      bucket->head[i].next, head);
+			if (drm_intel_gem_bo_madvise_internal
+			    (bufmgr_gem, bo_gem, I915_MADV_DONTNEED))
+				break;
+
+			drm_intel_gem_bo_cache_del(bufmgr_gem, bo_gem);
+			drm_intel_gem_bo_free(&bo_gem->bo);
+		}
+	}
+}
+
+/**
+ * Picks the buffer to reuse from a bucket, preferring one that already has
+ * the requested tiling and stride.  Render targets are taken from the MRU
+ * end of the lists, everything else from the LRU end.  Called with
+ * bufmgr_gem->lock held.
+ */
+static drm_intel_bo_gem *
+drm_intel_gem_bo_cache_find(struct drm_intel_gem_bo_bucket *bucket,
+			    bool for_render,
+			    uint32_t tiling_mode,
+			    unsigned long stride)
+{
+	drmMMListHead *head = &bucket->head[tiling_mode];
+	drmMMListHead *list;
+	int i;
+
+	list = for_render ? head->prev : head->next;
+	for (i = 0; list != head && i < TILING_SCAN; i++) {
+		drm_intel_bo_gem *bo_gem;
+
+		bo_gem = DRMLISTENTRY(drm_intel_bo_gem, list, head);
+		if (bo_gem->stride == stride)
+			return bo_gem;
+
+		list = for_render ? list->prev : list->next;
+	}
+
+	/* Anything else will need a SET_TILING, so the tiling doesn't
+	 * matter much.  Still try the same one first, as that keeps the
+	 * fence alignment we already paid for.
+	 */
+	for (i = 0; i < TILING_LISTS; i++) {
+		head = &bucket->head[(tiling_mode + i) % TILING_LISTS];
+		if (!DRMLISTEMPTY(head))
+			return DRMLISTENTRY(drm_intel_bo_gem,
+					    for_render ? head->prev : head->next,
+					    head);
+	}
+
+	return NULL;
+}
+
+/**
+ * Gives a reused buffer the requested tiling and stride, counting whether
+ * that took a SET_TILING ioctl.
+ */
+static int
+drm_intel_gem_bo_cache_retile(drm_intel_bo_gem *bo_gem,
+			      uint32_t tiling_mode,
+			      unsigned long stride,
+			      drm_intel_bo_cache_stats *stats)
+{
+	if (bo_gem->tiling_mode == tiling_mode && bo_gem->stride == stride) {
+		if (stats)
+			stats->set_tiling_avoided++;
+		return 0;
+	}
+
+	if (stats)
+		stats->set_tiling_needed++;
+	return drm_intel_gem_bo_set_tiling_internal(&bo_gem->bo,
+						    tiling_mode, stride);
+}
+
+/**
+ * Takes a buffer of the given bucket size from the shared cache, or returns
+ * NULL if there is no suitable one.  Called with bufmgr_gem->lock held.
+ */
+static drm_intel_bo_gem *
+drm_intel_gem_bo_cache_alloc_locked(drm_intel_bufmgr_gem *bufmgr_gem,
+				    struct drm_intel_gem_bo_bucket *bucket,
+				    bool for_render,
+				    uint32_t tiling_mode,
+				    unsigned long stride,
+				    drm_intel_bo_cache_stats *stats)
+{
+	drm_intel_bo_gem *bo_gem;
+	bool alloc_from_cache;
 
-	pthread_mutex_lock(&bufmgr_gem->lock);
 	/* Get a buffer out of the cache if available */
 retry:
 	alloc_from_cache = false;
-	if (bucket != NULL && !DRMLISTEMPTY(&bucket->head)) {
+	bo_gem = drm_intel_gem_bo_cache_find(bucket, for_render,
+					     tiling_mode, stride);
+	if (bo_gem != NULL) {
 		if (for_render) {
 			/* Allocate new render-target BOs from the tail (MRU)
 			 * of the list, as it will likely be hot in the GPU
 			 * cache and in the aperture for us.
 			 */
-			bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
-					      bucket->head.prev, head);
-			DRMLISTDEL(&bo_gem->head);
+			drm_intel_gem_bo_cache_del(bufmgr_gem, bo_gem);
 			alloc_from_cache = true;
 		} else {
 			/* For non-render-target BOs (where we're probably
@@ -666,11 +1245,9 @@ retry:
 			 * allocating a new buffer is probably faster than
 			 * waiting for the GPU to finish.
 			 */
-			bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
-					      bucket->head.next, head);
 			if (!drm_intel_gem_bo_busy(&bo_gem->bo)) {
 				alloc_from_cache = true;
-				DRMLISTDEL(&bo_gem->head);
+				drm_intel_gem_bo_cache_del(bufmgr_gem, bo_gem);
 			}
 		}
 
@@ -683,58 +1260,260 @@ retry:
 				goto retry;
 			}
 
-			if (drm_intel_gem_bo_set_tiling_internal(&bo_gem->bo,
-								 tiling_mode,
-								 stride)) {
+			if (drm_intel_gem_bo_cache_retile(bo_gem,
+							  tiling_mode,
+							  stride, stats)) {
 				drm_intel_gem_bo_free(&bo_gem->bo);
 				goto retry;
 			}
 		}
 	}
+
+	return alloc_from_cache ? bo_gem : NULL;
+}
+
+static drm_intel_bo_gem *
+drm_intel_gem_bo_cache_alloc(drm_intel_bufmgr_gem *bufmgr_gem,
+			     struct drm_intel_gem_bo_bucket *bucket,
+			     bool for_render,
+			     uint32_t tiling_mode,
+			     unsigned long stride,
+			     drm_intel_bo_cache_stats *stats)
+{
+	drm_intel_bo_gem *bo_gem;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	bo_gem = drm_intel_gem_bo_cache_alloc_locked(bufmgr_gem, bucket,
+						     for_render, tiling_mode,
+						     stride, stats);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	return bo_gem;
+}
+
+/**
+ * Returns the calling thread's cache for this bufmgr, creating it on first
+ * use, or NULL if buffers are not being reused.
+ */
+static struct drm_intel_gem_bo_tcache *
+drm_intel_gem_bo_tcache_get(drm_intel_bufmgr_gem *bufmgr_gem)
+{
+	struct drm_intel_gem_bo_tcache *tc;
+
+	if (!bufmgr_gem->bo_reuse || bufmgr_gem->tcache_bins == 0)
+		return NULL;
+
+	tc = pthread_getspecific(bufmgr_gem->tcache_key);
+	if (tc != NULL)
+		return tc;
+
+	tc = calloc(1, sizeof(*tc) +
+		    bufmgr_gem->tcache_bins * sizeof(tc->bin[0]));
+	if (tc == NULL)
+		return NULL;
+
+	if (pthread_setspecific(bufmgr_gem->tcache_key, tc) != 0) {
+		free(tc);
+		return NULL;
+	}
+	tc->bufmgr_gem = bufmgr_gem;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	DRMLISTADDTAIL(&tc->link, &bufmgr_gem->tcache_list);
 	pthread_mutex_unlock(&bufmgr_gem->lock);
 
-	if (!alloc_from_cache) {
-		struct drm_i915_gem_create create;
+	return tc;
+}
 
-		bo_gem = calloc(1, sizeof(*bo_gem));
-		if (!bo_gem)
-			return NULL;
+/**
+ * Takes a buffer of the given bucket size from the thread cache, without
+ * locking.  Follows the same MRU/idle policy as the shared cache.
+ */
+static drm_intel_bo_gem *
+drm_intel_gem_bo_tcache_alloc(drm_intel_bufmgr_gem *bufmgr_gem,
+			      struct drm_intel_gem_bo_tcache *tc,
+			      struct drm_intel_gem_bo_bucket *bucket,
+			      bool for_render,
+			      uint32_t tiling_mode,
+			      unsigned long stride)
+{
+	struct drm_intel_gem_bo_tcache_bin *bin;
+	drm_intel_bo_gem *bo_gem;
+	int i = bucket - bufmgr_gem->cache_bucket;
+	int j, n;
 
-		bo_gem->bo.size = bo_size;
+	if (i >= bufmgr_gem->tcache_bins)
+		return NULL;
 
-		VG_CLEAR(create);
-		create.size = bo_size;
+	bin = &tc->bin[i];
+	if (bin->count == 0)
+		return NULL;
 
-		ret = drmIoctl(bufmgr_gem->fd,
-			       DRM_IOCTL_I915_GEM_CREATE,
-			       &create);
-		bo_gem->gem_handle = create.handle;
-		bo_gem->bo.handle = bo_gem->gem_handle;
-		if (ret != 0) {
-			free(bo_gem);
-			return NULL;
+	/* Prefer a buffer that already has the right tiling and stride */
+	j = for_render ? bin->count - 1 : 0;
+	for (n = 0; n < bin->count; n++) {
+		int k = for_render ? bin->count - 1 - n : n;
+
+		if (bin->bos[k]->tiling_mode == tiling_mode &&
+		    bin->bos[k]->stride == stride) {
+			j = k;
+			break;
 		}
-		bo_gem->bo.bufmgr = bufmgr;
+	}
 
-		bo_gem->tiling_mode = I915_TILING_NONE;
-		bo_gem->swizzle_mode = I915_BIT_6_SWIZZLE_NONE;
-		bo_gem->stride = 0;
+	bo_gem = bin->bos[j];
+	if (!for_render && drm_intel_gem_bo_busy(&bo_gem->bo))
+		return NULL;
+	bin->count--;
+	memmove(bin->bos + j, bin->bos + j + 1,
+		(bin->count - j) * sizeof(bin->bos[0]));
 
-		if (drm_intel_gem_bo_set_tiling_internal(&bo_gem->bo,
-							 tiling_mode,
-							 stride)) {
-		    drm_intel_gem_bo_free(&bo_gem->bo);
-		    return NULL;
-		}
+	if (!drm_intel_gem_bo_madvise_internal(bufmgr_gem, bo_gem,
+					       I915_MADV_WILLNEED)) {
+		pthread_mutex_lock(&bufmgr_gem->lock);
+		drm_intel_gem_bo_free(&bo_gem->bo);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return NULL;
+	}
+
+	if (drm_intel_gem_bo_cache_retile(bo_gem, tiling_mode, stride,
+					  &tc->stats)) {
+		pthread_mutex_lock(&bufmgr_gem->lock);
+		drm_intel_gem_bo_free(&bo_gem->bo);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return NULL;
+	}
+
+	return bo_gem;
+}
+
+/**
+ * Rounds an allocation up to its cache bucket size, if it has one.
+ */
+static unsigned long
+drm_intel_gem_bo_round_size(drm_intel_bufmgr_gem *bufmgr_gem,
+			    unsigned long size,
+			    struct drm_intel_gem_bo_bucket **bucket)
+{
+	unsigned int page_size = getpagesize();
+
+	/* Round the allocated size up to a power of two number of pages. */
+	*bucket = drm_intel_gem_bo_bucket_for_size(bufmgr_gem, size);
+
+	/* If we don't have caching at this size, don't actually round the
+	 * allocation up.
+	 */
+	if (*bucket == NULL) {
+		if (size < page_size)
+			size = page_size;
+		return size;
+	}
+
+	return (*bucket)->size;
+}
 
-		DRMINITLISTHEAD(&bo_gem->name_list);
-		DRMINITLISTHEAD(&bo_gem->vma_list);
+/**
+ * Creates the GEM object behind a freshly allocated bo_gem.
+ */
+static int
+drm_intel_gem_bo_create(drm_intel_bufmgr_gem *bufmgr_gem,
+			drm_intel_bo_gem *bo_gem,
+			unsigned long bo_size,
+			uint32_t tiling_mode,
+			unsigned long stride)
+{
+	struct drm_i915_gem_create create;
+	int ret;
+
+	bo_gem->bo.size = bo_size;
+
+	VG_CLEAR(create);
+	create.size = bo_size;
+
+	ret = drmIoctl(bufmgr_gem->fd,
+		       DRM_IOCTL_I915_GEM_CREATE,
+		       &create);
+	if (ret != 0)
+		return -errno;
+
+	bo_gem->gem_handle = create.handle;
+	bo_gem->bo.handle = bo_gem->gem_handle;
+	bo_gem->bo.bufmgr = &bufmgr_gem->bufmgr;
+
+	bo_gem->tiling_mode = I915_TILING_NONE;
+	bo_gem->swizzle_mode = I915_BIT_6_SWIZZLE_NONE;
+	bo_gem->stride = 0;
+
+	DRMINITLISTHEAD(&bo_gem->name_list);
+	DRMINITLISTHEAD(&bo_gem->vma_list);
+
+	ret = drm_intel_gem_bo_set_tiling_internal(&bo_gem->bo,
+						   tiling_mode,
+						   stride);
+	if (ret != 0)
+		drmCloseBufferHandle(bufmgr_gem->fd, bo_gem->gem_handle);
+
+	return ret;
+}
+
+/**
+ * Looks for a reusable buffer in the thread cache, then in the shared one.
+ */
+static drm_intel_bo_gem *
+drm_intel_gem_bo_cache_lookup(drm_intel_bufmgr_gem *bufmgr_gem,
+			      struct drm_intel_gem_bo_bucket *bucket,
+			      bool for_render,
+			      uint32_t tiling_mode,
+			      unsigned long stride)
+{
+	struct drm_intel_gem_bo_tcache *tc;
+	drm_intel_bo_gem *bo_gem = NULL;
+
+	/* Try our own recently freed buffers first, then the ones
+	 * other threads have given back to the shared cache.
+	 */
+	tc = drm_intel_gem_bo_tcache_get(bufmgr_gem);
+	if (tc != NULL)
+		bo_gem = drm_intel_gem_bo_tcache_alloc(bufmgr_gem, tc,
+						       bucket,
+						       for_render,
+						       tiling_mode,
+						       stride);
+	if (bo_gem != NULL) {
+		tc->stats.hits++;
+		return bo_gem;
+	}
+
+	bo_gem = drm_intel_gem_bo_cache_alloc(bufmgr_gem, bucket,
+					      for_render, tiling_mode,
+					      stride,
+					      tc ? &tc->stats : NULL);
+	if (tc != NULL) {
+		if (bo_gem != NULL)
+			tc->stats.steals++;
+		else
+			tc->stats.misses++;
 	}
 
+	return bo_gem;
+}
+
+/**
+ * Resets the per-allocation state of a new or recycled buffer.
+ */
+static void
+drm_intel_gem_bo_init(drm_intel_bufmgr_gem *bufmgr_gem,
+		      drm_intel_bo_gem *bo_gem,
+		      const char *name)
+{
 	bo_gem->name = name;
 	atomic_set(&bo_gem->refcount, 1);
-	bo_gem->validate_index = -1;
+	bo_gem->validate_gen = 0;
 	bo_gem->reloc_tree_fences = 0;
+	bo_gem->reloc_tree_size = 0;
+	bo_gem->aperture_size = 0;
+	bo_gem->aperture_root = 0;
+	bo_gem->aperture_tag = 0;
 	bo_gem->used_as_reloc_target = false;
 	bo_gem->has_error = false;
 	bo_gem->reusable = true;
@@ -744,355 +1523,985 @@ retry:
 	drm_intel_bo_gem_set_in_aperture_size(bufmgr_gem, bo_gem);
 
 	DBG("bo_create: buf %d (%s) %ldb\n",
-	    bo_gem->gem_handle, bo_gem->name, size);
-
-	return &bo_gem->bo;
+	    bo_gem->gem_handle, bo_gem->name, bo_gem->bo.size);
 }
 
-static drm_intel_bo *
-drm_intel_gem_bo_alloc_for_render(drm_intel_bufmgr *bufmgr,
-				  const char *name,
-				  unsigned long size,
-				  unsigned int alignment)
+/**
+ * Updates the presumed offsets of a slab's chunks after its buffer moved.
+ */
+static void
+drm_intel_gem_slab_set_offset(struct drm_intel_gem_slab *slab)
 {
-	return drm_intel_gem_bo_alloc_internal(bufmgr, name, size,
-					       BO_ALLOC_FOR_RENDER,
-					       I915_TILING_NONE, 0);
-}
+	int i;
 
-static drm_intel_bo *
-drm_intel_gem_bo_alloc(drm_intel_bufmgr *bufmgr,
-		       const char *name,
-		       unsigned long size,
-		       unsigned int alignment)
-{
-	return drm_intel_gem_bo_alloc_internal(bufmgr, name, size, 0,
-					       I915_TILING_NONE, 0);
+	for (i = 0; i < SLAB_CHUNKS; i++)
+		slab->chunk[i].bo.offset = slab->bo->offset +
+					   slab->chunk[i].slab_offset;
 }
 
-static drm_intel_bo *
-drm_intel_gem_bo_alloc_tiled(drm_intel_bufmgr *bufmgr, const char *name,
-			     int x, int y, int cpp, uint32_t *tiling_mode,
-			     unsigned long *pitch, unsigned long flags)
+static struct drm_intel_gem_slab *
+drm_intel_gem_slab_create(drm_intel_bufmgr_gem *bufmgr_gem,
+			  unsigned long chunk_size)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
-	unsigned long size, stride;
-	uint32_t tiling;
-
-	do {
-		unsigned long aligned_y, height_alignment;
-
-		tiling = *tiling_mode;
+	struct drm_intel_gem_slab *slab;
+	int i;
 
-		/* If we're tiled, our allocations are in 8 or 32-row blocks,
-		 * so failure to align our height means that we won't allocate
-		 * enough pages.
-		 *
-		 * If we're untiled, we still have to align to 2 rows high
-		 * because the data port accesses 2x2 blocks even if the
-		 * bottom row isn't to be rendered, so failure to align means
-		 * we could walk off the end of the GTT and fault.  This is
-		 * documented on 965, and may be the case on older chipsets
-		 * too so we try to be careful.
-		 */
-		aligned_y = y;
-		height_alignment = 2;
+	slab = calloc(1, sizeof(*slab));
+	if (slab == NULL)
+		return NULL;
 
-		if ((bufmgr_gem->gen == 2) && tiling != I915_TILING_NONE)
-			height_alignment = 16;
-		else if (tiling == I915_TILING_X
-			|| (IS_915(bufmgr_gem->pci_device)
-			    && tiling == I915_TILING_Y))
-			height_alignment = 8;
-		else if (tiling == I915_TILING_Y)
-			height_alignment = 32;
-		aligned_y = ALIGN(y, height_alignment);
+	slab->bo = drm_intel_gem_bo_alloc_internal(&bufmgr_gem->bufmgr, "slab",
+						   chunk_size * SLAB_CHUNKS,
+						   0, I915_TILING_NONE, 0);
+	if (slab->bo == NULL) {
+		free(slab);
+		return NULL;
+	}
+	((drm_intel_bo_gem *) slab->bo)->backing_slab = slab;
 
-		stride = x * cpp;
-		stride = drm_intel_gem_bo_tile_pitch(bufmgr_gem, stride, tiling_mode);
-		size = stride * aligned_y;
-		size = drm_intel_gem_bo_tile_size(bufmgr_gem, size, tiling_mode);
-	} while (*tiling_mode != tiling);
-	*pitch = stride;
+	slab->chunk_size = chunk_size;
+	slab->free = ~0ULL;
+	for (i = 0; i < SLAB_CHUNKS; i++) {
+		slab->chunk[i].slab = slab;
+		slab->chunk[i].slab_offset = i * chunk_size;
+	}
+	drm_intel_gem_slab_set_offset(slab);
 
-	if (tiling == I915_TILING_NONE)
-		stride = 0;
+	return slab;
+}
 
-	return drm_intel_gem_bo_alloc_internal(bufmgr, name, size, flags,
-					       tiling, stride);
+/** Called with bufmgr_gem->lock held. */
+static void
+drm_intel_gem_slab_destroy(struct drm_intel_gem_slab *slab, time_t time)
+{
+	DRMLISTDEL(&slab->link);
+	((drm_intel_bo_gem *) slab->bo)->backing_slab = NULL;
+	drm_intel_gem_bo_unreference_locked_timed(slab->bo, time);
+	free(slab);
 }
 
 /**
- * Returns a drm_intel_bo wrapping the given buffer object handle.
- *
- * This can be used when one application needs to pass a buffer object
- * to another.
+ * Carves a buffer of at most SLAB_MAX_SIZE bytes out of a slab.
  */
-drm_intel_bo *
-drm_intel_bo_gem_create_from_name(drm_intel_bufmgr *bufmgr,
-				  const char *name,
-				  unsigned int handle)
+static drm_intel_bo_gem *
+drm_intel_gem_slab_alloc(drm_intel_bufmgr_gem *bufmgr_gem,
+			 unsigned long size)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
+	struct drm_intel_gem_slab *slab, *new_slab = NULL;
+	drmMMListHead *slabs;
 	drm_intel_bo_gem *bo_gem;
-	int ret;
-	struct drm_gem_open open_arg;
-	struct drm_i915_gem_get_tiling get_tiling;
-	drmMMListHead *list;
+	int class = 0, i;
 
-	/* At the moment most applications only have a few named bo.
-	 * For instance, in a DRI client only the render buffers passed
-	 * between X and the client are named. And since X returns the
-	 * alternating names for the front/back buffer a linear search
-	 * provides a sufficiently fast match.
-	 */
-	for (list = bufmgr_gem->named.next;
-	     list != &bufmgr_gem->named;
-	     list = list->next) {
-		bo_gem = DRMLISTENTRY(drm_intel_bo_gem, list, name_list);
-		if (bo_gem->global_name == handle) {
-			drm_intel_gem_bo_reference(&bo_gem->bo);
-			return &bo_gem->bo;
-		}
-	}
+	while (size > (1UL << (SLAB_MIN_SHIFT + class)))
+		class++;
+	slabs = &bufmgr_gem->slabs[class];
 
-	bo_gem = calloc(1, sizeof(*bo_gem));
-	if (!bo_gem)
-		return NULL;
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	while (DRMLISTEMPTY(slabs) ||
+	       DRMLISTENTRY(struct drm_intel_gem_slab,
+			    slabs->next, link)->free == 0) {
+		if (new_slab != NULL) {
+			DRMLISTADD(&new_slab->link, slabs);
+			break;
+		}
 
-	VG_CLEAR(open_arg);
-	open_arg.name = handle;
-	ret = drmIoctl(bufmgr_gem->fd,
-		       DRM_IOCTL_GEM_OPEN,
-		       &open_arg);
-	if (ret != 0) {
-		DBG("Couldn't reference %s handle 0x%08x: %s\n",
-		    name, handle, strerror(errno));
-		free(bo_gem);
-		return NULL;
+		/* Getting the slab's buffer takes the lock */
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		new_slab = drm_intel_gem_slab_create(bufmgr_gem,
+						     1UL << (SLAB_MIN_SHIFT +
+							     class));
+		if (new_slab == NULL)
+			return NULL;
+		pthread_mutex_lock(&bufmgr_gem->lock);
 	}
-	bo_gem->bo.size = open_arg.size;
-	bo_gem->bo.offset = 0;
-	bo_gem->bo.virtual = NULL;
-	bo_gem->bo.bufmgr = bufmgr;
-	bo_gem->name = name;
-	atomic_set(&bo_gem->refcount, 1);
-	bo_gem->validate_index = -1;
-	bo_gem->gem_handle = open_arg.handle;
-	bo_gem->bo.handle = open_arg.handle;
-	bo_gem->global_name = handle;
-	bo_gem->reusable = false;
 
-	VG_CLEAR(get_tiling);
-	get_tiling.handle = bo_gem->gem_handle;
-	ret = drmIoctl(bufmgr_gem->fd,
-		       DRM_IOCTL_I915_GEM_GET_TILING,
-		       &get_tiling);
-	if (ret != 0) {
-		drm_intel_gem_bo_unreference(&bo_gem->bo);
-		return NULL;
+	slab = DRMLISTENTRY(struct drm_intel_gem_slab, slabs->next, link);
+	i = ffsll(slab->free) - 1;
+	slab->free &= ~(1ULL << i);
+	/* Keep the full slabs at the end of the list */
+	if (slab->free == 0) {
+		DRMLISTDEL(&slab->link);
+		DRMLISTADDTAIL(&slab->link, slabs);
 	}
-	bo_gem->tiling_mode = get_tiling.tiling_mode;
-	bo_gem->swizzle_mode = get_tiling.swizzle_mode;
-	/* XXX stride is unknown */
-	drm_intel_bo_gem_set_in_aperture_size(bufmgr_gem, bo_gem);
+	if (new_slab != NULL && new_slab != slab) {
+		/* Someone else freed a chunk meanwhile */
+		DRMLISTADDTAIL(&new_slab->link, slabs);
+	}
+	pthread_mutex_unlock(&bufmgr_gem->lock);
 
+	bo_gem = &slab->chunk[i];
+	bo_gem->bo.size = slab->chunk_size;
+	bo_gem->bo.offset = slab->bo->offset + bo_gem->slab_offset;
+	bo_gem->bo.virtual = NULL;
+	bo_gem->bo.bufmgr = &bufmgr_gem->bufmgr;
+	bo_gem->bo.handle = slab->bo->handle;
+	bo_gem->gem_handle = slab->bo->handle;
+	bo_gem->tiling_mode = I915_TILING_NONE;
+	bo_gem->swizzle_mode = I915_BIT_6_SWIZZLE_NONE;
+	bo_gem->stride = 0;
+	bo_gem->map_count = 0;
+	bo_gem->included_in_check_aperture = false;
+	DRMINITLISTHEAD(&bo_gem->name_list);
 	DRMINITLISTHEAD(&bo_gem->vma_list);
-	DRMLISTADDTAIL(&bo_gem->name_list, &bufmgr_gem->named);
-	DBG("bo_create_from_handle: %d (%s)\n", handle, bo_gem->name);
 
-	return &bo_gem->bo;
+	return bo_gem;
 }
 
-static void
-drm_intel_gem_bo_free(drm_intel_bo *bo)
+static drm_intel_bo *
+drm_intel_gem_bo_alloc_internal(drm_intel_bufmgr *bufmgr,
+				const char *name,
+				unsigned long size,
+				unsigned long flags,
+				uint32_t tiling_mode,
+				unsigned long stride)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-	struct drm_gem_close close;
-	int ret;
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
+	drm_intel_bo_gem *bo_gem = NULL;
+	struct drm_intel_gem_bo_bucket *bucket;
+	unsigned long bo_size;
+	bool for_render = false;
 
-	DRMLISTDEL(&bo_gem->vma_list);
-	if (bo_gem->mem_virtual) {
-		VG(VALGRIND_FREELIKE_BLOCK(bo_gem->mem_virtual, 0));
-		munmap(bo_gem->mem_virtual, bo_gem->bo.size);
-		bufmgr_gem->vma_count--;
-	}
-	if (bo_gem->gtt_virtual) {
-		munmap(bo_gem->gtt_virtual, bo_gem->bo.size);
-		bufmgr_gem->vma_count--;
-	}
+	if (flags & BO_ALLOC_FOR_RENDER)
+		for_render = true;
 
-	/* Close this object */
-	VG_CLEAR(close);
-	close.handle = bo_gem->gem_handle;
-	ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_GEM_CLOSE, &close);
-	if (ret != 0) {
-		DBG("DRM_IOCTL_GEM_CLOSE %d failed (%s): %s\n",
-		    bo_gem->gem_handle, bo_gem->name, strerror(errno));
+	if (bufmgr_gem->suballoc && size <= SLAB_MAX_SIZE &&
+	    tiling_mode == I915_TILING_NONE) {
+		bo_gem = drm_intel_gem_slab_alloc(bufmgr_gem, size);
+		if (bo_gem != NULL) {
+			drm_intel_gem_bo_init(bufmgr_gem, bo_gem, name);
+			return &bo_gem->bo;
+		}
 	}
-	free(bo_gem->aub_annotations);
-	free(bo);
-}
-
-static void
-drm_intel_gem_bo_mark_mmaps_incoherent(drm_intel_bo *bo)
-{
-#if HAVE_VALGRIND
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
 
-	if (bo_gem->mem_virtual)
-		VALGRIND_MAKE_MEM_NOACCESS(bo_gem->mem_virtual, bo->size);
+	bo_size = drm_intel_gem_bo_round_size(bufmgr_gem, size, &bucket);
 
-	if (bo_gem->gtt_virtual)
-		VALGRIND_MAKE_MEM_NOACCESS(bo_gem->gtt_virtual, bo->size);
-#endif
-}
+	if (bucket != NULL)
+		bo_gem = drm_intel_gem_bo_cache_lookup(bufmgr_gem, bucket,
+						       for_render,
+						       tiling_mode, stride);
 
-/** Frees all cached buffers significantly older than @time. */
-static void
-drm_intel_gem_cleanup_bo_cache(drm_intel_bufmgr_gem *bufmgr_gem, time_t time)
-{
-	int i;
+	if (bo_gem == NULL) {
+		bo_gem = calloc(1, sizeof(*bo_gem));
+		if (!bo_gem)
+			return NULL;
 
-	if (bufmgr_gem->time == time)
-		return;
+		if (drm_intel_gem_bo_create(bufmgr_gem, bo_gem, bo_size,
+					    tiling_mode, stride)) {
+			free(bo_gem);
+			return NULL;
+		}
+	}
 
-	for (i = 0; i < bufmgr_gem->num_buckets; i++) {
-		struct drm_intel_gem_bo_bucket *bucket =
-		    &bufmgr_gem->cache_bucket[i];
+	drm_intel_gem_bo_init(bufmgr_gem, bo_gem, name);
 
-		while (!DRMLISTEMPTY(&bucket->head)) {
-			drm_intel_bo_gem *bo_gem;
+	return &bo_gem->bo;
+}
 
-			bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
-					      bucket->head.next, head);
-			if (time - bo_gem->free_time <= 1)
-				break;
+/**
+ * Allocates \c count untiled buffers at once.
+ *
+ * Cached buffers are reused where possible, taking the cache lock only
+ * once for all of them, and the structs of the rest come from a single
+ * allocation.
+ */
+static int
+drm_intel_gem_bo_alloc_array(drm_intel_bufmgr *bufmgr,
+			     const char *name,
+			     int count,
+			     const unsigned long *sizes,
+			     unsigned int alignment,
+			     drm_intel_bo **bos)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
+	struct drm_intel_gem_bo_tcache *tc;
+	struct drm_intel_gem_bo_block *block;
+	drm_intel_bo_gem *bo_gem;
+	int i, n, missing = 0, ret = 0;
 
-			DRMLISTDEL(&bo_gem->head);
+	tc = drm_intel_gem_bo_tcache_get(bufmgr_gem);
 
-			drm_intel_gem_bo_free(&bo_gem->bo);
+	for (i = 0; i < count; i++) {
+		struct drm_intel_gem_bo_bucket *bucket;
+
+		bos[i] = NULL;
+		drm_intel_gem_bo_round_size(bufmgr_gem, sizes[i], &bucket);
+		if (bucket != NULL && tc != NULL) {
+			bo_gem = drm_intel_gem_bo_tcache_alloc(bufmgr_gem, tc,
+							       bucket, false,
+							       I915_TILING_NONE,
+							       0);
+			if (bo_gem != NULL) {
+				tc->stats.hits++;
+				bos[i] = &bo_gem->bo;
+				continue;
+			}
 		}
+		missing++;
 	}
 
-	bufmgr_gem->time = time;
-}
+	if (missing && bufmgr_gem->bo_reuse) {
+		pthread_mutex_lock(&bufmgr_gem->lock);
+		for (i = 0; i < count; i++) {
+			struct drm_intel_gem_bo_bucket *bucket;
+
+			if (bos[i] != NULL)
+				continue;
+
+			drm_intel_gem_bo_round_size(bufmgr_gem, sizes[i],
+						    &bucket);
+			if (bucket == NULL)
+				continue;
+
+			bo_gem = drm_intel_gem_bo_cache_alloc_locked(bufmgr_gem,
+								     bucket,
+								     false,
+								     I915_TILING_NONE,
+								     0,
+								     tc ? &tc->stats : NULL);
+			if (bo_gem != NULL) {
+				bos[i] = &bo_gem->bo;
+				missing--;
+			}
+			if (tc != NULL) {
+				if (bo_gem != NULL)
+					tc->stats.steals++;
+				else
+					tc->stats.misses++;
+			}
+		}
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+	}
 
-static void drm_intel_gem_bo_purge_vma_cache(drm_intel_bufmgr_gem *bufmgr_gem)
-{
-	int limit;
+	block = NULL;
+	if (missing) {
+		block = calloc(1, sizeof(*block) + missing * sizeof(*bo_gem));
+		if (block == NULL)
+			ret = -ENOMEM;
+	}
 
-	DBG("%s: cached=%d, open=%d, limit=%d\n", __FUNCTION__,
-	    bufmgr_gem->vma_count, bufmgr_gem->vma_open, bufmgr_gem->vma_max);
+	for (i = 0, n = 0; i < count; i++) {
+		unsigned long bo_size;
+		struct drm_intel_gem_bo_bucket *bucket;
 
-	if (bufmgr_gem->vma_max < 0)
-		return;
+		if (bos[i] != NULL) {
+			bo_gem = (drm_intel_bo_gem *) bos[i];
+			drm_intel_gem_bo_init(bufmgr_gem, bo_gem, name);
+			continue;
+		}
+		if (ret)
+			continue;
 
-	/* We may need to evict a few entries in order to create new mmaps */
-	limit = bufmgr_gem->vma_max - 2*bufmgr_gem->vma_open;
-	if (limit < 0)
-		limit = 0;
+		bo_gem = &block->bos[n++];
+		bo_size = drm_intel_gem_bo_round_size(bufmgr_gem, sizes[i],
+						      &bucket);
+		ret = drm_intel_gem_bo_create(bufmgr_gem, bo_gem, bo_size,
+					      I915_TILING_NONE, 0);
+		if (ret)
+			continue;
 
-	while (bufmgr_gem->vma_count > limit) {
-		drm_intel_bo_gem *bo_gem;
+		bo_gem->block = block;
+		atomic_inc(&block->refcount);
+		drm_intel_gem_bo_init(bufmgr_gem, bo_gem, name);
+		bos[i] = &bo_gem->bo;
+	}
 
-		bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
-				      bufmgr_gem->vma_cache.next,
-				      vma_list);
-		assert(bo_gem->map_count == 0);
-		DRMLISTDELINIT(&bo_gem->vma_list);
+	if (block != NULL && atomic_read(&block->refcount) == 0)
+		free(block);
 
-		if (bo_gem->mem_virtual) {
-			munmap(bo_gem->mem_virtual, bo_gem->bo.size);
-			bo_gem->mem_virtual = NULL;
-			bufmgr_gem->vma_count--;
-		}
-		if (bo_gem->gtt_virtual) {
-			munmap(bo_gem->gtt_virtual, bo_gem->bo.size);
-			bo_gem->gtt_virtual = NULL;
-			bufmgr_gem->vma_count--;
+	if (ret) {
+		for (i = 0; i < count; i++) {
+			if (bos[i] != NULL)
+				drm_intel_gem_bo_unreference(bos[i]);
+			bos[i] = NULL;
 		}
 	}
+
+	return ret;
 }
 
-static void drm_intel_gem_bo_close_vma(drm_intel_bufmgr_gem *bufmgr_gem,
-				       drm_intel_bo_gem *bo_gem)
+static drm_intel_bo *
+drm_intel_gem_bo_alloc_for_render(drm_intel_bufmgr *bufmgr,
+				  const char *name,
+				  unsigned long size,
+				  unsigned int alignment)
 {
-	bufmgr_gem->vma_open--;
-	DRMLISTADDTAIL(&bo_gem->vma_list, &bufmgr_gem->vma_cache);
-	if (bo_gem->mem_virtual)
-		bufmgr_gem->vma_count++;
-	if (bo_gem->gtt_virtual)
-		bufmgr_gem->vma_count++;
-	drm_intel_gem_bo_purge_vma_cache(bufmgr_gem);
+	return drm_intel_gem_bo_alloc_internal(bufmgr, name, size,
+					       BO_ALLOC_FOR_RENDER,
+					       I915_TILING_NONE, 0);
 }
 
-static void drm_intel_gem_bo_open_vma(drm_intel_bufmgr_gem *bufmgr_gem,
-				      drm_intel_bo_gem *bo_gem)
+static drm_intel_bo *
+drm_intel_gem_bo_alloc(drm_intel_bufmgr *bufmgr,
+		       const char *name,
+		       unsigned long size,
+		       unsigned int alignment)
 {
-	bufmgr_gem->vma_open++;
-	DRMLISTDEL(&bo_gem->vma_list);
-	if (bo_gem->mem_virtual)
-		bufmgr_gem->vma_count--;
-	if (bo_gem->gtt_virtual)
-		bufmgr_gem->vma_count--;
-	drm_intel_gem_bo_purge_vma_cache(bufmgr_gem);
+	return drm_intel_gem_bo_alloc_internal(bufmgr, name, size, 0,
+					       I915_TILING_NONE, 0);
 }
 
-static void
-drm_intel_gem_bo_unreference_final(drm_intel_bo *bo, time_t time)
+static drm_intel_bo *
+drm_intel_gem_bo_alloc_tiled(drm_intel_bufmgr *bufmgr, const char *name,
+			     int x, int y, int cpp, uint32_t *tiling_mode,
+			     unsigned long *pitch, unsigned long flags)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-	struct drm_intel_gem_bo_bucket *bucket;
-	int i;
-
-	/* Unreference all the target buffers */
-	for (i = 0; i < bo_gem->reloc_count; i++) {
-		if (bo_gem->reloc_target_info[i].bo != bo) {
-			drm_intel_gem_bo_unreference_locked_timed(bo_gem->
-								  reloc_target_info[i].bo,
-								  time);
-		}
-	}
-	bo_gem->reloc_count = 0;
-	bo_gem->used_as_reloc_target = false;
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+	unsigned long size, stride;
+	uint32_t tiling;
 
-	DBG("bo_unreference final: %d (%s)\n",
-	    bo_gem->gem_handle, bo_gem->name);
+	do {
+		unsigned long aligned_y, height_alignment;
 
-	/* release memory associated with this object */
-	if (bo_gem->reloc_target_info) {
-		free(bo_gem->reloc_target_info);
-		bo_gem->reloc_target_info = NULL;
-	}
-	if (bo_gem->relocs) {
-		free(bo_gem->relocs);
-		bo_gem->relocs = NULL;
-	}
+		tiling = *tiling_mode;
 
-	/* Clear any left-over mappings */
-	if (bo_gem->map_count) {
-		DBG("bo freed with non-zero map-count %d\n", bo_gem->map_count);
-		bo_gem->map_count = 0;
-		drm_intel_gem_bo_close_vma(bufmgr_gem, bo_gem);
-		drm_intel_gem_bo_mark_mmaps_incoherent(bo);
-	}
+		/* If we're tiled, our allocations are in 8 or 32-row blocks,
+		 * so failure to align our height means that we won't allocate
+		 * enough pages.
+		 *
+		 * If we're untiled, we still have to align to 2 rows high
+		 * because the data port accesses 2x2 blocks even if the
+		 * bottom row isn't to be rendered, so failure to align means
+		 * we could walk off the end of the GTT and fault.  This is
+		 * documented on 965, and may be the case on older chipsets
+		 * too so we try to be careful.
+		 */
+		aligned_y = y;
+		height_alignment = 2;
 
-	DRMLISTDEL(&bo_gem->name_list);
+		if ((bufmgr_gem->gen == 2) && tiling != I915_TILING_NONE)
+			height_alignment = 16;
+		else if (tiling == I915_TILING_X
+			|| (IS_915(bufmgr_gem->pci_device)
+			    && tiling == I915_TILING_Y))
+			height_alignment = 8;
+		else if (tiling == I915_TILING_Y)
+			height_alignment = 32;
+		aligned_y = ALIGN(y, height_alignment);
 
-	bucket = drm_intel_gem_bo_bucket_for_size(bufmgr_gem, bo->size);
-	/* Put the buffer into our internal cache for reuse if we can. */
+		stride = x * cpp;
+		stride = drm_intel_gem_bo_tile_pitch(bufmgr_gem, stride, tiling_mode);
+		size = stride * aligned_y;
+		size = drm_intel_gem_bo_tile_size(bufmgr_gem, size, tiling_mode);
+	} while (*tiling_mode != tiling);
+	*pitch = stride;
+
+	if (tiling == I915_TILING_NONE)
+		stride = 0;
+
+	return drm_intel_gem_bo_alloc_internal(bufmgr, name, size, flags,
+					       tiling, stride);
+}
+
+/**
+ * Wraps client memory with the USERPTR ioctl.  Returns NULL if the kernel
+ * doesn't support it or refuses this memory, and drm_intel_bo_alloc_userptr()
+ * then falls back to a copy.
+ */
+static drm_intel_bo *
+drm_intel_gem_bo_alloc_userptr(drm_intel_bufmgr *bufmgr,
+			       const char *name, void *addr,
+			       unsigned long size, unsigned long flags)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
+	drm_intel_bo_gem *bo_gem;
+	struct drm_i915_gem_userptr userptr;
+	int ret;
+
+	/* The kernel only wraps whole pages, don't bother asking otherwise */
+	if (size == 0 || (((uintptr_t) addr | size) & 4095))
+		return NULL;
+
+	bo_gem = calloc(1, sizeof(*bo_gem));
+	if (!bo_gem)
+		return NULL;
+
+	VG_CLEAR(userptr);
+	userptr.user_ptr = (uintptr_t) addr;
+	userptr.user_size = size;
+	userptr.flags = flags;
+	ret = drmIoctl(bufmgr_gem->fd,
+		       DRM_IOCTL_I915_GEM_USERPTR,
+		       &userptr);
+	if (ret != 0) {
+		DBG("bo_create_userptr: %p+%lu (%s) refused: %s\n",
+		    addr, size, name, strerror(errno));
+		free(bo_gem);
+		return NULL;
+	}
+
+	bo_gem->bo.size = size;
+	bo_gem->bo.bufmgr = bufmgr;
+	bo_gem->gem_handle = userptr.handle;
+	bo_gem->bo.handle = userptr.handle;
+	bo_gem->user_virtual = addr;
+	bo_gem->tiling_mode = I915_TILING_NONE;
+	bo_gem->swizzle_mode = I915_BIT_6_SWIZZLE_NONE;
+	DRMINITLISTHEAD(&bo_gem->name_list);
+	DRMINITLISTHEAD(&bo_gem->vma_list);
+
+	drm_intel_gem_bo_init(bufmgr_gem, bo_gem, name);
+	/* The pages belong to the client, the cache must not keep them */
+	bo_gem->reusable = false;
+
+	return &bo_gem->bo;
+}
+
+/**
+ * Records that a buffer is shared, so that importing it again finds this
+ * drm_intel_bo.  Called with bufmgr_gem->lock held.
+ */
+static void
+drm_intel_gem_bo_mark_shared_locked(drm_intel_bufmgr_gem *bufmgr_gem,
+				    drm_intel_bo_gem *bo_gem)
+{
+	bo_gem->reusable = false;
+	if (bo_gem->shared)
+		return;
+
+	bo_gem->shared = true;
+	DRMLISTADDTAIL(&bo_gem->name_list, &bufmgr_gem->named);
+	drmHashInsert(bufmgr_gem->handle_table, bo_gem->gem_handle, bo_gem);
+}
+
+/**
+ * Returns a drm_intel_bo wrapping the given buffer object handle.
+ *
+ * This can be used when one application needs to pass a buffer object
+ * to another.
+ */
+drm_intel_bo *
+drm_intel_bo_gem_create_from_name(drm_intel_bufmgr *bufmgr,
+				  const char *name,
+				  unsigned int handle)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
+	drm_intel_bo_gem *bo_gem;
+	void *value;
+	int ret;
+	struct drm_gem_open open_arg;
+	struct drm_i915_gem_get_tiling get_tiling;
+
+	/* A compositor may have hundreds of client buffers imported, and
+	 * looks most of them up again every frame, so keep the named
+	 * buffers in a hash table rather than searching the list.
+	 */
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	if (drmHashLookup(bufmgr_gem->name_table, handle, &value) == 0) {
+		bo_gem = value;
+		drm_intel_gem_bo_reference(&bo_gem->bo);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return &bo_gem->bo;
+	}
+
+	VG_CLEAR(open_arg);
+	open_arg.name = handle;
+	ret = drmIoctl(bufmgr_gem->fd,
+		       DRM_IOCTL_GEM_OPEN,
+		       &open_arg);
+	if (ret != 0) {
+		DBG("Couldn't reference %s handle 0x%08x: %s\n",
+		    name, handle, strerror(errno));
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return NULL;
+	}
+
+	bo_gem = calloc(1, sizeof(*bo_gem));
+	if (!bo_gem) {
+		drmCloseBufferHandle(bufmgr_gem->fd, open_arg.handle);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return NULL;
+	}
+
+	bo_gem->bo.size = open_arg.size;
+	bo_gem->bo.offset = 0;
+	bo_gem->bo.virtual = NULL;
+	bo_gem->bo.bufmgr = bufmgr;
+	bo_gem->name = name;
+	atomic_set(&bo_gem->refcount, 1);
+	bo_gem->gem_handle = open_arg.handle;
+	bo_gem->bo.handle = open_arg.handle;
+	bo_gem->global_name = handle;
+	bo_gem->reusable = false;
+	DRMINITLISTHEAD(&bo_gem->name_list);
+	DRMINITLISTHEAD(&bo_gem->vma_list);
+
+	VG_CLEAR(get_tiling);
+	get_tiling.handle = bo_gem->gem_handle;
+	ret = drmIoctl(bufmgr_gem->fd,
+		       DRM_IOCTL_I915_GEM_GET_TILING,
+		       &get_tiling);
+	if (ret != 0) {
+		drm_intel_gem_bo_free(&bo_gem->bo);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return NULL;
+	}
+	bo_gem->tiling_mode = get_tiling.tiling_mode;
+	bo_gem->swizzle_mode = get_tiling.swizzle_mode;
+	/* XXX stride is unknown */
+	drm_intel_bo_gem_set_in_aperture_size(bufmgr_gem, bo_gem);
+
+	drmHashInsert(bufmgr_gem->name_table, bo_gem->global_name, bo_gem);
+	drm_intel_gem_bo_mark_shared_locked(bufmgr_gem, bo_gem);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	DBG("bo_create_from_handle: %d (%s)\n", handle, bo_gem->name);
+
+	return &bo_gem->bo;
+}
+
+/**
+ * Returns a drm_intel_bo for the buffer behind a dma-buf file descriptor,
+ * shared by another process or device.
+ *
+ * Importing a buffer this bufmgr already has, whether through PRIME, flink
+ * or because it exported it itself, returns another reference to the same
+ * drm_intel_bo.  \p size is only used if the kernel can't tell the size of
+ * the dma-buf.
+ */
+drm_intel_bo *
+drm_intel_bo_gem_create_from_prime(drm_intel_bufmgr *bufmgr, int prime_fd,
+				   int size)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
+	drm_intel_bo_gem *bo_gem;
+	struct drm_i915_gem_get_tiling get_tiling;
+	uint32_t handle;
+	void *value;
+	off_t end;
+	int ret;
+
+	/* The kernel hands back the handle this file already has for the
+	 * buffer, if any, so it finds the drm_intel_bo too.
+	 */
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	ret = drmPrimeFDToHandle(bufmgr_gem->fd, prime_fd, &handle);
+	if (ret != 0) {
+		DBG("create_from_prime: failed to obtain handle from fd: %s\n",
+		    strerror(errno));
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return NULL;
+	}
+
+	if (drmHashLookup(bufmgr_gem->handle_table, handle, &value) == 0) {
+		bo_gem = value;
+		drm_intel_gem_bo_reference(&bo_gem->bo);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return &bo_gem->bo;
+	}
+
+	bo_gem = calloc(1, sizeof(*bo_gem));
+	if (!bo_gem) {
+		drmCloseBufferHandle(bufmgr_gem->fd, handle);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return NULL;
+	}
+
+	/* Kernels with dma-buf llseek support report the real size */
+	end = lseek(prime_fd, 0, SEEK_END);
+	bo_gem->bo.size = end != (off_t) -1 ? end : size;
+	bo_gem->bo.bufmgr = bufmgr;
+	bo_gem->name = "prime";
+	atomic_set(&bo_gem->refcount, 1);
+	bo_gem->gem_handle = handle;
+	bo_gem->bo.handle = handle;
+	DRMINITLISTHEAD(&bo_gem->name_list);
+	DRMINITLISTHEAD(&bo_gem->vma_list);
+
+	VG_CLEAR(get_tiling);
+	get_tiling.handle = bo_gem->gem_handle;
+	ret = drmIoctl(bufmgr_gem->fd,
+		       DRM_IOCTL_I915_GEM_GET_TILING,
+		       &get_tiling);
+	if (ret != 0) {
+		drm_intel_gem_bo_free(&bo_gem->bo);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return NULL;
+	}
+	bo_gem->tiling_mode = get_tiling.tiling_mode;
+	bo_gem->swizzle_mode = get_tiling.swizzle_mode;
+	/* XXX stride is unknown */
+	drm_intel_bo_gem_set_in_aperture_size(bufmgr_gem, bo_gem);
+
+	drm_intel_gem_bo_mark_shared_locked(bufmgr_gem, bo_gem);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	DBG("bo_create_from_prime: %d (%s)\n", handle, bo_gem->name);
+
+	return &bo_gem->bo;
+}
+
+static void
+drm_intel_gem_bo_free(drm_intel_bo *bo)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	int ret;
+
+	DRMLISTDEL(&bo_gem->vma_list);
+	drm_intel_gem_bo_unmap_vmas(bufmgr_gem, bo_gem);
+	drm_intel_gem_reloc_release_locked(bufmgr_gem, bo_gem);
+
+	/* Close this object */
+	ret = drmCloseBufferHandle(bufmgr_gem->fd, bo_gem->gem_handle);
+	if (ret != 0) {
+		DBG("DRM_IOCTL_GEM_CLOSE %d failed (%s): %s\n",
+		    bo_gem->gem_handle, bo_gem->name, strerror(errno));
+	}
+	free(bo_gem->aub_annotations);
+	if (bo_gem->block == NULL)
+		free(bo);
+	else if (atomic_dec_and_test(&bo_gem->block->refcount))
+		free(bo_gem->block);
+}
+
+static void
+drm_intel_gem_bo_mark_mmaps_incoherent(drm_intel_bo *bo)
+{
+#if HAVE_VALGRIND
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+
+	if (bo_gem->mem_virtual)
+		VALGRIND_MAKE_MEM_NOACCESS(bo_gem->mem_virtual, bo->size);
+
+	if (bo_gem->gtt_virtual)
+		VALGRIND_MAKE_MEM_NOACCESS(bo_gem->gtt_virtual, bo->size);
+#endif
+}
+
+/** Frees all cached buffers significantly older than @time. */
+static void
+drm_intel_gem_cleanup_bo_cache(drm_intel_bufmgr_gem *bufmgr_gem, time_t time)
+{
+	if (bufmgr_gem->time == time)
+		return;
+
+	while (!DRMLISTEMPTY(&bufmgr_gem->cache_lru)) {
+		drm_intel_bo_gem *bo_gem;
+
+		bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
+				      bufmgr_gem->cache_lru.next, lru);
+		if (time - bo_gem->free_time <= 1)
+			break;
+
+		drm_intel_gem_bo_cache_del(bufmgr_gem, bo_gem);
+		drm_intel_gem_bo_free(&bo_gem->bo);
+	}
+
+	bufmgr_gem->time = time;
+}
+
+static void
+drm_intel_gem_bo_cache_stats_add(drm_intel_bo_cache_stats *total,
+				 const drm_intel_bo_cache_stats *stats)
+{
+	total->hits += stats->hits;
+	total->misses += stats->misses;
+	total->steals += stats->steals;
+	total->flushes += stats->flushes;
+	total->set_tiling_avoided += stats->set_tiling_avoided;
+	total->set_tiling_needed += stats->set_tiling_needed;
+}
+
+/**
+ * Moves the \c count oldest buffers of a thread cache bin over to the shared
+ * bucket list.  Called with bufmgr_gem->lock held.
+ */
+static void
+drm_intel_gem_bo_tcache_flush_bin(drm_intel_bufmgr_gem *bufmgr_gem,
+				  struct drm_intel_gem_bo_tcache *tc,
+				  int i, int count, time_t time)
+{
+	struct drm_intel_gem_bo_tcache_bin *bin = &tc->bin[i];
+	struct drm_intel_gem_bo_bucket *bucket = &bufmgr_gem->cache_bucket[i];
+	int j;
+
+	/* Already purgeable, a purged one is caught when reused */
+	for (j = 0; j < count; j++)
+		drm_intel_gem_bo_cache_add(bufmgr_gem, bucket, bin->bos[j],
+					   time);
+
+	bin->count -= count;
+	memmove(bin->bos, bin->bos + count, bin->count * sizeof(bin->bos[0]));
+	tc->stats.flushes += count;
+}
+
+/**
+ * Stashes a buffer whose last reference is gone in the calling thread's
+ * cache.  Returns false if the buffer has to go through
+ * drm_intel_gem_bo_unreference_final() instead.
+ */
+static bool
+drm_intel_gem_bo_tcache_free(drm_intel_bufmgr_gem *bufmgr_gem,
+			     drm_intel_bo_gem *bo_gem)
+{
+	struct drm_intel_gem_bo_tcache *tc;
+	struct drm_intel_gem_bo_tcache_bin *bin;
+	struct drm_intel_gem_bo_bucket *bucket;
+	int i;
+
+	/* Dropping relocation targets and mappings needs the lock anyway. */
+	if (!bo_gem->reusable || bo_gem->reloc_count || bo_gem->map_count)
+		return false;
+
+	tc = drm_intel_gem_bo_tcache_get(bufmgr_gem);
+	if (tc == NULL)
+		return false;
+
+	bucket = drm_intel_gem_bo_bucket_for_size(bufmgr_gem, bo_gem->bo.size);
+	if (bucket == NULL)
+		return false;
+	i = bucket - bufmgr_gem->cache_bucket;
+	if (i >= bufmgr_gem->tcache_bins)
+		return false;
+
+	if (!drm_intel_gem_bo_madvise_internal(bufmgr_gem, bo_gem,
+					       I915_MADV_DONTNEED))
+		return false;
+
+	DBG("bo_unreference final: %d (%s) to thread cache\n",
+	    bo_gem->gem_handle, bo_gem->name);
+
+	bo_gem->used_as_reloc_target = false;
+	bo_gem->name = NULL;
+
+	bin = &tc->bin[i];
+	if (bin->count == TCACHE_DEPTH) {
+		struct timespec time;
+
+		clock_gettime(CLOCK_MONOTONIC, &time);
+
+		pthread_mutex_lock(&bufmgr_gem->lock);
+		drm_intel_gem_bo_tcache_flush_bin(bufmgr_gem, tc, i,
+						  TCACHE_DEPTH / 2,
+						  time.tv_sec);
+		drm_intel_gem_cleanup_bo_cache(bufmgr_gem, time.tv_sec);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+	}
+	bin->bos[bin->count++] = bo_gem;
+
+	return true;
+}
+
+/** Thread exit destructor: give the cached buffers back to everyone. */
+static void
+drm_intel_gem_bo_tcache_release(void *data)
+{
+	struct drm_intel_gem_bo_tcache *tc = data;
+	drm_intel_bufmgr_gem *bufmgr_gem = tc->bufmgr_gem;
+	struct timespec time;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	for (i = 0; i < bufmgr_gem->tcache_bins; i++)
+		drm_intel_gem_bo_tcache_flush_bin(bufmgr_gem, tc, i,
+						  tc->bin[i].count,
+						  time.tv_sec);
+	drm_intel_gem_bo_cache_stats_add(&bufmgr_gem->tcache_retired,
+					 &tc->stats);
+	DRMLISTDEL(&tc->link);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	free(tc);
+}
+
+/**
+ * Drops the cached mappings of a buffer that isn't mapped by anyone.
+ */
+static void drm_intel_gem_bo_unmap_vmas(drm_intel_bufmgr_gem *bufmgr_gem,
+					drm_intel_bo_gem *bo_gem)
+{
+	drm_intel_bo_vma_stats *stats = &bufmgr_gem->vma_stats;
+
+	if (bo_gem->mem_virtual) {
+		VG(VALGRIND_FREELIKE_BLOCK(bo_gem->mem_virtual, 0));
+		munmap(bo_gem->mem_virtual, bo_gem->bo.size);
+		bo_gem->mem_virtual = NULL;
+		bufmgr_gem->vma_count--;
+		stats->cpu_bytes -= bo_gem->bo.size;
+		stats->cached_cpu_bytes -= bo_gem->bo.size;
+		stats->munmaps++;
+	}
+	if (bo_gem->gtt_virtual) {
+		munmap(bo_gem->gtt_virtual, bo_gem->bo.size);
+		bo_gem->gtt_virtual = NULL;
+		bufmgr_gem->vma_count--;
+		stats->gtt_bytes -= bo_gem->bo.size;
+		stats->cached_gtt_bytes -= bo_gem->bo.size;
+		stats->munmaps++;
+	}
+}
+
+static void drm_intel_gem_bo_purge_vma_cache(drm_intel_bufmgr_gem *bufmgr_gem)
+{
+	drm_intel_bo_vma_stats *stats = &bufmgr_gem->vma_stats;
+	uint64_t open_bytes, byte_limit;
+	int limit;
+
+	DBG("%s: cached=%d, open=%d, limit=%d\n", __FUNCTION__,
+	    bufmgr_gem->vma_count, bufmgr_gem->vma_open, bufmgr_gem->vma_max);
+
+	if (bufmgr_gem->vma_max < 0 && bufmgr_gem->vma_max_bytes == 0)
+		return;
+
+	/* We may need to evict a few entries in order to create new mmaps */
+	limit = bufmgr_gem->vma_max - 2*bufmgr_gem->vma_open;
+	if (limit < 0)
+		limit = 0;
+
+	/* Mappings in use count against the byte limit too, but only the
+	 * cached ones can be dropped.
+	 */
+	byte_limit = UINT64_MAX;
+	if (bufmgr_gem->vma_max_bytes) {
+		open_bytes = stats->cpu_bytes + stats->gtt_bytes -
+			     stats->cached_cpu_bytes - stats->cached_gtt_bytes;
+		byte_limit = 0;
+		if (bufmgr_gem->vma_max_bytes > open_bytes)
+			byte_limit = bufmgr_gem->vma_max_bytes - open_bytes;
+	}
+
+	while ((bufmgr_gem->vma_max >= 0 && bufmgr_gem->vma_count > limit) ||
+	       stats->cached_cpu_bytes + stats->cached_gtt_bytes > byte_limit) {
+		drm_intel_bo_gem *bo_gem;
+
+		bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
+				      bufmgr_gem->vma_cache.next,
+				      vma_list);
+		assert(bo_gem->map_count == 0);
+		DRMLISTDELINIT(&bo_gem->vma_list);
+
+		drm_intel_gem_bo_unmap_vmas(bufmgr_gem, bo_gem);
+	}
+}
+
+static void drm_intel_gem_bo_close_vma(drm_intel_bufmgr_gem *bufmgr_gem,
+				       drm_intel_bo_gem *bo_gem)
+{
+	bufmgr_gem->vma_open--;
+	DRMLISTADDTAIL(&bo_gem->vma_list, &bufmgr_gem->vma_cache);
+	if (bo_gem->mem_virtual) {
+		bufmgr_gem->vma_count++;
+		bufmgr_gem->vma_stats.cached_cpu_bytes += bo_gem->bo.size;
+	}
+	if (bo_gem->gtt_virtual) {
+		bufmgr_gem->vma_count++;
+		bufmgr_gem->vma_stats.cached_gtt_bytes += bo_gem->bo.size;
+	}
+	drm_intel_gem_bo_purge_vma_cache(bufmgr_gem);
+}
+
+static void drm_intel_gem_bo_open_vma(drm_intel_bufmgr_gem *bufmgr_gem,
+				      drm_intel_bo_gem *bo_gem)
+{
+	bufmgr_gem->vma_open++;
+	DRMLISTDEL(&bo_gem->vma_list);
+	if (bo_gem->mem_virtual) {
+		bufmgr_gem->vma_count--;
+		bufmgr_gem->vma_stats.cached_cpu_bytes -= bo_gem->bo.size;
+	}
+	if (bo_gem->gtt_virtual) {
+		bufmgr_gem->vma_count--;
+		bufmgr_gem->vma_stats.cached_gtt_bytes -= bo_gem->bo.size;
+	}
+	drm_intel_gem_bo_purge_vma_cache(bufmgr_gem);
+}
+
+/**
+ * Returns a chunk to its slab.  Called with bufmgr_gem->lock held.
+ */
+static void
+drm_intel_gem_slab_free(drm_intel_bufmgr_gem *bufmgr_gem,
+			drm_intel_bo_gem *bo_gem, time_t time)
+{
+	struct drm_intel_gem_slab *slab = bo_gem->slab;
+	drmMMListHead *slabs;
+	int i = bo_gem - slab->chunk;
+
+	DBG("bo_unreference final: %d+%u (%s)\n",
+	    bo_gem->gem_handle, bo_gem->slab_offset, bo_gem->name);
+
+	/* Drop the mappings of the slab's buffer taken on our behalf */
+	while (bo_gem->map_count) {
+		drm_intel_bo_gem *slab_bo_gem = (drm_intel_bo_gem *) slab->bo;
+
+		bo_gem->map_count--;
+		if (--slab_bo_gem->map_count == 0) {
+			drm_intel_gem_bo_close_vma(bufmgr_gem, slab_bo_gem);
+			slab->bo->virtual = NULL;
+		}
+	}
+	bo_gem->name = NULL;
+
+	slabs = &bufmgr_gem->slabs[ffsl(slab->chunk_size) - 1 -
+				   SLAB_MIN_SHIFT];
+
+	if (slab->free == 0) {
+		DRMLISTDEL(&slab->link);
+		DRMLISTADD(&slab->link, slabs);
+	}
+	slab->free |= 1ULL << i;
+
+	/* Keep one empty slab around, release any other */
+	if (slab->free == ~0ULL &&
+	    (slabs->next != &slab->link || slabs->prev != &slab->link))
+		drm_intel_gem_slab_destroy(slab, time);
+}
+
+static void
+drm_intel_gem_bo_unreference_final(drm_intel_bo *bo, time_t time)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	struct drm_intel_gem_bo_bucket *bucket;
+	int i;
+
+	if (bo_gem->slab != NULL) {
+		drm_intel_gem_slab_free(bufmgr_gem, bo_gem, time);
+		return;
+	}
+
+	/* Unreference all the target buffers */
+	for (i = 0; i < bo_gem->reloc_count; i++) {
+		if (bo_gem->reloc_target_info[i].bo != bo) {
+			drm_intel_gem_bo_unreference_locked_timed(bo_gem->
+								  reloc_target_info[i].bo,
+								  time);
+		}
+	}
+	bo_gem->reloc_count = 0;
+	bo_gem->used_as_reloc_target = false;
+
+	DBG("bo_unreference final: %d (%s)\n",
+	    bo_gem->gem_handle, bo_gem->name);
+
+	/* The relocation list, if any, stays with the buffer until it is
+	 * closed, so reusing it from the cache doesn't allocate.
+	 */
+
+	/* Clear any left-over mappings */
+	if (bo_gem->map_count) {
+		DBG("bo freed with non-zero map-count %d\n", bo_gem->map_count);
+		bo_gem->map_count = 0;
+		drm_intel_gem_bo_close_vma(bufmgr_gem, bo_gem);
+		drm_intel_gem_bo_mark_mmaps_incoherent(bo);
+	}
+
+	DRMLISTDEL(&bo_gem->name_list);
+	if (bo_gem->global_name)
+		drmHashDelete(bufmgr_gem->name_table, bo_gem->global_name);
+	if (bo_gem->shared)
+		drmHashDelete(bufmgr_gem->handle_table, bo_gem->gem_handle);
+
+	bucket = drm_intel_gem_bo_bucket_for_size(bufmgr_gem, bo->size);
+	/* Put the buffer into our internal cache for reuse if we can. */
 	if (bufmgr_gem->bo_reuse && bo_gem->reusable && bucket != NULL &&
 	    drm_intel_gem_bo_madvise_internal(bufmgr_gem, bo_gem,
 					      I915_MADV_DONTNEED)) {
-		bo_gem->free_time = time;
-
 		bo_gem->name = NULL;
-		bo_gem->validate_index = -1;
 
-		DRMLISTADDTAIL(&bo_gem->head, &bucket->head);
+		drm_intel_gem_bo_cache_add(bufmgr_gem, bucket, bo_gem, time);
 	} else {
 		drm_intel_gem_bo_free(bo);
 	}
@@ -1113,11 +2522,37 @@ static void drm_intel_gem_bo_unreference(drm_intel_bo *bo)
 	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
 
 	assert(atomic_read(&bo_gem->refcount) > 0);
+
+	/* Named and PRIME-shared buffers can be found again by
+	 * create_from_name() and create_from_prime(), which must not revive
+	 * one whose last reference is being dropped.
+	 */
+	if (bo_gem->global_name || bo_gem->shared) {
+		drm_intel_bufmgr_gem *bufmgr_gem =
+		    (drm_intel_bufmgr_gem *) bo->bufmgr;
+		struct timespec time;
+
+		clock_gettime(CLOCK_MONOTONIC, &time);
+
+		pthread_mutex_lock(&bufmgr_gem->lock);
+		if (atomic_dec_and_test(&bo_gem->refcount)) {
+			drm_intel_gem_bo_unreference_final(bo, time.tv_sec);
+			drm_intel_gem_cleanup_bo_cache(bufmgr_gem,
+						       time.tv_sec);
+		}
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return;
+	}
+
 	if (atomic_dec_and_test(&bo_gem->refcount)) {
 		drm_intel_bufmgr_gem *bufmgr_gem =
 		    (drm_intel_bufmgr_gem *) bo->bufmgr;
 		struct timespec time;
 
+		if (bo_gem->slab == NULL &&
+		    drm_intel_gem_bo_tcache_free(bufmgr_gem, bo_gem))
+			return;
+
 		clock_gettime(CLOCK_MONOTONIC, &time);
 
 		pthread_mutex_lock(&bufmgr_gem->lock);
@@ -1127,6 +2562,29 @@ static void drm_intel_gem_bo_unreference(drm_intel_bo *bo)
 	}
 }
 
+/**
+ * Finishes mapping a chunk, once its slab's buffer has been mapped.
+ */
+static int
+drm_intel_gem_slab_mapped(drm_intel_bo *bo, int ret, bool gtt)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	drm_intel_bo_gem *slab_bo_gem = (drm_intel_bo_gem *) bo_gem->slab->bo;
+
+	if (ret)
+		return ret;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	bo_gem->map_count++;
+	bo->virtual = (char *) (gtt ? slab_bo_gem->gtt_virtual :
+				slab_bo_gem->mem_virtual) +
+		      bo_gem->slab_offset;
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	return 0;
+}
+
 static int drm_intel_gem_bo_map(drm_intel_bo *bo, int write_enable)
 {
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
@@ -1134,12 +2592,21 @@ static int drm_intel_gem_bo_map(drm_intel_bo *bo, int write_enable)
 	struct drm_i915_gem_set_domain set_domain;
 	int ret;
 
+	if (bo_gem->slab != NULL) {
+		ret = drm_intel_gem_bo_map(bo_gem->slab->bo, write_enable);
+		return drm_intel_gem_slab_mapped(bo, ret, false);
+	}
+
 	pthread_mutex_lock(&bufmgr_gem->lock);
+	drm_intel_gem_bo_exec_sync(bo, true);
 
 	if (bo_gem->map_count++ == 0)
 		drm_intel_gem_bo_open_vma(bufmgr_gem, bo_gem);
 
-	if (!bo_gem->mem_virtual) {
+	if (bo_gem->user_virtual) {
+		/* Already in our address space, SET_DOMAIN still waits */
+		bufmgr_gem->vma_stats.hits++;
+	} else if (!bo_gem->mem_virtual) {
 		struct drm_i915_gem_mmap mmap_arg;
 
 		DBG("bo_map: %d (%s), map_count=%d\n",
@@ -1164,10 +2631,14 @@ static int drm_intel_gem_bo_map(drm_intel_bo *bo, int write_enable)
 		}
 		VG(VALGRIND_MALLOCLIKE_BLOCK(mmap_arg.addr_ptr, mmap_arg.size, 0, 1));
 		bo_gem->mem_virtual = (void *)(uintptr_t) mmap_arg.addr_ptr;
-	}
+		bufmgr_gem->vma_stats.cpu_bytes += bo->size;
+		bufmgr_gem->vma_stats.misses++;
+	} else
+		bufmgr_gem->vma_stats.hits++;
+	bo->virtual = bo_gem->user_virtual ? bo_gem->user_virtual :
+		      bo_gem->mem_virtual;
 	DBG("bo_map: %d (%s) -> %p\n", bo_gem->gem_handle, bo_gem->name,
-	    bo_gem->mem_virtual);
-	bo->virtual = bo_gem->mem_virtual;
+	    bo->virtual);
 
 	VG_CLEAR(set_domain);
 	set_domain.handle = bo_gem->gem_handle;
@@ -1189,7 +2660,7 @@ static int drm_intel_gem_bo_map(drm_intel_bo *bo, int write_enable)
 		bo_gem->mapped_cpu_write = true;
 
 	drm_intel_gem_bo_mark_mmaps_incoherent(bo);
-	VG(VALGRIND_MAKE_MEM_DEFINED(bo_gem->mem_virtual, bo->size));
+	VG(VALGRIND_MAKE_MEM_DEFINED(bo->virtual, bo->size));
 	pthread_mutex_unlock(&bufmgr_gem->lock);
 
 	return 0;
@@ -1202,6 +2673,10 @@ map_gtt(drm_intel_bo *bo)
 	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
 	int ret;
 
+	/* Client memory only has the mapping the client gave us */
+	if (bo_gem->user_virtual)
+		return -EINVAL;
+
 	if (bo_gem->map_count++ == 0)
 		drm_intel_gem_bo_open_vma(bufmgr_gem, bo_gem);
 
@@ -1245,7 +2720,10 @@ map_gtt(drm_intel_bo *bo)
 				drm_intel_gem_bo_close_vma(bufmgr_gem, bo_gem);
 			return ret;
 		}
-	}
+		bufmgr_gem->vma_stats.gtt_bytes += bo->size;
+		bufmgr_gem->vma_stats.misses++;
+	} else
+		bufmgr_gem->vma_stats.hits++;
 
 	bo->virtual = bo_gem->gtt_virtual;
 
@@ -1262,7 +2740,13 @@ int drm_intel_gem_bo_map_gtt(drm_intel_bo *bo)
 	struct drm_i915_gem_set_domain set_domain;
 	int ret;
 
+	if (bo_gem->slab != NULL) {
+		ret = drm_intel_gem_bo_map_gtt(bo_gem->slab->bo);
+		return drm_intel_gem_slab_mapped(bo, ret, true);
+	}
+
 	pthread_mutex_lock(&bufmgr_gem->lock);
+	drm_intel_gem_bo_exec_sync(bo, true);
 
 	ret = map_gtt(bo);
 	if (ret) {
@@ -1316,8 +2800,14 @@ int drm_intel_gem_bo_map_gtt(drm_intel_bo *bo)
 int drm_intel_gem_bo_map_unsynchronized(drm_intel_bo *bo)
 {
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
 	int ret;
 
+	if (bo_gem->slab != NULL) {
+		ret = drm_intel_gem_bo_map_unsynchronized(bo_gem->slab->bo);
+		return drm_intel_gem_slab_mapped(bo, ret, true);
+	}
+
 	/* If the CPU cache isn't coherent with the GTT, then use a
 	 * regular synchronized mapping.  The problem is that we don't
 	 * track where the buffer was last used on the CPU side in
@@ -1346,6 +2836,14 @@ static int drm_intel_gem_bo_unmap(drm_intel_bo *bo)
 
 	pthread_mutex_lock(&bufmgr_gem->lock);
 
+	if (bo_gem->slab != NULL && bo_gem->map_count > 0) {
+		if (--bo_gem->map_count == 0)
+			bo->virtual = NULL;
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+
+		return drm_intel_gem_bo_unmap(bo_gem->slab->bo);
+	}
+
 	if (bo_gem->map_count <= 0) {
 		DBG("attempted to unmap an unmapped bo\n");
 		pthread_mutex_unlock(&bufmgr_gem->lock);
@@ -1392,6 +2890,51 @@ int drm_intel_gem_bo_unmap_gtt(drm_intel_bo *bo)
 	return drm_intel_gem_bo_unmap(bo);
 }
 
+/* Whether [offset, offset + size) lies within the buffer, without overflow */
+static bool
+drm_intel_gem_bo_range_valid(drm_intel_bo *bo, unsigned long offset,
+			     unsigned long size)
+{
+	return offset <= bo->size && size <= bo->size - offset;
+}
+
+/**
+ * Copies a list of ranges to or from the client memory behind a userptr
+ * buffer, which PWRITE and PREAD don't accept, once the GPU is done with
+ * it.
+ */
+static int
+drm_intel_gem_bo_copy_user(drm_intel_bo *bo,
+			   const drm_intel_bo_region *regions, int count,
+			   bool write)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	struct drm_i915_gem_set_domain set_domain;
+	char *virtual = bo_gem->user_virtual;
+	int i, ret;
+
+	VG_CLEAR(set_domain);
+	set_domain.handle = bo_gem->gem_handle;
+	set_domain.read_domains = I915_GEM_DOMAIN_CPU;
+	set_domain.write_domain = write ? I915_GEM_DOMAIN_CPU : 0;
+	ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_I915_GEM_SET_DOMAIN,
+		       &set_domain);
+	if (ret != 0)
+		return -errno;
+
+	for (i = 0; i < count; i++) {
+		if (write)
+			memcpy(virtual + regions[i].offset, regions[i].data,
+			       regions[i].size);
+		else
+			memcpy(regions[i].data, virtual + regions[i].offset,
+			       regions[i].size);
+	}
+
+	return 0;
+}
+
 static int
 drm_intel_gem_bo_subdata(drm_intel_bo *bo, unsigned long offset,
 			 unsigned long size, const void *data)
@@ -1401,9 +2944,23 @@ drm_intel_gem_bo_subdata(drm_intel_bo *bo, unsigned long offset,
 	struct drm_i915_gem_pwrite pwrite;
 	int ret;
 
+	/* The kernel only checks against the whole slab */
+	if (!drm_intel_gem_bo_range_valid(bo, offset, size))
+		return -EINVAL;
+
+	drm_intel_gem_bo_exec_sync(bo, false);
+
+	if (bo_gem->user_virtual) {
+		drm_intel_bo_region region = {
+			offset, size, (void *) data
+		};
+
+		return drm_intel_gem_bo_copy_user(bo, &region, 1, true);
+	}
+
 	VG_CLEAR(pwrite);
 	pwrite.handle = bo_gem->gem_handle;
-	pwrite.offset = offset;
+	pwrite.offset = bo_gem->slab_offset + offset;
 	pwrite.size = size;
 	pwrite.data_ptr = (uint64_t) (uintptr_t) data;
 	ret = drmIoctl(bufmgr_gem->fd,
@@ -1453,9 +3010,20 @@ drm_intel_gem_bo_get_subdata(drm_intel_bo *bo, unsigned long offset,
 	struct drm_i915_gem_pread pread;
 	int ret;
 
+	if (!drm_intel_gem_bo_range_valid(bo, offset, size))
+		return -EINVAL;
+
+	drm_intel_gem_bo_exec_sync(bo, false);
+
+	if (bo_gem->user_virtual) {
+		drm_intel_bo_region region = { offset, size, data };
+
+		return drm_intel_gem_bo_copy_user(bo, &region, 1, false);
+	}
+
 	VG_CLEAR(pread);
 	pread.handle = bo_gem->gem_handle;
-	pread.offset = offset;
+	pread.offset = bo_gem->slab_offset + offset;
 	pread.size = size;
 	pread.data_ptr = (uint64_t) (uintptr_t) data;
 	ret = drmIoctl(bufmgr_gem->fd,
@@ -1468,7 +3036,211 @@ drm_intel_gem_bo_get_subdata(drm_intel_bo *bo, unsigned long offset,
 		    (int)size, strerror(errno));
 	}
 
-	return ret;
+	return ret;
+}
+
+#define SUBDATA_BOUNCE_SIZE (64 * 1024)
+
+/**
+ * Copies a list of ranges through the mapping of a buffer, if it is
+ * mapped and idle.  Returns 0 when done, 1 if the buffer can't be
+ * accessed that way, or a negative errno.
+ */
+static int
+drm_intel_gem_bo_copy_mapped(drm_intel_bo *bo,
+			     const drm_intel_bo_region *regions, int count,
+			     bool write)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	drm_intel_bo_gem *storage_gem =
+		(drm_intel_bo_gem *) drm_intel_gem_bo_storage(bo);
+	struct drm_i915_gem_set_domain set_domain;
+	struct drm_i915_gem_busy busy;
+	uint32_t domain;
+	char *virtual;
+	int i, ret;
+
+	if (storage_gem->map_count == 0)
+		return 1;
+
+	/* Hold the lock so the mapping can't be dropped under us */
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	if (storage_gem->map_count == 0) {
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return 1;
+	}
+
+	/* PWRITE and PREAD see the pages as they are, the GTT would
+	 * detile them.
+	 */
+	if (storage_gem->mem_virtual) {
+		virtual = storage_gem->mem_virtual;
+		domain = I915_GEM_DOMAIN_CPU;
+	} else if (storage_gem->tiling_mode == I915_TILING_NONE) {
+		virtual = storage_gem->gtt_virtual;
+		domain = I915_GEM_DOMAIN_GTT;
+	} else {
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return 1;
+	}
+
+	/* The kernel would wait for a busy buffer too, but let it
+	 * schedule that rather than stalling here.
+	 */
+	VG_CLEAR(busy);
+	busy.handle = storage_gem->gem_handle;
+	ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_I915_GEM_BUSY, &busy);
+	if (ret != 0 || busy.busy) {
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return 1;
+	}
+
+	/* Move the buffer to the mapping's domain, as mapping it again
+	 * would, so that caches are flushed around the copy.
+	 */
+	VG_CLEAR(set_domain);
+	set_domain.handle = storage_gem->gem_handle;
+	set_domain.read_domains = domain;
+	set_domain.write_domain = write ? domain : 0;
+	ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_I915_GEM_SET_DOMAIN,
+		       &set_domain);
+	if (ret != 0) {
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return 1;
+	}
+
+	virtual += bo_gem->slab_offset;
+	for (i = 0; i < count; i++) {
+		if (domain == I915_GEM_DOMAIN_CPU && write)
+			memcpy(virtual + regions[i].offset, regions[i].data,
+			       regions[i].size);
+		else if (domain == I915_GEM_DOMAIN_CPU)
+			memcpy(regions[i].data, virtual + regions[i].offset,
+			       regions[i].size);
+		else if (write)
+			drmMemcpyToWC(virtual + regions[i].offset,
+				      regions[i].data, regions[i].size);
+		else
+			drmMemcpyFromWC(regions[i].data,
+					virtual + regions[i].offset,
+					regions[i].size);
+	}
+	if (write && domain == I915_GEM_DOMAIN_CPU)
+		storage_gem->mapped_cpu_write = true;
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	return 0;
+}
+
+/**
+ * Writes or reads a list of ranges, through the buffer's mapping if it
+ * has one that can be used, and otherwise with one PWRITE or PREAD per
+ * run of consecutive regions that are adjacent in the buffer.  Runs whose
+ * data isn't contiguous in memory go through a bounce buffer of up to
+ * SUBDATA_BOUNCE_SIZE.
+ */
+static int
+drm_intel_gem_bo_copy_v(drm_intel_bo *bo,
+			const drm_intel_bo_region *regions, int count,
+			bool write)
+{
+	char *bounce = NULL;
+	unsigned long bounce_size = 0;
+	int i, j, k, ret, ioctls = 0;
+
+	for (i = 0; i < count; i++) {
+		if (!drm_intel_gem_bo_range_valid(bo, regions[i].offset,
+						  regions[i].size))
+			return -EINVAL;
+	}
+
+	drm_intel_gem_bo_exec_sync(bo, false);
+
+	if (((drm_intel_bo_gem *) bo)->user_virtual)
+		return drm_intel_gem_bo_copy_user(bo, regions, count, write);
+
+	ret = drm_intel_gem_bo_copy_mapped(bo, regions, count, write);
+	if (ret <= 0)
+		return ret;
+
+	for (i = 0; i < count; i = j) {
+		unsigned long offset = regions[i].offset;
+		unsigned long size = regions[i].size;
+		bool contiguous = true;
+		char *data;
+
+		for (j = i + 1;
+		     j < count && regions[j].offset == offset + size;
+		     j++) {
+			bool next_contiguous = contiguous &&
+				regions[j].data ==
+				(char *) regions[i].data + size;
+
+			/* Gathering only pays off for small pieces */
+			if (!next_contiguous &&
+			    size + regions[j].size > SUBDATA_BOUNCE_SIZE)
+				break;
+			contiguous = next_contiguous;
+			size += regions[j].size;
+		}
+
+		data = regions[i].data;
+		if (!contiguous) {
+			if (size > bounce_size) {
+				free(bounce);
+				bounce = malloc(size);
+				if (bounce == NULL) {
+					ret = -ENOMEM;
+					break;
+				}
+				bounce_size = size;
+			}
+			data = bounce;
+		}
+
+		if (write) {
+			if (!contiguous) {
+				for (k = i; k < j; k++) {
+					memcpy(data, regions[k].data,
+					       regions[k].size);
+					data += regions[k].size;
+				}
+				data = bounce;
+			}
+			ret = drm_intel_gem_bo_subdata(bo, offset, size, data);
+		} else {
+			ret = drm_intel_gem_bo_get_subdata(bo, offset, size,
+							   data);
+			if (ret == 0 && !contiguous) {
+				for (k = i; k < j; k++) {
+					memcpy(regions[k].data, data,
+					       regions[k].size);
+					data += regions[k].size;
+				}
+			}
+		}
+		if (ret != 0)
+			break;
+		ioctls++;
+	}
+
+	free(bounce);
+	return ret ? ret : ioctls;
+}
+
+static int
+drm_intel_gem_bo_subdata_v(drm_intel_bo *bo,
+			   const drm_intel_bo_region *regions, int count)
+{
+	return drm_intel_gem_bo_copy_v(bo, regions, count, true);
+}
+
+static int
+drm_intel_gem_bo_get_subdata_v(drm_intel_bo *bo,
+			       const drm_intel_bo_region *regions, int count)
+{
+	return drm_intel_gem_bo_copy_v(bo, regions, count, false);
 }
 
 /** Waits for all GPU rendering with the object to have completed. */
@@ -1478,6 +3250,64 @@ drm_intel_gem_bo_wait_rendering(drm_intel_bo *bo)
 	drm_intel_gem_bo_start_gtt_access(bo, 1);
 }
 
+static int
+drm_intel_gem_bo_poll_busy(void *data)
+{
+	return drm_intel_gem_bo_busy(data) ? -EBUSY : 0;
+}
+
+/**
+ * Waits at most \p timeout_ns nanoseconds for the GPU to be done with the
+ * buffer, or for ever if it is negative.  A timeout of 0 only checks.
+ *
+ * Unlike drm_intel_bo_wait_rendering(), this doesn't move the buffer to
+ * another domain.  Kernels without the timed wait ioctl are polled.
+ *
+ * Returns 0 once the buffer is idle, -ETIME if it still wasn't when the
+ * time ran out, or another negative errno.
+ */
+int
+drm_intel_gem_bo_wait(drm_intel_bo *bo, int64_t timeout_ns)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	struct drm_i915_gem_wait wait;
+	struct timespec start, now;
+	int64_t elapsed;
+	int ret;
+
+	if (timeout_ns == 0)
+		return drm_intel_gem_bo_busy(bo) ? -ETIME : 0;
+
+	/* Batches still queued for submission count against the timeout */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	drm_intel_gem_bo_exec_sync(bo, false);
+	if (timeout_ns > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (now.tv_sec - start.tv_sec) * 1000000000LL +
+			  now.tv_nsec - start.tv_nsec;
+		timeout_ns = elapsed < timeout_ns ? timeout_ns - elapsed : 0;
+	}
+
+	if (!bufmgr_gem->has_wait_timeout) {
+		if (timeout_ns < 0) {
+			drm_intel_gem_bo_wait_rendering(bo);
+			return 0;
+		}
+		return drmPollBusy(drm_intel_gem_bo_poll_busy, bo, timeout_ns);
+	}
+
+	VG_CLEAR(wait);
+	wait.bo_handle = bo_gem->gem_handle;
+	wait.flags = 0;
+	wait.timeout_ns = timeout_ns;
+	ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_I915_GEM_WAIT, &wait);
+	if (ret != 0)
+		return -errno;
+
+	return 0;
+}
+
 /**
  * Sets the object to the GTT read and possibly write domain, used by the X
  * 2D driver in the absence of kernel support to do drm_intel_gem_bo_map_gtt().
@@ -1493,6 +3323,8 @@ drm_intel_gem_bo_start_gtt_access(drm_intel_bo *bo, int write_enable)
 	struct drm_i915_gem_set_domain set_domain;
 	int ret;
 
+	drm_intel_gem_bo_exec_sync(bo, false);
+
 	VG_CLEAR(set_domain);
 	set_domain.handle = bo_gem->gem_handle;
 	set_domain.read_domains = I915_GEM_DOMAIN_GTT;
@@ -1514,28 +3346,166 @@ drm_intel_bufmgr_gem_destroy(drm_intel_bufmgr *bufmgr)
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
 	int i;
 
+	if (bufmgr_gem->exec_queue != NULL)
+		drm_intel_gem_exec_queue_destroy(bufmgr_gem);
+
 	free(bufmgr_gem->exec2_objects);
 	free(bufmgr_gem->exec_objects);
 	free(bufmgr_gem->exec_bos);
+	free(bufmgr_gem->walk_stack);
+
+	/* Threads using this bufmgr may outlive it, so make sure their exit
+	 * doesn't try to release the caches we are about to free here.
+	 */
+	if (bufmgr_gem->tcache_bins) {
+		pthread_setspecific(bufmgr_gem->tcache_key, NULL);
+		pthread_key_delete(bufmgr_gem->tcache_key);
+	}
+	while (!DRMLISTEMPTY(&bufmgr_gem->tcache_list)) {
+		struct drm_intel_gem_bo_tcache *tc;
+
+		tc = DRMLISTENTRY(struct drm_intel_gem_bo_tcache,
+				  bufmgr_gem->tcache_list.next, link);
+		for (i = 0; i < bufmgr_gem->tcache_bins; i++) {
+			struct drm_intel_gem_bo_tcache_bin *bin = &tc->bin[i];
+
+			while (bin->count)
+				drm_intel_gem_bo_free(&bin->bos[--bin->count]->bo);
+		}
+		DRMLISTDEL(&tc->link);
+		free(tc);
+	}
+
+	for (i = 0; i < SLAB_CLASSES; i++) {
+		while (!DRMLISTEMPTY(&bufmgr_gem->slabs[i])) {
+			struct drm_intel_gem_slab *slab;
+
+			slab = DRMLISTENTRY(struct drm_intel_gem_slab,
+					    bufmgr_gem->slabs[i].next, link);
+			drm_intel_gem_slab_destroy(slab, 0);
+		}
+	}
 
 	pthread_mutex_destroy(&bufmgr_gem->lock);
 
 	/* Free any cached buffer objects we were going to reuse */
-	for (i = 0; i < bufmgr_gem->num_buckets; i++) {
-		struct drm_intel_gem_bo_bucket *bucket =
-		    &bufmgr_gem->cache_bucket[i];
-		drm_intel_bo_gem *bo_gem;
+	drm_intel_gem_bo_cache_empty(bufmgr_gem);
+	free(bufmgr_gem->cache_bucket);
+	drm_intel_gem_reloc_arena_destroy(bufmgr_gem);
 
-		while (!DRMLISTEMPTY(&bucket->head)) {
-			bo_gem = DRMLISTENTRY(drm_intel_bo_gem,
-					      bucket->head.next, head);
-			DRMLISTDEL(&bo_gem->head);
+	drmHashDestroy(bufmgr_gem->name_table);
+	drmHashDestroy(bufmgr_gem->handle_table);
 
-			drm_intel_gem_bo_free(&bo_gem->bo);
+	free(bufmgr);
+}
+
+/**
+ * Makes room for a frame at the given depth of the relocation walk stack.
+ */
+static int
+drm_intel_gem_walk_reserve(drm_intel_bufmgr_gem *bufmgr_gem, int depth)
+{
+	struct drm_intel_gem_walk_frame *frame;
+	int new_size;
+
+	if (depth < bufmgr_gem->walk_size)
+		return 0;
+
+	new_size = bufmgr_gem->walk_size * 2;
+	if (new_size == 0)
+		new_size = 16;
+	frame = realloc(bufmgr_gem->walk_stack, sizeof(*frame) * new_size);
+	if (frame == NULL)
+		return -ENOMEM;
+	bufmgr_gem->walk_stack = frame;
+	bufmgr_gem->walk_size = new_size;
+	return 0;
+}
+
+/**
+ * Tags the tree rooted at bo as counted in the tree identified by root,
+ * adding the aperture space of the buffers that weren't already to
+ * *total.
+ *
+ * Like the relocation walk at execution, this uses the bufmgr's walk
+ * stack rather than recursing, so the caller must hold the lock.
+ */
+static int
+drm_intel_gem_bo_count_tree(drm_intel_bufmgr_gem *bufmgr_gem,
+			    drm_intel_bo *bo, uint64_t root, int *total)
+{
+	struct drm_intel_gem_walk_frame *frame;
+	drm_intel_bo_gem *bo_gem;
+	int depth = 0;
+
+	for (;;) {
+		bo = drm_intel_gem_bo_storage(bo);
+		bo_gem = (drm_intel_bo_gem *) bo;
+		if (bo_gem->aperture_tag != root) {
+			bo_gem->aperture_tag = root;
+			*total += bo_gem->aperture_size;
+
+			/* The relocations of a target can't change any more */
+			if (bo_gem->reloc_count > 0) {
+				if (drm_intel_gem_walk_reserve(bufmgr_gem,
+							       depth))
+					return -ENOMEM;
+				frame = &bufmgr_gem->walk_stack[depth++];
+				frame->bo = bo;
+				frame->reloc = 0;
+			}
+		}
+
+		/* Move on to the next target of the innermost buffer that
+		 * has any left.
+		 */
+		for (;;) {
+			if (depth == 0)
+				return 0;
+			frame = &bufmgr_gem->walk_stack[depth - 1];
+			bo_gem = (drm_intel_bo_gem *) frame->bo;
+			if (frame->reloc < bo_gem->reloc_count)
+				break;
+			depth--;
 		}
+		bo = bo_gem->reloc_target_info[frame->reloc++].bo;
 	}
+}
 
-	free(bufmgr);
+/**
+ * Grows bo's reloc_tree_size by the buffers of target's tree that it
+ * doesn't reach yet.
+ *
+ * Each buffer is only walked the first time it is reached from bo, so
+ * emitting many relocations to the same buffers stays cheap and the
+ * total never counts a buffer twice, unless another tree being built at
+ * the same time has reached it in between.
+ */
+static int
+drm_intel_gem_bo_account_reloc(drm_intel_bufmgr_gem *bufmgr_gem,
+			       drm_intel_bo_gem *bo_gem,
+			       drm_intel_bo *target_bo)
+{
+	drm_intel_bo_gem *target_gem =
+		(drm_intel_bo_gem *) drm_intel_gem_bo_storage(target_bo);
+	int total = 0;
+	int ret;
+
+	if (bo_gem->aperture_root != 0 &&
+	    target_gem->aperture_tag == bo_gem->aperture_root)
+		return 0;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	if (bo_gem->aperture_root == 0) {
+		bo_gem->aperture_root = ++bufmgr_gem->aperture_epoch;
+		bo_gem->aperture_tag = bo_gem->aperture_root;
+	}
+	ret = drm_intel_gem_bo_count_tree(bufmgr_gem, target_bo,
+					  bo_gem->aperture_root, &total);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	bo_gem->reloc_tree_size += total;
+	return ret;
 }
 
 /**
@@ -1561,6 +3531,10 @@ do_bo_emit_reloc(drm_intel_bo *bo, uint32_t offset,
 	if (bo_gem->has_error)
 		return -ENOMEM;
 
+	/* Sub-allocated buffers can't carry relocations themselves */
+	if (bo_gem->slab != NULL)
+		return -EINVAL;
+
 	if (target_bo_gem->has_error) {
 		bo_gem->has_error = true;
 		return -ENOMEM;
@@ -1574,13 +3548,16 @@ do_bo_emit_reloc(drm_intel_bo *bo, uint32_t offset,
 	if (target_bo_gem->tiling_mode == I915_TILING_NONE)
 		need_fence = false;
 
-	/* Create a new relocation list if needed */
-	if (bo_gem->relocs == NULL && drm_intel_setup_reloc_list(bo))
-		return -ENOMEM;
-
 	/* Check overflow */
 	assert(bo_gem->reloc_count < bufmgr_gem->max_relocs);
 
+	/* Create a new relocation list, or grow it, if needed */
+	if ((bo_gem->relocs == NULL ||
+	     bo_gem->reloc_count ==
+	     drm_intel_gem_reloc_capacity(bufmgr_gem, bo_gem->reloc_class)) &&
+	    drm_intel_setup_reloc_list(bo))
+		return -ENOMEM;
+
 	/* Check args */
 	assert(offset <= bo->size - 4);
 	assert((write_domain & (write_domain - 1)) == 0);
@@ -1591,8 +3568,15 @@ do_bo_emit_reloc(drm_intel_bo *bo, uint32_t offset,
 	assert(!bo_gem->used_as_reloc_target);
 	if (target_bo_gem != bo_gem) {
 		target_bo_gem->used_as_reloc_target = true;
-		bo_gem->reloc_tree_size += target_bo_gem->reloc_tree_size;
+		if (drm_intel_gem_bo_account_reloc(bufmgr_gem, bo_gem,
+						   target_bo)) {
+			bo_gem->has_error = true;
+			return -ENOMEM;
+		}
 	}
+	if (target_bo_gem->slab != NULL)
+		((drm_intel_bo_gem *) target_bo_gem->slab->bo)->
+			used_as_reloc_target = true;
 	/* An object needing a fence is a tiled buffer, so it won't have
 	 * relocs to other buffers.
 	 */
@@ -1600,13 +3584,18 @@ do_bo_emit_reloc(drm_intel_bo *bo, uint32_t offset,
 		target_bo_gem->reloc_tree_fences = 1;
 	bo_gem->reloc_tree_fences += target_bo_gem->reloc_tree_fences;
 
+	/* A chunk of a slab is relocated as an offset into the slab's
+	 * buffer, whose handle it shares.
+	 */
 	bo_gem->relocs[bo_gem->reloc_count].offset = offset;
-	bo_gem->relocs[bo_gem->reloc_count].delta = target_offset;
+	bo_gem->relocs[bo_gem->reloc_count].delta =
+	    target_bo_gem->slab_offset + target_offset;
 	bo_gem->relocs[bo_gem->reloc_count].target_handle =
 	    target_bo_gem->gem_handle;
 	bo_gem->relocs[bo_gem->reloc_count].read_domains = read_domains;
 	bo_gem->relocs[bo_gem->reloc_count].write_domain = write_domain;
-	bo_gem->relocs[bo_gem->reloc_count].presumed_offset = target_bo->offset;
+	bo_gem->relocs[bo_gem->reloc_count].presumed_offset =
+	    target_bo->offset - target_bo_gem->slab_offset;
 
 	bo_gem->reloc_target_info[bo_gem->reloc_count].bo = target_bo;
 	if (target_bo != bo)
@@ -1674,6 +3663,9 @@ drm_intel_gem_bo_clear_relocs(drm_intel_bo *bo, int start)
 
 	clock_gettime(CLOCK_MONOTONIC, &time);
 
+	/* A queued batch may still be about to hand the list over */
+	drm_intel_gem_bo_exec_sync(bo, false);
+
 	assert(bo_gem->reloc_count >= start);
 	/* Unreference the cleared target buffers */
 	for (i = start; i < bo_gem->reloc_count; i++) {
@@ -1684,67 +3676,134 @@ drm_intel_gem_bo_clear_relocs(drm_intel_bo *bo, int start)
 		}
 	}
 	bo_gem->reloc_count = start;
+
+	/* Dropped targets stay counted in reloc_tree_size unless the tree
+	 * is started over.
+	 */
+	if (start == 0) {
+		bo_gem->reloc_tree_size = bo_gem->aperture_size;
+		bo_gem->aperture_root = 0;
+	}
 }
 
 /**
- * Walk the tree of relocations rooted at BO and accumulate the list of
- * validations to be performed and update the relocation buffers with
- * index values into the validation list.
+ * Pushes bo onto the relocation walk stack, growing it as needed.
  */
-static void
-drm_intel_gem_bo_process_reloc(drm_intel_bo *bo)
+static int
+drm_intel_gem_walk_push(drm_intel_bufmgr_gem *bufmgr_gem,
+			drm_intel_bo *bo, int depth)
 {
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-	int i;
+	struct drm_intel_gem_walk_frame *frame;
 
-	if (bo_gem->relocs == NULL)
-		return;
+	if (drm_intel_gem_walk_reserve(bufmgr_gem, depth))
+		return -ENOMEM;
 
-	for (i = 0; i < bo_gem->reloc_count; i++) {
-		drm_intel_bo *target_bo = bo_gem->reloc_target_info[i].bo;
+	((drm_intel_bo_gem *) bo)->walk_gen = bufmgr_gem->exec_gen;
+	drm_intel_gem_bo_mark_mmaps_incoherent(bo);
 
-		if (target_bo == bo)
-			continue;
+	frame = &bufmgr_gem->walk_stack[depth];
+	frame->bo = bo;
+	frame->reloc = 0;
+	return 0;
+}
 
-		drm_intel_gem_bo_mark_mmaps_incoherent(bo);
+/**
+ * Walk the tree of relocations rooted at BO and accumulate the list of
+ * validations to be performed and update the relocation buffers with
+ * index values into the validation list.
+ *
+ * Targets are added depth-first, after everything they point to.  Each
+ * buffer is only descended into once per submission however many times it
+ * is referenced, and the walk keeps its own stack so that deep trees
+ * cannot overflow the caller's.
+ *
+ * Relocations whose presumed offset no longer matches their target are
+ * counted in exec_stats.relocs_needed.
+ */
+static int
+drm_intel_gem_bo_process_relocs(drm_intel_bo *bo, bool exec2)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	int depth = 0;
+	int ret;
 
-		/* Continue walking the tree depth-first. */
-		drm_intel_gem_bo_process_reloc(target_bo);
+	if (((drm_intel_bo_gem *) bo)->relocs == NULL)
+		return 0;
 
-		/* Add the target to the validate list */
-		drm_intel_add_validate_buffer(target_bo);
-	}
-}
+	ret = drm_intel_gem_walk_push(bufmgr_gem, bo, depth++);
+	if (ret)
+		return ret;
 
-static void
-drm_intel_gem_bo_process_reloc2(drm_intel_bo *bo)
-{
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *)bo;
-	int i;
+	while (depth > 0) {
+		struct drm_intel_gem_walk_frame *frame;
+		drm_intel_bo_gem *bo_gem;
+		drm_intel_bo *target_bo;
 
-	if (bo_gem->relocs == NULL)
-		return;
+		frame = &bufmgr_gem->walk_stack[depth - 1];
+		bo_gem = (drm_intel_bo_gem *) frame->bo;
 
-	for (i = 0; i < bo_gem->reloc_count; i++) {
-		drm_intel_bo *target_bo = bo_gem->reloc_target_info[i].bo;
-		int need_fence;
+		if (frame->reloc == bo_gem->reloc_count) {
+			/* Done with this subtree; its root gets added to the
+			 * list on behalf of the parent's relocation below.
+			 */
+			if (--depth == 0)
+				break;
+			target_bo = frame->bo;
+			frame--;
+			bo_gem = (drm_intel_bo_gem *) frame->bo;
+		} else {
+			drm_intel_bo_gem *target_gem;
 
-		if (target_bo == bo)
-			continue;
+			target_bo = drm_intel_gem_bo_storage(bo_gem->reloc_target_info[frame->reloc].bo);
 
-		drm_intel_gem_bo_mark_mmaps_incoherent(bo);
+			bufmgr_gem->exec_stats.relocs++;
+			if (bo_gem->relocs[frame->reloc].presumed_offset !=
+			    target_bo->offset)
+				bufmgr_gem->exec_stats.relocs_needed++;
 
-		/* Continue walking the tree depth-first. */
-		drm_intel_gem_bo_process_reloc2(target_bo);
+			if (target_bo == frame->bo) {
+				frame->reloc++;
+				continue;
+			}
 
-		need_fence = (bo_gem->reloc_target_info[i].flags &
-			      DRM_INTEL_RELOC_FENCE);
+			/* Continue walking the tree depth-first. */
+			target_gem = (drm_intel_bo_gem *) target_bo;
+			if (target_gem->relocs != NULL &&
+			    target_gem->walk_gen != bufmgr_gem->exec_gen) {
+				ret = drm_intel_gem_walk_push(bufmgr_gem,
+							      target_bo,
+							      depth++);
+				if (ret)
+					return ret;
+				continue;
+			}
+		}
 
 		/* Add the target to the validate list */
-		drm_intel_add_validate_buffer2(target_bo, need_fence);
+		if (exec2) {
+			uint64_t flags = 0;
+
+			if (bo_gem->reloc_target_info[frame->reloc].flags &
+			    DRM_INTEL_RELOC_FENCE)
+				flags |= EXEC_OBJECT_NEEDS_FENCE;
+			/* Without relocation processing, the kernel learns
+			 * about writes from the validation list only.
+			 */
+			if (bufmgr_gem->no_reloc &&
+			    bo_gem->relocs[frame->reloc].write_domain)
+				flags |= EXEC_OBJECT_WRITE;
+
+			ret = drm_intel_add_validate_buffer2(target_bo, flags);
+		} else {
+			ret = drm_intel_add_validate_buffer(target_bo);
+		}
+		if (ret)
+			return ret;
+		frame->reloc++;
 	}
-}
 
+	return 0;
+}
 
 static void
 drm_intel_update_buffer_offsets(drm_intel_bufmgr_gem *bufmgr_gem)
@@ -1762,27 +3821,41 @@ drm_intel_update_buffer_offsets(drm_intel_bufmgr_gem *bufmgr_gem)
 			    (unsigned long long)bufmgr_gem->exec_objects[i].
 			    offset);
 			bo->offset = bufmgr_gem->exec_objects[i].offset;
+			if (bo_gem->backing_slab != NULL)
+				drm_intel_gem_slab_set_offset(bo_gem->backing_slab);
 		}
 	}
 }
 
-static void
-drm_intel_update_buffer_offsets2 (drm_intel_bufmgr_gem *bufmgr_gem)
+/**
+ * Picks up the offsets the kernel placed the buffers at, returning whether
+ * any of them moved.
+ */
+static bool
+drm_intel_update_buffer_offsets2 (drm_intel_bufmgr_gem *bufmgr_gem,
+				  struct drm_i915_gem_exec_object2 *objects,
+				  drm_intel_bo **bos, int count)
 {
+	bool moved = false;
 	int i;
 
-	for (i = 0; i < bufmgr_gem->exec_count; i++) {
-		drm_intel_bo *bo = bufmgr_gem->exec_bos[i];
+	for (i = 0; i < count; i++) {
+		drm_intel_bo *bo = bos[i];
 		drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *)bo;
 
 		/* Update the buffer offset */
-		if (bufmgr_gem->exec2_objects[i].offset != bo->offset) {
+		if (objects[i].offset != bo->offset) {
 			DBG("BO %d (%s) migrated: 0x%08lx -> 0x%08llx\n",
 			    bo_gem->gem_handle, bo_gem->name, bo->offset,
-			    (unsigned long long)bufmgr_gem->exec2_objects[i].offset);
-			bo->offset = bufmgr_gem->exec2_objects[i].offset;
+			    (unsigned long long)objects[i].offset);
+			bo->offset = objects[i].offset;
+			if (bo_gem->backing_slab != NULL)
+				drm_intel_gem_slab_set_offset(bo_gem->backing_slab);
+			moved = true;
 		}
 	}
+
+	return moved;
 }
 
 static void
@@ -2024,46 +4097,241 @@ drm_intel_gem_bo_aub_dump_bmp(drm_intel_bo *bo,
 static void
 aub_exec(drm_intel_bo *bo, int ring_flag, int used)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	int i;
+	bool batch_buffer_needs_annotations;
+
+	if (!bufmgr_gem->aub_file)
+		return;
+
+	/* If batch buffer is not annotated, annotate it the best we
+	 * can.
+	 */
+	batch_buffer_needs_annotations = bo_gem->aub_annotation_count == 0;
+	if (batch_buffer_needs_annotations) {
+		drm_intel_aub_annotation annotations[2] = {
+			{ AUB_TRACE_TYPE_BATCH, 0, used },
+			{ AUB_TRACE_TYPE_NOTYPE, 0, bo->size }
+		};
+		drm_intel_bufmgr_gem_set_aub_annotations(bo, annotations, 2);
+	}
+
+	/* Write out all buffers to AUB memory */
+	for (i = 0; i < bufmgr_gem->exec_count; i++) {
+		aub_write_bo(bufmgr_gem->exec_bos[i]);
+	}
+
+	/* Remove any annotations we added */
+	if (batch_buffer_needs_annotations)
+		drm_intel_bufmgr_gem_set_aub_annotations(bo, NULL, 0);
+
+	/* Dump ring buffer */
+	aub_build_dump_ringbuffer(bufmgr_gem, bo_gem->aub_offset, ring_flag);
+
+	fflush(bufmgr_gem->aub_file);
+
+	/*
+	 * One frame has been dumped. So reset the aub_offset for the next frame.
+	 *
+	 * FIXME: Can we do this?
+	 */
+	bufmgr_gem->aub_offset = 0x10000;
+}
+
+/**
+ * Finishes the submissions the thread is done with: picks up the offsets
+ * the kernel chose and drops the references the jobs held.  Blocks until
+ * at least \c until jobs have been reaped in total.
+ */
+static void
+drm_intel_gem_exec_reap_locked(drm_intel_bufmgr_gem *bufmgr_gem,
+			       uint64_t until)
+{
+	struct drm_intel_gem_exec_queue *queue = bufmgr_gem->exec_queue;
+	struct timespec time;
+	bool have_time = false;
+
+	while (queue->reaped < queue->head) {
+		struct drm_intel_gem_exec_job *job;
+		int i;
+
+		if (queue->reaped < until) {
+			while (sem_wait(&queue->completed) == -1 &&
+			       errno == EINTR)
+				;
+		} else if (sem_trywait(&queue->completed) == -1) {
+			break;
+		}
+
+		if (!have_time) {
+			clock_gettime(CLOCK_MONOTONIC, &time);
+			have_time = true;
+		}
+
+		job = &queue->jobs[queue->reaped % queue->depth];
+		if (!drm_intel_update_buffer_offsets2(bufmgr_gem, job->objects,
+						      job->bos,
+						      job->execbuf.buffer_count) &&
+		    job->ret == 0 && job->no_reloc) {
+			bufmgr_gem->exec_stats.no_reloc_execs++;
+			bufmgr_gem->exec_stats.relocs_skipped += job->relocs;
+		}
+		if (job->ret != 0 && queue->error == 0)
+			queue->error = job->ret;
+
+		for (i = 0; i < job->execbuf.buffer_count; i++) {
+			drm_intel_bo_gem *bo_gem =
+				(drm_intel_bo_gem *) job->bos[i];
+
+			atomic_dec(&bo_gem->exec_pending, 1);
+			drm_intel_gem_bo_unreference_locked_timed(job->bos[i],
+								  time.tv_sec);
+		}
+		job->batch = NULL;
+		queue->reaped++;
+	}
+}
+
+/**
+ * Makes sure that the queued submissions using bo have reached the
+ * kernel, before asking it about or changing the buffer's contents.
+ */
+static void
+drm_intel_gem_bo_exec_sync(drm_intel_bo *bo, bool locked)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem =
+		(drm_intel_bo_gem *) drm_intel_gem_bo_storage(bo);
+
+	if (atomic_read(&bo_gem->exec_pending) == 0)
+		return;
+
+	if (!locked)
+		pthread_mutex_lock(&bufmgr_gem->lock);
+	drm_intel_gem_exec_reap_locked(bufmgr_gem,
+				       bufmgr_gem->exec_queue->head);
+	if (!locked)
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+}
+
+static void *
+drm_intel_gem_exec_thread(void *arg)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = arg;
+	struct drm_intel_gem_exec_queue *queue = bufmgr_gem->exec_queue;
+
+	for (;;) {
+		struct drm_intel_gem_exec_job *job;
+
+		while (sem_wait(&queue->queued) == -1 && errno == EINTR)
+			;
+		if (queue->stop)
+			break;
+
+		job = &queue->jobs[queue->tail++ % queue->depth];
+		job->ret = 0;
+		if (drmIoctl(bufmgr_gem->fd,
+			     DRM_IOCTL_I915_GEM_EXECBUFFER2,
+			     &job->execbuf) != 0) {
+			job->ret = -errno;
+			DBG("Execbuffer of %s failed: %s\n",
+			    ((drm_intel_bo_gem *) job->batch)->name,
+			    strerror(errno));
+		}
+
+		if (queue->callback)
+			queue->callback(job->batch, job->ret,
+					queue->callback_data);
+		sem_post(&queue->completed);
+	}
+
+	return NULL;
+}
+
+/**
+ * Copies the validation list into the next free job slot and hands it to
+ * the submission thread.
+ */
+static int
+drm_intel_gem_exec_queue_job(drm_intel_bufmgr_gem *bufmgr_gem,
+			     drm_intel_bo *batch,
+			     const struct drm_i915_gem_execbuffer2 *execbuf,
+			     unsigned long relocs, bool no_reloc)
+{
+	struct drm_intel_gem_exec_queue *queue = bufmgr_gem->exec_queue;
+	struct drm_intel_gem_exec_job *job;
 	int i;
-	bool batch_buffer_needs_annotations;
 
-	if (!bufmgr_gem->aub_file)
-		return;
+	/* Wait for a free slot */
+	drm_intel_gem_exec_reap_locked(bufmgr_gem,
+				       queue->head + 1 < queue->depth ? 0 :
+				       queue->head + 1 - queue->depth);
 
-	/* If batch buffer is not annotated, annotate it the best we
-	 * can.
-	 */
-	batch_buffer_needs_annotations = bo_gem->aub_annotation_count == 0;
-	if (batch_buffer_needs_annotations) {
-		drm_intel_aub_annotation annotations[2] = {
-			{ AUB_TRACE_TYPE_BATCH, 0, used },
-			{ AUB_TRACE_TYPE_NOTYPE, 0, bo->size }
-		};
-		drm_intel_bufmgr_gem_set_aub_annotations(bo, annotations, 2);
+	job = &queue->jobs[queue->head % queue->depth];
+	if (job->size < bufmgr_gem->exec_count) {
+		struct drm_i915_gem_exec_object2 *objects;
+		drm_intel_bo **bos;
+
+		objects = realloc(job->objects,
+				  sizeof(*objects) * bufmgr_gem->exec_size);
+		if (objects == NULL)
+			return -ENOMEM;
+		job->objects = objects;
+
+		bos = realloc(job->bos, sizeof(*bos) * bufmgr_gem->exec_size);
+		if (bos == NULL)
+			return -ENOMEM;
+		job->bos = bos;
+
+		job->size = bufmgr_gem->exec_size;
 	}
 
-	/* Write out all buffers to AUB memory */
+	memcpy(job->objects, bufmgr_gem->exec2_objects,
+	       sizeof(*job->objects) * bufmgr_gem->exec_count);
+	memcpy(job->bos, bufmgr_gem->exec_bos,
+	       sizeof(*job->bos) * bufmgr_gem->exec_count);
 	for (i = 0; i < bufmgr_gem->exec_count; i++) {
-		aub_write_bo(bufmgr_gem->exec_bos[i]);
+		drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) job->bos[i];
+
+		drm_intel_gem_bo_reference(job->bos[i]);
+		atomic_inc(&bo_gem->exec_pending);
 	}
 
-	/* Remove any annotations we added */
-	if (batch_buffer_needs_annotations)
-		drm_intel_bufmgr_gem_set_aub_annotations(bo, NULL, 0);
+	job->execbuf = *execbuf;
+	job->execbuf.buffers_ptr = (uintptr_t) job->objects;
+	job->batch = batch;
+	job->relocs = relocs;
+	job->no_reloc = no_reloc;
 
-	/* Dump ring buffer */
-	aub_build_dump_ringbuffer(bufmgr_gem, bo_gem->aub_offset, ring_flag);
+	queue->head++;
+	sem_post(&queue->queued);
+	return 0;
+}
 
-	fflush(bufmgr_gem->aub_file);
+static void
+drm_intel_gem_exec_queue_destroy(drm_intel_bufmgr_gem *bufmgr_gem)
+{
+	struct drm_intel_gem_exec_queue *queue = bufmgr_gem->exec_queue;
+	unsigned int i;
 
-	/*
-	 * One frame has been dumped. So reset the aub_offset for the next frame.
-	 *
-	 * FIXME: Can we do this?
-	 */
-	bufmgr_gem->aub_offset = 0x10000;
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	drm_intel_gem_exec_reap_locked(bufmgr_gem, queue->head);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	queue->stop = true;
+	sem_post(&queue->queued);
+	pthread_join(queue->thread, NULL);
+
+	for (i = 0; i < queue->depth; i++) {
+		free(queue->jobs[i].objects);
+		free(queue->jobs[i].bos);
+	}
+	free(queue->jobs);
+	sem_destroy(&queue->queued);
+	sem_destroy(&queue->completed);
+	free(queue);
+	bufmgr_gem->exec_queue = NULL;
 }
 
 static int
@@ -2073,19 +4341,27 @@ drm_intel_gem_bo_exec(drm_intel_bo *bo, int used,
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
 	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
 	struct drm_i915_gem_execbuffer execbuf;
-	int ret, i;
+	int ret;
 
 	if (bo_gem->has_error)
 		return -ENOMEM;
 
+	if (bo_gem->slab != NULL)
+		return -EINVAL;
+
 	pthread_mutex_lock(&bufmgr_gem->lock);
 	/* Update indices and set up the validate list. */
-	drm_intel_gem_bo_process_reloc(bo);
+	ret = drm_intel_gem_bo_process_relocs(bo, false);
 
 	/* Add the batch buffer to the validation list.  There are no
 	 * relocations pointing to it.
 	 */
-	drm_intel_add_validate_buffer(bo);
+	if (ret == 0)
+		ret = drm_intel_add_validate_buffer(bo);
+	if (ret)
+		goto out;
+
+	bufmgr_gem->exec_stats.execs++;
 
 	VG_CLEAR(execbuf);
 	execbuf.buffers_ptr = (uintptr_t) bufmgr_gem->exec_objects;
@@ -2115,18 +4391,14 @@ drm_intel_gem_bo_exec(drm_intel_bo *bo, int used,
 		}
 	}
 	drm_intel_update_buffer_offsets(bufmgr_gem);
+	drm_intel_gem_upload_rings_fence(bufmgr_gem, bo);
 
 	if (bufmgr_gem->bufmgr.debug)
 		drm_intel_gem_dump_validation_list(bufmgr_gem);
 
-	for (i = 0; i < bufmgr_gem->exec_count; i++) {
-		drm_intel_bo *bo = bufmgr_gem->exec_bos[i];
-		drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-
-		/* Disconnect the buffer from the validate list */
-		bo_gem->validate_index = -1;
-		bufmgr_gem->exec_bos[i] = NULL;
-	}
+out:
+	/* Disconnect the buffers from the validate list */
+	bufmgr_gem->exec_gen++;
 	bufmgr_gem->exec_count = 0;
 	pthread_mutex_unlock(&bufmgr_gem->lock);
 
@@ -2140,8 +4412,12 @@ drm_intel_gem_bo_mrb_exec2(drm_intel_bo *bo, int used,
 {
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bo->bufmgr;
 	struct drm_i915_gem_execbuffer2 execbuf;
+	unsigned long relocs, relocs_needed;
+	bool no_reloc;
 	int ret = 0;
-	int i;
+
+	if (((drm_intel_bo_gem *)bo)->slab != NULL)
+		return -EINVAL;
 
 	switch (flags & 0x7) {
 	default:
@@ -2159,229 +4435,903 @@ drm_intel_gem_bo_mrb_exec2(drm_intel_bo *bo, int used,
 		break;
 	}
 
-	pthread_mutex_lock(&bufmgr_gem->lock);
-	/* Update indices and set up the validate list. */
-	drm_intel_gem_bo_process_reloc2(bo);
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	if (bufmgr_gem->exec_queue != NULL)
+		drm_intel_gem_exec_reap_locked(bufmgr_gem,
+					       bufmgr_gem->exec_queue->reaped);
+	relocs = bufmgr_gem->exec_stats.relocs;
+	relocs_needed = bufmgr_gem->exec_stats.relocs_needed;
+
+	/* Update indices and set up the validate list. */
+	ret = drm_intel_gem_bo_process_relocs(bo, true);
+
+	/* Add the batch buffer to the validation list.  There are no relocations
+	 * pointing to it.
+	 */
+	if (ret == 0)
+		ret = drm_intel_add_validate_buffer2(bo, 0);
+	if (ret)
+		goto out;
+
+	/* If none of the targets has moved since its relocations were
+	 * written, the kernel only needs to look at them when it has to move
+	 * something itself.
+	 */
+	no_reloc = bufmgr_gem->no_reloc &&
+		bufmgr_gem->exec_stats.relocs_needed == relocs_needed;
+	relocs = bufmgr_gem->exec_stats.relocs - relocs;
+	bufmgr_gem->exec_stats.execs++;
+
+	VG_CLEAR(execbuf);
+	execbuf.buffers_ptr = (uintptr_t)bufmgr_gem->exec2_objects;
+	execbuf.buffer_count = bufmgr_gem->exec_count;
+	execbuf.batch_start_offset = 0;
+	execbuf.batch_len = used;
+	execbuf.cliprects_ptr = (uintptr_t)cliprects;
+	execbuf.num_cliprects = num_cliprects;
+	execbuf.DR1 = 0;
+	execbuf.DR4 = DR4;
+	execbuf.flags = flags;
+	if (no_reloc)
+		execbuf.flags |= I915_EXEC_NO_RELOC;
+	execbuf.rsvd1 = 0;
+	execbuf.rsvd2 = 0;
+
+	if (bufmgr_gem->exec_queue != NULL) {
+		/* Let the submission thread do the ioctl, unless the batch
+		 * gets dumped or skipped, which must not overtake it.
+		 */
+		if (bufmgr_gem->aub_file == NULL && !bufmgr_gem->no_exec) {
+			ret = drm_intel_gem_exec_queue_job(bufmgr_gem, bo,
+							   &execbuf, relocs,
+							   no_reloc);
+			goto skip_execution;
+		}
+		drm_intel_gem_exec_reap_locked(bufmgr_gem,
+					       bufmgr_gem->exec_queue->head);
+	}
+
+	aub_exec(bo, flags, used);
+
+	if (bufmgr_gem->no_exec)
+		goto skip_execution;
+
+	ret = drmIoctl(bufmgr_gem->fd,
+		       DRM_IOCTL_I915_GEM_EXECBUFFER2,
+		       &execbuf);
+	if (ret != 0) {
+		ret = -errno;
+		if (ret == -ENOSPC) {
+			DBG("Execbuffer fails to pin. "
+			    "Estimate: %u. Actual: %u. Available: %u\n",
+			    drm_intel_gem_estimate_batch_space(bufmgr_gem->exec_bos,
+							       bufmgr_gem->exec_count),
+			    drm_intel_gem_compute_batch_space(bufmgr_gem->exec_bos,
+							      bufmgr_gem->exec_count),
+			    (unsigned int) bufmgr_gem->gtt_size);
+		}
+	}
+	if (!drm_intel_update_buffer_offsets2(bufmgr_gem,
+					      bufmgr_gem->exec2_objects,
+					      bufmgr_gem->exec_bos,
+					      bufmgr_gem->exec_count) &&
+	    ret == 0 && no_reloc) {
+		bufmgr_gem->exec_stats.no_reloc_execs++;
+		bufmgr_gem->exec_stats.relocs_skipped += relocs;
+	}
+
+skip_execution:
+	drm_intel_gem_upload_rings_fence(bufmgr_gem, bo);
+
+	if (bufmgr_gem->bufmgr.debug)
+		drm_intel_gem_dump_validation_list(bufmgr_gem);
+
+out:
+	/* Disconnect the buffers from the validate list */
+	bufmgr_gem->exec_gen++;
+	bufmgr_gem->exec_count = 0;
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	return ret;
+}
+
+static int
+drm_intel_gem_bo_exec2(drm_intel_bo *bo, int used,
+		       drm_clip_rect_t *cliprects, int num_cliprects,
+		       int DR4)
+{
+	return drm_intel_gem_bo_mrb_exec2(bo, used,
+					cliprects, num_cliprects, DR4,
+					I915_EXEC_RENDER);
+}
+
+static int
+drm_intel_gem_bo_pin(drm_intel_bo *bo, uint32_t alignment)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	struct drm_i915_gem_pin pin;
+	int ret;
+
+	if (bo_gem->slab != NULL)
+		return -EINVAL;
+
+	VG_CLEAR(pin);
+	pin.handle = bo_gem->gem_handle;
+	pin.alignment = alignment;
+
+	ret = drmIoctl(bufmgr_gem->fd,
+		       DRM_IOCTL_I915_GEM_PIN,
+		       &pin);
+	if (ret != 0)
+		return -errno;
+
+	bo->offset = pin.offset;
+	return 0;
+}
+
+static int
+drm_intel_gem_bo_unpin(drm_intel_bo *bo)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	struct drm_i915_gem_unpin unpin;
+	int ret;
+
+	if (bo_gem->slab != NULL)
+		return -EINVAL;
+
+	VG_CLEAR(unpin);
+	unpin.handle = bo_gem->gem_handle;
+
+	ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_I915_GEM_UNPIN, &unpin);
+	if (ret != 0)
+		return -errno;
+
+	return 0;
+}
+
+static int
+drm_intel_gem_bo_set_tiling_internal(drm_intel_bo *bo,
+				     uint32_t tiling_mode,
+				     uint32_t stride)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	struct drm_i915_gem_set_tiling set_tiling;
+	int ret;
+
+	if (bo_gem->global_name == 0 &&
+	    tiling_mode == bo_gem->tiling_mode &&
+	    stride == bo_gem->stride)
+		return 0;
+
+	memset(&set_tiling, 0, sizeof(set_tiling));
+	do {
+		/* set_tiling is slightly broken and overwrites the
+		 * input on the error path, so we have to open code
+		 * rmIoctl.
+		 */
+		set_tiling.handle = bo_gem->gem_handle;
+		set_tiling.tiling_mode = tiling_mode;
+		set_tiling.stride = stride;
+
+		ret = ioctl(bufmgr_gem->fd,
+			    DRM_IOCTL_I915_GEM_SET_TILING,
+			    &set_tiling);
+	} while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+	if (ret == -1)
+		return -errno;
+
+	bo_gem->tiling_mode = set_tiling.tiling_mode;
+	bo_gem->swizzle_mode = set_tiling.swizzle_mode;
+	bo_gem->stride = set_tiling.stride;
+	return 0;
+}
+
+static int
+drm_intel_gem_bo_set_tiling(drm_intel_bo *bo, uint32_t * tiling_mode,
+			    uint32_t stride)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	int ret;
+
+	/* Linear buffers have no stride. By ensuring that we only ever use
+	 * stride 0 with linear buffers, we simplify our code.
+	 */
+	if (*tiling_mode == I915_TILING_NONE)
+		stride = 0;
+
+	/* Sub-allocated buffers share the tiling of their slab, and the
+	 * layout of client memory is the client's business.
+	 */
+	if ((bo_gem->slab != NULL || bo_gem->user_virtual) &&
+	    *tiling_mode != I915_TILING_NONE) {
+		*tiling_mode = bo_gem->tiling_mode;
+		return -EINVAL;
+	}
+
+	drm_intel_gem_bo_exec_sync(bo, false);
+
+	ret = drm_intel_gem_bo_set_tiling_internal(bo, *tiling_mode, stride);
+	if (ret == 0)
+		drm_intel_bo_gem_set_in_aperture_size(bufmgr_gem, bo_gem);
+
+	*tiling_mode = bo_gem->tiling_mode;
+	return ret;
+}
+
+static int
+drm_intel_gem_bo_get_tiling(drm_intel_bo *bo, uint32_t * tiling_mode,
+			    uint32_t * swizzle_mode)
+{
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+
+	*tiling_mode = bo_gem->tiling_mode;
+	*swizzle_mode = bo_gem->swizzle_mode;
+	return 0;
+}
+
+/** How rectangles of a tiled buffer are laid out in its CPU mapping */
+struct drm_intel_gem_tiled_layout {
+	unsigned int width_shift;	/* log2 of the tile width in bytes */
+	unsigned int height_shift;	/* log2 of the tile height in rows */
+	unsigned int span;		/* bytes contiguous within a tile row */
+	unsigned long stride;
+	uint32_t swizzle_mode;
+};
+
+static unsigned long
+drm_intel_gem_tiled_offset(const struct drm_intel_gem_tiled_layout *layout,
+			   unsigned long x, unsigned long y)
+{
+	unsigned long tx = x & ((1UL << layout->width_shift) - 1);
+	unsigned long ty = y & ((1UL << layout->height_shift) - 1);
+	unsigned long offset;
+
+	offset = ((y >> layout->height_shift) * layout->stride <<
+		  layout->height_shift) +
+		((x >> layout->width_shift) << 12);
 
-	/* Add the batch buffer to the validation list.  There are no relocations
-	 * pointing to it.
+	/* X tiles are 8 rows of 512 bytes, Y tiles 8 columns of 32 rows
+	 * of 16 bytes.
 	 */
-	drm_intel_add_validate_buffer2(bo, 0);
-
-	VG_CLEAR(execbuf);
-	execbuf.buffers_ptr = (uintptr_t)bufmgr_gem->exec2_objects;
-	execbuf.buffer_count = bufmgr_gem->exec_count;
-	execbuf.batch_start_offset = 0;
-	execbuf.batch_len = used;
-	execbuf.cliprects_ptr = (uintptr_t)cliprects;
-	execbuf.num_cliprects = num_cliprects;
-	execbuf.DR1 = 0;
-	execbuf.DR4 = DR4;
-	execbuf.flags = flags;
-	execbuf.rsvd1 = 0;
-	execbuf.rsvd2 = 0;
+	if (layout->height_shift == 3)
+		offset += (ty << 9) + tx;
+	else
+		offset += ((tx >> 4) << 9) + (ty << 4) + (tx & 15);
 
-	aub_exec(bo, flags, used);
+	/* The memory controller flips bit 6 with higher address bits */
+	switch (layout->swizzle_mode) {
+	case I915_BIT_6_SWIZZLE_9:
+		offset ^= (offset >> 3) & 64;
+		break;
+	case I915_BIT_6_SWIZZLE_9_10:
+		offset ^= ((offset >> 3) ^ (offset >> 4)) & 64;
+		break;
+	case I915_BIT_6_SWIZZLE_9_11:
+		offset ^= ((offset >> 3) ^ (offset >> 5)) & 64;
+		break;
+	case I915_BIT_6_SWIZZLE_9_10_11:
+		offset ^= ((offset >> 3) ^ (offset >> 4) ^ (offset >> 5)) & 64;
+		break;
+	}
 
-	if (bufmgr_gem->no_exec)
-		goto skip_execution;
+	return offset;
+}
 
-	ret = drmIoctl(bufmgr_gem->fd,
-		       DRM_IOCTL_I915_GEM_EXECBUFFER2,
-		       &execbuf);
-	if (ret != 0) {
-		ret = -errno;
-		if (ret == -ENOSPC) {
-			DBG("Execbuffer fails to pin. "
-			    "Estimate: %u. Actual: %u. Available: %u\n",
-			    drm_intel_gem_estimate_batch_space(bufmgr_gem->exec_bos,
-							       bufmgr_gem->exec_count),
-			    drm_intel_gem_compute_batch_space(bufmgr_gem->exec_bos,
-							      bufmgr_gem->exec_count),
-			    (unsigned int) bufmgr_gem->gtt_size);
+/**
+ * Copies a rectangle between linear memory and a mapping of a tiled
+ * buffer, one run of bytes that stay contiguous in the tiled layout at a
+ * time: 16 bytes in Y tiles, 64 in swizzled and 512 in plain X tiles.
+ */
+static void
+drm_intel_gem_tiled_copy(const struct drm_intel_gem_tiled_layout *layout,
+			 char *tiled, char *linear, unsigned long pitch,
+			 unsigned long x, unsigned long y,
+			 unsigned long width, unsigned long height,
+			 bool upload)
+{
+	unsigned long row, done, n;
+
+	for (row = 0; row < height; row++) {
+		char *line = linear + row * pitch;
+
+		for (done = 0; done < width; done += n) {
+			char *p = tiled +
+				drm_intel_gem_tiled_offset(layout, x + done,
+							   y + row);
+
+			n = layout->span - ((x + done) & (layout->span - 1));
+			if (n > width - done)
+				n = width - done;
+
+			/* Let the compiler inline the common whole runs */
+			if (n == 16 && upload)
+				memcpy(p, line + done, 16);
+			else if (n == 16)
+				memcpy(line + done, p, 16);
+			else if (n == 64 && upload)
+				memcpy(p, line + done, 64);
+			else if (n == 64)
+				memcpy(line + done, p, 64);
+			else if (upload)
+				memcpy(p, line + done, n);
+			else
+				memcpy(line + done, p, n);
 		}
 	}
-	drm_intel_update_buffer_offsets2(bufmgr_gem);
+}
 
-skip_execution:
-	if (bufmgr_gem->bufmgr.debug)
-		drm_intel_gem_dump_validation_list(bufmgr_gem);
+static int
+drm_intel_gem_bo_copy_tiled(drm_intel_bo *bo, uint32_t x, uint32_t y,
+			    uint32_t width, uint32_t height,
+			    char *data, uint32_t pitch, bool upload)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	struct drm_intel_gem_tiled_layout layout;
+	void *virtual;
+	char *tiled;
+	int ret;
 
-	for (i = 0; i < bufmgr_gem->exec_count; i++) {
-		drm_intel_bo *bo = bufmgr_gem->exec_bos[i];
-		drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *)bo;
+	switch (bo_gem->tiling_mode) {
+	case I915_TILING_X:
+		if (bufmgr_gem->gen < 3)
+			return -ENODEV;
+		layout.width_shift = 9;
+		layout.height_shift = 3;
+		layout.span = 512;
+		break;
+	case I915_TILING_Y:
+		if (bufmgr_gem->gen < 4)
+			return -ENODEV;
+		layout.width_shift = 7;
+		layout.height_shift = 5;
+		layout.span = 16;
+		break;
+	default:
+		return -EINVAL;
+	}
 
-		/* Disconnect the buffer from the validate list */
-		bo_gem->validate_index = -1;
-		bufmgr_gem->exec_bos[i] = NULL;
+	/* Swizzling on bit 17 depends on the physical address of each page */
+	switch (bo_gem->swizzle_mode) {
+	case I915_BIT_6_SWIZZLE_NONE:
+		break;
+	case I915_BIT_6_SWIZZLE_9:
+	case I915_BIT_6_SWIZZLE_9_10:
+	case I915_BIT_6_SWIZZLE_9_11:
+	case I915_BIT_6_SWIZZLE_9_10_11:
+		if (layout.span > 64)
+			layout.span = 64;
+		break;
+	default:
+		return -ENODEV;
 	}
-	bufmgr_gem->exec_count = 0;
-	pthread_mutex_unlock(&bufmgr_gem->lock);
+	layout.swizzle_mode = bo_gem->swizzle_mode;
+	layout.stride = bo_gem->stride;
 
-	return ret;
+	if (width == 0 || height == 0)
+		return 0;
+	if ((uint64_t) x + width > layout.stride ||
+	    ROUND_UP_TO((uint64_t) y + height, 1UL << layout.height_shift) *
+	    layout.stride > bo->size)
+		return -EINVAL;
+
+	/* The CPU mapping sees the tiled layout; keep a GTT mapping the
+	 * caller may hold in bo->virtual.
+	 */
+	virtual = bo->virtual;
+	ret = drm_intel_gem_bo_map(bo, upload);
+	if (ret)
+		return ret;
+	tiled = bo->virtual;
+
+	drm_intel_gem_tiled_copy(&layout, tiled, data, pitch,
+				 x, y, width, height, upload);
+
+	drm_intel_gem_bo_unmap(bo);
+	if (virtual != NULL)
+		bo->virtual = virtual;
+	return 0;
 }
 
 static int
-drm_intel_gem_bo_exec2(drm_intel_bo *bo, int used,
-		       drm_clip_rect_t *cliprects, int num_cliprects,
-		       int DR4)
+drm_intel_gem_bo_upload_tiled(drm_intel_bo *bo, uint32_t x, uint32_t y,
+			      uint32_t width, uint32_t height,
+			      const void *data, uint32_t pitch)
 {
-	return drm_intel_gem_bo_mrb_exec2(bo, used,
-					cliprects, num_cliprects, DR4,
-					I915_EXEC_RENDER);
+	return drm_intel_gem_bo_copy_tiled(bo, x, y, width, height,
+					   (char *) data, pitch, true);
 }
 
 static int
-drm_intel_gem_bo_pin(drm_intel_bo *bo, uint32_t alignment)
+drm_intel_gem_bo_readback_tiled(drm_intel_bo *bo, uint32_t x, uint32_t y,
+				uint32_t width, uint32_t height,
+				void *data, uint32_t pitch)
+{
+	return drm_intel_gem_bo_copy_tiled(bo, x, y, width, height,
+					   data, pitch, false);
+}
+
+static int
+drm_intel_gem_bo_flink(drm_intel_bo *bo, uint32_t * name)
 {
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
 	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-	struct drm_i915_gem_pin pin;
 	int ret;
 
-	VG_CLEAR(pin);
-	pin.handle = bo_gem->gem_handle;
-	pin.alignment = alignment;
+	/* A name would give access to the whole slab */
+	if (bo_gem->slab != NULL)
+		return -EINVAL;
 
-	ret = drmIoctl(bufmgr_gem->fd,
-		       DRM_IOCTL_I915_GEM_PIN,
-		       &pin);
-	if (ret != 0)
-		return -errno;
+	if (!bo_gem->global_name) {
+		struct drm_gem_flink flink;
 
-	bo->offset = pin.offset;
+		VG_CLEAR(flink);
+		flink.handle = bo_gem->gem_handle;
+
+		ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_GEM_FLINK, &flink);
+		if (ret != 0)
+			return -errno;
+
+		pthread_mutex_lock(&bufmgr_gem->lock);
+		bo_gem->global_name = flink.name;
+		drmHashInsert(bufmgr_gem->name_table, bo_gem->global_name,
+			      bo_gem);
+		drm_intel_gem_bo_mark_shared_locked(bufmgr_gem, bo_gem);
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+	}
+
+	*name = bo_gem->global_name;
 	return 0;
 }
 
-static int
-drm_intel_gem_bo_unpin(drm_intel_bo *bo)
+/**
+ * Exports a buffer as a dma-buf file descriptor, to be imported with
+ * drm_intel_bo_gem_create_from_prime() or by another device.
+ *
+ * The buffer is no longer reused once shared.  Returns 0 or a negative
+ * errno.
+ */
+int
+drm_intel_bo_gem_export_to_prime(drm_intel_bo *bo, int *prime_fd)
 {
 	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
 	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-	struct drm_i915_gem_unpin unpin;
 	int ret;
 
-	VG_CLEAR(unpin);
-	unpin.handle = bo_gem->gem_handle;
+	/* The dma-buf would give access to the whole slab */
+	if (bo_gem->slab != NULL)
+		return -EINVAL;
 
-	ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_I915_GEM_UNPIN, &unpin);
+	ret = drmPrimeHandleToFD(bufmgr_gem->fd, bo_gem->gem_handle,
+				 DRM_CLOEXEC, prime_fd);
 	if (ret != 0)
 		return -errno;
 
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	drm_intel_gem_bo_mark_shared_locked(bufmgr_gem, bo_gem);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
 	return 0;
 }
 
-static int
-drm_intel_gem_bo_set_tiling_internal(drm_intel_bo *bo,
-				     uint32_t tiling_mode,
-				     uint32_t stride)
+/**
+ * Enables unlimited caching of buffer objects for reuse.
+ *
+ * This is potentially very memory expensive, as the cache at each bucket
+ * size is only bounded by how many buffers of that size we've managed to have
+ * in flight at once.
+ */
+void
+drm_intel_bufmgr_gem_enable_reuse(drm_intel_bufmgr *bufmgr)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-	struct drm_i915_gem_set_tiling set_tiling;
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
+
+	bufmgr_gem->bo_reuse = true;
+}
+
+/**
+ * Enables carving small untiled buffer objects out of larger ones.
+ *
+ * Buffers of up to 2KB are then allocated from shared slabs, so they no
+ * longer each take a page and an entry in the validation list.  Such
+ * buffers can be mapped, read, written and used as relocation targets,
+ * but can't be named, pinned, tiled, executed, or contain relocations
+ * themselves.  Waiting for or checking whether one is busy applies to
+ * its whole slab.
+ */
+void
+drm_intel_bufmgr_gem_enable_suballoc(drm_intel_bufmgr *bufmgr)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
+
+	bufmgr_gem->suballoc = true;
+}
+
+/**
+ * Enables relocation-free submission, if the kernel supports it.
+ *
+ * Batches whose relocations all still match the offsets their targets
+ * were last seen at are then submitted with I915_EXEC_NO_RELOC, and the
+ * kernel only processes their relocations if it has to move a buffer.
+ * Callers must write the presumed address (target->offset + delta) into
+ * their buffers for every relocation they emit, and give each relocation
+ * its real write domain, as the kernel no longer reads it from the
+ * relocation entries.
+ */
+void
+drm_intel_bufmgr_gem_enable_no_reloc(drm_intel_bufmgr *bufmgr)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+
+	if (bufmgr_gem->bufmgr.bo_exec == drm_intel_gem_bo_exec2 &&
+	    bufmgr_gem->has_exec_no_reloc)
+		bufmgr_gem->no_reloc = true;
+}
+
+/**
+ * Returns the submission and relocation counters.
+ */
+void
+drm_intel_bufmgr_gem_get_exec_stats(drm_intel_bufmgr *bufmgr,
+				    drm_intel_bo_exec_stats *stats)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	*stats = bufmgr_gem->exec_stats;
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+}
+
+/**
+ * Moves execbuffer submission to a thread of its own.
+ *
+ * drm_intel_bo_mrb_exec() and friends then return as soon as the
+ * validation list is built and queued, with up to \c depth batches
+ * waiting for the thread before they block.  Errors from the kernel are
+ * reported to \c callback, which is called on the submission thread
+ * once the ioctl returns and must not call back into the bufmgr, and by
+ * drm_intel_bufmgr_gem_wait_exec_fence().
+ *
+ * Mapping, reading, writing, retiling or waiting on a buffer first
+ * waits for the queued batches using it to be submitted.  Buffers in a
+ * queued batch must not otherwise be changed, nor relocations be added
+ * to or cleared from them, until then.
+ */
+int
+drm_intel_bufmgr_gem_enable_async_exec(drm_intel_bufmgr *bufmgr,
+				       unsigned int depth,
+				       void (*callback)(drm_intel_bo *batch,
+							int ret, void *data),
+				       void *data)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+	struct drm_intel_gem_exec_queue *queue;
+	int ret;
+
+	if (bufmgr_gem->bufmgr.bo_exec != drm_intel_gem_bo_exec2)
+		return -ENODEV;
+	if (depth == 0)
+		return -EINVAL;
+	if (bufmgr_gem->exec_queue != NULL)
+		return -EBUSY;
+
+	queue = calloc(1, sizeof(*queue));
+	if (queue == NULL)
+		return -ENOMEM;
+	queue->jobs = calloc(depth, sizeof(*queue->jobs));
+	if (queue->jobs == NULL) {
+		free(queue);
+		return -ENOMEM;
+	}
+	queue->depth = depth;
+	queue->callback = callback;
+	queue->callback_data = data;
+	sem_init(&queue->queued, 0, 0);
+	sem_init(&queue->completed, 0, 0);
+
+	bufmgr_gem->exec_queue = queue;
+	ret = pthread_create(&queue->thread, NULL,
+			     drm_intel_gem_exec_thread, bufmgr_gem);
+	if (ret != 0) {
+		bufmgr_gem->exec_queue = NULL;
+		sem_destroy(&queue->queued);
+		sem_destroy(&queue->completed);
+		free(queue->jobs);
+		free(queue);
+		return -ret;
+	}
+
+	return 0;
+}
+
+/**
+ * Returns a fence for the last batch queued by
+ * drm_intel_bufmgr_gem_enable_async_exec(), or 0 if there is none.
+ */
+uint64_t
+drm_intel_bufmgr_gem_get_exec_fence(drm_intel_bufmgr *bufmgr)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+	uint64_t fence;
+
+	if (bufmgr_gem->exec_queue == NULL)
+		return 0;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	fence = bufmgr_gem->exec_queue->head;
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	return fence;
+}
+
+/**
+ * Waits until the batch the fence was taken for, and all the ones queued
+ * before it, have been submitted to the kernel.
+ *
+ * Returns the first error the kernel reported for a queued batch since
+ * the previous call, or 0.
+ */
+int
+drm_intel_bufmgr_gem_wait_exec_fence(drm_intel_bufmgr *bufmgr,
+				     uint64_t fence)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+	struct drm_intel_gem_exec_queue *queue = bufmgr_gem->exec_queue;
 	int ret;
 
-	if (bo_gem->global_name == 0 &&
-	    tiling_mode == bo_gem->tiling_mode &&
-	    stride == bo_gem->stride)
-		return 0;
+	if (queue == NULL)
+		return 0;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	drm_intel_gem_exec_reap_locked(bufmgr_gem,
+				       fence < queue->head ? fence : queue->head);
+	ret = queue->error;
+	queue->error = 0;
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	return ret;
+}
+
+/**
+ * Makes the batch being submitted the fence of the regions of every
+ * upload ring it uses that were written since the previous one.  Called
+ * with bufmgr_gem->lock held and the validation list still built.
+ */
+static void
+drm_intel_gem_upload_rings_fence(drm_intel_bufmgr_gem *bufmgr_gem,
+				 drm_intel_bo *batch)
+{
+	drm_intel_upload_ring *ring;
+	struct timespec time;
+	int i;
+
+	if (DRMLISTEMPTY(&bufmgr_gem->upload_rings))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	DRMLISTFOREACHENTRY(ring, &bufmgr_gem->upload_rings, link) {
+		drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *)
+			drm_intel_gem_bo_storage(ring->bo);
+
+		if (bo_gem->validate_gen != bufmgr_gem->exec_gen)
+			continue;
+
+		for (i = ring->unfenced; ; i = (i + 1) % ring->region_count) {
+			drm_intel_gem_bo_reference(batch);
+			if (ring->fence[i] != NULL)
+				drm_intel_gem_bo_unreference_locked_timed(ring->fence[i],
+									  time.tv_sec);
+			ring->fence[i] = batch;
+			if (i == ring->current)
+				break;
+		}
+		ring->unfenced = ring->current;
+		ring->fenced_head = atomic_read(&ring->head);
+	}
+}
+
+/**
+ * Creates a buffer of \c size bytes for streaming data to the GPU, mapped
+ * for as long as the ring exists, and split into \c regions equal parts
+ * which are reused in turn.
+ *
+ * Space is handed out by drm_intel_gem_upload_ring_alloc().  Any batch
+ * with a relocation to the ring's buffer keeps the regions written since
+ * the previous such batch from being reused until it has completed, so
+ * the data doesn't need to be copied or the buffer replaced every frame.
+ *
+ * The ring must be destroyed before the bufmgr.
+ */
+drm_intel_upload_ring *
+drm_intel_gem_upload_ring_create(drm_intel_bufmgr *bufmgr, const char *name,
+				 unsigned long size, int regions)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+	drm_intel_upload_ring *ring;
+	unsigned long region_size;
+
+	if (regions < 2)
+		return NULL;
+
+	region_size = (size / regions) & ~4095UL;
+	if (region_size == 0 ||
+	    (uint64_t) regions * (region_size + 1) > INT32_MAX)
+		return NULL;
+
+	ring = calloc(1, sizeof(*ring));
+	if (ring == NULL)
+		return NULL;
+
+	ring->fence = calloc(regions, sizeof(*ring->fence));
+	if (ring->fence == NULL)
+		goto err;
+
+	ring->bo = drm_intel_bo_alloc(bufmgr, name, regions * region_size, 4096);
+	if (ring->bo == NULL)
+		goto err;
 
-	memset(&set_tiling, 0, sizeof(set_tiling));
-	do {
-		/* set_tiling is slightly broken and overwrites the
-		 * input on the error path, so we have to open code
-		 * rmIoctl.
-		 */
-		set_tiling.handle = bo_gem->gem_handle;
-		set_tiling.tiling_mode = tiling_mode;
-		set_tiling.stride = stride;
+	if (drm_intel_gem_bo_map_unsynchronized(ring->bo)) {
+		drm_intel_bo_unreference(ring->bo);
+		goto err;
+	}
 
-		ret = ioctl(bufmgr_gem->fd,
-			    DRM_IOCTL_I915_GEM_SET_TILING,
-			    &set_tiling);
-	} while (ret == -1 && (errno == EINTR || errno == EAGAIN));
-	if (ret == -1)
-		return -errno;
+	ring->bufmgr_gem = bufmgr_gem;
+	ring->virtual = ring->bo->virtual;
+	ring->region_size = region_size;
+	ring->region_count = regions;
+	atomic_set(&ring->head, 0);
 
-	bo_gem->tiling_mode = set_tiling.tiling_mode;
-	bo_gem->swizzle_mode = set_tiling.swizzle_mode;
-	bo_gem->stride = set_tiling.stride;
-	return 0;
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	DRMLISTADDTAIL(&ring->link, &bufmgr_gem->upload_rings);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	return ring;
+
+err:
+	free(ring->fence);
+	free(ring);
+	return NULL;
 }
 
-static int
-drm_intel_gem_bo_set_tiling(drm_intel_bo *bo, uint32_t * tiling_mode,
-			    uint32_t stride)
+void
+drm_intel_gem_upload_ring_destroy(drm_intel_upload_ring *ring)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-	int ret;
+	drm_intel_bufmgr_gem *bufmgr_gem;
+	struct timespec time;
+	int i;
 
-	/* Linear buffers have no stride. By ensuring that we only ever use
-	 * stride 0 with linear buffers, we simplify our code.
-	 */
-	if (*tiling_mode == I915_TILING_NONE)
-		stride = 0;
+	if (ring == NULL)
+		return;
 
-	ret = drm_intel_gem_bo_set_tiling_internal(bo, *tiling_mode, stride);
-	if (ret == 0)
-		drm_intel_bo_gem_set_in_aperture_size(bufmgr_gem, bo_gem);
+	bufmgr_gem = ring->bufmgr_gem;
+	clock_gettime(CLOCK_MONOTONIC, &time);
 
-	*tiling_mode = bo_gem->tiling_mode;
-	return ret;
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	DRMLISTDEL(&ring->link);
+	for (i = 0; i < ring->region_count; i++) {
+		if (ring->fence[i] != NULL)
+			drm_intel_gem_bo_unreference_locked_timed(ring->fence[i],
+								  time.tv_sec);
+	}
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	drm_intel_bo_unmap(ring->bo);
+	drm_intel_bo_unreference(ring->bo);
+	free(ring->fence);
+	free(ring);
 }
 
-static int
-drm_intel_gem_bo_get_tiling(drm_intel_bo *bo, uint32_t * tiling_mode,
-			    uint32_t * swizzle_mode)
+/** Returns the buffer that drm_intel_gem_upload_ring_alloc() offsets are in */
+drm_intel_bo *
+drm_intel_gem_upload_ring_get_bo(drm_intel_upload_ring *ring)
 {
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-
-	*tiling_mode = bo_gem->tiling_mode;
-	*swizzle_mode = bo_gem->swizzle_mode;
-	return 0;
+	return ring->bo;
 }
 
+/**
+ * Moves on to the next region, unless another thread already has since
+ * head was \c seen, waiting for the last batch reading from it.
+ */
 static int
-drm_intel_gem_bo_flink(drm_intel_bo *bo, uint32_t * name)
+drm_intel_gem_upload_ring_advance(drm_intel_upload_ring *ring, int seen)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bo->bufmgr;
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
-	int ret;
+	drm_intel_bufmgr_gem *bufmgr_gem = ring->bufmgr_gem;
+	int stride = ring->region_size + 1;
+	int ret = 0;
 
-	if (!bo_gem->global_name) {
-		struct drm_gem_flink flink;
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	for (;;) {
+		int head = atomic_read(&ring->head);
+		int next = (ring->current + 1) % ring->region_count;
+		drm_intel_bo *batch = ring->fence[next];
 
-		VG_CLEAR(flink);
-		flink.handle = bo_gem->gem_handle;
+		if (head / stride != seen / stride)
+			break;
 
-		ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_GEM_FLINK, &flink);
-		if (ret != 0)
-			return -errno;
+		/* Everything was written for a single batch */
+		if (next == ring->unfenced) {
+			ret = -ENOSPC;
+			break;
+		}
 
-		bo_gem->global_name = flink.name;
-		bo_gem->reusable = false;
+		if (batch != NULL) {
+			struct timespec time;
+
+			if (drm_intel_gem_bo_busy_locked(batch)) {
+				drm_intel_gem_bo_reference(batch);
+				pthread_mutex_unlock(&bufmgr_gem->lock);
+				drm_intel_gem_bo_wait_rendering(batch);
+				drm_intel_gem_bo_unreference(batch);
+				pthread_mutex_lock(&bufmgr_gem->lock);
+				continue;
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &time);
+			drm_intel_gem_bo_unreference_locked_timed(batch,
+								  time.tv_sec);
+			ring->fence[next] = NULL;
+		}
+
+		/* Lose to any allocation still claiming space in the old
+		 * region, so that nothing lands there after we've decided
+		 * whether it needs fencing.
+		 */
+		if (atomic_cmpxchg(&ring->head, head, next * stride) != head)
+			continue;
 
-		DRMLISTADDTAIL(&bo_gem->name_list, &bufmgr_gem->named);
+		if (ring->unfenced == ring->current &&
+		    head == ring->fenced_head)
+			ring->unfenced = next;
+		ring->current = next;
 	}
+	pthread_mutex_unlock(&bufmgr_gem->lock);
 
-	*name = bo_gem->global_name;
-	return 0;
+	return ret;
 }
 
 /**
- * Enables unlimited caching of buffer objects for reuse.
+ * Claims \c size bytes of the ring aligned to \c alignment, a power of
+ * two, and returns their CPU address, with their offset in the ring's
+ * buffer in \c offset.  The mapping is write-combined, so fill it with
+ * drmMemcpyToWC() rather than memcpy() and don't read from it.
  *
- * This is potentially very memory expensive, as the cache at each bucket
- * size is only bounded by how many buffers of that size we've managed to have
- * in flight at once.
+ * Returns NULL if \c size is larger than a region, or if all regions have
+ * been written to since the last batch using the ring was submitted.  The
+ * caller should flush its batch then.
  */
-void
-drm_intel_bufmgr_gem_enable_reuse(drm_intel_bufmgr *bufmgr)
+void *
+drm_intel_gem_upload_ring_alloc(drm_intel_upload_ring *ring,
+				unsigned long size, unsigned int alignment,
+				uint32_t *offset)
 {
-	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *) bufmgr;
+	int stride = ring->region_size + 1;
 
-	bufmgr_gem->bo_reuse = true;
+	if (size > ring->region_size || alignment == 0)
+		return NULL;
+
+	for (;;) {
+		int head = atomic_read(&ring->head);
+		unsigned long region = head / stride;
+		unsigned long fill = head % stride;
+		unsigned long start = (fill + alignment - 1) & ~(alignment - 1UL);
+
+		if (start + size <= ring->region_size) {
+			if (atomic_cmpxchg(&ring->head, head,
+					   head + (start - fill) + size) != head)
+				continue;
+
+			*offset = region * ring->region_size + start;
+			return ring->virtual + *offset;
+		}
+
+		if (drm_intel_gem_upload_ring_advance(ring, head))
+			return NULL;
+	}
 }
 
 /**
@@ -2407,14 +5357,19 @@ drm_intel_bufmgr_gem_enable_fenced_relocs(drm_intel_bufmgr *bufmgr)
 static int
 drm_intel_gem_bo_get_aperture_space(drm_intel_bo *bo)
 {
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	drm_intel_bo_gem *bo_gem;
 	int i;
 	int total = 0;
 
-	if (bo == NULL || bo_gem->included_in_check_aperture)
+	if (bo == NULL)
+		return 0;
+
+	bo = drm_intel_gem_bo_storage(bo);
+	bo_gem = (drm_intel_bo_gem *) bo;
+	if (bo_gem->included_in_check_aperture)
 		return 0;
 
-	total += bo->size;
+	total += bo_gem->aperture_size;
 	bo_gem->included_in_check_aperture = true;
 
 	for (i = 0; i < bo_gem->reloc_count; i++)
@@ -2457,10 +5412,15 @@ drm_intel_gem_total_fences(drm_intel_bo ** bo_array, int count)
 static void
 drm_intel_gem_bo_clear_aperture_space_flag(drm_intel_bo *bo)
 {
-	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+	drm_intel_bo_gem *bo_gem;
 	int i;
 
-	if (bo == NULL || !bo_gem->included_in_check_aperture)
+	if (bo == NULL)
+		return;
+
+	bo = drm_intel_gem_bo_storage(bo);
+	bo_gem = (drm_intel_bo_gem *) bo;
+	if (!bo_gem->included_in_check_aperture)
 		return;
 
 	bo_gem->included_in_check_aperture = false;
@@ -2472,18 +5432,34 @@ drm_intel_gem_bo_clear_aperture_space_flag(drm_intel_bo *bo)
 
 /**
  * Return a conservative estimate for the amount of aperture required
- * for a collection of buffers. This may double-count some buffers.
+ * for a collection of buffers, in time proportional to their number.
+ *
+ * Buffers already reached from the first buffer, usually the batch, are
+ * free.  The others may double-count buffers shared between their trees.
  */
 static unsigned int
 drm_intel_gem_estimate_batch_space(drm_intel_bo **bo_array, int count)
 {
+	drm_intel_bo_gem *root = NULL;
 	int i;
 	unsigned int total = 0;
 
 	for (i = 0; i < count; i++) {
-		drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo_array[i];
-		if (bo_gem != NULL)
-			total += bo_gem->reloc_tree_size;
+		drm_intel_bo_gem *bo_gem;
+
+		if (bo_array[i] == NULL)
+			continue;
+
+		bo_gem = (drm_intel_bo_gem *)
+			drm_intel_gem_bo_storage(bo_array[i]);
+		if (root == NULL)
+			root = bo_gem;
+		else if (bo_gem == root ||
+			 (root->aperture_root != 0 &&
+			  bo_gem->aperture_tag == root->aperture_root))
+			continue;
+
+		total += bo_gem->reloc_tree_size;
 	}
 	return total;
 }
@@ -2592,6 +5568,14 @@ drm_intel_gem_bo_is_reusable(drm_intel_bo *bo)
 	return bo_gem->reusable;
 }
 
+static int
+drm_intel_gem_bo_is_userptr(drm_intel_bo *bo)
+{
+	drm_intel_bo_gem *bo_gem = (drm_intel_bo_gem *) bo;
+
+	return bo_gem->user_virtual != NULL;
+}
+
 static int
 _drm_intel_gem_bo_references(drm_intel_bo *bo, drm_intel_bo *target_bo)
 {
@@ -2624,43 +5608,206 @@ drm_intel_gem_bo_references(drm_intel_bo *bo, drm_intel_bo *target_bo)
 	return 0;
 }
 
-static void
-add_bucket(drm_intel_bufmgr_gem *bufmgr_gem, int size)
+static int
+add_bucket(struct drm_intel_gem_bo_bucket **buckets, int *count,
+	   unsigned long size)
 {
-	unsigned int i = bufmgr_gem->num_buckets;
-
-	assert(i < ARRAY_SIZE(bufmgr_gem->cache_bucket));
+	struct drm_intel_gem_bo_bucket *new_buckets;
+
+	/* Grow the array in powers of two, starting at 16 entries */
+	if (*count == 0 || (*count >= 16 && (*count & (*count - 1)) == 0)) {
+		new_buckets = realloc(*buckets,
+				      (*count ? 2 * *count : 16) *
+				      sizeof(**buckets));
+		if (new_buckets == NULL)
+			return -ENOMEM;
+		*buckets = new_buckets;
+	}
 
-	DRMINITLISTHEAD(&bufmgr_gem->cache_bucket[i].head);
-	bufmgr_gem->cache_bucket[i].size = size;
-	bufmgr_gem->num_buckets++;
+	(*buckets)[(*count)++].size = size;
+	return 0;
 }
 
-static void
+/**
+ * (Re)builds the cache size classes from cache_classes and cache_max_size.
+ * Called with an empty cache.
+ */
+static int
 init_cache_buckets(drm_intel_bufmgr_gem *bufmgr_gem)
 {
-	unsigned long size, cache_max_size = 64 * 1024 * 1024;
+	struct drm_intel_gem_bo_bucket *buckets = NULL;
+	unsigned long base, size;
+	int classes = bufmgr_gem->cache_classes;
+	int count = 0, i;
 
 	/* OK, so power of two buckets was too wasteful of memory.
-	 * Give 3 other sizes between each power of two, to hopefully
-	 * cover things accurately enough.  (The alternative is
-	 * probably to just go for exact matching of sizes, and assume
+	 * Give cache_classes - 1 other sizes between each power of two,
+	 * to hopefully cover things accurately enough.  (The alternative
+	 * is probably to just go for exact matching of sizes, and assume
 	 * that for things like composited window resize the tiled
 	 * width/height alignment and rounding of sizes to pages will
 	 * get us useful cache hit rates anyway)
+	 *
+	 * Below cache_classes pages the classes are every page.
 	 */
-	add_bucket(bufmgr_gem, 4096);
-	add_bucket(bufmgr_gem, 4096 * 2);
-	add_bucket(bufmgr_gem, 4096 * 3);
+	for (i = 1; i < classes; i++) {
+		if (add_bucket(&buckets, &count, i * 4096))
+			goto err;
+	}
 
+	for (base = classes * 4096; ; base *= 2) {
+		for (i = 0; i < classes; i++) {
+			size = base + base * i / classes;
+			if (size > bufmgr_gem->cache_max_size)
+				goto done;
+			if (add_bucket(&buckets, &count, size))
+				goto err;
+		}
+	}
+
+done:
 	/* Initialize the linked lists for BO reuse cache. */
-	for (size = 4 * 4096; size <= cache_max_size; size *= 2) {
-		add_bucket(bufmgr_gem, size);
+	for (i = 0; i < count; i++) {
+		int j;
+
+		for (j = 0; j < TILING_LISTS; j++)
+			DRMINITLISTHEAD(&buckets[i].head[j]);
+	}
+
+	free(bufmgr_gem->cache_bucket);
+	bufmgr_gem->cache_bucket = buckets;
+	bufmgr_gem->num_buckets = count;
+	return 0;
+
+err:
+	free(buckets);
+	return -ENOMEM;
+}
+
+static int
+tcache_bins_for_buckets(drm_intel_bufmgr_gem *bufmgr_gem)
+{
+	int i;
+
+	for (i = 0; i < bufmgr_gem->num_buckets; i++) {
+		if (bufmgr_gem->cache_bucket[i].size > TCACHE_MAX_SIZE)
+			break;
+	}
+
+	return i;
+}
+
+static void
+init_tcache(drm_intel_bufmgr_gem *bufmgr_gem)
+{
+	DRMINITLISTHEAD(&bufmgr_gem->tcache_list);
+
+	if (pthread_key_create(&bufmgr_gem->tcache_key,
+			       drm_intel_gem_bo_tcache_release) != 0)
+		return;
+
+	bufmgr_gem->tcache_bins = tcache_bins_for_buckets(bufmgr_gem);
+}
+
+/**
+ * Returns the buffer object cache counters, summed over all threads.
+ *
+ * Counters are only maintained while buffer reuse is enabled.  Those of
+ * threads still running are sampled without synchronization and may lag
+ * slightly behind.
+ */
+void
+drm_intel_bufmgr_gem_get_cache_stats(drm_intel_bufmgr *bufmgr,
+				     drm_intel_bo_cache_stats *stats)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+	drmMMListHead *list;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	*stats = bufmgr_gem->tcache_retired;
+	for (list = bufmgr_gem->tcache_list.next;
+	     list != &bufmgr_gem->tcache_list;
+	     list = list->next) {
+		struct drm_intel_gem_bo_tcache *tc;
+
+		tc = DRMLISTENTRY(struct drm_intel_gem_bo_tcache, list, link);
+		drm_intel_gem_bo_cache_stats_add(stats, &tc->stats);
+	}
+	stats->evictions = bufmgr_gem->cache_evictions;
+	stats->cached_bytes = bufmgr_gem->cache_bytes;
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+}
+
+/**
+ * Sets up the size classes of the buffer object cache.
+ *
+ * Each power of two size range is split into \c classes evenly spaced
+ * sizes, which must be a power of two no larger than 64, and allocations
+ * are rounded up to the next class.  Buffers larger than \c max_size are
+ * never cached.  The default is 4 classes up to 112MB.
+ *
+ * Buffers already in the cache are freed.  As per-thread caches index the
+ * classes without locking, this returns -EBUSY once any thread has
+ * allocated a buffer with reuse enabled.
+ */
+int
+drm_intel_bufmgr_gem_set_cache_classes(drm_intel_bufmgr *bufmgr,
+				       int classes, unsigned long max_size)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+	int old_classes = bufmgr_gem->cache_classes;
+	unsigned long old_max_size = bufmgr_gem->cache_max_size;
+	int ret;
+
+	if (classes < 1 || classes > 64 || (classes & (classes - 1)) ||
+	    max_size < 4096)
+		return -EINVAL;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+
+	if (!DRMLISTEMPTY(&bufmgr_gem->tcache_list)) {
+		pthread_mutex_unlock(&bufmgr_gem->lock);
+		return -EBUSY;
+	}
+
+	drm_intel_gem_bo_cache_empty(bufmgr_gem);
 
-		add_bucket(bufmgr_gem, size + size * 1 / 4);
-		add_bucket(bufmgr_gem, size + size * 2 / 4);
-		add_bucket(bufmgr_gem, size + size * 3 / 4);
+	bufmgr_gem->cache_classes = classes;
+	bufmgr_gem->cache_max_size = max_size;
+	ret = init_cache_buckets(bufmgr_gem);
+	if (ret) {
+		bufmgr_gem->cache_classes = old_classes;
+		bufmgr_gem->cache_max_size = old_max_size;
+	} else if (bufmgr_gem->tcache_bins) {
+		bufmgr_gem->tcache_bins = tcache_bins_for_buckets(bufmgr_gem);
 	}
+
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+
+	return ret;
+}
+
+/**
+ * Limits the total size of the unused buffers kept around for reuse in the
+ * shared cache, in addition to freeing them after a couple of seconds.  The
+ * least recently freed buffers are dropped first.  0, the default, means no
+ * limit.
+ *
+ * Each thread also keeps up to 8 of its own recently freed buffers of every
+ * size class up to 1MB, which this limit and the expiry do not cover.  Like
+ * the shared cache they are purgeable, so the kernel can reclaim them under
+ * memory pressure.
+ */
+void
+drm_intel_bufmgr_gem_set_cache_max_bytes(drm_intel_bufmgr *bufmgr,
+					 uint64_t max_bytes)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	bufmgr_gem->cache_max_bytes = max_bytes;
+	drm_intel_gem_bo_cache_trim(bufmgr_gem);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
 }
 
 void
@@ -2673,6 +5820,41 @@ drm_intel_bufmgr_gem_set_vma_cache_size(drm_intel_bufmgr *bufmgr, int limit)
 	drm_intel_gem_bo_purge_vma_cache(bufmgr_gem);
 }
 
+/**
+ * Limits the address space taken by CPU and GTT mappings together.
+ *
+ * Mappings are kept after drm_intel_bo_unmap() for the next map of the
+ * same buffer, and the least recently unmapped are dropped once the
+ * total goes over \c max_bytes.  Buffers still mapped aren't affected.
+ * 0, the default, means no limit; drm_intel_bufmgr_gem_set_vma_cache_size()
+ * still applies in addition.
+ */
+void
+drm_intel_bufmgr_gem_set_vma_cache_bytes(drm_intel_bufmgr *bufmgr,
+					 uint64_t max_bytes)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	bufmgr_gem->vma_max_bytes = max_bytes;
+	drm_intel_gem_bo_purge_vma_cache(bufmgr_gem);
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+}
+
+/**
+ * Returns the mapping cache counters.
+ */
+void
+drm_intel_bufmgr_gem_get_vma_stats(drm_intel_bufmgr *bufmgr,
+				   drm_intel_bo_vma_stats *stats)
+{
+	drm_intel_bufmgr_gem *bufmgr_gem = (drm_intel_bufmgr_gem *)bufmgr;
+
+	pthread_mutex_lock(&bufmgr_gem->lock);
+	*stats = bufmgr_gem->vma_stats;
+	pthread_mutex_unlock(&bufmgr_gem->lock);
+}
+
 /**
  * Get the PCI ID for the device.  This can be overridden by setting the
  * INTEL_DEVID_OVERRIDE environment variable to the desired ID.
@@ -2822,7 +6004,7 @@ drm_intel_bufmgr_gem_init(int fd, int batch_size)
 	drm_intel_bufmgr_gem *bufmgr_gem;
 	struct drm_i915_gem_get_aperture aperture;
 	drm_i915_getparam_t gp;
-	int ret, tmp;
+	int ret, tmp, i;
 	bool exec2 = false;
 
 	bufmgr_gem = calloc(1, sizeof(*bufmgr_gem));
@@ -2909,6 +6091,14 @@ drm_intel_bufmgr_gem_init(int fd, int batch_size)
 	} else
 		bufmgr_gem->has_llc = ret == 0;
 
+	gp.param = I915_PARAM_HAS_EXEC_NO_RELOC;
+	ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_I915_GETPARAM, &gp);
+	bufmgr_gem->has_exec_no_reloc = ret == 0 && tmp > 0;
+
+	gp.param = I915_PARAM_HAS_WAIT_TIMEOUT;
+	ret = drmIoctl(bufmgr_gem->fd, DRM_IOCTL_I915_GETPARAM, &gp);
+	bufmgr_gem->has_wait_timeout = ret == 0;
+
 	if (bufmgr_gem->gen < 4) {
 		gp.param = I915_PARAM_NUM_FENCES_AVAIL;
 		gp.value = &bufmgr_gem->available_fences;
@@ -2943,16 +6133,27 @@ drm_intel_bufmgr_gem_init(int fd, int batch_size)
 	 */
 	bufmgr_gem->max_relocs = batch_size / sizeof(uint32_t) / 2 - 2;
 
+	/* Generation 0 is what freshly allocated buffers carry, so that they
+	 * never appear to be on the validation list.
+	 */
+	bufmgr_gem->exec_gen = 1;
+
 	bufmgr_gem->bufmgr.bo_alloc = drm_intel_gem_bo_alloc;
 	bufmgr_gem->bufmgr.bo_alloc_for_render =
 	    drm_intel_gem_bo_alloc_for_render;
 	bufmgr_gem->bufmgr.bo_alloc_tiled = drm_intel_gem_bo_alloc_tiled;
+	bufmgr_gem->bufmgr.bo_alloc_array = drm_intel_gem_bo_alloc_array;
+	bufmgr_gem->bufmgr.bo_alloc_userptr = drm_intel_gem_bo_alloc_userptr;
 	bufmgr_gem->bufmgr.bo_reference = drm_intel_gem_bo_reference;
 	bufmgr_gem->bufmgr.bo_unreference = drm_intel_gem_bo_unreference;
 	bufmgr_gem->bufmgr.bo_map = drm_intel_gem_bo_map;
 	bufmgr_gem->bufmgr.bo_unmap = drm_intel_gem_bo_unmap;
 	bufmgr_gem->bufmgr.bo_subdata = drm_intel_gem_bo_subdata;
 	bufmgr_gem->bufmgr.bo_get_subdata = drm_intel_gem_bo_get_subdata;
+	bufmgr_gem->bufmgr.bo_subdata_v = drm_intel_gem_bo_subdata_v;
+	bufmgr_gem->bufmgr.bo_get_subdata_v = drm_intel_gem_bo_get_subdata_v;
+	bufmgr_gem->bufmgr.bo_upload_tiled = drm_intel_gem_bo_upload_tiled;
+	bufmgr_gem->bufmgr.bo_readback_tiled = drm_intel_gem_bo_readback_tiled;
 	bufmgr_gem->bufmgr.bo_wait_rendering = drm_intel_gem_bo_wait_rendering;
 	bufmgr_gem->bufmgr.bo_emit_reloc = drm_intel_gem_bo_emit_reloc;
 	bufmgr_gem->bufmgr.bo_emit_reloc_fence = drm_intel_gem_bo_emit_reloc_fence;
@@ -2975,14 +6176,35 @@ drm_intel_bufmgr_gem_init(int fd, int batch_size)
 	    drm_intel_gem_check_aperture_space;
 	bufmgr_gem->bufmgr.bo_disable_reuse = drm_intel_gem_bo_disable_reuse;
 	bufmgr_gem->bufmgr.bo_is_reusable = drm_intel_gem_bo_is_reusable;
+	bufmgr_gem->bufmgr.bo_is_userptr = drm_intel_gem_bo_is_userptr;
 	bufmgr_gem->bufmgr.get_pipe_from_crtc_id =
 	    drm_intel_gem_get_pipe_from_crtc_id;
 	bufmgr_gem->bufmgr.bo_references = drm_intel_gem_bo_references;
 
 	DRMINITLISTHEAD(&bufmgr_gem->named);
-	init_cache_buckets(bufmgr_gem);
+	bufmgr_gem->name_table = drmHashCreate();
+	bufmgr_gem->handle_table = drmHashCreate();
+	DRMINITLISTHEAD(&bufmgr_gem->cache_lru);
+	bufmgr_gem->cache_classes = 4;
+	bufmgr_gem->cache_max_size = 112 * 1024 * 1024;
+	if (bufmgr_gem->name_table == NULL ||
+	    bufmgr_gem->handle_table == NULL ||
+	    init_cache_buckets(bufmgr_gem)) {
+		if (bufmgr_gem->name_table)
+			drmHashDestroy(bufmgr_gem->name_table);
+		if (bufmgr_gem->handle_table)
+			drmHashDestroy(bufmgr_gem->handle_table);
+		pthread_mutex_destroy(&bufmgr_gem->lock);
+		free(bufmgr_gem);
+		return NULL;
+	}
+	init_tcache(bufmgr_gem);
+
+	for (i = 0; i < SLAB_CLASSES; i++)
+		DRMINITLISTHEAD(&bufmgr_gem->slabs[i]);
 
 	DRMINITLISTHEAD(&bufmgr_gem->vma_cache);
+	DRMINITLISTHEAD(&bufmgr_gem->upload_rings);
 	bufmgr_gem->vma_max = -1; /* unlimited by default */
 
 	return &bufmgr_gem->bufmgr;
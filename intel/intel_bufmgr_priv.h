@@ -83,6 +83,20 @@ struct _drm_intel_bufmgr {
 					 unsigned long *pitch,
 					 unsigned long flags);
 
+	/**
+	 * Allocate \c count untiled buffer objects at once.
+	 *
+	 * Optional; drm_intel_bo_alloc_array() falls back to calling
+	 * bo_alloc for each buffer.  Returns 0 or a negative errno, in
+	 * which case no buffers are left allocated.
+	 */
+	int (*bo_alloc_array) (drm_intel_bufmgr *bufmgr,
+			       const char *name,
+			       int count,
+			       const unsigned long *sizes,
+			       unsigned int alignment,
+			       drm_intel_bo **bos);
+
 	/** Takes a reference on a buffer object */
 	void (*bo_reference) (drm_intel_bo *bo);
 
@@ -125,6 +139,44 @@ struct _drm_intel_bufmgr {
 	int (*bo_get_subdata) (drm_intel_bo *bo, unsigned long offset,
 			       unsigned long size, void *data);
 
+	/**
+	 * Write or read a list of ranges of an object.
+	 *
+	 * Optional; drm_intel_bo_subdata_v() and drm_intel_bo_get_subdata_v()
+	 * fall back to one bo_subdata or bo_get_subdata call per range.
+	 * Return the number of write or read ioctls used, 0 if the data was
+	 * copied through a mapping, or a negative errno.
+	 */
+	int (*bo_subdata_v) (drm_intel_bo *bo,
+			     const drm_intel_bo_region *regions, int count);
+	int (*bo_get_subdata_v) (drm_intel_bo *bo,
+				 const drm_intel_bo_region *regions,
+				 int count);
+
+	/**
+	 * Write or read a rectangle of a tiled object from linear memory.
+	 *
+	 * Optional; drm_intel_bo_upload_tiled() and
+	 * drm_intel_bo_readback_tiled() return -ENODEV without it.
+	 */
+	int (*bo_upload_tiled) (drm_intel_bo *bo, uint32_t x, uint32_t y,
+				uint32_t width, uint32_t height,
+				const void *data, uint32_t pitch);
+	int (*bo_readback_tiled) (drm_intel_bo *bo, uint32_t x, uint32_t y,
+				  uint32_t width, uint32_t height,
+				  void *data, uint32_t pitch);
+
+	/**
+	 * Wrap client memory as a buffer object, without copying it.
+	 *
+	 * Optional; drm_intel_bo_alloc_userptr() copies the memory into a
+	 * buffer from bo_alloc without it, or when it returns NULL.
+	 */
+	drm_intel_bo *(*bo_alloc_userptr) (drm_intel_bufmgr *bufmgr,
+					   const char *name, void *addr,
+					   unsigned long size,
+					   unsigned long flags);
+
 	/**
 	 * Waits for rendering to an object by the GPU to have completed.
 	 *
@@ -260,6 +312,13 @@ struct _drm_intel_bufmgr {
 	 */
 	int (*bo_is_reusable) (drm_intel_bo *bo);
 
+	/**
+	 * Query whether a buffer wraps client memory, see bo_alloc_userptr.
+	 *
+	 * \param bo Buffer to query
+	 */
+	int (*bo_is_userptr) (drm_intel_bo *bo);
+
 	/**
 	 *
 	 * Return the pipe associated with a crtc_id so that vblank
@@ -180,6 +180,8 @@ dumb_bo_destroy(struct kms_bo *_bo)
 		bo->base.ptr = NULL;
 	}
 
+	drmPrimeForgetHandle(bo->base.kms->fd, bo->base.handle);
+
 	memset(&arg, 0, sizeof(arg));
 	arg.handle = bo->base.handle;
 
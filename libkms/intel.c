@@ -194,7 +194,6 @@ static int
 intel_bo_destroy(struct kms_bo *_bo)
 {
 	struct intel_bo *bo = (struct intel_bo *)_bo;
-	struct drm_gem_close arg;
 	int ret;
 
 	if (bo->base.ptr) {
@@ -203,10 +202,7 @@ intel_bo_destroy(struct kms_bo *_bo)
 		bo->base.ptr = NULL;
 	}
 
-	memset(&arg, 0, sizeof(arg));
-	arg.handle = bo->base.handle;
-
-	ret = drmIoctl(bo->base.kms->fd, DRM_IOCTL_GEM_CLOSE, &arg);
+	ret = drmCloseBufferHandle(bo->base.kms->fd, bo->base.handle);
 	if (ret)
 		return -errno;
 
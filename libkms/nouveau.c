@@ -176,7 +176,6 @@ static int
 nouveau_bo_destroy(struct kms_bo *_bo)
 {
 	struct nouveau_bo *bo = (struct nouveau_bo *)_bo;
-	struct drm_gem_close arg;
 	int ret;
 
 	if (bo->base.ptr) {
@@ -185,10 +184,7 @@ nouveau_bo_destroy(struct kms_bo *_bo)
 		bo->base.ptr = NULL;
 	}
 
-	memset(&arg, 0, sizeof(arg));
-	arg.handle = bo->base.handle;
-
-	ret = drmIoctl(bo->base.kms->fd, DRM_IOCTL_GEM_CLOSE, &arg);
+	ret = drmCloseBufferHandle(bo->base.kms->fd, bo->base.handle);
 	if (ret)
 		return -errno;
 
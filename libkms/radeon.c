@@ -198,7 +198,6 @@ static int
 radeon_bo_destroy(struct kms_bo *_bo)
 {
 	struct radeon_bo *bo = (struct radeon_bo *)_bo;
-	struct drm_gem_close arg;
 	int ret;
 
 	if (bo->base.ptr) {
@@ -207,10 +206,7 @@ radeon_bo_destroy(struct kms_bo *_bo)
 		bo->base.ptr = NULL;
 	}
 
-	memset(&arg, 0, sizeof(arg));
-	arg.handle = bo->base.handle;
-
-	ret = drmIoctl(bo->base.kms->fd, DRM_IOCTL_GEM_CLOSE, &arg);
+	ret = drmCloseBufferHandle(bo->base.kms->fd, bo->base.handle);
 	if (ret)
 		return -errno;
 
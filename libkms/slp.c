@@ -178,7 +178,6 @@ static int
 slp_bo_destroy(struct kms_bo *_bo)
 {
 	struct slp_bo *bo = (struct slp_bo *)_bo;
-	struct drm_gem_close arg;
 	int ret;
 
 	if (bo->base.ptr) {
@@ -187,10 +186,7 @@ slp_bo_destroy(struct kms_bo *_bo)
 		bo->base.ptr = NULL;
 	}
 
-	memset(&arg, 0, sizeof(arg));
-	arg.handle = bo->base.handle;
-
-	ret = drmIoctl(bo->base.kms->fd, DRM_IOCTL_GEM_CLOSE, &arg);
+	ret = drmCloseBufferHandle(bo->base.kms->fd, bo->base.handle);
 	if (ret)
 		return -errno;
 
@@ -314,12 +314,14 @@ static void
 nouveau_bo_del(struct nouveau_bo *bo)
 {
 	struct nouveau_bo_priv *nvbo = nouveau_bo(bo);
-	struct drm_gem_close req = { bo->handle };
 	DRMLISTDEL(&nvbo->head);
 	if (bo->map)
 		munmap(bo->map, bo->size);
-	drmIoctl(bo->device->fd, DRM_IOCTL_GEM_CLOSE, &req);
-	free(nvbo);
+	drmCloseBufferHandle(bo->device->fd, bo->handle);
+	if (!nvbo->block)
+		free(nvbo);
+	else if (atomic_dec_and_test(&nvbo->block->refcnt))
+		free(nvbo->block);
 }
 
 int
@@ -351,6 +353,52 @@ nouveau_bo_new(struct nouveau_device *dev, uint32_t flags, uint32_t align,
 	return 0;
 }
 
+int
+nouveau_bo_new_array(struct nouveau_device *dev, uint32_t flags,
+		     uint32_t align, int count, const uint64_t *sizes,
+		     union nouveau_bo_config *config, struct nouveau_bo **pbos)
+{
+	struct nouveau_device_priv *nvdev = nouveau_device(dev);
+	struct nouveau_bo_block *block;
+	int ret = 0, i;
+
+	if (count < 0)
+		return -EINVAL;
+	if (count == 0)
+		return 0;
+
+	block = calloc(1, sizeof(*block) + count * sizeof(block->bos[0]));
+	if (!block)
+		return -ENOMEM;
+	atomic_set(&block->refcnt, 1);
+
+	for (i = 0; i < count; i++) {
+		struct nouveau_bo_priv *nvbo = &block->bos[i];
+		struct nouveau_bo *bo = &nvbo->base;
+
+		atomic_set(&nvbo->refcnt, 1);
+		bo->device = dev;
+		bo->flags = flags;
+		bo->size = sizes[i];
+
+		ret = abi16_bo_init(bo, align, config);
+		if (ret) {
+			while (i--)
+				nouveau_bo_ref(NULL, &pbos[i]);
+			break;
+		}
+
+		nvbo->block = block;
+		atomic_inc(&block->refcnt);
+		DRMLISTADD(&nvbo->head, &nvdev->bo_list);
+		pbos[i] = bo;
+	}
+
+	if (atomic_dec_and_test(&block->refcnt))
+		free(block);
+	return ret;
+}
+
 int
 nouveau_bo_wrap(struct nouveau_device *dev, uint32_t handle,
 		struct nouveau_bo **pbo)
@@ -475,6 +523,36 @@ nouveau_bo_wait(struct nouveau_bo *bo, uint32_t access,
 	return ret;
 }
 
+struct nouveau_bo_poll {
+	struct nouveau_bo *bo;
+	uint32_t access;
+	struct nouveau_client *client;
+};
+
+static int
+nouveau_bo_poll_busy(void *data)
+{
+	struct nouveau_bo_poll *poll = data;
+
+	return nouveau_bo_wait(poll->bo, poll->access | NOUVEAU_BO_NOBLOCK,
+			       poll->client);
+}
+
+/* CPU_PREP either blocks for good or not at all, so a bounded wait polls;
+ * a negative timeout_ns is the same as nouveau_bo_wait().
+ */
+int
+nouveau_bo_wait_timeout(struct nouveau_bo *bo, uint32_t access,
+			struct nouveau_client *client, int64_t timeout_ns)
+{
+	struct nouveau_bo_poll poll = { bo, access, client };
+
+	if (timeout_ns < 0)
+		return nouveau_bo_wait(bo, access & ~NOUVEAU_BO_NOBLOCK,
+				       client);
+	return drmPollBusy(nouveau_bo_poll_busy, &poll, timeout_ns);
+}
+
 int
 nouveau_bo_map(struct nouveau_bo *bo, uint32_t access,
 	       struct nouveau_client *client)
@@ -125,6 +125,9 @@ struct nouveau_bo {
 int  nouveau_bo_new(struct nouveau_device *, uint32_t flags, uint32_t align,
 		    uint64_t size, union nouveau_bo_config *,
 		    struct nouveau_bo **);
+int  nouveau_bo_new_array(struct nouveau_device *, uint32_t flags,
+			  uint32_t align, int count, const uint64_t *sizes,
+			  union nouveau_bo_config *, struct nouveau_bo **);
 int  nouveau_bo_wrap(struct nouveau_device *, uint32_t handle,
 		     struct nouveau_bo **);
 int  nouveau_bo_name_ref(struct nouveau_device *dev, uint32_t name,
@@ -135,6 +138,8 @@ int  nouveau_bo_map(struct nouveau_bo *, uint32_t access,
 		    struct nouveau_client *);
 int  nouveau_bo_wait(struct nouveau_bo *, uint32_t access,
 		     struct nouveau_client *);
+int  nouveau_bo_wait_timeout(struct nouveau_bo *, uint32_t access,
+			     struct nouveau_client *, int64_t timeout_ns);
 
 struct nouveau_bufref {
 	struct nouveau_list thead;
@@ -83,6 +83,13 @@ struct nouveau_bo_priv {
 	uint64_t map_handle;
 	uint32_t name;
 	uint32_t access;
+	struct nouveau_bo_block *block;
+};
+
+/* storage shared by the buffers created by nouveau_bo_new_array() */
+struct nouveau_bo_block {
+	atomic_t refcnt;
+	struct nouveau_bo_priv bos[];
 };
 
 static inline struct nouveau_bo_priv *
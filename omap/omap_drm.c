@@ -37,6 +37,7 @@
 #include <fcntl.h>
 
 #include <xf86drm.h>
+#include <xf86atomic.h>
 
 #include "omap_drm.h"
 #include "omap_drmif.h"
@@ -58,6 +59,13 @@ struct omap_bo {
 	uint32_t	name;		/* flink global handle (DRI2 name) */
 	uint64_t	offset;		/* offset to mmap() */
 	int		fd;		/* dmabuf handle */
+	struct omap_bo_block *block;	/* shared allocation, if any */
+};
+
+/* storage for the buffer objects allocated by one omap_bo_new_array() */
+struct omap_bo_block {
+	atomic_t	refcount;
+	struct omap_bo	bos[];
 };
 
 struct omap_device * omap_device_new(int fd)
@@ -170,6 +178,64 @@ struct omap_bo * omap_bo_new_tiled(struct omap_device *dev,
 	return omap_bo_new_impl(dev, gsize, flags);
 }
 
+/* allocate several (un-tiled) buffer objects at once */
+int omap_bo_new_array(struct omap_device *dev, int count,
+		const uint32_t *sizes, uint32_t flags, struct omap_bo **bos)
+{
+	struct omap_bo_block *block;
+	int i, ret = 0;
+
+	if (count < 0 || (flags & OMAP_BO_TILED)) {
+		return -EINVAL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (sizes[i] == 0) {
+			return -EINVAL;
+		}
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	block = calloc(sizeof(*block) + count * sizeof(block->bos[0]), 1);
+	if (!block) {
+		return -ENOMEM;
+	}
+	atomic_set(&block->refcount, 1);
+
+	for (i = 0; i < count; i++) {
+		struct omap_bo *bo = &block->bos[i];
+		struct drm_omap_gem_new req = {
+				.size.bytes = sizes[i],
+				.flags = flags,
+		};
+
+		ret = drmCommandWriteRead(dev->fd, DRM_OMAP_GEM_NEW,
+				&req, sizeof(req));
+		if (ret) {
+			while (i--) {
+				omap_bo_del(bos[i]);
+			}
+			break;
+		}
+
+		bo->dev = dev;
+		bo->size = sizes[i];
+		bo->handle = req.handle;
+		bo->block = block;
+		atomic_inc(&block->refcount);
+		bos[i] = bo;
+	}
+
+	if (atomic_dec_and_test(&block->refcount)) {
+		free(block);
+	}
+
+	return ret;
+}
+
 /* get buffer info */
 static int get_buffer_info(struct omap_bo *bo)
 {
@@ -229,14 +295,14 @@ void omap_bo_del(struct omap_bo *bo)
 	}
 
 	if (bo->handle) {
-		struct drm_gem_close req = {
-				.handle = bo->handle,
-		};
-
-		drmIoctl(bo->dev->fd, DRM_IOCTL_GEM_CLOSE, &req);
+		drmCloseBufferHandle(bo->dev->fd, bo->handle);
 	}
 
-	free(bo);
+	if (!bo->block) {
+		free(bo);
+	} else if (atomic_dec_and_test(&bo->block->refcount)) {
+		free(bo->block);
+	}
 }
 
 /* get the global flink/DRI2 buffer name */
@@ -269,18 +335,13 @@ uint32_t omap_bo_handle(struct omap_bo *bo)
 int omap_bo_dmabuf(struct omap_bo *bo)
 {
 	if (!bo->fd) {
-		struct drm_prime_handle req = {
-				.handle = bo->handle,
-				.flags = DRM_CLOEXEC,
-		};
 		int ret;
 
-		ret = drmIoctl(bo->dev->fd, DRM_IOCTL_PRIME_HANDLE_TO_FD, &req);
+		ret = drmPrimeHandleToFD(bo->dev->fd, bo->handle, DRM_CLOEXEC,
+					 &bo->fd);
 		if (ret) {
 			return ret;
 		}
-
-		bo->fd = req.fd;
 	}
 	return bo->fd;
 }
@@ -49,6 +49,8 @@ struct omap_bo * omap_bo_new(struct omap_device *dev,
 		uint32_t size, uint32_t flags);
 struct omap_bo * omap_bo_new_tiled(struct omap_device *dev,
 		uint32_t width, uint32_t height, uint32_t flags);
+int omap_bo_new_array(struct omap_device *dev, int count,
+		const uint32_t *sizes, uint32_t flags, struct omap_bo **bos);
 struct omap_bo * omap_bo_from_name(struct omap_device *dev, uint32_t name);
 void omap_bo_del(struct omap_bo *bo);
 int omap_bo_get_name(struct omap_bo *bo, uint32_t *name);
@@ -29,6 +29,7 @@
  *      Dave Airlie
  *      Jérôme Glisse <glisse@freedesktop.org>
  */
+#include <xf86drm.h>
 #include <radeon_bo.h>
 #include <radeon_bo_int.h>
 
@@ -95,6 +96,22 @@ int radeon_bo_is_busy(struct radeon_bo *bo, uint32_t *domain)
     return boi->bom->funcs->bo_is_busy(boi, domain);
 }
 
+static int radeon_bo_poll_busy(void *data)
+{
+    uint32_t domain;
+
+    return radeon_bo_is_busy(data, &domain);
+}
+
+int radeon_bo_wait_timeout(struct radeon_bo *bo, int64_t timeout_ns)
+{
+    if (timeout_ns < 0) {
+        return radeon_bo_wait(bo);
+    }
+    /* the kernel can only wait for good, so poll instead */
+    return drmPollBusy(radeon_bo_poll_busy, bo, timeout_ns);
+}
+
 int radeon_bo_set_tiling(struct radeon_bo *bo,
                          uint32_t tiling_flags, uint32_t pitch)
 {
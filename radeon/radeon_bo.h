@@ -59,12 +59,25 @@ struct radeon_bo *radeon_bo_open(struct radeon_bo_manager *bom,
                                  uint32_t domains,
                                  uint32_t flags);
 
+/* Creates count new buffers at once, returns 0 or a negative errno in which
+ * case none of them are left allocated. */
+int radeon_bo_open_array(struct radeon_bo_manager *bom,
+                         int count,
+                         const uint32_t *sizes,
+                         uint32_t alignment,
+                         uint32_t domains,
+                         uint32_t flags,
+                         struct radeon_bo **bos);
+
 void radeon_bo_ref(struct radeon_bo *bo);
 struct radeon_bo *radeon_bo_unref(struct radeon_bo *bo);
 int radeon_bo_map(struct radeon_bo *bo, int write);
 int radeon_bo_unmap(struct radeon_bo *bo);
 int radeon_bo_wait(struct radeon_bo *bo);
 int radeon_bo_is_busy(struct radeon_bo *bo, uint32_t *domain);
+/* Waits at most timeout_ns for the buffer to go idle, for good if negative,
+ * returns 0, -ETIME or a negative errno. */
+int radeon_bo_wait_timeout(struct radeon_bo *bo, int64_t timeout_ns);
 int radeon_bo_set_tiling(struct radeon_bo *bo, uint32_t tiling_flags, uint32_t pitch);
 int radeon_bo_get_tiling(struct radeon_bo *bo, uint32_t *tiling_flags, uint32_t *pitch);
 int radeon_bo_is_static(struct radeon_bo *bo);
@@ -36,6 +36,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
 #include <sys/mman.h>
 #include <errno.h>
 #include "xf86drm.h"
@@ -52,14 +55,95 @@ struct radeon_bo_gem {
     int                 map_count;
     atomic_t            reloc_in_cs;
     void *priv_ptr;
+    struct radeon_bo_gem_block *block;
+    /* exported or imported through PRIME, and in the handle table */
+    int                 shared;
+    /* flinked, so other processes can use it too */
+    int                 exported;
+    /* bumped by every CS using the bo; idle_seq is what it was when the
+     * bo was last seen idle, so the two match for as long as it still is */
+    atomic_t            cs_seq;
+    int                 idle_seq;
+};
+
+/* storage shared by the buffers created by one bo_open_array() call */
+struct radeon_bo_gem_block {
+    atomic_t            refcount;
+    struct radeon_bo_gem bos[];
 };
 
 struct bo_manager_gem {
     struct radeon_bo_manager    base;
+    /* buffers shared through PRIME, by handle */
+    void                        *handle_table;
+    /* buffers shared through flink, by name */
+    void                        *name_table;
+    struct radeon_bo_gem_stats  stats;
 };
 
+/* busy queries in a bo_wait() before blocking in the kernel, the first
+ * ones back to back and the others yielding the CPU in between */
+#define BO_WAIT_POLLS 8
+#define BO_WAIT_SPINS 4
+
 static int bo_wait(struct radeon_bo_int *boi);
+static int bo_is_busy(struct radeon_bo_int *boi, uint32_t *domain);
     
+static void bo_free(struct radeon_bo_gem *bo_gem)
+{
+    struct radeon_bo_gem_block *block = bo_gem->block;
+
+    memset(bo_gem, 0, sizeof(struct radeon_bo_gem));
+    if (block == NULL)
+        free(bo_gem);
+    else if (atomic_dec_and_test(&block->refcount))
+        free(block);
+}
+
+static int bo_create(struct radeon_bo_manager *bom,
+                     struct radeon_bo_gem *bo)
+{
+    struct drm_radeon_gem_create args;
+    int r;
+
+    args.size = bo->base.size;
+    args.alignment = bo->base.alignment;
+    args.initial_domain = bo->base.domains;
+    args.flags = 0;
+    args.handle = 0;
+    r = drmCommandWriteRead(bom->fd, DRM_RADEON_GEM_CREATE,
+                            &args, sizeof(args));
+    bo->base.handle = args.handle;
+    if (r) {
+        fprintf(stderr, "Failed to allocate :\n");
+        fprintf(stderr, "   size      : %d bytes\n", bo->base.size);
+        fprintf(stderr, "   alignment : %d bytes\n", bo->base.alignment);
+        fprintf(stderr, "   domains   : %d\n", bo->base.domains);
+    }
+    return r;
+}
+
+static void bo_init(struct radeon_bo_manager *bom,
+                    struct radeon_bo_gem *bo,
+                    uint32_t size,
+                    uint32_t alignment,
+                    uint32_t domains,
+                    uint32_t flags)
+{
+    bo->base.bom = bom;
+    bo->base.handle = 0;
+    bo->base.size = size;
+    bo->base.alignment = alignment;
+    bo->base.domains = domains;
+    bo->base.flags = flags;
+    bo->base.ptr = NULL;
+    atomic_set(&bo->reloc_in_cs, 0);
+    bo->map_count = 0;
+    /* new buffers are idle */
+    atomic_set(&bo->cs_seq, 0);
+    bo->idle_seq = 0;
+}
+
 static struct radeon_bo *bo_open(struct radeon_bo_manager *bom,
                                  uint32_t handle,
                                  uint32_t size,
@@ -67,7 +151,9 @@ static struct radeon_bo *bo_open(struct radeon_bo_manager *bom,
                                  uint32_t domains,
                                  uint32_t flags)
 {
+    struct bo_manager_gem *bomg = (struct bo_manager_gem*)bom;
     struct radeon_bo_gem *bo;
+    void *value;
     int r;
 
     bo = (struct radeon_bo_gem*)calloc(1, sizeof(struct radeon_bo_gem));
@@ -75,18 +161,18 @@ static struct radeon_bo *bo_open(struct radeon_bo_manager *bom,
         return NULL;
     }
 
-    bo->base.bom = bom;
-    bo->base.handle = 0;
-    bo->base.size = size;
-    bo->base.alignment = alignment;
-    bo->base.domains = domains;
-    bo->base.flags = flags;
-    bo->base.ptr = NULL;
-    atomic_set(&bo->reloc_in_cs, 0);
-    bo->map_count = 0;
+    bo_init(bom, bo, size, alignment, domains, flags);
     if (handle) {
         struct drm_gem_open open_arg;
 
+        /* GEM_OPEN makes a new handle each time, so a name we already
+         * have has to be found before asking the kernel */
+        if (drmHashLookup(bomg->name_table, handle, &value) == 0) {
+            free(bo);
+            radeon_bo_ref((struct radeon_bo*)value);
+            return (struct radeon_bo*)value;
+        }
+
         memset(&open_arg, 0, sizeof(open_arg));
         open_arg.name = handle;
         r = drmIoctl(bom->fd, DRM_IOCTL_GEM_OPEN, &open_arg);
@@ -97,22 +183,10 @@ static struct radeon_bo *bo_open(struct radeon_bo_manager *bom,
         bo->base.handle = open_arg.handle;
         bo->base.size = open_arg.size;
         bo->name = handle;
+        drmHashInsert(bomg->name_table, handle, bo);
     } else {
-        struct drm_radeon_gem_create args;
-
-        args.size = size;
-        args.alignment = alignment;
-        args.initial_domain = bo->base.domains;
-        args.flags = 0;
-        args.handle = 0;
-        r = drmCommandWriteRead(bom->fd, DRM_RADEON_GEM_CREATE,
-                                &args, sizeof(args));
-        bo->base.handle = args.handle;
+        r = bo_create(bom, bo);
         if (r) {
-            fprintf(stderr, "Failed to allocate :\n");
-            fprintf(stderr, "   size      : %d bytes\n", size);
-            fprintf(stderr, "   alignment : %d bytes\n", alignment);
-            fprintf(stderr, "   domains   : %d\n", bo->base.domains);
             free(bo);
             return NULL;
         }
@@ -121,6 +195,47 @@ static struct radeon_bo *bo_open(struct radeon_bo_manager *bom,
     return (struct radeon_bo*)bo;
 }
 
+static int bo_open_array(struct radeon_bo_manager *bom,
+                         int count,
+                         const uint32_t *sizes,
+                         uint32_t alignment,
+                         uint32_t domains,
+                         uint32_t flags,
+                         struct radeon_bo **bos)
+{
+    struct radeon_bo_gem_block *block;
+    int i, r;
+
+    if (count == 0)
+        return 0;
+
+    /* one allocation for all the structs, freed with the last buffer */
+    block = calloc(1, sizeof(*block) + count * sizeof(struct radeon_bo_gem));
+    if (block == NULL)
+        return -ENOMEM;
+    atomic_set(&block->refcount, 1);
+
+    for (i = 0; i < count; i++) {
+        struct radeon_bo_gem *bo = &block->bos[i];
+
+        bo_init(bom, bo, sizes[i], alignment, domains, flags);
+        r = bo_create(bom, bo);
+        if (r) {
+            while (i--)
+                radeon_bo_unref(bos[i]);
+            break;
+        }
+        bo->block = block;
+        atomic_inc(&block->refcount);
+        bos[i] = (struct radeon_bo*)bo;
+        radeon_bo_ref(bos[i]);
+    }
+
+    if (atomic_dec_and_test(&block->refcount))
+        free(block);
+    return i < count ? r : 0;
+}
+
 static void bo_ref(struct radeon_bo_int *boi)
 {
 }
@@ -128,7 +243,6 @@ static void bo_ref(struct radeon_bo_int *boi)
 static struct radeon_bo *bo_unref(struct radeon_bo_int *boi)
 {
     struct radeon_bo_gem *bo_gem = (struct radeon_bo_gem*)boi;
-    struct drm_gem_close args;
 
     if (boi->cref) {
         return (struct radeon_bo *)boi;
@@ -136,15 +250,20 @@ static struct radeon_bo *bo_unref(struct radeon_bo_int *boi)
     if (bo_gem->priv_ptr) {
         munmap(bo_gem->priv_ptr, boi->size);
     }
+    if (bo_gem->shared) {
+        struct bo_manager_gem *bomg = (struct bo_manager_gem*)boi->bom;
 
-    /* Zero out args to make valgrind happy */
-    memset(&args, 0, sizeof(args));
+        drmHashDelete(bomg->handle_table, boi->handle);
+    }
+    if (bo_gem->name) {
+        struct bo_manager_gem *bomg = (struct bo_manager_gem*)boi->bom;
+
+        drmHashDelete(bomg->name_table, bo_gem->name);
+    }
 
     /* close object */
-    args.handle = boi->handle;
-    drmIoctl(boi->bom->fd, DRM_IOCTL_GEM_CLOSE, &args);
-    memset(bo_gem, 0, sizeof(struct radeon_bo_gem));
-    free(bo_gem);
+    drmCloseBufferHandle(boi->bom->fd, boi->handle);
+    bo_free(bo_gem);
     return NULL;
 }
 
@@ -202,24 +321,71 @@ static int bo_unmap(struct radeon_bo_int *boi)
     return 0;
 }
 
-static int bo_wait(struct radeon_bo_int *boi)
+/* whether no CS has used the bo since it was last seen idle */
+static int bo_known_idle(struct radeon_bo_gem *bo_gem, int seq)
 {
+    /* others may be keeping shared buffers busy */
+    if (bo_gem->name || bo_gem->exported || bo_gem->shared) {
+        return 0;
+    }
+    return seq == bo_gem->idle_seq;
+}
+
+static int bo_wait_idle(void *data)
+{
+    struct radeon_bo_int *boi = data;
     struct drm_radeon_gem_wait_idle args;
-    int ret;
 
     /* Zero out args to make valgrind happy */
     memset(&args, 0, sizeof(args));
     args.handle = boi->handle;
-    do {
-        ret = drmCommandWriteRead(boi->bom->fd, DRM_RADEON_GEM_WAIT_IDLE,
-                                  &args, sizeof(args));
-    } while (ret == -EBUSY);
+    return drmCommandWriteRead(boi->bom->fd, DRM_RADEON_GEM_WAIT_IDLE,
+                               &args, sizeof(args));
+}
+
+static int bo_wait(struct radeon_bo_int *boi)
+{
+    struct radeon_bo_gem *bo_gem = (struct radeon_bo_gem*)boi;
+    struct bo_manager_gem *bomg = (struct bo_manager_gem*)boi->bom;
+    int seq = atomic_read(&bo_gem->cs_seq);
+    uint32_t domain;
+    int i, ret;
+
+    bomg->stats.waits++;
+    if (bo_known_idle(bo_gem, seq)) {
+        bomg->stats.waits_avoided++;
+        return 0;
+    }
+
+    /* work about to finish is cheaper to poll for than to sleep on */
+    for (i = 0; i < BO_WAIT_POLLS; i++) {
+        ret = bo_is_busy(boi, &domain);
+        if (ret != -EBUSY) {
+            break;
+        }
+        if (i >= BO_WAIT_SPINS) {
+            sched_yield();
+        }
+    }
+    if (ret == -EBUSY) {
+        /* the kernel may give up with -EBUSY too, back off between tries
+         * instead of spinning on it */
+        bomg->stats.waits_blocked++;
+        ret = drmPollBusy(bo_wait_idle, boi, -1);
+    } else {
+        bomg->stats.waits_polled++;
+    }
+    if (ret == 0) {
+        bo_gem->idle_seq = seq;
+    }
     return ret;
 }
 
 static int bo_is_busy(struct radeon_bo_int *boi, uint32_t *domain)
 {
+    struct radeon_bo_gem *bo_gem = (struct radeon_bo_gem*)boi;
     struct drm_radeon_gem_busy args;
+    int seq = atomic_read(&bo_gem->cs_seq);
     int ret;
 
     args.handle = boi->handle;
@@ -227,6 +393,9 @@ static int bo_is_busy(struct radeon_bo_int *boi, uint32_t *domain)
 
     ret = drmCommandWriteRead(boi->bom->fd, DRM_RADEON_GEM_BUSY,
                               &args, sizeof(args));
+    if (ret == 0) {
+        bo_gem->idle_seq = seq;
+    }
 
     *domain = args.domain;
     return ret;
@@ -283,6 +452,37 @@ static struct radeon_bo_funcs bo_gem_funcs = {
     bo_is_busy,
 };
 
+/* Lives here rather than in radeon_bo.c so that the batched path can be
+ * picked for our own managers without a hook in the installed
+ * radeon_bo_funcs, which other managers may lay out without it. */
+int radeon_bo_open_array(struct radeon_bo_manager *bom,
+                         int count,
+                         const uint32_t *sizes,
+                         uint32_t alignment,
+                         uint32_t domains,
+                         uint32_t flags,
+                         struct radeon_bo **bos)
+{
+    int i;
+
+    if (count < 0)
+        return -EINVAL;
+    if (bom->funcs == &bo_gem_funcs)
+        return bo_open_array(bom, count, sizes, alignment, domains, flags,
+                             bos);
+
+    for (i = 0; i < count; i++) {
+        bos[i] = bom->funcs->bo_open(bom, 0, sizes[i], alignment,
+                                     domains, flags);
+        if (bos[i] == NULL) {
+            while (i--)
+                radeon_bo_unref(bos[i]);
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
 struct radeon_bo_manager *radeon_bo_manager_gem_ctor(int fd)
 {
     struct bo_manager_gem *bomg;
@@ -291,6 +491,17 @@ struct radeon_bo_manager *radeon_bo_manager_gem_ctor(int fd)
     if (bomg == NULL) {
         return NULL;
     }
+    bomg->handle_table = drmHashCreate();
+    if (bomg->handle_table == NULL) {
+        free(bomg);
+        return NULL;
+    }
+    bomg->name_table = drmHashCreate();
+    if (bomg->name_table == NULL) {
+        drmHashDestroy(bomg->handle_table);
+        free(bomg);
+        return NULL;
+    }
     bomg->base.funcs = &bo_gem_funcs;
     bomg->base.fd = fd;
     return (struct radeon_bo_manager*)bomg;
@@ -303,6 +514,8 @@ void radeon_bo_manager_gem_dtor(struct radeon_bo_manager *bom)
     if (bom == NULL) {
         return;
     }
+    drmHashDestroy(bomg->name_table);
+    drmHashDestroy(bomg->handle_table);
     free(bomg);
 }
 
@@ -318,9 +531,27 @@ void *radeon_gem_get_reloc_in_cs(struct radeon_bo *bo)
     return &bo_gem->reloc_in_cs;
 }
 
+void radeon_gem_bo_mark_busy(struct radeon_bo *bo)
+{
+    struct radeon_bo_gem *bo_gem = (struct radeon_bo_gem*)bo;
+
+    /* bo might be referenced from another context */
+    atomic_inc(&bo_gem->cs_seq);
+}
+
+void radeon_bo_manager_gem_get_stats(struct radeon_bo_manager *bom,
+                                     struct radeon_bo_gem_stats *stats)
+{
+    struct bo_manager_gem *bomg = (struct bo_manager_gem*)bom;
+
+    *stats = bomg->stats;
+}
+
 int radeon_gem_get_kernel_name(struct radeon_bo *bo, uint32_t *name)
 {
     struct radeon_bo_int *boi = (struct radeon_bo_int *)bo;
+    struct radeon_bo_gem *bo_gem = (struct radeon_bo_gem*)bo;
+    struct bo_manager_gem *bomg = (struct bo_manager_gem*)boi->bom;
     struct drm_gem_flink flink;
     int r;
 
@@ -329,6 +560,12 @@ int radeon_gem_get_kernel_name(struct radeon_bo *bo, uint32_t *name)
     if (r) {
         return r;
     }
+    bo_gem->exported = 1;
+    /* so that opening our own name hands back this bo */
+    if (!bo_gem->name) {
+        bo_gem->name = flink.name;
+        drmHashInsert(bomg->name_table, flink.name, bo_gem);
+    }
     *name = flink.name;
     return 0;
 }
@@ -349,3 +586,65 @@ int radeon_gem_set_domain(struct radeon_bo *bo, uint32_t read_domains, uint32_t
                             sizeof(args));
     return r;
 }
+
+int radeon_gem_prime_share_bo(struct radeon_bo *bo, int *handle)
+{
+    struct radeon_bo_gem *bo_gem = (struct radeon_bo_gem*)bo;
+    struct bo_manager_gem *bomg = (struct bo_manager_gem*)bo_gem->base.bom;
+    int r;
+
+    r = drmPrimeHandleToFD(bomg->base.fd, bo->handle, DRM_CLOEXEC, handle);
+    if (r) {
+        return -errno;
+    }
+
+    /* importing it back must find this bo */
+    if (!bo_gem->shared) {
+        bo_gem->shared = 1;
+        drmHashInsert(bomg->handle_table, bo->handle, bo_gem);
+    }
+    return 0;
+}
+
+struct radeon_bo *radeon_gem_bo_open_prime(struct radeon_bo_manager *bom,
+                                           int fd_handle,
+                                           uint32_t size)
+{
+    struct bo_manager_gem *bomg = (struct bo_manager_gem*)bom;
+    struct radeon_bo_gem *bo;
+    uint32_t handle;
+    void *value;
+    off_t end;
+    int r;
+
+    r = drmPrimeFDToHandle(bom->fd, fd_handle, &handle);
+    if (r) {
+        return NULL;
+    }
+
+    /* the kernel hands back the handle we already have for a buffer
+     * imported or exported before, so share its bo too */
+    if (drmHashLookup(bomg->handle_table, handle, &value) == 0) {
+        radeon_bo_ref((struct radeon_bo*)value);
+        return (struct radeon_bo*)value;
+    }
+
+    bo = (struct radeon_bo_gem*)calloc(1, sizeof(struct radeon_bo_gem));
+    if (bo == NULL) {
+        drmCloseBufferHandle(bom->fd, handle);
+        return NULL;
+    }
+
+    /* dma-bufs that support seeking know their size better than we do */
+    end = lseek(fd_handle, 0, SEEK_END);
+    if (end != (off_t)-1) {
+        size = end;
+    }
+    bo_init(bom, bo, size, 0, RADEON_GEM_DOMAIN_GTT, 0);
+    bo->base.handle = handle;
+    bo->shared = 1;
+    drmHashInsert(bomg->handle_table, handle, bo);
+
+    radeon_bo_ref((struct radeon_bo*)bo);
+    return (struct radeon_bo*)bo;
+}
@@ -34,11 +34,30 @@
 
 #include "radeon_bo.h"
 
+/* bo_wait() counters, including the waits done by radeon_bo_map() */
+struct radeon_bo_gem_stats {
+    unsigned long waits;
+    /* known to be idle from the CS history, no ioctl needed */
+    unsigned long waits_avoided;
+    /* found idle by a few busy queries */
+    unsigned long waits_polled;
+    /* had to block in the kernel */
+    unsigned long waits_blocked;
+};
+
 struct radeon_bo_manager *radeon_bo_manager_gem_ctor(int fd);
 void radeon_bo_manager_gem_dtor(struct radeon_bo_manager *bom);
+void radeon_bo_manager_gem_get_stats(struct radeon_bo_manager *bom,
+                                     struct radeon_bo_gem_stats *stats);
 
 uint32_t radeon_gem_name_bo(struct radeon_bo *bo);
 void *radeon_gem_get_reloc_in_cs(struct radeon_bo *bo);
+/* called for every bo a CS used, once submitted */
+void radeon_gem_bo_mark_busy(struct radeon_bo *bo);
 int radeon_gem_set_domain(struct radeon_bo *bo, uint32_t read_domains, uint32_t write_domain);
 int radeon_gem_get_kernel_name(struct radeon_bo *bo, uint32_t *name);
+int radeon_gem_prime_share_bo(struct radeon_bo *bo, int *handle);
+struct radeon_bo *radeon_gem_bo_open_prime(struct radeon_bo_manager *bom,
+                                           int fd_handle,
+                                           uint32_t size);
 #endif
@@ -440,6 +440,7 @@ static int cs_gem_emit(struct radeon_cs_int *cs)
         csg->relocs_bo[i]->space_accounted = 0;
         /* bo might be referenced from another context so have to use atomic opertions */
         atomic_dec((atomic_t *)radeon_gem_get_reloc_in_cs((struct radeon_bo*)csg->relocs_bo[i]), cs->id);
+        radeon_gem_bo_mark_busy((struct radeon_bo *)csg->relocs_bo[i]);
         radeon_bo_unref((struct radeon_bo *)csg->relocs_bo[i]);
         csg->relocs_bo[i] = NULL;
     }
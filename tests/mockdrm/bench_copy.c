@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Compares drmMemcpyToWC() and drmMemcpyFromWC() with memcpy() on plain
+ * anonymous memory.  Real write-combined mappings need a GPU; this only
+ * shows what the streaming routines cost when they gain nothing, and how
+ * they behave once the copy no longer fits in the caches.  Run with
+ * LIBDRM_COPY set to compare the implementations.
+ *
+ * Usage: bench_copy [-m megabytes]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "xf86drm.h"
+#include "mockdrm.h"
+
+enum mode {
+	MODE_MEMCPY,
+	MODE_TO_WC,
+	MODE_FROM_WC,
+};
+
+static double
+run(enum mode mode, char *dst, const char *src, size_t size, size_t total)
+{
+	uint64_t start, elapsed;
+	size_t done;
+
+	start = mockdrm_time_ns();
+	for (done = 0; done < total; done += size) {
+		switch (mode) {
+		case MODE_MEMCPY:
+			memcpy(dst, src, size);
+			break;
+		case MODE_TO_WC:
+			drmMemcpyToWC(dst, src, size);
+			break;
+		case MODE_FROM_WC:
+			drmMemcpyFromWC(dst, src, size);
+			break;
+		}
+	}
+	elapsed = mockdrm_time_ns() - start;
+
+	/* MB/s */
+	return (double)done * 1000 / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t sizes[] = { 256, 4096, 65536, 1 << 20, 16 << 20 };
+	size_t total = 512 << 20;
+	const char *env;
+	char *src, *dst;
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, "m:")) != -1) {
+		switch (c) {
+		case 'm':
+			total = (size_t)atoi(optarg) << 20;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m megabytes]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	src = mmap(NULL, 16 << 20, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	dst = mmap(NULL, 16 << 20, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	assert(src != MAP_FAILED && dst != MAP_FAILED);
+	memset(src, 0x5a, 16 << 20);
+	memset(dst, 0xa5, 16 << 20);
+
+	env = getenv("LIBDRM_COPY");
+	printf("%zu MB per size, LIBDRM_COPY=%s, MB/s\n", total >> 20,
+	       env ? env : "(unset)");
+	printf("%10s %12s %12s %12s\n", "size", "memcpy", "to_wc", "from_wc");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		printf("%10zu %12.0f %12.0f %12.0f\n", sizes[i],
+		       run(MODE_MEMCPY, dst, src, sizes[i], total),
+		       run(MODE_TO_WC, dst, src, sizes[i], total),
+		       run(MODE_FROM_WC, dst, src, sizes[i], total));
+	}
+
+	munmap(src, 16 << 20);
+	munmap(dst, 16 << 20);
+
+	return 0;
+}
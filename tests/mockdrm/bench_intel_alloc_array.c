@@ -0,0 +1,161 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Compares setting up a set of buffers one drm_intel_bo_alloc() at a time
+ * with a single drm_intel_bo_alloc_array() call, both from an empty cache
+ * (application startup) and from a cache holding the previous frame's
+ * buffers (swapchain or mip chain reallocation).
+ *
+ * Usage: bench_intel_alloc_array [-n buffers] [-i iterations]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+static void
+alloc_single(drm_intel_bufmgr *bufmgr, int count,
+	     const unsigned long *sizes, drm_intel_bo **bos)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		bos[i] = drm_intel_bo_alloc(bufmgr, "bench", sizes[i], 4096);
+		assert(bos[i] != NULL);
+	}
+}
+
+static void
+alloc_array(drm_intel_bufmgr *bufmgr, int count,
+	    const unsigned long *sizes, drm_intel_bo **bos)
+{
+	int ret;
+
+	ret = drm_intel_bo_alloc_array(bufmgr, "bench", count, sizes, 4096,
+				       bos);
+	assert(ret == 0);
+}
+
+static void
+run(int fd, const char *name, int reuse, int count, int iterations,
+    const unsigned long *sizes,
+    void (*alloc)(drm_intel_bufmgr *, int, const unsigned long *,
+		  drm_intel_bo **))
+{
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo **bos;
+	uint64_t elapsed = 0, start;
+	unsigned long creates;
+	int i, j;
+
+	bos = calloc(count, sizeof(*bos));
+	assert(bos != NULL);
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	if (reuse)
+		drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	creates = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE);
+	for (i = 0; i < iterations; i++) {
+		start = mockdrm_time_ns();
+		alloc(bufmgr, count, sizes, bos);
+		elapsed += mockdrm_time_ns() - start;
+
+		for (j = 0; j < count; j++)
+			drm_intel_bo_unreference(bos[j]);
+	}
+	creates = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE) - creates;
+
+	printf("%-24s %10lu %10.0f\n", name, creates,
+	       (double)elapsed / ((uint64_t)iterations * count));
+
+	drm_intel_bufmgr_destroy(bufmgr);
+	free(bos);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long *sizes;
+	int count = 64, iterations = 1000;
+	int fd, c, i;
+
+	while ((c = getopt(argc, argv, "n:i:")) != -1) {
+		switch (c) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n buffers] [-i iterations]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	/* Staging buffers, a mip chain and some full-sized surfaces */
+	sizes = calloc(count, sizeof(*sizes));
+	assert(sizes != NULL);
+	for (i = 0; i < count; i++) {
+		switch (i % 4) {
+		case 0:
+			sizes[i] = 4096;
+			break;
+		case 1:
+			sizes[i] = 64 * 1024;
+			break;
+		case 2:
+			sizes[i] = (1024 * 1024) >> (i % 8);
+			break;
+		default:
+			sizes[i] = 8 * 1024 * 1024;
+			break;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+
+	printf("%d buffers, %d iterations\n", count, iterations);
+	printf("%-24s %10s %10s\n", "allocation", "creates", "ns/bo");
+	run(fd, "single, no reuse", 0, count, iterations, sizes, alloc_single);
+	run(fd, "array, no reuse", 0, count, iterations, sizes, alloc_array);
+	run(fd, "single, cached", 1, count, iterations, sizes, alloc_single);
+	run(fd, "array, cached", 1, count, iterations, sizes, alloc_array);
+
+	mockdrm_close(fd);
+	free(sizes);
+
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Measures drm_intel_bufmgr_check_aperture_space() the way 3D drivers
+ * use it: before every draw, for the batch and the surfaces the draw is
+ * about to reference.  The surfaces add up to a little less than the
+ * usable aperture, and are referenced over and over again, so the batch
+ * gets close to the limit without reaching it.
+ *
+ * Usage: bench_intel_aperture [-i iterations]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+#define NUM_SURFACES	176
+#define SURFACE_SIZE	(1024 * 1024)
+#define DRAW_SURFACES	4
+
+static void
+run(drm_intel_bufmgr *bufmgr, drm_intel_bo **surfaces, int draws,
+    int iterations)
+{
+	drm_intel_bo *check[1 + DRAW_SURFACES];
+	uint64_t checks = 0, emit = 0, start;
+	int i, j, n, ret;
+
+	for (n = 0; n < iterations; n++) {
+		drm_intel_bo *batch;
+
+		batch = drm_intel_bo_alloc(bufmgr, "batch",
+					   draws * DRAW_SURFACES * 4, 4096);
+		assert(batch != NULL);
+		check[0] = batch;
+
+		for (i = 0; i < draws; i++) {
+			for (j = 0; j < DRAW_SURFACES; j++)
+				check[1 + j] = surfaces[(i * 7 + j * 45) %
+							NUM_SURFACES];
+
+			start = mockdrm_time_ns();
+			ret = drm_intel_bufmgr_check_aperture_space(check,
+								    1 + DRAW_SURFACES);
+			assert(ret == 0);
+			checks += mockdrm_time_ns() - start;
+
+			start = mockdrm_time_ns();
+			for (j = 0; j < DRAW_SURFACES; j++) {
+				ret = drm_intel_bo_emit_reloc(batch,
+							      (i * DRAW_SURFACES + j) * 4,
+							      check[1 + j], 0,
+							      I915_GEM_DOMAIN_RENDER,
+							      0);
+				assert(ret == 0);
+			}
+			emit += mockdrm_time_ns() - start;
+		}
+
+		drm_intel_bo_unreference(batch);
+	}
+
+	printf("%8d %12.0f %12.0f\n", draws * DRAW_SURFACES,
+	       (double)checks / iterations, (double)emit / iterations);
+}
+
+int main(int argc, char **argv)
+{
+	static const int draws[] = { 250, 500, 1250, 2500 };
+	drm_intel_bo *surfaces[NUM_SURFACES];
+	drm_intel_bufmgr *bufmgr;
+	int iterations = 20;
+	unsigned int i;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "i:")) != -1) {
+		switch (c) {
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-i iterations]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 128 * 1024);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	for (i = 0; i < NUM_SURFACES; i++) {
+		surfaces[i] = drm_intel_bo_alloc(bufmgr, "surface",
+						 SURFACE_SIZE, 4096);
+		assert(surfaces[i] != NULL);
+	}
+
+	printf("%d iterations, %d surfaces of %dkB\n",
+	       iterations, NUM_SURFACES, SURFACE_SIZE / 1024);
+	printf("%8s %12s %12s\n", "relocs", "check ns", "emit ns");
+	for (i = 0; i < sizeof(draws) / sizeof(draws[0]); i++)
+		run(bufmgr, surfaces, draws[i], iterations);
+
+	for (i = 0; i < NUM_SURFACES; i++)
+		drm_intel_bo_unreference(surfaces[i]);
+	drm_intel_bufmgr_destroy(bufmgr);
+	mockdrm_close(fd);
+
+	return 0;
+}
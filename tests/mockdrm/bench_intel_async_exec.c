@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Compares synchronous and threaded execbuffer submission against a mock
+ * execbuffer ioctl with injected latency.  Between batches the caller
+ * spins for a while, standing in for the work a driver does to build the
+ * next one.  "exec" is the time the caller spends inside
+ * drm_intel_bo_exec(), "total" the time per batch including waiting for
+ * every submission to complete at the end.
+ *
+ * Usage: bench_intel_async_exec [-l latency_ns] [-w work_ns] [-d depth]
+ *                               [-i iterations]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+#define MI_BATCH_BUFFER_END	(0xA << 23)
+
+#define NUM_TARGETS	64
+#define RELOCS		100
+
+static void
+spin(unsigned int ns)
+{
+	uint64_t until = mockdrm_time_ns() + ns;
+
+	while (mockdrm_time_ns() < until)
+		;
+}
+
+static void
+run(int fd, const char *mode, unsigned int depth, unsigned int work,
+    int iterations)
+{
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *targets[NUM_TARGETS];
+	uint64_t exec = 0, start, total;
+	uint32_t end = MI_BATCH_BUFFER_END;
+	int i, n, ret;
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	if (depth) {
+		ret = drm_intel_bufmgr_gem_enable_async_exec(bufmgr, depth,
+							     NULL, NULL);
+		assert(ret == 0);
+	}
+
+	for (i = 0; i < NUM_TARGETS; i++) {
+		targets[i] = drm_intel_bo_alloc(bufmgr, "surface", 4096, 4096);
+		assert(targets[i] != NULL);
+	}
+
+	total = mockdrm_time_ns();
+	for (n = 0; n < iterations; n++) {
+		drm_intel_bo *batch;
+
+		batch = drm_intel_bo_alloc(bufmgr, "batch", 4096, 4096);
+		assert(batch != NULL);
+		for (i = 0; i < RELOCS; i++) {
+			ret = drm_intel_bo_emit_reloc(batch, i * 4,
+						      targets[(n + i) % NUM_TARGETS],
+						      0, I915_GEM_DOMAIN_RENDER,
+						      0);
+			assert(ret == 0);
+		}
+		ret = drm_intel_bo_subdata(batch, RELOCS * 4, 4, &end);
+		assert(ret == 0);
+		spin(work);
+
+		start = mockdrm_time_ns();
+		ret = drm_intel_bo_exec(batch, RELOCS * 4 + 8, NULL, 0, 0);
+		assert(ret == 0);
+		exec += mockdrm_time_ns() - start;
+
+		drm_intel_bo_unreference(batch);
+	}
+	ret = drm_intel_bufmgr_gem_wait_exec_fence(bufmgr,
+						   drm_intel_bufmgr_gem_get_exec_fence(bufmgr));
+	assert(ret == 0);
+	total = mockdrm_time_ns() - total;
+
+	printf("%-8s %6u %12.0f %12.0f\n", mode, depth,
+	       (double)exec / iterations, (double)total / iterations);
+
+	for (i = 0; i < NUM_TARGETS; i++)
+		drm_intel_bo_unreference(targets[i]);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int latency = 200000, work = 200000, depth = 8;
+	int iterations = 500;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "l:w:d:i:")) != -1) {
+		switch (c) {
+		case 'l':
+			latency = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			work = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-l latency_ns] [-w work_ns] "
+				"[-d depth] [-i iterations]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+	mockdrm_set_latency(DRM_IOCTL_I915_GEM_EXECBUFFER2, latency);
+
+	printf("%d iterations, %d relocations per batch, %u ns exec latency, "
+	       "%u ns work\n", iterations, RELOCS, latency, work);
+	printf("%-8s %6s %12s %12s\n", "mode", "depth", "exec ns", "total ns");
+	run(fd, "sync", 0, work, iterations);
+	if (depth)
+		run(fd, "async", depth, work, iterations);
+
+	mockdrm_close(fd);
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Replays a synthetic allocation trace through the intel gem bufmgr under
+ * different cache configurations, and reports how many objects had to be
+ * created and how much memory is lost to rounding up to the size classes.
+ *
+ * Usage: bench_intel_cache [-n operations] [-s seed]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+#define MAX_LIVE	64
+
+struct config {
+	const char *name;
+	int reuse;
+	int classes;
+	unsigned long max_size;
+	uint64_t max_bytes;
+};
+
+static const struct config configs[] = {
+	{ "no reuse", 0, 0, 0, 0 },
+	{ "4 classes <= 112M (default)", 1, 4, 112 << 20, 0 },
+	{ "2 classes <= 512M", 1, 2, 512 << 20, 0 },
+	{ "8 classes <= 512M", 1, 8, 512 << 20, 0 },
+	{ "8 classes <= 512M, 256M cap", 1, 8, 512 << 20, 256 << 20 },
+};
+
+static uint32_t seed;
+
+static uint32_t
+rand32(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/* Mostly small state and vertex buffers, some textures and video frames,
+ * and the occasional very large surface.
+ */
+static unsigned long
+trace_size(void)
+{
+	uint32_t r = rand32() % 100;
+
+	if (r < 60)
+		return 4096 + rand32() % (256 << 10);
+	if (r < 90)
+		return (256 << 10) + rand32() % (8 << 20);
+	return (8 << 20) + rand32() % (248 << 20);
+}
+
+static void
+run(int fd, const struct config *config, int ops, uint32_t trace_seed)
+{
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *live[MAX_LIVE];
+	drm_intel_bo_cache_stats cache_stats;
+	struct mockdrm_stats stats;
+	uint64_t requested = 0, allocated = 0, start;
+	unsigned long creates;
+	int nlive = 0, i, ret;
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	if (config->reuse) {
+		drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+		ret = drm_intel_bufmgr_gem_set_cache_classes(bufmgr,
+							     config->classes,
+							     config->max_size);
+		assert(ret == 0);
+		drm_intel_bufmgr_gem_set_cache_max_bytes(bufmgr,
+							 config->max_bytes);
+	}
+
+	seed = trace_seed;
+	mockdrm_reset_stats();
+	creates = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE);
+	start = mockdrm_time_ns();
+
+	for (i = 0; i < ops; i++) {
+		/* Keep the working set wobbling around half of MAX_LIVE */
+		if (nlive == 0 ||
+		    (nlive < MAX_LIVE && rand32() % MAX_LIVE >= nlive)) {
+			unsigned long size = trace_size();
+
+			live[nlive] = drm_intel_bo_alloc(bufmgr, "trace",
+							 size, 4096);
+			assert(live[nlive] != NULL);
+			requested += size;
+			allocated += live[nlive]->size;
+			nlive++;
+		} else {
+			int victim = rand32() % nlive;
+
+			drm_intel_bo_unreference(live[victim]);
+			live[victim] = live[--nlive];
+		}
+	}
+
+	mockdrm_get_stats(&stats);
+	creates = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE) - creates;
+	drm_intel_bufmgr_gem_get_cache_stats(bufmgr, &cache_stats);
+
+	printf("%-30s %8lu %8lu %7.2f%% %8lu %8lu %8.0f\n",
+	       config->name, creates, stats.ioctls,
+	       100.0 * (allocated - requested) / requested,
+	       cache_stats.evictions,
+	       (unsigned long)(cache_stats.cached_bytes >> 20),
+	       (double)(mockdrm_time_ns() - start) / ops);
+
+	while (nlive)
+		drm_intel_bo_unreference(live[--nlive]);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t trace_seed = 0x12345678;
+	int ops = 20000;
+	unsigned int i;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "n:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			ops = atoi(optarg);
+			break;
+		case 's':
+			trace_seed = strtoul(optarg, NULL, 0) | 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n ops] [-s seed]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+
+	printf("%d operations, at most %d live buffers\n", ops, MAX_LIVE);
+	printf("%-30s %8s %8s %8s %8s %8s %8s\n", "config", "creates",
+	       "ioctls", "wasted", "evicted", "cachedMB", "ns/op");
+	for (i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+		run(fd, &configs[i], ops, trace_seed);
+
+	mockdrm_close(fd);
+
+	return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Measures the CPU time spent by the intel gem bufmgr on emitting
+ * relocations and submitting batches with many of them.  The time the mock
+ * device spends emulating execbuffer is reported separately, so the
+ * "exec" column is what the library itself costs per submission.
+ *
+ * Each batch points at a set of surface buffers, directly and through
+ * state buffers that have relocations of their own, like a 3D driver's
+ * binding tables do.
+ *
+ * Usage: bench_intel_exec [-n] [-i iterations]
+ *
+ *   -n  enable relocation-free submission
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+#define MI_BATCH_BUFFER_END	(0xA << 23)
+
+#define NUM_TARGETS	512
+#define NUM_STATES	64
+#define STATE_RELOCS	16
+
+static void
+run(drm_intel_bufmgr *bufmgr, int relocs, int iterations)
+{
+	drm_intel_bo *targets[NUM_TARGETS], *states[NUM_STATES];
+	struct mockdrm_stats stats;
+	uint64_t emit = 0, exec = 0, kernel = 0, start;
+	uint32_t end = MI_BATCH_BUFFER_END;
+	int i, j, n, ret;
+
+	for (i = 0; i < NUM_TARGETS; i++) {
+		targets[i] = drm_intel_bo_alloc(bufmgr, "surface", 4096, 4096);
+		assert(targets[i] != NULL);
+	}
+
+	mockdrm_reset_stats();
+	for (n = 0; n < iterations; n++) {
+		drm_intel_bo *batch;
+
+		batch = drm_intel_bo_alloc(bufmgr, "batch",
+					   (relocs + 2) * 4, 4096);
+		assert(batch != NULL);
+
+		start = mockdrm_time_ns();
+		for (i = 0; i < NUM_STATES; i++) {
+			states[i] = drm_intel_bo_alloc(bufmgr, "state",
+						       4096, 4096);
+			assert(states[i] != NULL);
+			for (j = 0; j < STATE_RELOCS; j++) {
+				ret = drm_intel_bo_emit_reloc(states[i], j * 4,
+							      targets[(i * 7 + j * 13) % NUM_TARGETS],
+							      0,
+							      I915_GEM_DOMAIN_SAMPLER,
+							      0);
+				assert(ret == 0);
+			}
+		}
+		for (i = 0; i < relocs; i++) {
+			drm_intel_bo *target;
+
+			if (i % 8 == 0)
+				target = states[(i / 8) % NUM_STATES];
+			else
+				target = targets[(i * 31) % NUM_TARGETS];
+			ret = drm_intel_bo_emit_reloc(batch, i * 4, target, 0,
+						      I915_GEM_DOMAIN_RENDER,
+						      0);
+			assert(ret == 0);
+		}
+		emit += mockdrm_time_ns() - start;
+
+		ret = drm_intel_bo_subdata(batch, relocs * 4, 4, &end);
+		assert(ret == 0);
+
+		mockdrm_get_stats(&stats);
+		kernel -= stats.ioctl_ns;
+		start = mockdrm_time_ns();
+		ret = drm_intel_bo_exec(batch, (relocs + 2) * 4, NULL, 0, 0);
+		assert(ret == 0);
+		exec += mockdrm_time_ns() - start;
+		mockdrm_get_stats(&stats);
+		kernel += stats.ioctl_ns;
+
+		drm_intel_bo_unreference(batch);
+		for (i = 0; i < NUM_STATES; i++)
+			drm_intel_bo_unreference(states[i]);
+	}
+
+	mockdrm_get_stats(&stats);
+	printf("%8d %12.0f %12.0f %12.0f %12.0f\n", relocs,
+	       (double)emit / iterations, (double)(exec - kernel) / iterations,
+	       (double)kernel / iterations,
+	       (double)stats.relocs_skipped / iterations);
+
+	for (i = 0; i < NUM_TARGETS; i++)
+		drm_intel_bo_unreference(targets[i]);
+}
+
+int main(int argc, char **argv)
+{
+	static const int relocs[] = { 1000, 2000, 5000, 10000 };
+	drm_intel_bufmgr *bufmgr;
+	int iterations = 200, no_reloc = 0;
+	unsigned int i;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "ni:")) != -1) {
+		switch (c) {
+		case 'n':
+			no_reloc = 1;
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n] [-i iterations]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 128 * 1024);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	if (no_reloc)
+		drm_intel_bufmgr_gem_enable_no_reloc(bufmgr);
+
+	printf("%d iterations, %d surfaces, %d state buffers\n",
+	       iterations, NUM_TARGETS, NUM_STATES);
+	printf("%8s %12s %12s %12s %12s\n",
+	       "relocs", "emit ns", "exec ns", "kernel ns", "skipped");
+	for (i = 0; i < sizeof(relocs) / sizeof(relocs[0]); i++)
+		run(bufmgr, relocs[i], iterations);
+
+	drm_intel_bufmgr_destroy(bufmgr);
+	mockdrm_close(fd);
+
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Measures drm_intel_bo_gem_create_from_name() when a client keeps looking
+ * up the same set of N flinked buffers, as a compositor does every frame.
+ *
+ * Usage: bench_intel_flink [-r rounds]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+static void
+run(drm_intel_bufmgr *exporter, drm_intel_bufmgr *importer, int count,
+    int rounds)
+{
+	drm_intel_bo **bos, **imported;
+	uint32_t *names;
+	uint64_t first, start, repeat;
+	int i, r, ret;
+
+	bos = calloc(count, sizeof(*bos));
+	imported = calloc(count, sizeof(*imported));
+	names = calloc(count, sizeof(*names));
+	assert(bos && imported && names);
+
+	for (i = 0; i < count; i++) {
+		bos[i] = drm_intel_bo_alloc(exporter, "client", 4096, 4096);
+		assert(bos[i] != NULL);
+		ret = drm_intel_bo_flink(bos[i], &names[i]);
+		assert(ret == 0);
+	}
+
+	start = mockdrm_time_ns();
+	for (i = 0; i < count; i++) {
+		imported[i] = drm_intel_bo_gem_create_from_name(importer,
+								"import",
+								names[i]);
+		assert(imported[i] != NULL);
+	}
+	first = mockdrm_time_ns() - start;
+
+	start = mockdrm_time_ns();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < count; i++) {
+			drm_intel_bo *bo;
+
+			bo = drm_intel_bo_gem_create_from_name(importer,
+							       "import",
+							       names[i]);
+			drm_intel_bo_unreference(bo);
+		}
+	}
+	repeat = mockdrm_time_ns() - start;
+
+	printf("%8d %12.0f %12.0f\n", count, (double)first / count,
+	       (double)repeat / ((uint64_t)rounds * count));
+
+	for (i = 0; i < count; i++) {
+		drm_intel_bo_unreference(imported[i]);
+		drm_intel_bo_unreference(bos[i]);
+	}
+	free(names);
+	free(imported);
+	free(bos);
+}
+
+int main(int argc, char **argv)
+{
+	static const int counts[] = { 1, 10, 100, 1000, 5000 };
+	drm_intel_bufmgr *exporter, *importer;
+	int rounds = 100;
+	int fd, fd2, c;
+	unsigned int i;
+
+	while ((c = getopt(argc, argv, "r:")) != -1) {
+		switch (c) {
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	fd2 = mockdrm_open("i915");
+	assert(fd >= 0 && fd2 >= 0);
+	exporter = drm_intel_bufmgr_gem_init(fd, 4096);
+	importer = drm_intel_bufmgr_gem_init(fd2, 4096);
+	assert(exporter != NULL && importer != NULL);
+
+	printf("%8s %12s %12s\n", "names", "ns/open", "ns/lookup");
+	for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+		run(exporter, importer, counts[i], rounds);
+
+	drm_intel_bufmgr_destroy(importer);
+	drm_intel_bufmgr_destroy(exporter);
+	mockdrm_close(fd2);
+	mockdrm_close(fd);
+
+	return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Counts the heap allocations made by libdrm_intel for relocation lists:
+ * a set of long-lived state buffers with a few relocations each, and
+ * every frame a batch with many relocations plus some short-lived state
+ * buffers that cycle through the bo cache.  malloc() and friends are
+ * wrapped to count calls and track the bytes in use, which with the
+ * ioctls going to the mock device is nearly all relocation lists.
+ *
+ * Usage: bench_intel_relocs [-s state_bos] [-r batch_relocs] [-f frames]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include <malloc.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+#define MI_BATCH_BUFFER_END	(0xA << 23)
+
+#define TRANSIENT_BOS	64
+
+/* glibc's allocator, which the wrappers below forward to */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long mallocs;
+static size_t heap_bytes, heap_peak;
+
+static void *
+count_alloc(void *ptr)
+{
+	if (ptr != NULL) {
+		mallocs++;
+		heap_bytes += malloc_usable_size(ptr);
+		if (heap_bytes > heap_peak)
+			heap_peak = heap_bytes;
+	}
+	return ptr;
+}
+
+void *
+malloc(size_t size)
+{
+	return count_alloc(__libc_malloc(size));
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	return count_alloc(__libc_calloc(nmemb, size));
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	if (ptr != NULL)
+		heap_bytes -= malloc_usable_size(ptr);
+	return count_alloc(__libc_realloc(ptr, size));
+}
+
+void
+free(void *ptr)
+{
+	if (ptr != NULL)
+		heap_bytes -= malloc_usable_size(ptr);
+	__libc_free(ptr);
+}
+
+int main(int argc, char **argv)
+{
+	int num_state = 2000, relocs = 400, frames = 200;
+	uint32_t end = MI_BATCH_BUFFER_END;
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *target, **state;
+	unsigned long frame_mallocs;
+	size_t base;
+	int fd, c, i, n, ret;
+
+	while ((c = getopt(argc, argv, "s:r:f:")) != -1) {
+		switch (c) {
+		case 's':
+			num_state = atoi(optarg);
+			break;
+		case 'r':
+			relocs = atoi(optarg);
+			break;
+		case 'f':
+			frames = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-s state_bos] "
+				"[-r batch_relocs] [-f frames]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 16384);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	target = drm_intel_bo_alloc(bufmgr, "surface", 1 << 20, 4096);
+	assert(target != NULL);
+	state = calloc(num_state, sizeof(*state));
+	assert(state != NULL);
+
+	base = heap_bytes;
+	for (i = 0; i < num_state; i++) {
+		state[i] = drm_intel_bo_alloc(bufmgr, "state", 4096, 4096);
+		assert(state[i] != NULL);
+		for (n = 0; n < 4; n++) {
+			ret = drm_intel_bo_emit_reloc(state[i], n * 4, target,
+						      0, I915_GEM_DOMAIN_SAMPLER,
+						      0);
+			assert(ret == 0);
+		}
+	}
+	printf("%d state buffers with 4 relocations: %zu bytes of heap\n",
+	       num_state, heap_bytes - base);
+
+	frame_mallocs = 0;
+	heap_peak = heap_bytes;
+	base = heap_bytes;
+	for (n = 0; n < frames; n++) {
+		drm_intel_bo *batch, *transient[TRANSIENT_BOS];
+		unsigned long before = mallocs;
+
+		batch = drm_intel_bo_alloc(bufmgr, "batch", 16384, 4096);
+		assert(batch != NULL);
+		for (i = 0; i < TRANSIENT_BOS; i++) {
+			transient[i] = drm_intel_bo_alloc(bufmgr, "transient",
+							  4096, 4096);
+			assert(transient[i] != NULL);
+			ret = drm_intel_bo_emit_reloc(transient[i], 0, target,
+						      0, I915_GEM_DOMAIN_SAMPLER,
+						      0);
+			assert(ret == 0);
+		}
+		for (i = 0; i < relocs; i++) {
+			drm_intel_bo *bo = i < TRANSIENT_BOS ? transient[i] :
+				state[i % num_state];
+
+			ret = drm_intel_bo_emit_reloc(batch, i * 4, bo, 0,
+						      I915_GEM_DOMAIN_SAMPLER,
+						      0);
+			assert(ret == 0);
+		}
+		ret = drm_intel_bo_subdata(batch, relocs * 4, 4, &end);
+		assert(ret == 0);
+		ret = drm_intel_bo_exec(batch, relocs * 4 + 8, NULL, 0, 0);
+		assert(ret == 0);
+
+		drm_intel_bo_unreference(batch);
+		for (i = 0; i < TRANSIENT_BOS; i++)
+			drm_intel_bo_unreference(transient[i]);
+
+		/* The first frame fills the caches */
+		if (n > 0)
+			frame_mallocs += mallocs - before;
+	}
+	printf("%d frames, %d batch relocations: %.1f mallocs per frame, "
+	       "%zu bytes of heap peak\n", frames, relocs,
+	       frames > 1 ? (double)frame_mallocs / (frames - 1) : 0.0,
+	       heap_peak - base);
+
+	for (i = 0; i < num_state; i++)
+		drm_intel_bo_unreference(state[i]);
+	free(state);
+	drm_intel_bo_unreference(target);
+	drm_intel_bufmgr_destroy(bufmgr);
+	mockdrm_close(fd);
+
+	return 0;
+}
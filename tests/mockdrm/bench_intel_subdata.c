@@ -0,0 +1,160 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Measures the throughput of uploading many small ranges into a buffer
+ * object: one drm_intel_bo_subdata() per range, drm_intel_bo_subdata_v()
+ * on an unmapped buffer, and drm_intel_bo_subdata_v() on a buffer that is
+ * kept mapped.
+ *
+ * Usage: bench_intel_subdata [-a] [-i iterations]
+ *
+ *   -a  make the ranges adjacent in the buffer, from scattered memory
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+enum mode {
+	MODE_LOOP,
+	MODE_VECTOR,
+	MODE_MAPPED,
+};
+
+static double
+run(drm_intel_bufmgr *bufmgr, enum mode mode, int count, int size,
+    int adjacent, int iterations)
+{
+	drm_intel_bo_region *regions;
+	drm_intel_bo *bo;
+	uint64_t start, elapsed;
+	char *src;
+	int i, n, ret;
+
+	/* Leave gaps between the ranges in memory, and in the buffer
+	 * unless they are to be adjacent.
+	 */
+	src = calloc(count, 2 * size);
+	regions = calloc(count, sizeof(*regions));
+	assert(src != NULL && regions != NULL);
+	for (i = 0; i < count; i++) {
+		regions[i].offset = (unsigned long)i * (adjacent ? 1 : 2) * size;
+		regions[i].size = size;
+		regions[i].data = src + (unsigned long)i * 2 * size;
+	}
+
+	bo = drm_intel_bo_alloc(bufmgr, "upload", (unsigned long)count * 2 * size,
+				4096);
+	assert(bo != NULL);
+	if (mode == MODE_MAPPED) {
+		ret = drm_intel_bo_map(bo, 1);
+		assert(ret == 0);
+	}
+
+	start = mockdrm_time_ns();
+	for (n = 0; n < iterations; n++) {
+		if (mode == MODE_LOOP) {
+			for (i = 0; i < count; i++) {
+				ret = drm_intel_bo_subdata(bo,
+							   regions[i].offset,
+							   size,
+							   regions[i].data);
+				assert(ret == 0);
+			}
+		} else {
+			ret = drm_intel_bo_subdata_v(bo, regions, count);
+			assert(ret >= 0);
+			assert((ret == 0) == (mode == MODE_MAPPED));
+		}
+	}
+	elapsed = mockdrm_time_ns() - start;
+
+	if (mode == MODE_MAPPED)
+		drm_intel_bo_unmap(bo);
+	drm_intel_bo_unreference(bo);
+	free(regions);
+	free(src);
+
+	/* MB/s */
+	return (double)count * size * iterations * 1000 / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	static const int counts[] = { 16, 256, 4096 };
+	static const int sizes[] = { 16, 256, 4096 };
+	drm_intel_bufmgr *bufmgr;
+	int iterations = 20, adjacent = 0;
+	unsigned int i, j;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "ai:")) != -1) {
+		switch (c) {
+		case 'a':
+			adjacent = 1;
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-a] [-i iterations]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+
+	printf("%d iterations, %s ranges, MB/s\n", iterations,
+	       adjacent ? "adjacent" : "separate");
+	printf("%8s %8s %12s %12s %12s\n",
+	       "ranges", "size", "subdata", "subdata_v", "mapped");
+	for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		for (j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++) {
+			printf("%8d %8d %12.1f %12.1f %12.1f\n",
+			       counts[i], sizes[j],
+			       run(bufmgr, MODE_LOOP, counts[i], sizes[j],
+				   adjacent, iterations),
+			       run(bufmgr, MODE_VECTOR, counts[i], sizes[j],
+				   adjacent, iterations),
+			       run(bufmgr, MODE_MAPPED, counts[i], sizes[j],
+				   adjacent, iterations));
+		}
+	}
+
+	drm_intel_bufmgr_destroy(bufmgr);
+	mockdrm_close(fd);
+
+	return 0;
+}
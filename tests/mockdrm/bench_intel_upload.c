@@ -0,0 +1,187 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Measures streaming small uploads (vertices, constants) into buffers
+ * referenced by a batch, one batch per frame: a new buffer filled with
+ * drm_intel_bo_subdata() per upload, a new buffer mapped and written per
+ * upload, or space carved out of a drm_intel_upload_ring.  Buffers are
+ * kept busy for a while after each batch.
+ *
+ * Usage: bench_intel_upload [-g gpu_time_ns] [-n uploads] [-s size]
+ *                           [-i iterations]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+#define MI_BATCH_BUFFER_END	(0xA << 23)
+
+enum mode {
+	MODE_SUBDATA,
+	MODE_MAP,
+	MODE_RING,
+};
+
+static const char *mode_names[] = { "subdata", "map", "ring" };
+
+static void
+run(int fd, enum mode mode, int uploads, int size, int iterations)
+{
+	struct mockdrm_stats stats;
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_upload_ring *ring = NULL;
+	uint32_t end = MI_BATCH_BUFFER_END;
+	uint64_t start, elapsed;
+	char *data;
+	int i, n, ret;
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	if (mode == MODE_RING) {
+		ring = drm_intel_gem_upload_ring_create(bufmgr, "upload",
+							4 * uploads * size +
+							4 * 4096, 4);
+		assert(ring != NULL);
+	}
+
+	data = malloc(size);
+	assert(data != NULL);
+	memset(data, 0x5a, size);
+
+	mockdrm_reset_stats();
+	start = mockdrm_time_ns();
+	for (n = 0; n < iterations; n++) {
+		drm_intel_bo *batch;
+
+		batch = drm_intel_bo_alloc(bufmgr, "batch", uploads * 4 + 8,
+					   4096);
+		assert(batch != NULL);
+		for (i = 0; i < uploads; i++) {
+			drm_intel_bo *bo;
+			uint32_t offset = 0;
+			void *ptr;
+
+			switch (mode) {
+			case MODE_SUBDATA:
+				bo = drm_intel_bo_alloc(bufmgr, "upload", size,
+							64);
+				assert(bo != NULL);
+				ret = drm_intel_bo_subdata(bo, 0, size, data);
+				assert(ret == 0);
+				break;
+			case MODE_MAP:
+				bo = drm_intel_bo_alloc(bufmgr, "upload", size,
+							64);
+				assert(bo != NULL);
+				ret = drm_intel_bo_map(bo, 1);
+				assert(ret == 0);
+				memcpy(bo->virtual, data, size);
+				drm_intel_bo_unmap(bo);
+				break;
+			default:
+				ptr = drm_intel_gem_upload_ring_alloc(ring, size,
+								      64,
+								      &offset);
+				assert(ptr != NULL);
+				memcpy(ptr, data, size);
+				bo = drm_intel_gem_upload_ring_get_bo(ring);
+				drm_intel_bo_reference(bo);
+				break;
+			}
+
+			ret = drm_intel_bo_emit_reloc(batch, i * 4, bo, offset,
+						      I915_GEM_DOMAIN_VERTEX,
+						      0);
+			assert(ret == 0);
+			drm_intel_bo_unreference(bo);
+		}
+		ret = drm_intel_bo_subdata(batch, uploads * 4, 4, &end);
+		assert(ret == 0);
+		ret = drm_intel_bo_exec(batch, uploads * 4 + 8, NULL, 0, 0);
+		assert(ret == 0);
+		drm_intel_bo_unreference(batch);
+	}
+	elapsed = mockdrm_time_ns() - start;
+	mockdrm_get_stats(&stats);
+
+	printf("%-8s %8d %8d %12.0f %12.2f %8lu\n", mode_names[mode],
+	       uploads, size, (double)elapsed / iterations / uploads,
+	       (double)stats.ioctls / iterations / uploads, stats.stalls);
+
+	free(data);
+	drm_intel_gem_upload_ring_destroy(ring);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+int main(int argc, char **argv)
+{
+	int uploads = 64, size = 256, iterations = 1000;
+	unsigned int gpu_time = 100000;
+	int fd, c, mode;
+
+	while ((c = getopt(argc, argv, "g:n:s:i:")) != -1) {
+		switch (c) {
+		case 'g':
+			gpu_time = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			uploads = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-g gpu_time_ns] [-n uploads] "
+				"[-s size] [-i iterations]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+	mockdrm_set_gpu_time(gpu_time);
+
+	printf("%d iterations, gpu time %u ns\n", iterations, gpu_time);
+	printf("%-8s %8s %8s %12s %12s %8s\n", "mode", "uploads", "size",
+	       "ns/upload", "ioctls/upl", "stalls");
+	for (mode = MODE_SUBDATA; mode <= MODE_RING; mode++)
+		run(fd, mode, uploads, size, iterations);
+
+	mockdrm_close(fd);
+
+	return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Measures handing client memory to the GPU, one batch per buffer: copied
+ * into a new buffer with drm_intel_bo_subdata(), as drivers do without
+ * userptr and as drm_intel_bo_alloc_userptr() falls back to, or wrapped
+ * in place by drm_intel_bo_alloc_userptr().  With -r, the results are
+ * also brought back into client memory after the batch.
+ *
+ * Usage: bench_intel_userptr [-g gpu_time_ns] [-s size] [-i iterations]
+ *                            [-r]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+#define MI_BATCH_BUFFER_END	(0xA << 23)
+
+enum mode {
+	MODE_COPY,
+	MODE_WRAP,
+};
+
+static const char *mode_names[] = { "copy", "wrap" };
+
+static void
+run(int fd, enum mode mode, unsigned long size, int iterations, int readback)
+{
+	struct mockdrm_stats stats;
+	drm_intel_bufmgr *bufmgr;
+	uint32_t cmds[2] = { 0, MI_BATCH_BUFFER_END };
+	uint64_t start, elapsed;
+	void *data;
+	int n, ret;
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	ret = posix_memalign(&data, 4096, size);
+	assert(ret == 0);
+	memset(data, 0x5a, size);
+
+	mockdrm_reset_stats();
+	start = mockdrm_time_ns();
+	for (n = 0; n < iterations; n++) {
+		drm_intel_bo *batch, *bo;
+
+		if (mode == MODE_COPY) {
+			bo = drm_intel_bo_alloc(bufmgr, "client", size, 4096);
+			assert(bo != NULL);
+			ret = drm_intel_bo_subdata(bo, 0, size, data);
+			assert(ret == 0);
+		} else {
+			bo = drm_intel_bo_alloc_userptr(bufmgr, "client", data,
+							size, 0);
+			assert(bo != NULL && drm_intel_bo_is_userptr(bo));
+		}
+
+		batch = drm_intel_bo_alloc(bufmgr, "batch", 4096, 4096);
+		assert(batch != NULL);
+		ret = drm_intel_bo_subdata(batch, 0, sizeof(cmds), cmds);
+		assert(ret == 0);
+		ret = drm_intel_bo_emit_reloc(batch, 0, bo, 0,
+					      I915_GEM_DOMAIN_RENDER,
+					      I915_GEM_DOMAIN_RENDER);
+		assert(ret == 0);
+		ret = drm_intel_bo_exec(batch, sizeof(cmds), NULL, 0, 0);
+		assert(ret == 0);
+
+		if (readback && mode == MODE_COPY) {
+			ret = drm_intel_bo_get_subdata(bo, 0, size, data);
+			assert(ret == 0);
+		} else if (readback) {
+			drm_intel_bo_wait_rendering(bo);
+		}
+
+		drm_intel_bo_unreference(batch);
+		drm_intel_bo_unreference(bo);
+	}
+	elapsed = mockdrm_time_ns() - start;
+	mockdrm_get_stats(&stats);
+
+	printf("%-8s %10lu %12.0f %10.0f %8.2f %8lu\n", mode_names[mode],
+	       size, (double)elapsed / iterations,
+	       (double)size * iterations * 1000 / elapsed,
+	       (double)stats.ioctls / iterations, stats.stalls);
+
+	free(data);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned long sizes[] = {
+		64 * 1024, 1024 * 1024, 16 * 1024 * 1024
+	};
+	unsigned long size = 0;
+	int iterations = 200, readback = 0;
+	unsigned int gpu_time = 0;
+	int fd, c, i, mode;
+
+	while ((c = getopt(argc, argv, "g:s:i:r")) != -1) {
+		switch (c) {
+		case 'g':
+			gpu_time = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'r':
+			readback = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-g gpu_time_ns] [-s size] "
+				"[-i iterations] [-r]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+	mockdrm_set_gpu_time(gpu_time);
+
+	printf("%d iterations, gpu time %u ns%s\n", iterations, gpu_time,
+	       readback ? ", with readback" : "");
+	printf("%-8s %10s %12s %10s %8s %8s\n", "mode", "size", "ns/buffer",
+	       "MB/s", "ioctls", "stalls");
+	for (i = 0; i < 3; i++) {
+		if (size != 0 && i > 0)
+			break;
+		for (mode = MODE_COPY; mode <= MODE_WRAP; mode++)
+			run(fd, mode, size ? size : sizes[i], iterations,
+			    readback);
+	}
+
+	mockdrm_close(fd);
+
+	return 0;
+}
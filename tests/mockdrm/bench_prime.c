@@ -0,0 +1,136 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Imports the same set of dma-bufs every frame, the way a compositor
+ * receives its clients' buffers, with and without the PRIME import cache.
+ * Each import costs an ioctl plus -l nanoseconds of simulated kernel time
+ * without the cache, and an fstat() and a hash lookup with it.
+ *
+ * Usage: bench_prime [-b buffers] [-f frames] [-l latency_ns]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+#include "xf86drm.h"
+#include "mockdrm.h"
+
+static double
+run(int fd, const int *prime_fds, int buffers, int frames, int cache,
+    unsigned long *ioctls)
+{
+	uint64_t start, elapsed;
+	unsigned long before;
+	uint32_t handle;
+	int i, j, ret;
+
+	ret = drmPrimeEnableHandleCache(fd, cache);
+	assert(ret == 0);
+
+	before = mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE);
+	start = mockdrm_time_ns();
+	for (i = 0; i < frames; i++) {
+		for (j = 0; j < buffers; j++) {
+			ret = drmPrimeFDToHandle(fd, prime_fds[j], &handle);
+			assert(ret == 0);
+		}
+	}
+	elapsed = mockdrm_time_ns() - start;
+	*ioctls = mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE) - before;
+
+	drmPrimeEnableHandleCache(fd, 0);
+
+	/* ns per import */
+	return (double)elapsed / ((double)frames * buffers);
+}
+
+int main(int argc, char **argv)
+{
+	struct drm_mode_create_dumb create;
+	int buffers = 8, frames = 20000, latency = 0;
+	unsigned long ioctls_off, ioctls_on;
+	double off, on;
+	int client, server, *prime_fds;
+	int c, i, ret;
+
+	while ((c = getopt(argc, argv, "b:f:l:")) != -1) {
+		switch (c) {
+		case 'b':
+			buffers = atoi(optarg);
+			break;
+		case 'f':
+			frames = atoi(optarg);
+			break;
+		case 'l':
+			latency = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-b buffers] [-f frames] "
+				"[-l latency_ns]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	client = mockdrm_open("mock");
+	server = mockdrm_open("mock");
+	assert(client >= 0 && server >= 0);
+	prime_fds = calloc(buffers, sizeof(*prime_fds));
+	assert(prime_fds != NULL);
+
+	for (i = 0; i < buffers; i++) {
+		memset(&create, 0, sizeof(create));
+		create.width = 256;
+		create.height = 256;
+		create.bpp = 32;
+		ret = drmIoctl(client, DRM_IOCTL_MODE_CREATE_DUMB, &create);
+		assert(ret == 0);
+		ret = drmPrimeHandleToFD(client, create.handle, DRM_CLOEXEC,
+					 &prime_fds[i]);
+		assert(ret == 0);
+	}
+
+	mockdrm_set_latency(DRM_IOCTL_PRIME_FD_TO_HANDLE, latency);
+	off = run(server, prime_fds, buffers, frames, 0, &ioctls_off);
+	on = run(server, prime_fds, buffers, frames, 1, &ioctls_on);
+
+	printf("%d buffers x %d frames, %d ns per import ioctl\n",
+	       buffers, frames, latency);
+	printf("%10s %12s %12s\n", "cache", "ns/import", "ioctls");
+	printf("%10s %12.1f %12lu\n", "off", off, ioctls_off);
+	printf("%10s %12.1f %12lu\n", "on", on, ioctls_on);
+
+	for (i = 0; i < buffers; i++)
+		close(prime_fds[i]);
+	free(prime_fds);
+	mockdrm_close(server);
+	mockdrm_close(client);
+
+	return 0;
+}
@@ -0,0 +1,527 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "xf86drm.h"
+#include "xf86drmMode.h"
+#include "mockdrm.h"
+
+static void
+test_version(int fd)
+{
+	drmVersionPtr version;
+
+	printf("Testing version.\n");
+
+	version = drmGetVersion(fd);
+	assert(version != NULL);
+	assert(strcmp(version->name, "mock") == 0);
+	drmFreeVersion(version);
+}
+
+static void
+test_modeset(int fd)
+{
+	drmModeResPtr res;
+	drmModeConnectorPtr connector;
+	drmModeEncoderPtr encoder;
+	drmModeCrtcPtr crtc;
+	int i, ret;
+
+	printf("Testing mode resources.\n");
+
+	res = drmModeGetResources(fd);
+	assert(res != NULL);
+	assert(res->count_crtcs == 2);
+	assert(res->count_connectors == 2);
+
+	for (i = 0; i < res->count_connectors; i++) {
+		connector = drmModeGetConnector(fd, res->connectors[i]);
+		assert(connector != NULL);
+		assert(connector->connection == DRM_MODE_CONNECTED);
+		assert(connector->count_modes == 1);
+
+		encoder = drmModeGetEncoder(fd, connector->encoder_id);
+		assert(encoder != NULL);
+
+		ret = drmModeSetCrtc(fd, encoder->crtc_id, 0, 0, 0,
+				     &connector->connector_id, 1,
+				     &connector->modes[0]);
+		assert(ret == 0);
+
+		crtc = drmModeGetCrtc(fd, encoder->crtc_id);
+		assert(crtc != NULL);
+		assert(crtc->mode_valid);
+		assert(crtc->mode.hdisplay == connector->modes[0].hdisplay);
+
+		drmModeFreeCrtc(crtc);
+		drmModeFreeEncoder(encoder);
+		drmModeFreeConnector(connector);
+	}
+
+	drmModeFreeResources(res);
+}
+
+static void
+test_dumb(int fd)
+{
+	struct drm_mode_create_dumb create;
+	struct drm_mode_map_dumb map;
+	struct drm_mode_destroy_dumb destroy;
+	struct drm_gem_flink flink;
+	struct drm_gem_open open_arg;
+	uint32_t *ptr, *ptr2, fb_id;
+	drmModeCrtcPtr crtc;
+	drmModeResPtr res;
+	int fd2, ret;
+
+	printf("Testing dumb buffers and framebuffers.\n");
+
+	memset(&create, 0, sizeof(create));
+	create.width = 640;
+	create.height = 480;
+	create.bpp = 32;
+	ret = drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &create);
+	assert(ret == 0);
+	assert(create.pitch >= 640 * 4);
+
+	memset(&map, 0, sizeof(map));
+	map.handle = create.handle;
+	ret = drmIoctl(fd, DRM_IOCTL_MODE_MAP_DUMB, &map);
+	assert(ret == 0);
+
+	ptr = mmap(NULL, create.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   fd, map.offset);
+	assert(ptr != MAP_FAILED);
+	ptr[0] = 0xdeadbeef;
+
+	/* The object is shared with a second client through its name. */
+	flink.handle = create.handle;
+	ret = drmIoctl(fd, DRM_IOCTL_GEM_FLINK, &flink);
+	assert(ret == 0);
+
+	fd2 = mockdrm_open("mock");
+	assert(fd2 >= 0);
+	open_arg.name = flink.name;
+	ret = drmIoctl(fd2, DRM_IOCTL_GEM_OPEN, &open_arg);
+	assert(ret == 0);
+	assert(open_arg.size >= create.size);
+
+	map.handle = open_arg.handle;
+	ret = drmIoctl(fd2, DRM_IOCTL_MODE_MAP_DUMB, &map);
+	assert(ret == 0);
+	ptr2 = mmap(NULL, create.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd2, map.offset);
+	assert(ptr2 != MAP_FAILED);
+	assert(ptr2[0] == 0xdeadbeef);
+	munmap(ptr2, create.size);
+	mockdrm_close(fd2);
+
+	ret = drmModeAddFB(fd, 640, 480, 24, 32, create.pitch, create.handle,
+			   &fb_id);
+	assert(ret == 0);
+
+	res = drmModeGetResources(fd);
+	assert(res != NULL);
+	ret = drmModeSetCrtc(fd, res->crtcs[0], fb_id, 0, 0, NULL, 0, NULL);
+	assert(ret == 0);
+	ret = drmModePageFlip(fd, res->crtcs[0], fb_id, 0, NULL);
+	assert(ret == 0);
+	crtc = drmModeGetCrtc(fd, res->crtcs[0]);
+	assert(crtc != NULL && crtc->buffer_id == fb_id);
+	drmModeFreeCrtc(crtc);
+	drmModeFreeResources(res);
+
+	ret = drmModeRmFB(fd, fb_id);
+	assert(ret == 0);
+	ret = drmModeRmFB(fd, fb_id);
+	assert(ret == -EINVAL);
+
+	munmap(ptr, create.size);
+	destroy.handle = create.handle;
+	ret = drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+	assert(ret == 0);
+	ret = drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+	assert(ret == -1 && errno == EINVAL);
+}
+
+static void
+test_latency(int fd)
+{
+	struct mockdrm_stats stats;
+	uint64_t start, elapsed;
+	drmVersionPtr version;
+	int i;
+
+	printf("Testing latency injection.\n");
+
+	mockdrm_reset_stats();
+	mockdrm_set_latency(DRM_IOCTL_VERSION, 200000);
+
+	start = mockdrm_time_ns();
+	for (i = 0; i < 5; i++) {
+		version = drmGetVersion(fd);
+		assert(version != NULL);
+		drmFreeVersion(version);
+	}
+	elapsed = mockdrm_time_ns() - start;
+
+	/* drmGetVersion() issues the ioctl twice: once for the sizes and
+	 * once for the strings.
+	 */
+	assert(mockdrm_ioctl_count(DRM_IOCTL_VERSION) == 10);
+	assert(elapsed >= 10 * 200000);
+
+	mockdrm_get_stats(&stats);
+	assert(stats.ioctls == 10);
+
+	mockdrm_set_latency(DRM_IOCTL_VERSION, 0);
+}
+
+static void
+test_ioctl_stats(int fd)
+{
+	drmIoctlStats stats[4];
+	drmVersionPtr version;
+	uint64_t value;
+	int i, n, found = 0;
+
+	printf("Testing ioctl statistics.\n");
+
+	drmResetIoctlStats();
+	drmSetIoctlStats(1);
+
+	version = drmGetVersion(fd);
+	assert(version != NULL);
+	drmFreeVersion(version);
+	assert(drmGetCap(fd, 0xdead, &value) != 0);
+
+	drmSetIoctlStats(0);
+	version = drmGetVersion(fd);
+	drmFreeVersion(version);
+
+	n = drmGetIoctlStats(NULL, 0);
+	assert(n == 2);
+	n = drmGetIoctlStats(stats, 4);
+	assert(n == 2);
+
+	for (i = 0; i < n; i++) {
+		if (stats[i].request == DRM_IOCTL_VERSION) {
+			assert(stats[i].count == 2);
+			assert(stats[i].errors == 0);
+			found++;
+		} else if (stats[i].request == DRM_IOCTL_GET_CAP) {
+			assert(stats[i].count == 1);
+			assert(stats[i].errors == 1);
+			assert(stats[i].last_errno == EINVAL);
+			found++;
+		}
+		assert(stats[i].retries == 0);
+		assert(stats[i].total_ns >= stats[i].max_ns);
+	}
+	assert(found == 2);
+
+	drmResetIoctlStats();
+	assert(drmGetIoctlStats(NULL, 0) == 0);
+}
+
+static void *
+prime_cache_worker(void *data)
+{
+	int prime_fd = *(int *)data;
+	uint32_t handle;
+	int fds[16], i, j, ret;
+
+	/* Enough fds for some of them to share a bucket of the cache table */
+	for (j = 0; j < 16; j++) {
+		fds[j] = mockdrm_open("mock");
+		assert(fds[j] >= 0);
+	}
+	for (i = 0; i < 1000; i++) {
+		for (j = 0; j < 16; j++) {
+			ret = drmPrimeEnableHandleCache(fds[j], 1);
+			assert(ret == 0);
+		}
+		j = i % 16;
+		ret = drmPrimeFDToHandle(fds[j], prime_fd, &handle);
+		assert(ret == 0);
+		ret = drmCloseBufferHandle(fds[j], handle);
+		assert(ret == 0);
+		for (j = 0; j < 16; j++) {
+			ret = drmPrimeEnableHandleCache(fds[j], 0);
+			assert(ret == 0);
+		}
+	}
+	for (j = 0; j < 16; j++)
+		mockdrm_close(fds[j]);
+
+	return NULL;
+}
+
+static void
+test_prime(int fd)
+{
+	struct drm_mode_create_dumb create, create2;
+	struct drm_mode_destroy_dumb destroy;
+	struct stat st, st2;
+	uint32_t handle, handle2, handle3;
+	unsigned long imports;
+	pthread_t threads[4];
+	int fd2, prime_fd, pipe_fds[2], anon_fds[2], i, ret;
+
+	printf("Testing PRIME helpers and the import cache.\n");
+
+	memset(&create, 0, sizeof(create));
+	create.width = 64;
+	create.height = 64;
+	create.bpp = 32;
+	ret = drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &create);
+	assert(ret == 0);
+	ret = drmPrimeHandleToFD(fd, create.handle, DRM_CLOEXEC, &prime_fd);
+	assert(ret == 0 && prime_fd >= 0);
+
+	/* Without the cache every import is an ioctl */
+	fd2 = mockdrm_open("mock");
+	assert(fd2 >= 0);
+	imports = mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE);
+	ret = drmPrimeFDToHandle(fd2, prime_fd, &handle);
+	assert(ret == 0);
+	ret = drmPrimeFDToHandle(fd2, prime_fd, &handle2);
+	assert(ret == 0 && handle2 == handle);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE) ==
+	       imports + 2);
+
+	/* With it, only the first one */
+	ret = drmPrimeEnableHandleCache(fd2, 1);
+	assert(ret == 0);
+	ret = drmPrimeFDToHandle(fd2, prime_fd, &handle2);
+	assert(ret == 0 && handle2 == handle);
+	ret = drmPrimeFDToHandle(fd2, prime_fd, &handle2);
+	assert(ret == 0 && handle2 == handle);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE) ==
+	       imports + 3);
+
+	/* Closing the handle drops the entry */
+	ret = drmCloseBufferHandle(fd2, handle);
+	assert(ret == 0);
+	ret = drmPrimeFDToHandle(fd2, prime_fd, &handle3);
+	assert(ret == 0);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE) ==
+	       imports + 4);
+
+	/* Anything that isn't a dma-buf still goes to the kernel */
+	ret = pipe(pipe_fds);
+	assert(ret == 0);
+	ret = drmPrimeFDToHandle(fd2, pipe_fds[0], &handle2);
+	assert(ret == -1 && errno == EINVAL);
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+
+	ret = drmPrimeEnableHandleCache(fd2, 0);
+	assert(ret == 0);
+	ret = drmPrimeFDToHandle(fd2, prime_fd, &handle2);
+	assert(ret == 0 && handle2 == handle3);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE) ==
+	       imports + 6);
+	mockdrm_close(fd2);
+
+	/* The caches of different fds are used from different threads */
+	for (i = 0; i < 4; i++) {
+		ret = pthread_create(&threads[i], NULL, prime_cache_worker,
+				     &prime_fd);
+		assert(ret == 0);
+	}
+	for (i = 0; i < 4; i++)
+		pthread_join(threads[i], NULL);
+
+	/* Where all dma-bufs share one inode, it can't identify them */
+	mockdrm_set_anon_dmabufs(1);
+	create2 = create;
+	ret = drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &create2);
+	assert(ret == 0);
+	ret = drmPrimeHandleToFD(fd, create.handle, 0, &anon_fds[0]);
+	assert(ret == 0);
+	ret = drmPrimeHandleToFD(fd, create2.handle, 0, &anon_fds[1]);
+	assert(ret == 0);
+	ret = fstat(anon_fds[0], &st);
+	assert(ret == 0);
+	ret = fstat(anon_fds[1], &st2);
+	assert(ret == 0 && st2.st_ino == st.st_ino);
+
+	fd2 = mockdrm_open("mock");
+	assert(fd2 >= 0);
+	ret = drmPrimeEnableHandleCache(fd2, 1);
+	assert(ret == -ENOSYS);
+	ret = drmPrimeFDToHandle(fd2, anon_fds[0], &handle);
+	assert(ret == 0);
+	ret = drmPrimeFDToHandle(fd2, anon_fds[1], &handle2);
+	assert(ret == 0 && handle2 != handle);
+	mockdrm_close(fd2);
+	close(anon_fds[0]);
+	close(anon_fds[1]);
+	mockdrm_set_anon_dmabufs(0);
+	ret = drmCloseBufferHandle(fd, create2.handle);
+	assert(ret == 0);
+
+	/* An export is cached as well, for importing it back */
+	ret = drmPrimeEnableHandleCache(fd, 1);
+	assert(ret == 0);
+	close(prime_fd);
+	ret = drmPrimeHandleToFD(fd, create.handle, 0, &prime_fd);
+	assert(ret == 0);
+	imports = mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE);
+	ret = drmPrimeFDToHandle(fd, prime_fd, &handle);
+	assert(ret == 0 && handle == create.handle);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE) == imports);
+
+	/* Dumb buffers are forgotten before being destroyed */
+	drmPrimeForgetHandle(fd, create.handle);
+	ret = drmPrimeFDToHandle(fd, prime_fd, &handle);
+	assert(ret == 0 && handle == create.handle);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_PRIME_FD_TO_HANDLE) ==
+	       imports + 1);
+	close(prime_fd);
+
+	drmPrimeForgetHandle(fd, create.handle);
+	memset(&destroy, 0, sizeof(destroy));
+	destroy.handle = create.handle;
+	ret = drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+	assert(ret == 0);
+	drmPrimeEnableHandleCache(fd, 0);
+}
+
+static int
+poll_busy(void *data)
+{
+	int *calls = data;
+
+	return ++*calls < 4 ? -EBUSY : 0;
+}
+
+static int
+poll_always_busy(void *data)
+{
+	++*(int *)data;
+	return -EBUSY;
+}
+
+static void
+test_poll_busy(void)
+{
+	uint64_t start, elapsed;
+	int calls, ret;
+
+	printf("Testing busy polling.\n");
+
+	calls = 0;
+	ret = drmPollBusy(poll_busy, &calls, -1);
+	assert(ret == 0 && calls == 4);
+
+	calls = 0;
+	ret = drmPollBusy(poll_always_busy, &calls, 0);
+	assert(ret == -ETIME && calls == 1);
+
+	/* Sleeps in between, but checks once more at the deadline */
+	calls = 0;
+	start = mockdrm_time_ns();
+	ret = drmPollBusy(poll_always_busy, &calls, 5000000);
+	elapsed = mockdrm_time_ns() - start;
+	assert(ret == -ETIME);
+	assert(elapsed >= 5000000 && elapsed < 100000000);
+	assert(calls > 2 && calls < 1000);
+}
+
+static void
+test_copy(void)
+{
+	static const size_t sizes[] = { 0, 1, 15, 127, 128, 129, 191, 4096, 5003 };
+	unsigned char *src, *dst, *ref;
+	size_t len = 5003 + 64 + 32;
+	unsigned int i, s, d, dir;
+
+	printf("Testing WC copy routines.\n");
+
+	src = malloc(len);
+	dst = malloc(len);
+	ref = malloc(len);
+	assert(src != NULL && dst != NULL && ref != NULL);
+	for (i = 0; i < len; i++)
+		src[i] = i * 7 + 1;
+
+	/* Every alignment of source and destination, each direction, and
+	 * nothing written past the end.
+	 */
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (s = 0; s < 32; s += 3) {
+			for (d = 0; d < 32; d += 5) {
+				for (dir = 0; dir < 2; dir++) {
+					memset(dst, 0xee, len);
+					memset(ref, 0xee, len);
+					memcpy(ref + d, src + s, sizes[i]);
+					if (dir)
+						drmMemcpyFromWC(dst + d, src + s,
+								sizes[i]);
+					else
+						drmMemcpyToWC(dst + d, src + s,
+							      sizes[i]);
+					assert(memcmp(dst, ref, len) == 0);
+				}
+			}
+		}
+	}
+
+	free(src);
+	free(dst);
+	free(ref);
+}
+
+int main(int argc, char **argv)
+{
+	int fd;
+
+	fd = mockdrm_open("mock");
+	assert(fd >= 0);
+
+	test_version(fd);
+	test_modeset(fd);
+	test_dumb(fd);
+	test_latency(fd);
+	test_ioctl_stats(fd);
+	test_prime(fd);
+	test_poll_busy();
+	test_copy();
+
+	mockdrm_close(fd);
+
+	return 0;
+}
@@ -0,0 +1,1713 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_bufmgr.h"
+#include "mockdrm.h"
+
+#define MI_BATCH_BUFFER_END	(0xA << 23)
+#define MI_NOOP			0
+
+static void
+test_bo(drm_intel_bufmgr *bufmgr, int fd)
+{
+	drm_intel_bufmgr *bufmgr2;
+	drm_intel_bo *bo, *bo2;
+	uint32_t data[1024], name;
+	int fd2, ret;
+
+	printf("Testing bo access paths.\n");
+
+	bo = drm_intel_bo_alloc(bufmgr, "test", sizeof(data), 4096);
+	assert(bo != NULL);
+
+	memset(data, 0x3c, sizeof(data));
+	ret = drm_intel_bo_subdata(bo, 0, sizeof(data), data);
+	assert(ret == 0);
+
+	ret = drm_intel_bo_map(bo, 0);
+	assert(ret == 0);
+	assert(memcmp(bo->virtual, data, sizeof(data)) == 0);
+	drm_intel_bo_unmap(bo);
+
+	ret = drm_intel_gem_bo_map_gtt(bo);
+	assert(ret == 0);
+	((uint32_t *)bo->virtual)[0] = 0xc0ffee;
+	drm_intel_gem_bo_unmap_gtt(bo);
+
+	memset(data, 0, sizeof(data));
+	ret = drm_intel_bo_get_subdata(bo, 0, sizeof(data), data);
+	assert(ret == 0);
+	assert(data[0] == 0xc0ffee && data[1] == 0x3c3c3c3c);
+
+	ret = drm_intel_bo_flink(bo, &name);
+	assert(ret == 0);
+
+	fd2 = mockdrm_open("i915");
+	assert(fd2 >= 0);
+	bufmgr2 = drm_intel_bufmgr_gem_init(fd2, 4096);
+	assert(bufmgr2 != NULL);
+	bo2 = drm_intel_bo_gem_create_from_name(bufmgr2, "shared", name);
+	assert(bo2 != NULL);
+	ret = drm_intel_bo_get_subdata(bo2, 0, sizeof(data), data);
+	assert(ret == 0);
+	assert(data[0] == 0xc0ffee);
+	drm_intel_bo_unreference(bo2);
+	drm_intel_bufmgr_destroy(bufmgr2);
+	mockdrm_close(fd2);
+
+	drm_intel_bo_unreference(bo);
+}
+
+static void
+test_exec(drm_intel_bufmgr *bufmgr, int fd)
+{
+	struct mockdrm_stats stats;
+	drm_intel_bo *batch, *target;
+	uint32_t cmds[4];
+	int ret;
+
+	printf("Testing execbuffer and relocations.\n");
+
+	batch = drm_intel_bo_alloc(bufmgr, "batch", 4096, 4096);
+	target = drm_intel_bo_alloc(bufmgr, "target", 4096, 4096);
+	assert(batch != NULL && target != NULL);
+
+	cmds[0] = MI_NOOP;
+	cmds[1] = 0;
+	cmds[2] = MI_BATCH_BUFFER_END;
+	cmds[3] = MI_NOOP;
+	ret = drm_intel_bo_subdata(batch, 0, sizeof(cmds), cmds);
+	assert(ret == 0);
+	ret = drm_intel_bo_emit_reloc(batch, 4, target, 16,
+				      I915_GEM_DOMAIN_RENDER,
+				      I915_GEM_DOMAIN_RENDER);
+	assert(ret == 0);
+
+	mockdrm_reset_stats();
+	mockdrm_set_gpu_time(1000000000);
+
+	ret = drm_intel_bo_exec(batch, sizeof(cmds), NULL, 0, 0);
+	assert(ret == 0);
+
+	mockdrm_get_stats(&stats);
+	assert(stats.execs == 1);
+	assert(stats.relocs == 1);
+	assert(target->offset != 0);
+
+	assert(drm_intel_bo_busy(target));
+	mockdrm_set_gpu_time(0);
+
+	ret = drm_intel_bo_get_subdata(batch, 4, 4, cmds);
+	assert(ret == 0);
+	assert(cmds[0] == target->offset + 16);
+
+	drm_intel_bo_unreference(target);
+	drm_intel_bo_unreference(batch);
+}
+
+static void *
+thread_cache_worker(void *data)
+{
+	drm_intel_bufmgr *bufmgr = data;
+	drm_intel_bo *bo;
+
+	/* Our own cache is empty, so this has to come from what the main
+	 * thread flushed to the shared buckets.
+	 */
+	bo = drm_intel_bo_alloc(bufmgr, "worker", 4096, 4096);
+	assert(bo != NULL);
+	drm_intel_bo_unreference(bo);
+
+	return NULL;
+}
+
+static void
+test_thread_cache(int fd)
+{
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo_cache_stats stats;
+	drm_intel_bo *bo, *bos[16];
+	unsigned long creates;
+	pthread_t thread;
+	int i, ret;
+
+	printf("Testing per-thread bo cache.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	bo = drm_intel_bo_alloc(bufmgr, "a", 4096, 4096);
+	assert(bo != NULL);
+	drm_intel_bo_unreference(bo);
+	creates = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE);
+	assert(drm_intel_bo_alloc(bufmgr, "b", 4096, 4096) == bo);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE) == creates);
+	drm_intel_bo_unreference(bo);
+
+	drm_intel_bufmgr_gem_get_cache_stats(bufmgr, &stats);
+	assert(stats.hits == 1);
+	assert(stats.misses == 1);
+	assert(stats.steals == 0);
+
+	/* Overflow the thread cache into the shared buckets. */
+	for (i = 0; i < 16; i++) {
+		bos[i] = drm_intel_bo_alloc(bufmgr, "burst", 4096, 4096);
+		assert(bos[i] != NULL);
+	}
+	for (i = 0; i < 16; i++)
+		drm_intel_bo_unreference(bos[i]);
+
+	drm_intel_bufmgr_gem_get_cache_stats(bufmgr, &stats);
+	assert(stats.flushes > 0);
+
+	ret = pthread_create(&thread, NULL, thread_cache_worker, bufmgr);
+	assert(ret == 0);
+	pthread_join(thread, NULL);
+
+	drm_intel_bufmgr_gem_get_cache_stats(bufmgr, &stats);
+	assert(stats.steals == 1);
+
+	/* The kernel can still reclaim what sits in a thread cache */
+	bo = drm_intel_bo_alloc(bufmgr, "purgeable", 8192, 4096);
+	assert(bo != NULL);
+	drm_intel_bo_unreference(bo);
+	mockdrm_purge();
+	creates = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE);
+	bo = drm_intel_bo_alloc(bufmgr, "purgeable", 8192, 4096);
+	assert(bo != NULL);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE) == creates + 1);
+	drm_intel_bo_unreference(bo);
+
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+static void
+test_cache_classes(int fd)
+{
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo_cache_stats stats;
+	drm_intel_bo *bo;
+	unsigned long creates, size = 200 * 1024 * 1024 + 1;
+	int ret;
+
+	printf("Testing bo cache size classes.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	ret = drm_intel_bufmgr_gem_set_cache_classes(bufmgr, 3, 1 << 30);
+	assert(ret == -EINVAL);
+	ret = drm_intel_bufmgr_gem_set_cache_classes(bufmgr, 8, 512 << 20);
+	assert(ret == 0);
+
+	/* Beyond the old 112MB limit, rounded to 8 classes per doubling */
+	bo = drm_intel_bo_alloc(bufmgr, "large", size, 4096);
+	assert(bo != NULL);
+	assert(bo->size == 208 * 1024 * 1024);
+	drm_intel_bo_unreference(bo);
+
+	creates = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE);
+	assert(drm_intel_bo_alloc(bufmgr, "large", size, 4096) == bo);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE) == creates);
+	drm_intel_bo_unreference(bo);
+
+	drm_intel_bufmgr_gem_get_cache_stats(bufmgr, &stats);
+	assert(stats.cached_bytes == bo->size);
+	assert(stats.evictions == 0);
+
+	drm_intel_bufmgr_gem_set_cache_max_bytes(bufmgr, 64 * 1024 * 1024);
+	drm_intel_bufmgr_gem_get_cache_stats(bufmgr, &stats);
+	assert(stats.cached_bytes == 0);
+	assert(stats.evictions == 1);
+
+	/* The thread caches index the classes, so they are fixed by now. */
+	bo = drm_intel_bo_alloc(bufmgr, "small", 4096, 4096);
+	drm_intel_bo_unreference(bo);
+	ret = drm_intel_bufmgr_gem_set_cache_classes(bufmgr, 4, 1 << 20);
+	assert(ret == -EBUSY);
+
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+static void
+test_tiling_reuse(int fd)
+{
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo_cache_stats stats;
+	drm_intel_bo *linear, *tiled, *bo;
+	uint32_t tiling;
+	unsigned long pitch, set_tiling;
+	int i;
+
+	printf("Testing tiling-aware bo reuse.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	/* Once small enough for the thread cache, and once large enough
+	 * to go through the shared lists.
+	 */
+	for (i = 0; i < 2; i++) {
+		int height = i ? 1024 : 64;
+
+		tiling = I915_TILING_X;
+		tiled = drm_intel_bo_alloc_tiled(bufmgr, "x", 1024, height, 4,
+						 &tiling, &pitch, 0);
+		assert(tiled != NULL && tiling == I915_TILING_X);
+		linear = drm_intel_bo_alloc(bufmgr, "linear", tiled->size,
+					    4096);
+		assert(linear != NULL && linear->size == tiled->size);
+
+		/* Free the tiled one first, so the linear one is the MRU */
+		drm_intel_bo_unreference(tiled);
+		drm_intel_bo_unreference(linear);
+
+		set_tiling = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_SET_TILING);
+		bo = drm_intel_bo_alloc_tiled(bufmgr, "x", 1024, height, 4,
+					      &tiling, &pitch,
+					      BO_ALLOC_FOR_RENDER);
+		assert(bo == tiled);
+		bo = drm_intel_bo_alloc(bufmgr, "linear", tiled->size, 4096);
+		assert(bo == linear);
+		assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_SET_TILING) ==
+		       set_tiling);
+
+		drm_intel_bo_unreference(tiled);
+		drm_intel_bo_unreference(linear);
+	}
+
+	drm_intel_bufmgr_gem_get_cache_stats(bufmgr, &stats);
+	assert(stats.set_tiling_avoided >= 4);
+	assert(stats.set_tiling_needed == 0);
+
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+/* Byte by byte reference for drm_intel_bo_upload_tiled() */
+static unsigned long
+tiled_offset(uint32_t tiling, uint32_t swizzle, unsigned long stride,
+	     unsigned long x, unsigned long y)
+{
+	unsigned long tile_width = tiling == I915_TILING_X ? 512 : 128;
+	unsigned long tile_height = tiling == I915_TILING_X ? 8 : 32;
+	unsigned long tile, offset, bit = 0;
+
+	tile = y / tile_height * (stride / tile_width) + x / tile_width;
+	x %= tile_width;
+	y %= tile_height;
+	if (tiling == I915_TILING_X)
+		offset = tile * 4096 + y * 512 + x;
+	else
+		offset = tile * 4096 + x / 16 * 512 + y * 16 + x % 16;
+
+	switch (swizzle) {
+	case I915_BIT_6_SWIZZLE_9:
+		bit = offset >> 9;
+		break;
+	case I915_BIT_6_SWIZZLE_9_10:
+		bit = (offset >> 9) ^ (offset >> 10);
+		break;
+	case I915_BIT_6_SWIZZLE_9_11:
+		bit = (offset >> 9) ^ (offset >> 11);
+		break;
+	case I915_BIT_6_SWIZZLE_9_10_11:
+		bit = (offset >> 9) ^ (offset >> 10) ^ (offset >> 11);
+		break;
+	}
+	return offset ^ ((bit & 1) << 6);
+}
+
+static void
+test_tiled_copy(int fd)
+{
+	static const uint32_t swizzles[] = {
+		I915_BIT_6_SWIZZLE_NONE,
+		I915_BIT_6_SWIZZLE_9,
+		I915_BIT_6_SWIZZLE_9_10,
+		I915_BIT_6_SWIZZLE_9_11,
+		I915_BIT_6_SWIZZLE_9_10_11,
+	};
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *bo;
+	unsigned char *src, *dst, *expect;
+	uint32_t tiling, t, x = 37, y = 5, width = 700, height = 50;
+	uint32_t pitch = 768;
+	unsigned long stride;
+	unsigned int i, j, k;
+	int ret;
+
+	printf("Testing tiled upload and readback.\n");
+
+	/* Without reuse, so every buffer gets the swizzling set below */
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+
+	src = malloc(pitch * height);
+	dst = malloc(pitch * height);
+	assert(src != NULL && dst != NULL);
+	for (i = 0; i < pitch * height; i++)
+		src[i] = rand();
+
+	for (t = I915_TILING_X; t <= I915_TILING_Y; t++) {
+		for (k = 0; k < sizeof(swizzles) / sizeof(swizzles[0]); k++) {
+			mockdrm_set_swizzle(t, swizzles[k]);
+			tiling = t;
+			bo = drm_intel_bo_alloc_tiled(bufmgr, "tiled", 256, 64, 4,
+						      &tiling, &stride, 0);
+			assert(bo != NULL && tiling == t && stride == 1024);
+
+			expect = calloc(1, bo->size);
+			assert(expect != NULL);
+			for (j = 0; j < height; j++) {
+				for (i = 0; i < width; i++) {
+					expect[tiled_offset(t, swizzles[k],
+							    stride, x + i,
+							    y + j)] =
+						src[j * pitch + i];
+				}
+			}
+
+			ret = drm_intel_bo_map(bo, 1);
+			assert(ret == 0);
+			memset(bo->virtual, 0, bo->size);
+			drm_intel_bo_unmap(bo);
+
+			ret = drm_intel_bo_upload_tiled(bo, x, y, width, height,
+							src, pitch);
+			assert(ret == 0);
+
+			ret = drm_intel_bo_map(bo, 0);
+			assert(ret == 0);
+			assert(memcmp(bo->virtual, expect, bo->size) == 0);
+			drm_intel_bo_unmap(bo);
+
+			memset(dst, 0, pitch * height);
+			ret = drm_intel_bo_readback_tiled(bo, x, y, width,
+							  height, dst, pitch);
+			assert(ret == 0);
+			for (j = 0; j < height; j++)
+				assert(memcmp(dst + j * pitch, src + j * pitch,
+					      width) == 0);
+
+			assert(drm_intel_bo_upload_tiled(bo, 400, 0, 700, 1,
+							 src, pitch) ==
+			       -EINVAL);
+			assert(drm_intel_bo_upload_tiled(bo, 0, 60, 16, 5,
+							 src, pitch) ==
+			       -EINVAL);
+
+			free(expect);
+			drm_intel_bo_unreference(bo);
+		}
+		mockdrm_set_swizzle(t, I915_BIT_6_SWIZZLE_NONE);
+	}
+
+	/* Swizzling on physical addresses can't be done on the CPU */
+	mockdrm_set_swizzle(I915_TILING_X, I915_BIT_6_SWIZZLE_9_10_17);
+	tiling = I915_TILING_X;
+	bo = drm_intel_bo_alloc_tiled(bufmgr, "tiled", 256, 64, 4, &tiling,
+				      &stride, 0);
+	assert(bo != NULL);
+	assert(drm_intel_bo_upload_tiled(bo, 0, 0, 16, 1, src, pitch) ==
+	       -ENODEV);
+	drm_intel_bo_unreference(bo);
+	mockdrm_set_swizzle(I915_TILING_X, I915_BIT_6_SWIZZLE_NONE);
+
+	bo = drm_intel_bo_alloc(bufmgr, "linear", 4096, 4096);
+	assert(bo != NULL);
+	assert(drm_intel_bo_readback_tiled(bo, 0, 0, 16, 1, dst, pitch) ==
+	       -EINVAL);
+	drm_intel_bo_unreference(bo);
+
+	free(src);
+	free(dst);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+static void
+test_vma_cache(int fd)
+{
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo_vma_stats stats;
+	drm_intel_bo *bos[4];
+	int i, ret;
+
+	printf("Testing the mapping cache.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_set_vma_cache_bytes(bufmgr, 3 * 65536);
+
+	for (i = 0; i < 4; i++) {
+		bos[i] = drm_intel_bo_alloc(bufmgr, "vma", 65536, 4096);
+		assert(bos[i] != NULL);
+		ret = drm_intel_bo_map(bos[i], 1);
+		assert(ret == 0);
+		drm_intel_bo_unmap(bos[i]);
+	}
+	drm_intel_bufmgr_gem_get_vma_stats(bufmgr, &stats);
+	assert(stats.hits == 0 && stats.misses == 4 && stats.munmaps == 1);
+	assert(stats.cpu_bytes == 3 * 65536);
+	assert(stats.cached_cpu_bytes == 3 * 65536);
+
+	/* The least recently unmapped buffer was dropped, and buffers in
+	 * use count against the limit.
+	 */
+	ret = drm_intel_bo_map(bos[1], 0);
+	assert(ret == 0);
+	ret = drm_intel_bo_map(bos[0], 0);
+	assert(ret == 0);
+	drm_intel_bo_unmap(bos[0]);
+	drm_intel_bufmgr_gem_get_vma_stats(bufmgr, &stats);
+	assert(stats.hits == 1 && stats.misses == 5 && stats.munmaps == 2);
+	assert(stats.cpu_bytes == 3 * 65536);
+	assert(stats.cached_cpu_bytes == 2 * 65536);
+	drm_intel_bo_unmap(bos[1]);
+
+	/* GTT mappings share the same budget */
+	ret = drm_intel_gem_bo_map_gtt(bos[3]);
+	assert(ret == 0);
+	drm_intel_gem_bo_unmap_gtt(bos[3]);
+	drm_intel_bufmgr_gem_get_vma_stats(bufmgr, &stats);
+	assert(stats.hits == 1 && stats.misses == 6 && stats.munmaps == 3);
+	assert(stats.cpu_bytes == 2 * 65536 && stats.gtt_bytes == 65536);
+	assert(stats.cached_cpu_bytes == 2 * 65536);
+	assert(stats.cached_gtt_bytes == 65536);
+
+	drm_intel_bufmgr_gem_set_vma_cache_bytes(bufmgr, 65536);
+	drm_intel_bufmgr_gem_get_vma_stats(bufmgr, &stats);
+	assert(stats.munmaps == 6);
+	assert(stats.cpu_bytes == 0 && stats.gtt_bytes == 0);
+	assert(stats.cached_cpu_bytes == 0 && stats.cached_gtt_bytes == 0);
+
+	for (i = 0; i < 4; i++)
+		drm_intel_bo_unreference(bos[i]);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+static void
+test_alloc_array(int fd)
+{
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *bos[32], *cached[4];
+	unsigned long sizes[32], creates;
+	int i, j, ret;
+
+	printf("Testing batched bo allocation.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	/* A few cached buffers, both thread-local and shared sized */
+	for (i = 0; i < 4; i++) {
+		cached[i] = drm_intel_bo_alloc(bufmgr, "cached",
+					       i < 2 ? 8192 : 4 << 20, 4096);
+		assert(cached[i] != NULL);
+	}
+	for (i = 0; i < 4; i++)
+		drm_intel_bo_unreference(cached[i]);
+
+	for (i = 0; i < 32; i++)
+		sizes[i] = 4096;
+	sizes[1] = 8192;
+	sizes[8] = 4 << 20;
+
+	creates = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE);
+	ret = drm_intel_bo_alloc_array(bufmgr, "array", 32, sizes, 4096, bos);
+	assert(ret == 0);
+
+	/* Two of the requests are served by the cached buffers */
+	assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE) ==
+	       creates + 30);
+	for (i = 0; i < 32; i++) {
+		assert(bos[i] != NULL && bos[i]->size >= sizes[i]);
+		for (j = 0; j < i; j++)
+			assert(bos[j]->handle != bos[i]->handle);
+	}
+	assert(bos[1] == cached[0] || bos[1] == cached[1]);
+	assert(bos[8] == cached[2] || bos[8] == cached[3]);
+
+	ret = drm_intel_bo_subdata(bos[31], 0, sizeof(sizes), sizes);
+	assert(ret == 0);
+
+	/* Buffers sharing one block can be released in any order */
+	for (i = 0; i < 32; i += 2)
+		drm_intel_bo_unreference(bos[i]);
+	for (i = 1; i < 32; i += 2)
+		drm_intel_bo_unreference(bos[i]);
+
+	ret = drm_intel_bo_alloc_array(bufmgr, "none", 0, sizes, 4096, bos);
+	assert(ret == 0);
+
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+static void
+test_suballoc(int fd)
+{
+	struct mockdrm_stats stats;
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo_region region;
+	drm_intel_bo *batch, *bos[100], *big;
+	uint32_t cmds[2 * 100 + 2], data[64], tiling, name;
+	unsigned long creates;
+	int i, ret;
+
+	printf("Testing small bo sub-allocation.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	drm_intel_bufmgr_gem_enable_suballoc(bufmgr);
+
+	creates = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE);
+	for (i = 0; i < 100; i++) {
+		bos[i] = drm_intel_bo_alloc(bufmgr, "small", 200, 64);
+		assert(bos[i] != NULL && bos[i]->size == 256);
+		memset(data, i, sizeof(data));
+		ret = drm_intel_bo_subdata(bos[i], 0, 256, data);
+		assert(ret == 0);
+	}
+	/* Two slabs of 64 chunks */
+	assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_CREATE) == creates + 2);
+
+	/* Larger buffers still get their own object */
+	big = drm_intel_bo_alloc(bufmgr, "big", 4096, 4096);
+	assert(big != NULL && big->handle != bos[0]->handle);
+
+	for (i = 0; i < 100; i += 33) {
+		ret = drm_intel_bo_map(bos[i], 1);
+		assert(ret == 0);
+		assert(((uint8_t *)bos[i]->virtual)[0] == i);
+		assert(((uint8_t *)bos[i]->virtual)[255] == i);
+		((uint8_t *)bos[i]->virtual)[1] = 0xff;
+		drm_intel_bo_unmap(bos[i]);
+		assert(bos[i]->virtual == NULL);
+
+		ret = drm_intel_bo_get_subdata(bos[i], 0, 4, data);
+		assert(ret == 0);
+		assert(((uint8_t *)data)[1] == 0xff);
+		assert(((uint8_t *)data)[2] == i);
+	}
+
+	/* Nothing spills into the neighbouring chunks */
+	memset(data, 0xee, sizeof(data));
+	ret = drm_intel_bo_subdata(bos[1], 128, 256, data);
+	assert(ret == -EINVAL);
+	ret = drm_intel_bo_map(bos[1], 1);
+	assert(ret == 0);
+	region.offset = 128;
+	region.size = 256;
+	region.data = data;
+	ret = drm_intel_bo_subdata_v(bos[1], &region, 1);
+	assert(ret == -EINVAL);
+	drm_intel_bo_unmap(bos[1]);
+	for (i = 0; i < 4; i++) {
+		ret = drm_intel_bo_get_subdata(bos[i], 252, 4, data);
+		assert(ret == 0 && ((uint8_t *)data)[0] == i);
+	}
+
+	tiling = I915_TILING_X;
+	ret = drm_intel_bo_set_tiling(bos[0], &tiling, 512);
+	assert(ret == -EINVAL && tiling == I915_TILING_NONE);
+	ret = drm_intel_bo_flink(bos[0], &name);
+	assert(ret == -EINVAL);
+
+	/* Relocations to all of them only validate the two slabs */
+	batch = drm_intel_bo_alloc(bufmgr, "batch", 4096, 4096);
+	assert(batch != NULL);
+	for (i = 0; i < 100; i++) {
+		cmds[2 * i] = MI_NOOP;
+		cmds[2 * i + 1] = bos[i]->offset + 4;
+		ret = drm_intel_bo_emit_reloc(batch, 8 * i + 4, bos[i], 4,
+					      I915_GEM_DOMAIN_RENDER, 0);
+		assert(ret == 0);
+		assert(drm_intel_bo_references(batch, bos[i]));
+	}
+	cmds[200] = MI_BATCH_BUFFER_END;
+	cmds[201] = MI_NOOP;
+	ret = drm_intel_bo_subdata(batch, 0, sizeof(cmds), cmds);
+	assert(ret == 0);
+
+	mockdrm_reset_stats();
+	ret = drm_intel_bo_exec(batch, sizeof(cmds), NULL, 0, 0);
+	assert(ret == 0);
+	mockdrm_get_stats(&stats);
+	assert(stats.exec_objects == 3);
+	assert(stats.relocs == 100);
+
+	ret = drm_intel_bo_get_subdata(batch, 0, sizeof(cmds), cmds);
+	assert(ret == 0);
+	for (i = 0; i < 100; i++) {
+		assert(bos[i]->offset != 0);
+		assert(cmds[2 * i + 1] == bos[i]->offset + 4);
+	}
+
+	/* A chunk referenced by a batch stays allocated until the batch
+	 * is released, so it can't be handed out again meanwhile.
+	 */
+	drm_intel_bo_unreference(bos[99]);
+	bos[99] = drm_intel_bo_alloc(bufmgr, "small", 256, 64);
+	assert(bos[99] != NULL);
+	assert(bos[99]->offset != bos[98]->offset + 256);
+	drm_intel_bo_unreference(batch);
+
+	for (i = 0; i < 100; i++)
+		drm_intel_bo_unreference(bos[i]);
+	drm_intel_bo_unreference(big);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+static void
+test_validate_list(drm_intel_bufmgr *bufmgr)
+{
+	struct mockdrm_stats stats;
+	drm_intel_bo *batch, *shared, *chain[2000];
+	uint32_t cmds[4], value;
+	int i, n, ret;
+
+	printf("Testing validation list construction.\n");
+
+	shared = drm_intel_bo_alloc(bufmgr, "shared", 4096, 4096);
+	assert(shared != NULL);
+
+	/* A long chain of buffers pointing at the next one, all of them
+	 * also pointing at the shared buffer.  Targets can't gain
+	 * relocations of their own, so build it from the tail.
+	 */
+	for (i = 0; i < 2000; i++) {
+		chain[i] = drm_intel_bo_alloc(bufmgr, "chain", 4096, 4096);
+		assert(chain[i] != NULL);
+	}
+	for (i = 1999; i >= 0; i--) {
+		ret = drm_intel_bo_emit_reloc(chain[i], 0, shared, 0,
+					      I915_GEM_DOMAIN_SAMPLER, 0);
+		assert(ret == 0);
+		if (i == 1999)
+			continue;
+		ret = drm_intel_bo_emit_reloc(chain[i], 4, chain[i + 1], 8,
+					      I915_GEM_DOMAIN_SAMPLER, 0);
+		assert(ret == 0);
+	}
+
+	for (n = 0; n < 2; n++) {
+		batch = drm_intel_bo_alloc(bufmgr, "batch", 4096, 4096);
+		assert(batch != NULL);
+		cmds[0] = MI_NOOP;
+		cmds[1] = MI_NOOP;
+		cmds[2] = MI_BATCH_BUFFER_END;
+		cmds[3] = MI_NOOP;
+		ret = drm_intel_bo_subdata(batch, 0, sizeof(cmds), cmds);
+		assert(ret == 0);
+		ret = drm_intel_bo_emit_reloc(batch, 0, shared, 0,
+					      I915_GEM_DOMAIN_RENDER, 0);
+		assert(ret == 0);
+		if (n == 0) {
+			ret = drm_intel_bo_emit_reloc(batch, 4, chain[0], 0,
+						      I915_GEM_DOMAIN_RENDER,
+						      0);
+			assert(ret == 0);
+		}
+
+		mockdrm_reset_stats();
+		ret = drm_intel_bo_exec(batch, sizeof(cmds), NULL, 0, 0);
+		assert(ret == 0);
+		mockdrm_get_stats(&stats);
+
+		/* Every buffer is listed once, whatever happened to be on
+		 * the list for the previous submission.
+		 */
+		if (n == 0) {
+			assert(stats.exec_objects == 2000 + 2);
+			assert(stats.relocs == 2 + 2000 + 1999);
+		} else {
+			assert(stats.exec_objects == 2);
+			assert(stats.relocs == 1);
+		}
+		drm_intel_bo_unreference(batch);
+	}
+
+	for (i = 0; i < 1999; i++) {
+		ret = drm_intel_bo_get_subdata(chain[i], 4, 4, &value);
+		assert(ret == 0);
+		assert(value == chain[i + 1]->offset + 8);
+	}
+
+	for (i = 0; i < 2000; i++)
+		drm_intel_bo_unreference(chain[i]);
+	drm_intel_bo_unreference(shared);
+}
+
+#define APERTURE_TARGET_SIZE	(16 * 1024 * 1024)
+
+static void
+test_aperture(drm_intel_bufmgr *bufmgr)
+{
+	drm_intel_bo *batch, *other, *state, *targets[12], *check[5];
+	int i, ret;
+
+	printf("Testing aperture accounting.\n");
+
+	/* The mock aperture is 256MB, so 192MB can be used per batch */
+	for (i = 0; i < 12; i++) {
+		targets[i] = drm_intel_bo_alloc(bufmgr, "target",
+						APERTURE_TARGET_SIZE, 4096);
+		assert(targets[i] != NULL);
+	}
+	state = drm_intel_bo_alloc(bufmgr, "state", 4096, 4096);
+	assert(state != NULL);
+	for (i = 0; i < 4; i++) {
+		ret = drm_intel_bo_emit_reloc(state, i * 4, targets[i], 0,
+					      I915_GEM_DOMAIN_SAMPLER, 0);
+		assert(ret == 0);
+	}
+
+	/* Many relocations to 8 targets, half of them also reached
+	 * through the state buffer: 128MB and two pages.
+	 */
+	batch = drm_intel_bo_alloc(bufmgr, "batch", 4096, 4096);
+	assert(batch != NULL);
+	for (i = 0; i < 64; i++) {
+		ret = drm_intel_bo_emit_reloc(batch, i * 4, targets[i % 8], 0,
+					      I915_GEM_DOMAIN_RENDER, 0);
+		assert(ret == 0);
+	}
+	for (i = 64; i < 72; i++) {
+		ret = drm_intel_bo_emit_reloc(batch, i * 4, state, 0,
+					      I915_GEM_DOMAIN_RENDER, 0);
+		assert(ret == 0);
+	}
+
+	check[0] = batch;
+	check[1] = targets[0];
+	check[2] = state;
+	assert(drm_intel_bufmgr_check_aperture_space(check, 3) == 0);
+	for (i = 1; i < 5; i++)
+		check[i] = targets[7 + i];
+	assert(drm_intel_bufmgr_check_aperture_space(check, 4) == 0);
+	assert(drm_intel_bufmgr_check_aperture_space(check, 5) == -ENOSPC);
+
+	/* Another batch reaching a target in between makes the estimate
+	 * count it twice, which the exact count has to make up for.
+	 */
+	other = drm_intel_bo_alloc(bufmgr, "other", 4096, 4096);
+	assert(other != NULL);
+	ret = drm_intel_bo_emit_reloc(other, 0, targets[0], 0,
+				      I915_GEM_DOMAIN_RENDER, 0);
+	assert(ret == 0);
+	ret = drm_intel_bo_emit_reloc(batch, 72 * 4, targets[0], 0,
+				      I915_GEM_DOMAIN_RENDER, 0);
+	assert(ret == 0);
+	assert(drm_intel_bufmgr_check_aperture_space(check, 4) == 0);
+	assert(drm_intel_bufmgr_check_aperture_space(check, 5) == -ENOSPC);
+
+	/* Starting over forgets the dropped targets */
+	drm_intel_gem_bo_clear_relocs(batch, 0);
+	for (i = 0; i < 11; i++) {
+		ret = drm_intel_bo_emit_reloc(batch, i * 4, targets[i], 0,
+					      I915_GEM_DOMAIN_RENDER, 0);
+		assert(ret == 0);
+	}
+	assert(drm_intel_bufmgr_check_aperture_space(check, 1) == 0);
+	check[1] = targets[11];
+	assert(drm_intel_bufmgr_check_aperture_space(check, 2) == -ENOSPC);
+
+	drm_intel_bo_unreference(other);
+	drm_intel_bo_unreference(batch);
+	drm_intel_bo_unreference(state);
+	for (i = 0; i < 12; i++)
+		drm_intel_bo_unreference(targets[i]);
+}
+
+static drm_intel_bo *
+make_batch(drm_intel_bufmgr *bufmgr, drm_intel_bo *target)
+{
+	drm_intel_bo *batch;
+	uint32_t cmds[4];
+	int ret;
+
+	batch = drm_intel_bo_alloc(bufmgr, "batch", 4096, 4096);
+	assert(batch != NULL);
+	cmds[0] = MI_NOOP;
+	cmds[1] = target->offset + 16;
+	cmds[2] = MI_BATCH_BUFFER_END;
+	cmds[3] = MI_NOOP;
+	ret = drm_intel_bo_subdata(batch, 0, sizeof(cmds), cmds);
+	assert(ret == 0);
+	ret = drm_intel_bo_emit_reloc(batch, 4, target, 16,
+				      I915_GEM_DOMAIN_RENDER,
+				      I915_GEM_DOMAIN_RENDER);
+	assert(ret == 0);
+	return batch;
+}
+
+static void
+test_subdata_v(drm_intel_bufmgr *bufmgr)
+{
+	drm_intel_bo_region regions[6], overflow[2];
+	drm_intel_bo *bo, *batch;
+	uint32_t src[64], a[4], b[4], c[4], dst[64];
+	unsigned long pwrites;
+	int i, ret;
+
+	printf("Testing scatter-gather subdata.\n");
+
+	bo = drm_intel_bo_alloc(bufmgr, "subdata_v", 65536, 4096);
+	assert(bo != NULL);
+	for (i = 0; i < 64; i++)
+		src[i] = i;
+	for (i = 0; i < 4; i++) {
+		a[i] = 0x100 + i;
+		b[i] = 0x200 + i;
+		c[i] = 0x300 + i;
+	}
+
+	/* Three runs: contiguous in memory, gathered from separate
+	 * arrays, and a lone region further on.
+	 */
+	regions[0].offset = 0;
+	regions[0].size = 64;
+	regions[0].data = src;
+	regions[1].offset = 64;
+	regions[1].size = 64;
+	regions[1].data = src + 16;
+	regions[2].offset = 128;
+	regions[2].size = 128;
+	regions[2].data = src + 32;
+	regions[3].offset = 4096;
+	regions[3].size = sizeof(a);
+	regions[3].data = a;
+	regions[4].offset = 4096 + sizeof(a);
+	regions[4].size = sizeof(b);
+	regions[4].data = b;
+	regions[5].offset = 8192;
+	regions[5].size = sizeof(c);
+	regions[5].data = c;
+
+	pwrites = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_PWRITE);
+	ret = drm_intel_bo_subdata_v(bo, regions, 6);
+	assert(ret == 3);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_PWRITE) ==
+	       pwrites + 3);
+
+	ret = drm_intel_bo_get_subdata(bo, 0, sizeof(dst), dst);
+	assert(ret == 0);
+	assert(memcmp(dst, src, sizeof(src)) == 0);
+	ret = drm_intel_bo_get_subdata(bo, 4096, 32, dst);
+	assert(ret == 0);
+	assert(dst[0] == 0x100 && dst[4] == 0x200 && dst[7] == 0x203);
+
+	/* Read back into the separate arrays */
+	memset(a, 0, sizeof(a));
+	memset(b, 0, sizeof(b));
+	memset(c, 0, sizeof(c));
+	ret = drm_intel_bo_get_subdata_v(bo, regions + 3, 3);
+	assert(ret == 2);
+	assert(a[3] == 0x103 && b[0] == 0x200 && c[2] == 0x302);
+
+	/* An idle mapped buffer is written through the mapping */
+	ret = drm_intel_bo_map(bo, 0);
+	assert(ret == 0);
+	for (i = 0; i < 4; i++)
+		c[i] = 0x400 + i;
+	pwrites = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_PWRITE);
+	ret = drm_intel_bo_subdata_v(bo, regions + 5, 1);
+	assert(ret == 0);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_PWRITE) == pwrites);
+	assert(((uint32_t *) bo->virtual)[8192 / 4 + 1] == 0x401);
+
+	/* Regions past the end are refused before anything is copied */
+	overflow[0] = regions[5];
+	overflow[1] = regions[5];
+	overflow[1].offset = bo->size - 8;
+	ret = drm_intel_bo_subdata_v(bo, overflow, 2);
+	assert(ret == -EINVAL);
+	assert(((uint32_t *) bo->virtual)[8192 / 4 + 1] == 0x401);
+	overflow[1].offset = bo->size + 4096;
+	overflow[1].size = -4096ul;
+	ret = drm_intel_bo_get_subdata_v(bo, overflow + 1, 1);
+	assert(ret == -EINVAL);
+
+	/* but not while the GPU uses it */
+	batch = make_batch(bufmgr, bo);
+	mockdrm_set_gpu_time(20000000);
+	ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+	assert(ret == 0);
+	mockdrm_set_gpu_time(0);
+	assert(drm_intel_bo_busy(bo));
+	ret = drm_intel_bo_subdata_v(bo, regions, 3);
+	assert(ret == 1);
+	drm_intel_bo_unmap(bo);
+	ret = drm_intel_bo_subdata_v(bo, overflow, 2);
+	assert(ret == -EINVAL);
+	ret = drm_intel_bo_subdata(bo, bo->size - 8, 16, c);
+	assert(ret == -EINVAL);
+
+	drm_intel_bo_unreference(batch);
+	drm_intel_bo_unreference(bo);
+}
+
+static void
+test_upload_ring(drm_intel_bufmgr *bufmgr)
+{
+	struct mockdrm_stats stats;
+	drm_intel_upload_ring *ring;
+	drm_intel_bo *batch;
+	unsigned long stalls;
+	uint32_t offset, value;
+	uint32_t *ptr;
+	int i, ret;
+
+	printf("Testing streaming upload ring.\n");
+
+	assert(drm_intel_gem_upload_ring_create(bufmgr, "ring", 16384, 1) == NULL);
+	ring = drm_intel_gem_upload_ring_create(bufmgr, "ring", 16384, 4);
+	assert(ring != NULL);
+	assert(drm_intel_gem_upload_ring_alloc(ring, 4097, 4, &offset) == NULL);
+
+	/* Allocations are aligned and move to the next region when they
+	 * don't fit
+	 */
+	ptr = drm_intel_gem_upload_ring_alloc(ring, 10, 4, &offset);
+	assert(ptr != NULL && offset == 0);
+	ptr = drm_intel_gem_upload_ring_alloc(ring, 3000, 64, &offset);
+	assert(ptr != NULL && offset == 64);
+	ptr = drm_intel_gem_upload_ring_alloc(ring, 3000, 4, &offset);
+	assert(ptr != NULL && offset == 4096);
+	*ptr = 0xc0ffee;
+	ret = drm_intel_bo_get_subdata(drm_intel_gem_upload_ring_get_bo(ring),
+				       4096, sizeof(value), &value);
+	assert(ret == 0 && value == 0xc0ffee);
+
+	/* Without a batch using it, the ring fills up */
+	for (i = 2; i < 4; i++) {
+		ptr = drm_intel_gem_upload_ring_alloc(ring, 3000, 4, &offset);
+		assert(ptr != NULL && offset == i * 4096);
+	}
+	assert(drm_intel_gem_upload_ring_alloc(ring, 3000, 4, &offset) == NULL);
+
+	/* Submitting one frees the regions once it completes */
+	batch = make_batch(bufmgr, drm_intel_gem_upload_ring_get_bo(ring));
+	mockdrm_set_gpu_time(20000000);
+	ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+	assert(ret == 0);
+	mockdrm_set_gpu_time(0);
+	assert(drm_intel_bo_busy(batch));
+
+	mockdrm_get_stats(&stats);
+	stalls = stats.stalls;
+	ptr = drm_intel_gem_upload_ring_alloc(ring, 3000, 4, &offset);
+	assert(ptr != NULL && offset == 0);
+	assert(!drm_intel_bo_busy(batch));
+	mockdrm_get_stats(&stats);
+	assert(stats.stalls == stalls + 1);
+
+	/* Regions written since then aren't fenced by it */
+	ptr = drm_intel_gem_upload_ring_alloc(ring, 3000, 4, &offset);
+	assert(ptr != NULL && offset == 4096);
+	ptr = drm_intel_gem_upload_ring_alloc(ring, 3000, 4, &offset);
+	assert(ptr != NULL && offset == 8192);
+	ptr = drm_intel_gem_upload_ring_alloc(ring, 3000, 4, &offset);
+	assert(ptr != NULL && offset == 12288);
+	assert(drm_intel_gem_upload_ring_alloc(ring, 3000, 4, &offset) == NULL);
+	mockdrm_get_stats(&stats);
+	assert(stats.stalls == stalls + 1);
+
+	drm_intel_gem_upload_ring_destroy(ring);
+	drm_intel_bo_unreference(batch);
+}
+
+/* A kernel relocation entry plus libdrm_intel's target pointer and flags */
+#define RELOC_ENTRY_SIZE \
+	(sizeof(struct drm_i915_gem_relocation_entry) + 2 * sizeof(void *))
+
+static void
+test_reloc_arena(int fd)
+{
+	drm_intel_bo_exec_stats exec_stats;
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *batch, *target, *bos[1000];
+	uint32_t values[300];
+	uint64_t reloc_bytes;
+	int i, ret;
+
+	printf("Testing relocation list arena.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 16384);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	target = drm_intel_bo_alloc(bufmgr, "target", 65536, 4096);
+	assert(target != NULL);
+
+	/* The list grows past its first few sizes, keeping its entries */
+	batch = drm_intel_bo_alloc(bufmgr, "batch", 4096, 4096);
+	assert(batch != NULL);
+	for (i = 0; i < 300; i++) {
+		ret = drm_intel_bo_emit_reloc(batch, i * 4, target, i * 8,
+					      I915_GEM_DOMAIN_RENDER, 0);
+		assert(ret == 0);
+	}
+	assert(drm_intel_gem_bo_get_reloc_count(batch) == 300);
+	values[0] = MI_BATCH_BUFFER_END;
+	ret = drm_intel_bo_subdata(batch, 1200, 4, values);
+	assert(ret == 0);
+	ret = drm_intel_bo_exec(batch, 1208, NULL, 0, 0);
+	assert(ret == 0);
+	ret = drm_intel_bo_get_subdata(batch, 0, sizeof(values), values);
+	assert(ret == 0);
+	for (i = 0; i < 300; i++)
+		assert(values[i] == target->offset + i * 8);
+
+	/* 512 entries don't fit a chunk */
+	drm_intel_bufmgr_gem_get_exec_stats(bufmgr, &exec_stats);
+	reloc_bytes = exec_stats.reloc_bytes;
+	assert(reloc_bytes == 65536 + 512 * RELOC_ENTRY_SIZE);
+
+	/* Coming back from the cache, the batch brings its list along */
+	drm_intel_bo_unreference(batch);
+	batch = drm_intel_bo_alloc(bufmgr, "batch", 4096, 4096);
+	for (i = 0; i < 300; i++) {
+		ret = drm_intel_bo_emit_reloc(batch, i * 4, target, 0,
+					      I915_GEM_DOMAIN_RENDER, 0);
+		assert(ret == 0);
+	}
+	drm_intel_bufmgr_gem_get_exec_stats(bufmgr, &exec_stats);
+	assert(exec_stats.reloc_bytes == reloc_bytes);
+	drm_intel_bo_unreference(batch);
+
+	/* Buffers with a single relocation only take the smallest lists,
+	 * where each used to get room for max_relocs.
+	 */
+	for (i = 0; i < 1000; i++) {
+		bos[i] = drm_intel_bo_alloc(bufmgr, "state", 4096, 4096);
+		assert(bos[i] != NULL);
+		ret = drm_intel_bo_emit_reloc(bos[i], 0, target, 0,
+					      I915_GEM_DOMAIN_RENDER, 0);
+		assert(ret == 0);
+	}
+	drm_intel_bufmgr_gem_get_exec_stats(bufmgr, &exec_stats);
+	assert(exec_stats.reloc_bytes - reloc_bytes <=
+	       1000 * 16 * RELOC_ENTRY_SIZE + 65536);
+	for (i = 0; i < 1000; i++)
+		drm_intel_bo_unreference(bos[i]);
+
+	drm_intel_bo_unreference(target);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+static void
+test_no_reloc(int fd)
+{
+	struct mockdrm_stats stats;
+	drm_intel_bo_exec_stats exec_stats;
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *batch, *stale, *target;
+	uint32_t value;
+	int ret;
+
+	printf("Testing relocation-free execbuffer.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	drm_intel_bufmgr_gem_enable_no_reloc(bufmgr);
+
+	target = drm_intel_bo_alloc(bufmgr, "target", 4096, 4096);
+	assert(target != NULL);
+
+	/* The first submission binds the target, so the kernel has to
+	 * process the relocation even though nothing looked stale.
+	 */
+	batch = make_batch(bufmgr, target);
+	stale = make_batch(bufmgr, target);
+	mockdrm_reset_stats();
+	ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+	assert(ret == 0);
+	mockdrm_get_stats(&stats);
+	assert(stats.relocs_written == 1 && stats.relocs_skipped == 0);
+	drm_intel_bufmgr_gem_get_exec_stats(bufmgr, &exec_stats);
+	assert(exec_stats.execs == 1 && exec_stats.relocs == 1);
+	assert(exec_stats.relocs_needed == 0);
+	assert(exec_stats.no_reloc_execs == 0 && exec_stats.relocs_skipped == 0);
+	drm_intel_bo_unreference(batch);
+
+	/* Once everything stays put, relocation processing is skipped.  The
+	 * new batch is the previous one coming back from the cache, so it
+	 * is already bound too.
+	 */
+	batch = make_batch(bufmgr, target);
+	assert(batch->offset != 0);
+	mockdrm_reset_stats();
+	ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+	assert(ret == 0);
+	mockdrm_get_stats(&stats);
+	assert(stats.relocs_written == 0 && stats.relocs_skipped == 1);
+	drm_intel_bufmgr_gem_get_exec_stats(bufmgr, &exec_stats);
+	assert(exec_stats.execs == 2 && exec_stats.relocs == 2);
+	assert(exec_stats.no_reloc_execs == 1 && exec_stats.relocs_skipped == 1);
+	ret = drm_intel_bo_get_subdata(batch, 4, 4, &value);
+	assert(ret == 0 && value == target->offset + 16);
+	drm_intel_bo_unreference(batch);
+
+	/* A batch written before the target got its offset gets its
+	 * relocations processed as usual.
+	 */
+	mockdrm_reset_stats();
+	ret = drm_intel_bo_exec(stale, 16, NULL, 0, 0);
+	assert(ret == 0);
+	mockdrm_get_stats(&stats);
+	assert(stats.relocs_written == 1 && stats.relocs_skipped == 0);
+	drm_intel_bufmgr_gem_get_exec_stats(bufmgr, &exec_stats);
+	assert(exec_stats.execs == 3 && exec_stats.relocs_needed == 1);
+	assert(exec_stats.no_reloc_execs == 1);
+	ret = drm_intel_bo_get_subdata(stale, 4, 4, &value);
+	assert(ret == 0 && value == target->offset + 16);
+	drm_intel_bo_unreference(stale);
+
+	drm_intel_bo_unreference(target);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+struct async_results {
+	int done;
+	int last_ret;
+};
+
+static void
+async_callback(drm_intel_bo *batch, int ret, void *data)
+{
+	struct async_results *results = data;
+
+	assert(batch != NULL);
+	results->done++;
+	results->last_ret = ret;
+}
+
+static void
+test_async_exec(int fd)
+{
+	struct async_results results = { 0 };
+	struct mockdrm_stats stats;
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *batch, *target, *target2;
+	uint64_t fence;
+	uint32_t value;
+	int i, ret;
+
+	printf("Testing asynchronous submission.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	ret = drm_intel_bufmgr_gem_enable_async_exec(bufmgr, 4, async_callback,
+						     &results);
+	assert(ret == 0);
+	ret = drm_intel_bufmgr_gem_enable_async_exec(bufmgr, 4, NULL, NULL);
+	assert(ret == -EBUSY);
+
+	target = drm_intel_bo_alloc(bufmgr, "target", 4096, 4096);
+	assert(target != NULL);
+
+	/* More batches than fit in the queue, each taking a while */
+	mockdrm_reset_stats();
+	mockdrm_set_latency(DRM_IOCTL_I915_GEM_EXECBUFFER2, 1000000);
+	for (i = 0; i < 8; i++) {
+		batch = make_batch(bufmgr, target);
+		ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+		assert(ret == 0);
+		assert(drm_intel_bufmgr_gem_get_exec_fence(bufmgr) == i + 1);
+		if (i < 7)
+			drm_intel_bo_unreference(batch);
+	}
+
+	/* Reading the last batch back waits for it to be submitted, which
+	 * patched in the target's address.
+	 */
+	ret = drm_intel_bo_get_subdata(batch, 4, 4, &value);
+	assert(ret == 0);
+	assert(target->offset != 0 && value == target->offset + 16);
+	mockdrm_get_stats(&stats);
+	assert(stats.execs == 8);
+	drm_intel_bo_unreference(batch);
+
+	fence = drm_intel_bufmgr_gem_get_exec_fence(bufmgr);
+	ret = drm_intel_bufmgr_gem_wait_exec_fence(bufmgr, fence);
+	assert(ret == 0);
+	assert(results.done == 8 && results.last_ret == 0);
+	mockdrm_set_latency(DRM_IOCTL_I915_GEM_EXECBUFFER2, 0);
+
+	/* Queued batches keep their buffers busy */
+	mockdrm_set_gpu_time(1000000000);
+	batch = make_batch(bufmgr, target);
+	ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+	assert(ret == 0);
+	assert(drm_intel_bo_busy(target));
+	mockdrm_set_gpu_time(0);
+	drm_intel_bo_unreference(batch);
+
+	/* Errors only show up once the kernel has seen the batch */
+	batch = make_batch(bufmgr, target);
+	ret = drm_intel_bo_mrb_exec(batch, 16, NULL, 0, 0,
+				    I915_EXEC_RENDER | (1 << 30));
+	assert(ret == 0);
+	fence = drm_intel_bufmgr_gem_get_exec_fence(bufmgr);
+	ret = drm_intel_bufmgr_gem_wait_exec_fence(bufmgr, fence);
+	assert(ret == -EINVAL);
+	assert(results.done == 10 && results.last_ret == -EINVAL);
+	ret = drm_intel_bufmgr_gem_wait_exec_fence(bufmgr, fence);
+	assert(ret == 0);
+	drm_intel_bo_unreference(batch);
+
+	/* Starting the relocation list over doesn't touch the one a queued
+	 * batch has yet to hand to the kernel.
+	 */
+	target2 = drm_intel_bo_alloc(bufmgr, "target2", 4096, 4096);
+	assert(target2 != NULL);
+	mockdrm_set_latency(DRM_IOCTL_I915_GEM_EXECBUFFER2, 1000000);
+	batch = make_batch(bufmgr, target);
+	ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+	assert(ret == 0);
+	drm_intel_bo_unreference(batch);
+	batch = make_batch(bufmgr, target2);
+	ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+	assert(ret == 0);
+	drm_intel_gem_bo_clear_relocs(batch, 0);
+	ret = drm_intel_bo_emit_reloc(batch, 4, target2, 32,
+				      I915_GEM_DOMAIN_RENDER,
+				      I915_GEM_DOMAIN_RENDER);
+	assert(ret == 0);
+	ret = drm_intel_bo_get_subdata(batch, 4, 4, &value);
+	assert(ret == 0);
+	assert(target2->offset != 0 && value == target2->offset + 16);
+	mockdrm_set_latency(DRM_IOCTL_I915_GEM_EXECBUFFER2, 0);
+	drm_intel_bo_unreference(batch);
+	drm_intel_bo_unreference(target2);
+
+	/* Tearing down the bufmgr finishes what is still queued */
+	batch = make_batch(bufmgr, target);
+	ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+	assert(ret == 0);
+	drm_intel_bo_unreference(batch);
+	drm_intel_bo_unreference(target);
+	drm_intel_bufmgr_destroy(bufmgr);
+	assert(results.done == 13);
+}
+
+static void
+test_named_lookup(drm_intel_bufmgr *bufmgr)
+{
+	drm_intel_bufmgr *importer;
+	drm_intel_bo *bos[64], *imported[64], *bo;
+	uint32_t names[64];
+	unsigned long opens;
+	int fd2, i, ret;
+
+	printf("Testing flink name lookup.\n");
+
+	fd2 = mockdrm_open("i915");
+	assert(fd2 >= 0);
+	importer = drm_intel_bufmgr_gem_init(fd2, 4096);
+	assert(importer != NULL);
+
+	for (i = 0; i < 64; i++) {
+		bos[i] = drm_intel_bo_alloc(bufmgr, "exported", 4096, 4096);
+		assert(bos[i] != NULL);
+		ret = drm_intel_bo_flink(bos[i], &names[i]);
+		assert(ret == 0);
+
+		/* Our own names resolve to the very same bo */
+		bo = drm_intel_bo_gem_create_from_name(bufmgr, "self",
+						       names[i]);
+		assert(bo == bos[i]);
+		drm_intel_bo_unreference(bo);
+	}
+
+	opens = mockdrm_ioctl_count(DRM_IOCTL_GEM_OPEN);
+	for (i = 0; i < 64; i++) {
+		imported[i] = drm_intel_bo_gem_create_from_name(importer,
+								"imported",
+								names[i]);
+		assert(imported[i] != NULL);
+	}
+	for (i = 63; i >= 0; i--) {
+		bo = drm_intel_bo_gem_create_from_name(importer, "again",
+						       names[i]);
+		assert(bo == imported[i]);
+		drm_intel_bo_unreference(bo);
+	}
+	assert(mockdrm_ioctl_count(DRM_IOCTL_GEM_OPEN) == opens + 64);
+
+	/* Once released, a name has to be opened again */
+	drm_intel_bo_unreference(imported[0]);
+	imported[0] = drm_intel_bo_gem_create_from_name(importer, "reopened",
+							names[0]);
+	assert(imported[0] != NULL);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_GEM_OPEN) == opens + 65);
+
+	for (i = 0; i < 64; i++) {
+		drm_intel_bo_unreference(imported[i]);
+		drm_intel_bo_unreference(bos[i]);
+	}
+
+	drm_intel_bufmgr_destroy(importer);
+	mockdrm_close(fd2);
+}
+
+static void
+test_userptr(int fd)
+{
+	struct mockdrm_stats stats;
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *bo, *batch, *target;
+	uint32_t *mem, tiling, value;
+	unsigned long objects, pwrites;
+	int i, ret;
+
+	printf("Testing userptr buffers.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	ret = posix_memalign((void **)&mem, 4096, 16384);
+	assert(ret == 0);
+	for (i = 0; i < 4096; i++)
+		mem[i] = i;
+
+	/* The client memory is the buffer: no copies, and mapping it
+	 * hands back the same pointer.
+	 */
+	pwrites = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_PWRITE);
+	bo = drm_intel_bo_alloc_userptr(bufmgr, "userptr", mem, 16384, 0);
+	assert(bo != NULL && bo->size == 16384);
+	assert(drm_intel_bo_is_userptr(bo));
+	assert(!drm_intel_bo_is_reusable(bo));
+	ret = drm_intel_bo_map(bo, 1);
+	assert(ret == 0 && bo->virtual == mem);
+	drm_intel_bo_unmap(bo);
+	assert(drm_intel_gem_bo_map_gtt(bo) == -EINVAL);
+
+	value = 0xdeadbeef;
+	ret = drm_intel_bo_subdata(bo, 8192, 4, &value);
+	assert(ret == 0 && mem[2048] == 0xdeadbeef);
+	ret = drm_intel_bo_get_subdata(bo, 4, 4, &value);
+	assert(ret == 0 && value == 1);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_PWRITE) == pwrites);
+
+	tiling = I915_TILING_X;
+	ret = drm_intel_bo_set_tiling(bo, &tiling, 512);
+	assert(ret == -EINVAL && tiling == I915_TILING_NONE);
+
+	/* As a batch, with the relocation patched in client memory */
+	target = drm_intel_bo_alloc(bufmgr, "target", 4096, 4096);
+	assert(target != NULL);
+	mem[0] = MI_NOOP;
+	mem[1] = 0;
+	mem[2] = MI_BATCH_BUFFER_END;
+	mem[3] = MI_NOOP;
+	ret = drm_intel_bo_emit_reloc(bo, 4, target, 16,
+				      I915_GEM_DOMAIN_RENDER, 0);
+	assert(ret == 0);
+	ret = drm_intel_bo_exec(bo, 16, NULL, 0, 0);
+	assert(ret == 0);
+	assert(target->offset != 0 && mem[1] == target->offset + 16);
+
+	/* As a relocation target, and busy while the GPU uses it */
+	batch = make_batch(bufmgr, bo);
+	mockdrm_set_gpu_time(20000000);
+	ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+	assert(ret == 0);
+	mockdrm_set_gpu_time(0);
+	assert(drm_intel_bo_busy(bo));
+	mockdrm_reset_stats();
+	ret = drm_intel_bo_map(bo, 0);
+	assert(ret == 0);
+	mockdrm_get_stats(&stats);
+	assert(stats.stalls == 1 && !drm_intel_bo_busy(bo));
+	drm_intel_bo_unmap(bo);
+	ret = drm_intel_bo_get_subdata(batch, 4, 4, &value);
+	assert(ret == 0 && value == bo->offset + 16);
+	drm_intel_bo_unreference(batch);
+
+	/* Released straight away rather than cached */
+	mockdrm_get_stats(&stats);
+	objects = stats.objects;
+	drm_intel_bo_unreference(bo);
+	mockdrm_get_stats(&stats);
+	assert(stats.objects == objects - 1);
+
+	/* Memory the kernel won't wrap gets copied instead */
+	pwrites = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_PWRITE);
+	bo = drm_intel_bo_alloc_userptr(bufmgr, "unaligned", mem + 16, 4096,
+					0);
+	assert(bo != NULL && !drm_intel_bo_is_userptr(bo));
+	assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_PWRITE) == pwrites + 1);
+	mem[16] = 0x12345678;
+	ret = drm_intel_bo_get_subdata(bo, 4, 4, &value);
+	assert(ret == 0 && value == 17);
+	ret = drm_intel_bo_get_subdata(bo, 0, 4, &value);
+	assert(ret == 0 && value == 16);
+	drm_intel_bo_unreference(bo);
+
+	bo = drm_intel_bo_alloc_userptr(bufmgr, "unsynchronized", mem, 16384,
+					I915_USERPTR_UNSYNCHRONIZED);
+	assert(bo != NULL && !drm_intel_bo_is_userptr(bo));
+	ret = drm_intel_bo_get_subdata(bo, 8192, 4, &value);
+	assert(ret == 0 && value == 0xdeadbeef);
+	drm_intel_bo_unreference(bo);
+
+	drm_intel_bo_unreference(target);
+	drm_intel_bufmgr_destroy(bufmgr);
+	free(mem);
+}
+
+struct prime_worker {
+	drm_intel_bufmgr *bufmgr;
+	int prime_fd;
+};
+
+static void *
+prime_import_worker(void *data)
+{
+	struct prime_worker *w = data;
+	drm_intel_bo *bo;
+	uint32_t value;
+	int i, ret;
+
+	for (i = 0; i < 2000; i++) {
+		bo = drm_intel_bo_gem_create_from_prime(w->bufmgr,
+							w->prime_fd, 4096);
+		assert(bo != NULL);
+		ret = drm_intel_bo_get_subdata(bo, 0, 4, &value);
+		assert(ret == 0 && value == 0xdeadbeef);
+		drm_intel_bo_unreference(bo);
+	}
+
+	return NULL;
+}
+
+static void
+test_prime(int fd)
+{
+	drm_intel_bufmgr *bufmgr, *bufmgr2;
+	drm_intel_bo *bo, *bo2, *bo3, *small;
+	struct prime_worker workers[4];
+	pthread_t threads[4];
+	uint32_t data[1024];
+	int fd2, prime_fd, prime_fd2, i, ret;
+
+	printf("Testing PRIME import and export.\n");
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	drm_intel_bufmgr_gem_enable_suballoc(bufmgr);
+
+	bo = drm_intel_bo_alloc(bufmgr, "exported", 16384, 4096);
+	assert(bo != NULL);
+	memset(data, 0x3c, sizeof(data));
+	ret = drm_intel_bo_subdata(bo, 12288, sizeof(data), data);
+	assert(ret == 0);
+	assert(drm_intel_bo_is_reusable(bo));
+	ret = drm_intel_bo_gem_export_to_prime(bo, &prime_fd);
+	assert(ret == 0 && prime_fd >= 0);
+	assert(!drm_intel_bo_is_reusable(bo));
+
+	/* Exporting again is another fd for the same buffer */
+	ret = drm_intel_bo_gem_export_to_prime(bo, &prime_fd2);
+	assert(ret == 0 && prime_fd2 != prime_fd);
+
+	/* Importing it back finds the original */
+	bo2 = drm_intel_bo_gem_create_from_prime(bufmgr, prime_fd2, 0);
+	assert(bo2 == bo);
+	drm_intel_bo_unreference(bo2);
+	close(prime_fd2);
+
+	/* On another device: sized from the dma-buf, sharing contents,
+	 * and imported only once however often it's handed over.
+	 */
+	fd2 = mockdrm_open("i915");
+	assert(fd2 >= 0);
+	bufmgr2 = drm_intel_bufmgr_gem_init(fd2, 4096);
+	assert(bufmgr2 != NULL);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr2);
+	bo2 = drm_intel_bo_gem_create_from_prime(bufmgr2, prime_fd, 4096);
+	assert(bo2 != NULL && bo2->size == 16384);
+	assert(!drm_intel_bo_is_reusable(bo2));
+	ret = drm_intel_bo_get_subdata(bo2, 12288, 4, data);
+	assert(ret == 0 && data[0] == 0x3c3c3c3c);
+	bo3 = drm_intel_bo_gem_create_from_prime(bufmgr2, prime_fd, 4096);
+	assert(bo3 == bo2);
+	drm_intel_bo_unreference(bo3);
+
+	data[0] = 0xdeadbeef;
+	ret = drm_intel_bo_subdata(bo2, 0, 4, data);
+	assert(ret == 0);
+	ret = drm_intel_bo_get_subdata(bo, 0, 4, data);
+	assert(ret == 0 && data[0] == 0xdeadbeef);
+
+	/* Once the last reference is gone the next import is a new bo */
+	drm_intel_bo_unreference(bo2);
+	bo2 = drm_intel_bo_gem_create_from_prime(bufmgr2, prime_fd, 4096);
+	assert(bo2 != NULL);
+	ret = drm_intel_bo_get_subdata(bo2, 0, 4, data);
+	assert(ret == 0 && data[0] == 0xdeadbeef);
+	drm_intel_bo_unreference(bo2);
+
+	/* Threads dropping the last reference to an imported buffer while
+	 * others import it again must never revive a freed bo.
+	 */
+	for (i = 0; i < 4; i++) {
+		workers[i].bufmgr = bufmgr2;
+		workers[i].prime_fd = prime_fd;
+		ret = pthread_create(&threads[i], NULL,
+				     prime_import_worker, &workers[i]);
+		assert(ret == 0);
+	}
+	for (i = 0; i < 4; i++)
+		pthread_join(threads[i], NULL);
+	close(prime_fd);
+
+	/* A sub-allocated bo would hand out the whole slab */
+	small = drm_intel_bo_alloc(bufmgr, "small", 256, 64);
+	assert(small != NULL);
+	ret = drm_intel_bo_gem_export_to_prime(small, &prime_fd);
+	assert(ret == -EINVAL);
+	drm_intel_bo_unreference(small);
+
+	drm_intel_bo_unreference(bo);
+	drm_intel_bufmgr_destroy(bufmgr2);
+	mockdrm_close(fd2);
+	drm_intel_bufmgr_destroy(bufmgr);
+}
+
+static void
+test_bo_wait(int fd)
+{
+	drm_intel_bufmgr *bufmgr;
+	drm_intel_bo *bo, *batch;
+	unsigned long waits, busies;
+	uint64_t start, elapsed;
+	int pass, ret;
+
+	printf("Testing timed bo waits.\n");
+
+	/* With the wait ioctl, then polling as on kernels without it */
+	for (pass = 0; pass < 2; pass++) {
+		mockdrm_set_unsupported(DRM_IOCTL_I915_GEM_WAIT, pass);
+		bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+		assert(bufmgr != NULL);
+
+		bo = drm_intel_bo_alloc(bufmgr, "target", 4096, 4096);
+		assert(bo != NULL);
+		assert(drm_intel_gem_bo_wait(bo, 0) == 0);
+
+		batch = make_batch(bufmgr, bo);
+		mockdrm_set_gpu_time(50000000);
+		ret = drm_intel_bo_exec(batch, 16, NULL, 0, 0);
+		assert(ret == 0);
+		mockdrm_set_gpu_time(0);
+
+		waits = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_WAIT);
+		busies = mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_BUSY);
+		assert(drm_intel_gem_bo_wait(bo, 0) == -ETIME);
+
+		start = mockdrm_time_ns();
+		ret = drm_intel_gem_bo_wait(bo, 2000000);
+		elapsed = mockdrm_time_ns() - start;
+		assert(ret == -ETIME);
+		assert(elapsed >= 2000000 && elapsed < 40000000);
+		if (pass == 0) {
+			assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_WAIT) ==
+			       waits + 1);
+		} else {
+			assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_WAIT) ==
+			       waits);
+			assert(mockdrm_ioctl_count(DRM_IOCTL_I915_GEM_BUSY) >
+			       busies + 2);
+		}
+
+		/* Long enough this time, and back as soon as it's idle */
+		start = mockdrm_time_ns();
+		ret = drm_intel_gem_bo_wait(bo, 1000000000);
+		elapsed = mockdrm_time_ns() - start;
+		assert(ret == 0 && !drm_intel_bo_busy(bo));
+		assert(elapsed < 500000000);
+
+		drm_intel_bo_unreference(batch);
+		drm_intel_bo_unreference(bo);
+		drm_intel_bufmgr_destroy(bufmgr);
+	}
+	mockdrm_set_unsupported(DRM_IOCTL_I915_GEM_WAIT, 0);
+}
+
+int main(int argc, char **argv)
+{
+	drm_intel_bufmgr *bufmgr;
+	int fd;
+
+	fd = mockdrm_open("i915");
+	assert(fd >= 0);
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr != NULL);
+
+	test_bo(bufmgr, fd);
+	test_exec(bufmgr, fd);
+	test_validate_list(bufmgr);
+	test_aperture(bufmgr);
+	test_subdata_v(bufmgr);
+	test_upload_ring(bufmgr);
+	test_named_lookup(bufmgr);
+	test_thread_cache(fd);
+	test_cache_classes(fd);
+	test_tiling_reuse(fd);
+	test_tiled_copy(fd);
+	test_vma_cache(fd);
+	test_alloc_array(fd);
+	test_suballoc(fd);
+	test_reloc_arena(fd);
+	test_no_reloc(fd);
+	test_async_exec(fd);
+	test_userptr(fd);
+	test_prime(fd);
+	test_bo_wait(fd);
+
+	drm_intel_bufmgr_destroy(bufmgr);
+	mockdrm_close(fd);
+
+	return 0;
+}
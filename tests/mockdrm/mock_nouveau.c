@@ -0,0 +1,140 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include "xf86drm.h"
+#include "nouveau.h"
+#include "mockdrm.h"
+
+int main(int argc, char **argv)
+{
+	struct nv04_fifo nv04_data = { .vram = 0xbeef0201, .gart = 0xbeef0202 };
+	struct nouveau_device *dev;
+	struct nouveau_client *client;
+	struct nouveau_object *chan;
+	struct nouveau_pushbuf *push;
+	struct nouveau_bufctx *bctx;
+	struct nouveau_bo *bo, *bo2, *bos[8];
+	struct mockdrm_stats stats;
+	uint64_t sizes[8], start, elapsed;
+	uint32_t name;
+	int fd, ret, i;
+
+	fd = mockdrm_open("nouveau");
+	assert(fd >= 0);
+
+	ret = nouveau_device_wrap(fd, 0, &dev);
+	assert(ret == 0);
+	assert(dev->chipset == 0x50);
+	ret = nouveau_client_new(dev, &client);
+	assert(ret == 0);
+
+	printf("Testing bo map and sharing.\n");
+
+	ret = nouveau_bo_new(dev, NOUVEAU_BO_GART | NOUVEAU_BO_MAP, 0,
+			     64 * 1024, NULL, &bo);
+	assert(ret == 0);
+	ret = nouveau_bo_map(bo, NOUVEAU_BO_WR, client);
+	assert(ret == 0);
+	memset(bo->map, 0xa5, bo->size);
+
+	ret = nouveau_bo_name_get(bo, &name);
+	assert(ret == 0);
+	ret = nouveau_bo_name_ref(dev, name, &bo2);
+	assert(ret == 0);
+	assert(bo2 == bo);
+	nouveau_bo_ref(NULL, &bo2);
+
+	printf("Testing batched bo creation.\n");
+
+	for (i = 0; i < 8; i++)
+		sizes[i] = 4096 << i;
+	ret = nouveau_bo_new_array(dev, NOUVEAU_BO_GART | NOUVEAU_BO_MAP, 0,
+				   8, sizes, NULL, bos);
+	assert(ret == 0);
+	for (i = 0; i < 8; i++) {
+		assert(bos[i]->size == sizes[i]);
+		ret = nouveau_bo_map(bos[i], NOUVEAU_BO_WR, client);
+		assert(ret == 0);
+		memset(bos[i]->map, i, bos[i]->size);
+	}
+	ret = nouveau_bo_wrap(dev, bos[5]->handle, &bo2);
+	assert(ret == 0);
+	assert(bo2 == bos[5]);
+	for (i = 0; i < 8; i++)
+		nouveau_bo_ref(NULL, &bos[i]);
+	assert(((uint8_t *)bo2->map)[bo2->size - 1] == 5);
+	nouveau_bo_ref(NULL, &bo2);
+
+	printf("Testing pushbuf submission.\n");
+
+	ret = nouveau_object_new(&dev->object, 0, NOUVEAU_FIFO_CHANNEL_CLASS,
+				 &nv04_data, sizeof(nv04_data), &chan);
+	assert(ret == 0);
+	ret = nouveau_pushbuf_new(client, chan, 1, 4096, true, &push);
+	assert(ret == 0);
+	ret = nouveau_bufctx_new(client, 1, &bctx);
+	assert(ret == 0);
+
+	mockdrm_reset_stats();
+	mockdrm_set_gpu_time(1000000000);
+
+	nouveau_bufctx_refn(bctx, 0, bo, NOUVEAU_BO_GART | NOUVEAU_BO_RD);
+	nouveau_pushbuf_bufctx(push, bctx);
+	ret = nouveau_pushbuf_space(push, 8, 1, 0);
+	assert(ret == 0);
+	ret = nouveau_pushbuf_validate(push);
+	assert(ret == 0);
+	*push->cur++ = 0x00040000;
+	nouveau_pushbuf_reloc(push, bo, 0, NOUVEAU_BO_LOW, 0, 0);
+	ret = nouveau_pushbuf_kick(push, chan);
+	assert(ret == 0);
+
+	mockdrm_get_stats(&stats);
+	assert(stats.execs == 1);
+
+	ret = nouveau_bo_wait(bo, NOUVEAU_BO_RD | NOUVEAU_BO_NOBLOCK, client);
+	assert(ret == -EBUSY);
+	start = mockdrm_time_ns();
+	ret = nouveau_bo_wait_timeout(bo, NOUVEAU_BO_RD, client, 2000000);
+	elapsed = mockdrm_time_ns() - start;
+	assert(ret == -ETIME);
+	assert(elapsed >= 2000000 && elapsed < 500000000);
+	mockdrm_set_gpu_time(0);
+
+	nouveau_pushbuf_bufctx(push, NULL);
+	nouveau_bufctx_del(&bctx);
+	nouveau_pushbuf_del(&push);
+	nouveau_object_del(&chan);
+	nouveau_bo_ref(NULL, &bo);
+	nouveau_client_del(&client);
+	nouveau_device_del(&dev);
+	mockdrm_close(fd);
+
+	return 0;
+}
@@ -0,0 +1,390 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include "xf86drm.h"
+#include "radeon_drm.h"
+#include "radeon_bo.h"
+#include "radeon_bo_int.h"
+#include "radeon_bo_gem.h"
+#include "radeon_cs.h"
+#include "radeon_cs_gem.h"
+#include "mockdrm.h"
+
+static void
+test_bo(struct radeon_bo_manager *bom, int fd)
+{
+	struct radeon_bo_manager *bom2;
+	struct radeon_bo *bo, *bo2, *bo3;
+	unsigned long opens;
+	uint32_t name;
+	int fd2, ret;
+
+	printf("Testing bo map and sharing.\n");
+
+	bo = radeon_bo_open(bom, 0, 64 * 1024, 0, RADEON_GEM_DOMAIN_GTT, 0);
+	assert(bo != NULL);
+	ret = radeon_bo_map(bo, 1);
+	assert(ret == 0);
+	memset(bo->ptr, 0x5a, bo->size);
+	radeon_bo_unmap(bo);
+
+	ret = radeon_gem_get_kernel_name(bo, &name);
+	assert(ret == 0);
+	bo2 = radeon_bo_open(bom, name, 0, 0, 0, 0);
+	assert(bo2 == bo);
+	radeon_bo_unref(bo2);
+
+	fd2 = mockdrm_open("radeon");
+	assert(fd2 >= 0);
+	bom2 = radeon_bo_manager_gem_ctor(fd2);
+	assert(bom2 != NULL);
+	opens = mockdrm_ioctl_count(DRM_IOCTL_GEM_OPEN);
+	bo2 = radeon_bo_open(bom2, name, 0, 0, 0, 0);
+	assert(bo2 != NULL);
+	bo3 = radeon_bo_open(bom2, name, 0, 0, 0, 0);
+	assert(bo3 == bo2);
+	radeon_bo_unref(bo3);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_GEM_OPEN) == opens + 1);
+	ret = radeon_bo_map(bo2, 0);
+	assert(ret == 0);
+	assert(((uint8_t *)bo2->ptr)[bo->size - 1] == 0x5a);
+	radeon_bo_unmap(bo2);
+	radeon_bo_unref(bo2);
+	radeon_bo_manager_gem_dtor(bom2);
+	mockdrm_close(fd2);
+
+	radeon_bo_unref(bo);
+}
+
+static void
+test_prime(struct radeon_bo_manager *bom, int fd)
+{
+	struct radeon_bo_manager *bom2;
+	struct radeon_bo *bo, *bo2, *bo3;
+	int fd2, prime_fd, ret;
+
+	printf("Testing PRIME import and export.\n");
+
+	bo = radeon_bo_open(bom, 0, 64 * 1024, 0, RADEON_GEM_DOMAIN_GTT, 0);
+	assert(bo != NULL);
+	ret = radeon_bo_map(bo, 1);
+	assert(ret == 0);
+	memset(bo->ptr, 0xa5, bo->size);
+	radeon_bo_unmap(bo);
+
+	ret = radeon_gem_prime_share_bo(bo, &prime_fd);
+	assert(ret == 0 && prime_fd >= 0);
+	bo2 = radeon_gem_bo_open_prime(bom, prime_fd, 0);
+	assert(bo2 == bo);
+	radeon_bo_unref(bo2);
+
+	fd2 = mockdrm_open("radeon");
+	assert(fd2 >= 0);
+	bom2 = radeon_bo_manager_gem_ctor(fd2);
+	assert(bom2 != NULL);
+	bo2 = radeon_gem_bo_open_prime(bom2, prime_fd, 4096);
+	assert(bo2 != NULL && bo2->size == 64 * 1024);
+	bo3 = radeon_gem_bo_open_prime(bom2, prime_fd, 4096);
+	assert(bo3 == bo2);
+	radeon_bo_unref(bo3);
+	ret = radeon_bo_map(bo2, 0);
+	assert(ret == 0);
+	assert(((uint8_t *)bo2->ptr)[bo2->size - 1] == 0xa5);
+	radeon_bo_unmap(bo2);
+	radeon_bo_unref(bo2);
+	radeon_bo_manager_gem_dtor(bom2);
+	mockdrm_close(fd2);
+	close(prime_fd);
+
+	radeon_bo_unref(bo);
+}
+
+/* A manager outside libdrm, laid out with only the installed funcs */
+static struct radeon_bo *
+plain_bo_open(struct radeon_bo_manager *bom, uint32_t handle, uint32_t size,
+	      uint32_t alignment, uint32_t domains, uint32_t flags)
+{
+	struct radeon_bo_int *boi;
+
+	boi = calloc(1, sizeof(*boi));
+	if (boi == NULL)
+		return NULL;
+	boi->bom = bom;
+	boi->size = size;
+	boi->cref = 1;
+	return (struct radeon_bo *)boi;
+}
+
+static void
+plain_bo_ref(struct radeon_bo_int *boi)
+{
+}
+
+static struct radeon_bo *
+plain_bo_unref(struct radeon_bo_int *boi)
+{
+	if (boi->cref)
+		return (struct radeon_bo *)boi;
+	free(boi);
+	return NULL;
+}
+
+static struct radeon_bo_funcs plain_bo_funcs = {
+	.bo_open = plain_bo_open,
+	.bo_ref = plain_bo_ref,
+	.bo_unref = plain_bo_unref,
+};
+
+static void
+test_bo_array(struct radeon_bo_manager *bom, int fd)
+{
+	struct radeon_bo_manager plain = { &plain_bo_funcs, -1 };
+	struct radeon_bo *bos[16];
+	uint32_t sizes[16];
+	unsigned long creates;
+	int i, ret;
+
+	printf("Testing batched bo creation.\n");
+
+	for (i = 0; i < 16; i++)
+		sizes[i] = 4096 * (i + 1);
+
+	creates = mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_CREATE);
+	ret = radeon_bo_open_array(bom, 16, sizes, 0, RADEON_GEM_DOMAIN_GTT,
+				   0, bos);
+	assert(ret == 0);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_CREATE) ==
+	       creates + 16);
+
+	for (i = 0; i < 16; i++) {
+		assert(bos[i]->size == sizes[i]);
+		ret = radeon_bo_map(bos[i], 1);
+		assert(ret == 0);
+		memset(bos[i]->ptr, i, bos[i]->size);
+		radeon_bo_unmap(bos[i]);
+	}
+
+	radeon_bo_ref(bos[3]);
+	for (i = 15; i >= 0; i--)
+		radeon_bo_unref(bos[i]);
+	ret = radeon_bo_map(bos[3], 0);
+	assert(ret == 0);
+	assert(((uint8_t *)bos[3]->ptr)[0] == 3);
+	radeon_bo_unmap(bos[3]);
+	radeon_bo_unref(bos[3]);
+
+	/* other managers get one bo_open() per buffer */
+	ret = radeon_bo_open_array(&plain, 16, sizes, 0, RADEON_GEM_DOMAIN_GTT,
+				   0, bos);
+	assert(ret == 0);
+	for (i = 0; i < 16; i++) {
+		assert(bos[i]->size == sizes[i]);
+		radeon_bo_unref(bos[i]);
+	}
+}
+
+static void
+test_cs(struct radeon_bo_manager *bom, int fd)
+{
+	struct radeon_cs_manager *csm;
+	struct mockdrm_stats stats;
+	struct radeon_cs *cs;
+	struct radeon_bo *bo;
+	uint64_t start, elapsed;
+	uint32_t domain;
+	int ret;
+
+	printf("Testing command submission and busy tracking.\n");
+
+	csm = radeon_cs_manager_gem_ctor(fd);
+	assert(csm != NULL);
+	cs = radeon_cs_create(csm, 64);
+	assert(cs != NULL);
+	radeon_cs_set_limit(cs, RADEON_GEM_DOMAIN_GTT, 64 * 1024 * 1024);
+	radeon_cs_set_limit(cs, RADEON_GEM_DOMAIN_VRAM, 64 * 1024 * 1024);
+
+	bo = radeon_bo_open(bom, 0, 4096, 0, RADEON_GEM_DOMAIN_GTT, 0);
+	assert(bo != NULL);
+
+	mockdrm_reset_stats();
+	mockdrm_set_gpu_time(1000000000);
+
+	ret = radeon_cs_space_check_with_bo(cs, bo, 0, RADEON_GEM_DOMAIN_GTT);
+	assert(ret == 0);
+	radeon_cs_begin(cs, 4, __FILE__, __func__, __LINE__);
+	radeon_cs_write_dword(cs, 0x80000000);
+	radeon_cs_write_reloc(cs, bo, 0, RADEON_GEM_DOMAIN_GTT, 0);
+	radeon_cs_write_dword(cs, 0x80000000);
+	radeon_cs_end(cs, __FILE__, __func__, __LINE__);
+	ret = radeon_cs_emit(cs);
+	assert(ret == 0);
+
+	mockdrm_get_stats(&stats);
+	assert(stats.execs == 1);
+	assert(stats.relocs == 1);
+
+	ret = radeon_bo_is_busy(bo, &domain);
+	assert(ret == -EBUSY);
+
+	/* Timed waits give up when they should */
+	assert(radeon_bo_wait_timeout(bo, 0) == -ETIME);
+	start = mockdrm_time_ns();
+	ret = radeon_bo_wait_timeout(bo, 2000000);
+	elapsed = mockdrm_time_ns() - start;
+	assert(ret == -ETIME);
+	assert(elapsed >= 2000000 && elapsed < 500000000);
+
+	mockdrm_set_gpu_time(0);
+	radeon_bo_unref(bo);
+	radeon_cs_destroy(cs);
+	radeon_cs_manager_gem_dtor(csm);
+}
+
+static void
+emit_with_bo(struct radeon_cs *cs, struct radeon_bo *bo)
+{
+	int ret;
+
+	ret = radeon_cs_space_check_with_bo(cs, bo, 0, RADEON_GEM_DOMAIN_GTT);
+	assert(ret == 0);
+	radeon_cs_begin(cs, 4, __FILE__, __func__, __LINE__);
+	radeon_cs_write_dword(cs, 0x80000000);
+	radeon_cs_write_reloc(cs, bo, 0, RADEON_GEM_DOMAIN_GTT, 0);
+	radeon_cs_write_dword(cs, 0x80000000);
+	radeon_cs_end(cs, __FILE__, __func__, __LINE__);
+	ret = radeon_cs_emit(cs);
+	assert(ret == 0);
+	radeon_cs_erase(cs);
+}
+
+static void
+test_bo_wait(struct radeon_bo_manager *bom, int fd)
+{
+	struct radeon_bo_gem_stats before, stats;
+	struct radeon_cs_manager *csm;
+	struct radeon_cs *cs;
+	struct radeon_bo *bo;
+	unsigned long waits, busies;
+	uint64_t start;
+	uint32_t name;
+	int ret;
+
+	printf("Testing bo waits and the idle cache.\n");
+
+	csm = radeon_cs_manager_gem_ctor(fd);
+	assert(csm != NULL);
+	cs = radeon_cs_create(csm, 64);
+	assert(cs != NULL);
+	radeon_cs_set_limit(cs, RADEON_GEM_DOMAIN_GTT, 64 * 1024 * 1024);
+	radeon_cs_set_limit(cs, RADEON_GEM_DOMAIN_VRAM, 64 * 1024 * 1024);
+
+	bo = radeon_bo_open(bom, 0, 4096, 0, RADEON_GEM_DOMAIN_GTT, 0);
+	assert(bo != NULL);
+	waits = mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_WAIT_IDLE);
+	busies = mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_BUSY);
+	radeon_bo_manager_gem_get_stats(bom, &before);
+
+	/* A new buffer is idle, mapping it doesn't need to ask */
+	ret = radeon_bo_map(bo, 1);
+	assert(ret == 0);
+	radeon_bo_unmap(bo);
+	radeon_bo_manager_gem_get_stats(bom, &stats);
+	assert(stats.waits == before.waits + 1);
+	assert(stats.waits_avoided == before.waits_avoided + 1);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_WAIT_IDLE) == waits);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_BUSY) == busies);
+
+	/* Long GPU work: a few busy queries, then blocking */
+	mockdrm_set_gpu_time(20000000);
+	emit_with_bo(cs, bo);
+	mockdrm_set_gpu_time(0);
+	start = mockdrm_time_ns();
+	ret = radeon_bo_map(bo, 1);
+	assert(ret == 0);
+	assert(mockdrm_time_ns() - start >= 10000000);
+	radeon_bo_unmap(bo);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_WAIT_IDLE) == waits + 1);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_BUSY) == busies + 8);
+	radeon_bo_manager_gem_get_stats(bom, &stats);
+	assert(stats.waits_blocked == before.waits_blocked + 1);
+
+	/* Seen idle since, so no more ioctls */
+	ret = radeon_bo_map(bo, 0);
+	assert(ret == 0);
+	radeon_bo_unmap(bo);
+	ret = radeon_bo_wait(bo);
+	assert(ret == 0);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_WAIT_IDLE) == waits + 1);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_BUSY) == busies + 8);
+
+	/* Work that is already done by the time we look: one query */
+	emit_with_bo(cs, bo);
+	ret = radeon_bo_wait(bo);
+	assert(ret == 0);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_BUSY) == busies + 9);
+	radeon_bo_manager_gem_get_stats(bom, &stats);
+	assert(stats.waits_polled == before.waits_polled + 1);
+	assert(stats.waits_avoided == before.waits_avoided + 3);
+
+	/* Other processes can use a named buffer behind our back */
+	ret = radeon_gem_get_kernel_name(bo, &name);
+	assert(ret == 0);
+	ret = radeon_bo_wait(bo);
+	assert(ret == 0);
+	assert(mockdrm_ioctl_count(DRM_IOCTL_RADEON_GEM_BUSY) == busies + 10);
+	radeon_bo_manager_gem_get_stats(bom, &stats);
+	assert(stats.waits == before.waits + 6);
+
+	radeon_bo_unref(bo);
+	radeon_cs_destroy(cs);
+	radeon_cs_manager_gem_dtor(csm);
+}
+
+int main(int argc, char **argv)
+{
+	struct radeon_bo_manager *bom;
+	int fd;
+
+	fd = mockdrm_open("radeon");
+	assert(fd >= 0);
+	bom = radeon_bo_manager_gem_ctor(fd);
+	assert(bom != NULL);
+
+	test_bo(bom, fd);
+	test_prime(bom, fd);
+	test_bo_array(bom, fd);
+	test_cs(bom, fd);
+	test_bo_wait(bom, fd);
+
+	radeon_bo_manager_gem_dtor(bom);
+	mockdrm_close(fd);
+
+	return 0;
+}
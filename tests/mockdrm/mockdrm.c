@@ -0,0 +1,2054 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/* Deliberately no config.h: a large file offset define would rename the
+ * mmap() we interpose below.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/vfs.h>
+
+#include "drm.h"
+#include "drm_mode.h"
+#include "i915_drm.h"
+#include "radeon_drm.h"
+#include "nouveau_drm.h"
+#include "mockdrm.h"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+#define ALIGN(v, a) (((v) + (a) - 1) & ~((uint64_t)(a) - 1))
+#define U642VOID(x) ((void *)(unsigned long)(x))
+
+#define MOCK_MAX_FD 1024
+#define MOCK_PAGE_SIZE 4096
+
+#define MOCK_NUM_CRTCS 2
+#define MOCK_CRTC_ID(i) (0x10 + (i))
+#define MOCK_ENCODER_ID(i) (0x20 + (i))
+#define MOCK_CONNECTOR_ID(i) (0x30 + (i))
+
+#define MOCK_DMA_BUF_MAGIC 0x444d4142
+#define MOCK_ANON_INODE_FS_MAGIC 0x09041934
+
+#define MOCK_APERTURE_SIZE (256 * 1024 * 1024)
+#define MOCK_VRAM_SIZE (256 * 1024 * 1024)
+
+enum mock_driver {
+	MOCK_GENERIC,
+	MOCK_I915,
+	MOCK_RADEON,
+	MOCK_NOUVEAU,
+};
+
+struct mock_obj {
+	uint64_t size;
+	uint64_t offset;	/* location in the backing file */
+	void *user;		/* client memory of a userptr object, if any */
+	int dmabuf_fd;		/* our own fd of its dma-buf, or -1 */
+	ino_t dmabuf_ino;
+	struct mock_obj *dmabuf_next;
+	uint64_t gpu_offset;	/* fake GTT / VRAM address, 0 if unbound */
+	uint64_t busy_until;
+	uint32_t name;
+	int refs;		/* handles referencing this object */
+	uint32_t tiling_mode;
+	uint32_t stride;
+	uint32_t domain;
+	uint32_t madv;		/* last I915_MADV_* advice, WILLNEED at first */
+	int purged;		/* backing pages dropped by mockdrm_purge() */
+};
+
+struct mock_fb {
+	uint32_t id;
+	uint32_t width, height, pitch, bpp, depth, handle;
+	struct mock_fb *next;
+};
+
+struct mock_file {
+	int fd;
+	enum mock_driver driver;
+	struct mock_obj **handles;
+	uint32_t num_handles;
+	uint32_t next_handle;
+	struct mock_fb *fbs;
+	uint32_t crtc_fb[MOCK_NUM_CRTCS];
+	struct drm_mode_modeinfo crtc_mode[MOCK_NUM_CRTCS];
+	int crtc_mode_valid[MOCK_NUM_CRTCS];
+};
+
+struct mock_call {
+	uint64_t stall_until;
+};
+
+static pthread_mutex_t mock_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct mock_file *mock_files[MOCK_MAX_FD];
+static int backing_fd = -1;
+static uint64_t backing_end;
+static uint64_t gpu_offset_next = 1024 * 1024;
+
+static struct mock_obj *dmabufs;	/* exported objects */
+static int anon_dmabuf_fd = -1;		/* the one inode of anon dma-bufs */
+static ino_t anon_dmabuf_ino;
+static struct mock_obj *anon_dmabufs[MOCK_MAX_FD];	/* by exported fd */
+static int anon_dmabufs_enabled;
+static struct mock_obj **names;
+static uint32_t num_names;
+static uint32_t next_name = 1;
+static uint32_t next_fb_id = 0x100;
+
+static unsigned int latency_ns[256];
+static unsigned char unsupported_ioctls[256];	/* ioctls older kernels lack */
+static unsigned int default_latency_ns;
+static unsigned int gpu_time_ns;
+static uint32_t swizzle_modes[3];	/* bit 6 swizzling per tiling mode */
+static int mock_initialized;
+
+static unsigned long ioctl_counts[256];
+static struct mockdrm_stats stats;
+
+static const struct drm_mode_modeinfo mock_modes[MOCK_NUM_CRTCS] = {
+	{ 148500, 1920, 2008, 2052, 2200, 0, 1080, 1084, 1089, 1125, 0,
+	  60, DRM_MODE_FLAG_PHSYNC | DRM_MODE_FLAG_PVSYNC,
+	  DRM_MODE_TYPE_DRIVER | DRM_MODE_TYPE_PREFERRED, "1920x1080" },
+	{ 74250, 1280, 1390, 1430, 1650, 0, 720, 725, 730, 750, 0,
+	  60, DRM_MODE_FLAG_PHSYNC | DRM_MODE_FLAG_PVSYNC,
+	  DRM_MODE_TYPE_DRIVER | DRM_MODE_TYPE_PREFERRED, "1280x720" },
+};
+
+uint64_t
+mockdrm_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void
+mock_delay_until(uint64_t until)
+{
+	uint64_t now = mockdrm_time_ns();
+
+	if (until <= now)
+		return;
+
+	/* Sleeping has a granularity of tens of microseconds; spin for
+	 * short delays so that small injected latencies stay accurate.
+	 */
+	if (until - now > 50000) {
+		struct timespec ts;
+		uint64_t ns = until - now - 20000;
+
+		ts.tv_sec = ns / 1000000000ull;
+		ts.tv_nsec = ns % 1000000000ull;
+		nanosleep(&ts, NULL);
+	}
+
+	while (mockdrm_time_ns() < until)
+		;
+}
+
+static void
+mock_init_locked(void)
+{
+	const char *env;
+
+	if (mock_initialized)
+		return;
+
+	env = getenv("MOCKDRM_LATENCY_NS");
+	if (env)
+		default_latency_ns = strtoul(env, NULL, 0);
+	env = getenv("MOCKDRM_GPU_TIME_NS");
+	if (env)
+		gpu_time_ns = strtoul(env, NULL, 0);
+
+	mock_initialized = 1;
+}
+
+/* Returns an anonymous file, or -1 with errno set */
+static int
+mock_tmpfile(const char *name)
+{
+	char path[] = "/tmp/mockdrm-XXXXXX";
+	int fd = -1;
+
+#ifdef SYS_memfd_create
+	fd = syscall(SYS_memfd_create, name, 0);
+#endif
+	if (fd < 0) {
+		fd = mkstemp(path);
+		if (fd >= 0)
+			unlink(path);
+	}
+	return fd;
+}
+
+static int
+mock_backing_init_locked(void)
+{
+	if (backing_fd >= 0)
+		return 0;
+
+	backing_fd = mock_tmpfile("mockdrm");
+	if (backing_fd < 0)
+		return -errno;
+
+	/* Keep the first page unused so that no object has offset 0. */
+	backing_end = MOCK_PAGE_SIZE;
+	return 0;
+}
+
+/*
+ * Passthrough to the real system calls for non-mock file descriptors.
+ */
+static int
+sys_ioctl(int fd, unsigned long request, void *arg)
+{
+	return syscall(SYS_ioctl, fd, request, arg);
+}
+
+static void *
+sys_mmap(void *addr, size_t length, int prot, int flags, int fd,
+	 uint64_t offset)
+{
+#ifdef SYS_mmap2
+	if (offset & (MOCK_PAGE_SIZE - 1)) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+	return (void *)syscall(SYS_mmap2, addr, length, prot, flags, fd,
+			       (unsigned long)(offset / MOCK_PAGE_SIZE));
+#else
+	return (void *)syscall(SYS_mmap, addr, length, prot, flags, fd,
+			       (off_t)offset);
+#endif
+}
+
+static struct mock_file *
+mock_file_lookup(int fd)
+{
+	if (fd < 0 || fd >= MOCK_MAX_FD)
+		return NULL;
+	return mock_files[fd];
+}
+
+int
+mockdrm_is_mock(int fd)
+{
+	return mock_file_lookup(fd) != NULL;
+}
+
+int
+mockdrm_open(const char *driver)
+{
+	struct mock_file *file;
+	int fd, ret;
+
+	file = calloc(1, sizeof(*file));
+	if (file == NULL)
+		return -ENOMEM;
+
+	if (strcmp(driver, "i915") == 0)
+		file->driver = MOCK_I915;
+	else if (strcmp(driver, "radeon") == 0)
+		file->driver = MOCK_RADEON;
+	else if (strcmp(driver, "nouveau") == 0)
+		file->driver = MOCK_NOUVEAU;
+	else
+		file->driver = MOCK_GENERIC;
+	file->next_handle = 1;
+
+	/* A real descriptor keeps the number unique and lets fstat() and
+	 * close() behave.
+	 */
+	fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+	if (fd < 0 || fd >= MOCK_MAX_FD) {
+		ret = fd < 0 ? -errno : -EMFILE;
+		if (fd >= 0)
+			close(fd);
+		free(file);
+		return ret;
+	}
+	file->fd = fd;
+
+	pthread_mutex_lock(&mock_lock);
+	mock_init_locked();
+	ret = mock_backing_init_locked();
+	if (ret == 0)
+		mock_files[fd] = file;
+	pthread_mutex_unlock(&mock_lock);
+
+	if (ret) {
+		close(fd);
+		free(file);
+		return ret;
+	}
+
+	return fd;
+}
+
+static void
+mock_obj_unref_locked(struct mock_obj *obj)
+{
+	if (--obj->refs > 0)
+		return;
+
+	if (obj->name)
+		names[obj->name] = NULL;
+
+	if (obj->dmabuf_fd >= 0) {
+		struct mock_obj **prev;
+
+		for (prev = &dmabufs; *prev != obj; prev = &(*prev)->dmabuf_next)
+			;
+		*prev = obj->dmabuf_next;
+		close(obj->dmabuf_fd);
+	}
+	if (anon_dmabuf_fd >= 0) {
+		int fd;
+
+		for (fd = 0; fd < MOCK_MAX_FD; fd++) {
+			if (anon_dmabufs[fd] == obj)
+				anon_dmabufs[fd] = NULL;
+		}
+	}
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+	if (obj->user == NULL)
+		fallocate(backing_fd,
+			  FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			  obj->offset, obj->size);
+#endif
+	stats.objects--;
+	stats.object_bytes -= obj->size;
+	free(obj);
+}
+
+int
+mockdrm_close(int fd)
+{
+	struct mock_file *file;
+	struct mock_fb *fb;
+	uint32_t i;
+
+	pthread_mutex_lock(&mock_lock);
+	file = mock_file_lookup(fd);
+	if (file == NULL) {
+		pthread_mutex_unlock(&mock_lock);
+		return -EBADF;
+	}
+	mock_files[fd] = NULL;
+
+	for (i = 0; i < file->num_handles; i++) {
+		if (file->handles[i])
+			mock_obj_unref_locked(file->handles[i]);
+	}
+	pthread_mutex_unlock(&mock_lock);
+
+	while ((fb = file->fbs) != NULL) {
+		file->fbs = fb->next;
+		free(fb);
+	}
+	free(file->handles);
+	free(file);
+
+	return close(fd);
+}
+
+void
+mockdrm_set_latency(unsigned long request, unsigned int ns)
+{
+	pthread_mutex_lock(&mock_lock);
+	mock_init_locked();
+	if (request == 0)
+		default_latency_ns = ns;
+	else
+		latency_ns[_IOC_NR(request)] = ns;
+	pthread_mutex_unlock(&mock_lock);
+}
+
+void
+mockdrm_set_unsupported(unsigned long request, int unsupported)
+{
+	pthread_mutex_lock(&mock_lock);
+	mock_init_locked();
+	unsupported_ioctls[_IOC_NR(request)] = unsupported != 0;
+	pthread_mutex_unlock(&mock_lock);
+}
+
+void
+mockdrm_set_anon_dmabufs(int anon)
+{
+	pthread_mutex_lock(&mock_lock);
+	anon_dmabufs_enabled = anon != 0;
+	pthread_mutex_unlock(&mock_lock);
+}
+
+void
+mockdrm_purge(void)
+{
+	struct mock_file *file;
+	uint32_t h;
+	int fd;
+
+	pthread_mutex_lock(&mock_lock);
+	for (fd = 0; fd < MOCK_MAX_FD; fd++) {
+		file = mock_files[fd];
+		if (file == NULL)
+			continue;
+		for (h = 1; h < file->num_handles; h++) {
+			struct mock_obj *obj = file->handles[h];
+
+			if (obj != NULL && obj->madv == I915_MADV_DONTNEED)
+				obj->purged = 1;
+		}
+	}
+	pthread_mutex_unlock(&mock_lock);
+}
+
+void
+mockdrm_set_gpu_time(unsigned int ns)
+{
+	pthread_mutex_lock(&mock_lock);
+	mock_init_locked();
+	gpu_time_ns = ns;
+	pthread_mutex_unlock(&mock_lock);
+}
+
+void
+mockdrm_set_swizzle(uint32_t tiling_mode, uint32_t swizzle_mode)
+{
+	pthread_mutex_lock(&mock_lock);
+	swizzle_modes[tiling_mode] = swizzle_mode;
+	pthread_mutex_unlock(&mock_lock);
+}
+
+unsigned long
+mockdrm_ioctl_count(unsigned long request)
+{
+	return ioctl_counts[_IOC_NR(request)];
+}
+
+void
+mockdrm_get_stats(struct mockdrm_stats *out)
+{
+	pthread_mutex_lock(&mock_lock);
+	*out = stats;
+	pthread_mutex_unlock(&mock_lock);
+}
+
+void
+mockdrm_reset_stats(void)
+{
+	unsigned long objects;
+	uint64_t object_bytes;
+
+	pthread_mutex_lock(&mock_lock);
+	objects = stats.objects;
+	object_bytes = stats.object_bytes;
+	memset(&stats, 0, sizeof(stats));
+	memset(ioctl_counts, 0, sizeof(ioctl_counts));
+	stats.objects = objects;
+	stats.object_bytes = object_bytes;
+	pthread_mutex_unlock(&mock_lock);
+}
+
+/*
+ * Object and handle management
+ */
+
+static struct mock_obj *
+mock_obj_lookup(struct mock_file *file, uint32_t handle)
+{
+	if (handle == 0 || handle >= file->num_handles)
+		return NULL;
+	return file->handles[handle];
+}
+
+static int
+mock_handle_add(struct mock_file *file, struct mock_obj *obj,
+		uint32_t *handle)
+{
+	uint32_t h;
+
+	for (h = file->next_handle; h < file->num_handles; h++) {
+		if (file->handles[h] == NULL)
+			break;
+	}
+
+	if (h >= file->num_handles) {
+		uint32_t new_size = file->num_handles ? file->num_handles * 2 : 64;
+		struct mock_obj **handles;
+
+		handles = realloc(file->handles, new_size * sizeof(*handles));
+		if (handles == NULL)
+			return -ENOMEM;
+		memset(handles + file->num_handles, 0,
+		       (new_size - file->num_handles) * sizeof(*handles));
+		file->handles = handles;
+		file->num_handles = new_size;
+		if (h == 0)
+			h = 1;
+	}
+
+	file->handles[h] = obj;
+	file->next_handle = h + 1;
+	obj->refs++;
+	*handle = h;
+	return 0;
+}
+
+static int
+mock_handle_del(struct mock_file *file, uint32_t handle)
+{
+	struct mock_obj *obj = mock_obj_lookup(file, handle);
+
+	if (obj == NULL)
+		return -EINVAL;
+
+	file->handles[handle] = NULL;
+	if (handle < file->next_handle)
+		file->next_handle = handle;
+	mock_obj_unref_locked(obj);
+	return 0;
+}
+
+static int
+mock_obj_create(struct mock_file *file, uint64_t size, uint32_t *handle,
+		struct mock_obj **out)
+{
+	struct mock_obj *obj;
+	int ret;
+
+	if (size == 0)
+		return -EINVAL;
+
+	obj = calloc(1, sizeof(*obj));
+	if (obj == NULL)
+		return -ENOMEM;
+
+	obj->size = ALIGN(size, MOCK_PAGE_SIZE);
+	obj->offset = backing_end;
+	obj->dmabuf_fd = -1;
+	if (ftruncate(backing_fd, obj->offset + obj->size) != 0) {
+		ret = -errno;
+		free(obj);
+		return ret;
+	}
+
+	ret = mock_handle_add(file, obj, handle);
+	if (ret) {
+		free(obj);
+		return ret;
+	}
+
+	backing_end += obj->size;
+	stats.objects++;
+	stats.creates++;
+	stats.object_bytes += obj->size;
+	if (out)
+		*out = obj;
+	return 0;
+}
+
+/*
+ * Wraps client memory like the i915 USERPTR ioctl.  Unsynchronized
+ * objects are refused as if the caller lacked CAP_SYS_ADMIN.
+ */
+static int
+mock_obj_create_user(struct mock_file *file,
+		     struct drm_i915_gem_userptr *userptr)
+{
+	struct mock_obj *obj;
+	int ret;
+
+	if (userptr->flags & ~(I915_USERPTR_READ_ONLY |
+			       I915_USERPTR_UNSYNCHRONIZED))
+		return -EINVAL;
+	if (userptr->user_size == 0 ||
+	    (userptr->user_ptr | userptr->user_size) & (MOCK_PAGE_SIZE - 1))
+		return -EINVAL;
+	if (userptr->flags & I915_USERPTR_UNSYNCHRONIZED)
+		return -EPERM;
+
+	obj = calloc(1, sizeof(*obj));
+	if (obj == NULL)
+		return -ENOMEM;
+
+	obj->size = userptr->user_size;
+	obj->user = U642VOID(userptr->user_ptr);
+	obj->dmabuf_fd = -1;
+
+	ret = mock_handle_add(file, obj, &userptr->handle);
+	if (ret) {
+		free(obj);
+		return ret;
+	}
+
+	stats.objects++;
+	stats.creates++;
+	stats.object_bytes += obj->size;
+	return 0;
+}
+
+static uint64_t
+mock_obj_bind(struct mock_obj *obj)
+{
+	if (obj->gpu_offset == 0) {
+		obj->gpu_offset = gpu_offset_next;
+		gpu_offset_next += obj->size;
+	}
+	return obj->gpu_offset;
+}
+
+static void
+mock_obj_wait(struct mock_call *call, struct mock_obj *obj)
+{
+	if (obj->busy_until > mockdrm_time_ns()) {
+		stats.stalls++;
+		if (obj->busy_until > call->stall_until)
+			call->stall_until = obj->busy_until;
+	}
+}
+
+static void
+mock_obj_execute(struct mock_obj *obj)
+{
+	obj->busy_until = mockdrm_time_ns() + gpu_time_ns;
+}
+
+static int
+mock_obj_write(struct mock_obj *obj, uint64_t offset, const void *data,
+	       uint64_t size)
+{
+	if (offset > obj->size || size > obj->size - offset)
+		return -EINVAL;
+	if (obj->user) {
+		memcpy((char *)obj->user + offset, data, size);
+		return 0;
+	}
+	if (pwrite(backing_fd, data, size, obj->offset + offset) != (ssize_t)size)
+		return -EFAULT;
+	return 0;
+}
+
+static int
+mock_obj_read(struct mock_obj *obj, uint64_t offset, void *data,
+	      uint64_t size)
+{
+	if (offset > obj->size || size > obj->size - offset)
+		return -EINVAL;
+	if (obj->user) {
+		memcpy(data, (char *)obj->user + offset, size);
+		return 0;
+	}
+	if (pread(backing_fd, data, size, obj->offset + offset) != (ssize_t)size)
+		return -EFAULT;
+	return 0;
+}
+
+/*
+ * Core ioctls
+ */
+
+static int
+mock_copy_string(char *dst, size_t *len, const char *src)
+{
+	size_t n = strlen(src);
+
+	if (dst && *len)
+		memcpy(dst, src, n < *len ? n : *len);
+	*len = n;
+	return 0;
+}
+
+static int
+mock_version(struct mock_file *file, struct drm_version *v)
+{
+	switch (file->driver) {
+	case MOCK_I915:
+		v->version_major = 1;
+		v->version_minor = 6;
+		v->version_patchlevel = 0;
+		mock_copy_string(v->name, &v->name_len, "i915");
+		break;
+	case MOCK_RADEON:
+		v->version_major = 2;
+		v->version_minor = 16;
+		v->version_patchlevel = 0;
+		mock_copy_string(v->name, &v->name_len, "radeon");
+		break;
+	case MOCK_NOUVEAU:
+		v->version_major = 1;
+		v->version_minor = 0;
+		v->version_patchlevel = 0;
+		mock_copy_string(v->name, &v->name_len, "nouveau");
+		break;
+	case MOCK_GENERIC:
+	default:
+		v->version_major = 1;
+		v->version_minor = 0;
+		v->version_patchlevel = 0;
+		mock_copy_string(v->name, &v->name_len, "mock");
+		break;
+	}
+	mock_copy_string(v->date, &v->date_len, "20120101");
+	mock_copy_string(v->desc, &v->desc_len, "libdrm mock device");
+	return 0;
+}
+
+static int
+mock_gem_flink(struct mock_file *file, struct drm_gem_flink *flink)
+{
+	struct mock_obj *obj = mock_obj_lookup(file, flink->handle);
+
+	if (obj == NULL)
+		return -ENOENT;
+
+	if (obj->name == 0) {
+		if (next_name >= num_names) {
+			uint32_t new_size = num_names ? num_names * 2 : 64;
+			struct mock_obj **new_names;
+
+			new_names = realloc(names, new_size * sizeof(*names));
+			if (new_names == NULL)
+				return -ENOMEM;
+			memset(new_names + num_names, 0,
+			       (new_size - num_names) * sizeof(*names));
+			names = new_names;
+			num_names = new_size;
+		}
+		obj->name = next_name++;
+		names[obj->name] = obj;
+	}
+
+	flink->name = obj->name;
+	return 0;
+}
+
+static int
+mock_gem_open(struct mock_file *file, struct drm_gem_open *open_arg)
+{
+	struct mock_obj *obj = NULL;
+	int ret;
+
+	if (open_arg->name < num_names)
+		obj = names[open_arg->name];
+	if (obj == NULL)
+		return -ENOENT;
+
+	ret = mock_handle_add(file, obj, &open_arg->handle);
+	if (ret)
+		return ret;
+
+	open_arg->size = obj->size;
+	return 0;
+}
+
+/*
+ * An exported object's dma-buf is a file of its own, so it has an inode
+ * and a size like the real thing, though mapping it doesn't give access
+ * to the object.  Unlike in the kernel, it doesn't keep the object alive:
+ * importing it fails once all handles to the object are closed.
+ *
+ * With anonymous dma-bufs, every export is a new open of the same file
+ * instead, and the fd it was handed out as tells which object it is.
+ */
+static int
+mock_prime_export_anon(struct mock_obj *obj, struct drm_prime_handle *prime)
+{
+	char path[64];
+	struct stat st;
+	int fd;
+
+	if (anon_dmabuf_fd < 0) {
+		fd = mock_tmpfile("mockdrm-anon-dmabuf");
+		if (fd < 0)
+			return -errno;
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			return -ENOMEM;
+		}
+		anon_dmabuf_fd = fd;
+		anon_dmabuf_ino = st.st_ino;
+	}
+
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", anon_dmabuf_fd);
+	fd = open(path, O_RDWR | (prime->flags & DRM_CLOEXEC ? O_CLOEXEC : 0));
+	if (fd < 0)
+		return -errno;
+	if (fd >= MOCK_MAX_FD) {
+		close(fd);
+		return -EMFILE;
+	}
+	anon_dmabufs[fd] = obj;
+	prime->fd = fd;
+	return 0;
+}
+
+static int
+mock_prime_handle_to_fd(struct mock_file *file,
+			struct drm_prime_handle *prime)
+{
+	struct mock_obj *obj = mock_obj_lookup(file, prime->handle);
+	struct stat st;
+	int fd;
+
+	if (obj == NULL)
+		return -ENOENT;
+	if (prime->flags & ~DRM_CLOEXEC)
+		return -EINVAL;
+	if (anon_dmabufs_enabled)
+		return mock_prime_export_anon(obj, prime);
+
+	if (obj->dmabuf_fd < 0) {
+		fd = mock_tmpfile("mockdrm-dmabuf");
+		if (fd < 0)
+			return -errno;
+		if (ftruncate(fd, obj->size) != 0 || fstat(fd, &st) != 0) {
+			close(fd);
+			return -ENOMEM;
+		}
+		obj->dmabuf_fd = fd;
+		obj->dmabuf_ino = st.st_ino;
+		obj->dmabuf_next = dmabufs;
+		dmabufs = obj;
+	}
+
+	fd = fcntl(obj->dmabuf_fd,
+		   prime->flags & DRM_CLOEXEC ? F_DUPFD_CLOEXEC : F_DUPFD, 0);
+	if (fd < 0)
+		return -errno;
+	prime->fd = fd;
+	return 0;
+}
+
+static int
+mock_prime_fd_to_handle(struct mock_file *file,
+			struct drm_prime_handle *prime)
+{
+	struct mock_obj *obj;
+	struct stat st;
+	uint32_t h;
+
+	if (fstat(prime->fd, &st) != 0)
+		return -errno;
+	if (anon_dmabuf_fd >= 0 && st.st_ino == anon_dmabuf_ino) {
+		obj = prime->fd < MOCK_MAX_FD ? anon_dmabufs[prime->fd] : NULL;
+	} else {
+		for (obj = dmabufs; obj != NULL; obj = obj->dmabuf_next) {
+			if (obj->dmabuf_ino == st.st_ino)
+				break;
+		}
+	}
+	if (obj == NULL)
+		return -EINVAL;
+
+	/* Like the kernel, hand back the handle the file already has */
+	for (h = 1; h < file->num_handles; h++) {
+		if (file->handles[h] == obj) {
+			prime->handle = h;
+			return 0;
+		}
+	}
+	return mock_handle_add(file, obj, &prime->handle);
+}
+
+static int
+mock_get_cap(struct drm_get_cap *cap)
+{
+	switch (cap->capability) {
+	case DRM_CAP_DUMB_BUFFER:
+	case DRM_CAP_VBLANK_HIGH_CRTC:
+		cap->value = 1;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * KMS ioctls.  The device has a fixed topology of MOCK_NUM_CRTCS crtcs,
+ * each driving one encoder and one connected connector with one mode.
+ */
+
+static void
+mock_copy_ids(uint64_t ptr, uint32_t count, uint32_t (*id)(int), int n)
+{
+	uint32_t *ids = U642VOID(ptr);
+	int i;
+
+	if (ids == NULL || count < (uint32_t)n)
+		return;
+	for (i = 0; i < n; i++)
+		ids[i] = id(i);
+}
+
+static uint32_t mock_crtc_id(int i) { return MOCK_CRTC_ID(i); }
+static uint32_t mock_encoder_id(int i) { return MOCK_ENCODER_ID(i); }
+static uint32_t mock_connector_id(int i) { return MOCK_CONNECTOR_ID(i); }
+
+static int
+mock_mode_getresources(struct mock_file *file, struct drm_mode_card_res *res)
+{
+	struct mock_fb *fb;
+	uint32_t count_fbs = 0;
+
+	for (fb = file->fbs; fb; fb = fb->next)
+		count_fbs++;
+
+	if (res->fb_id_ptr && res->count_fbs >= count_fbs) {
+		uint32_t *ids = U642VOID(res->fb_id_ptr);
+
+		for (fb = file->fbs; fb; fb = fb->next)
+			*ids++ = fb->id;
+	}
+	mock_copy_ids(res->crtc_id_ptr, res->count_crtcs,
+		      mock_crtc_id, MOCK_NUM_CRTCS);
+	mock_copy_ids(res->encoder_id_ptr, res->count_encoders,
+		      mock_encoder_id, MOCK_NUM_CRTCS);
+	mock_copy_ids(res->connector_id_ptr, res->count_connectors,
+		      mock_connector_id, MOCK_NUM_CRTCS);
+
+	res->count_fbs = count_fbs;
+	res->count_crtcs = MOCK_NUM_CRTCS;
+	res->count_encoders = MOCK_NUM_CRTCS;
+	res->count_connectors = MOCK_NUM_CRTCS;
+	res->min_width = 1;
+	res->max_width = 8192;
+	res->min_height = 1;
+	res->max_height = 8192;
+	return 0;
+}
+
+static int
+mock_crtc_index(uint32_t id, uint32_t base)
+{
+	if (id < base || id >= base + MOCK_NUM_CRTCS)
+		return -1;
+	return id - base;
+}
+
+static int
+mock_mode_getcrtc(struct mock_file *file, struct drm_mode_crtc *crtc)
+{
+	int i = mock_crtc_index(crtc->crtc_id, MOCK_CRTC_ID(0));
+
+	if (i < 0)
+		return -EINVAL;
+
+	crtc->fb_id = file->crtc_fb[i];
+	crtc->x = crtc->y = 0;
+	crtc->gamma_size = 256;
+	crtc->mode_valid = file->crtc_mode_valid[i];
+	if (crtc->mode_valid)
+		crtc->mode = file->crtc_mode[i];
+	else
+		memset(&crtc->mode, 0, sizeof(crtc->mode));
+	return 0;
+}
+
+static int
+mock_mode_setcrtc(struct mock_file *file, struct drm_mode_crtc *crtc)
+{
+	int i = mock_crtc_index(crtc->crtc_id, MOCK_CRTC_ID(0));
+
+	if (i < 0)
+		return -EINVAL;
+
+	file->crtc_fb[i] = crtc->fb_id;
+	file->crtc_mode_valid[i] = crtc->mode_valid;
+	if (crtc->mode_valid)
+		file->crtc_mode[i] = crtc->mode;
+	return 0;
+}
+
+static int
+mock_mode_getencoder(struct drm_mode_get_encoder *enc)
+{
+	int i = mock_crtc_index(enc->encoder_id, MOCK_ENCODER_ID(0));
+
+	if (i < 0)
+		return -EINVAL;
+
+	enc->encoder_type = DRM_MODE_ENCODER_TMDS;
+	enc->crtc_id = MOCK_CRTC_ID(i);
+	enc->possible_crtcs = (1 << MOCK_NUM_CRTCS) - 1;
+	enc->possible_clones = 0;
+	return 0;
+}
+
+static int
+mock_mode_getconnector(struct drm_mode_get_connector *conn)
+{
+	int i = mock_crtc_index(conn->connector_id, MOCK_CONNECTOR_ID(0));
+
+	if (i < 0)
+		return -EINVAL;
+
+	if (conn->modes_ptr && conn->count_modes >= 1) {
+		struct drm_mode_modeinfo *modes = U642VOID(conn->modes_ptr);
+
+		modes[0] = mock_modes[i];
+	}
+	if (conn->encoders_ptr && conn->count_encoders >= 1) {
+		uint32_t *encoders = U642VOID(conn->encoders_ptr);
+
+		encoders[0] = MOCK_ENCODER_ID(i);
+	}
+
+	conn->count_modes = 1;
+	conn->count_props = 0;
+	conn->count_encoders = 1;
+	conn->encoder_id = MOCK_ENCODER_ID(i);
+	conn->connector_type = DRM_MODE_CONNECTOR_HDMIA;
+	conn->connector_type_id = i + 1;
+	conn->connection = 1; /* connected */
+	conn->mm_width = mock_modes[i].hdisplay / 4;
+	conn->mm_height = mock_modes[i].vdisplay / 4;
+	conn->subpixel = 0;
+	return 0;
+}
+
+static struct mock_fb *
+mock_fb_lookup(struct mock_file *file, uint32_t id, struct mock_fb ***prev)
+{
+	struct mock_fb **link, *fb;
+
+	for (link = &file->fbs; (fb = *link) != NULL; link = &fb->next) {
+		if (fb->id == id) {
+			if (prev)
+				*prev = link;
+			return fb;
+		}
+	}
+	return NULL;
+}
+
+static int
+mock_mode_addfb(struct mock_file *file, uint32_t *fb_id, uint32_t width,
+		uint32_t height, uint32_t pitch, uint32_t bpp, uint32_t depth,
+		uint32_t handle)
+{
+	struct mock_obj *obj = mock_obj_lookup(file, handle);
+	struct mock_fb *fb;
+
+	if (obj == NULL)
+		return -ENOENT;
+	if ((uint64_t)pitch * height > obj->size)
+		return -EINVAL;
+
+	fb = calloc(1, sizeof(*fb));
+	if (fb == NULL)
+		return -ENOMEM;
+
+	fb->id = next_fb_id++;
+	fb->width = width;
+	fb->height = height;
+	fb->pitch = pitch;
+	fb->bpp = bpp;
+	fb->depth = depth;
+	fb->handle = handle;
+	fb->next = file->fbs;
+	file->fbs = fb;
+
+	*fb_id = fb->id;
+	return 0;
+}
+
+static int
+mock_mode_rmfb(struct mock_file *file, uint32_t *id)
+{
+	struct mock_fb **prev, *fb = mock_fb_lookup(file, *id, &prev);
+	int i;
+
+	if (fb == NULL)
+		return -EINVAL;
+
+	for (i = 0; i < MOCK_NUM_CRTCS; i++) {
+		if (file->crtc_fb[i] == fb->id)
+			file->crtc_fb[i] = 0;
+	}
+	*prev = fb->next;
+	free(fb);
+	return 0;
+}
+
+static int
+mock_mode_getfb(struct mock_file *file, struct drm_mode_fb_cmd *cmd)
+{
+	struct mock_fb *fb = mock_fb_lookup(file, cmd->fb_id, NULL);
+
+	if (fb == NULL)
+		return -EINVAL;
+
+	cmd->width = fb->width;
+	cmd->height = fb->height;
+	cmd->pitch = fb->pitch;
+	cmd->bpp = fb->bpp;
+	cmd->depth = fb->depth;
+	cmd->handle = fb->handle;
+	return 0;
+}
+
+static int
+mock_mode_page_flip(struct mock_file *file,
+		    struct drm_mode_crtc_page_flip *flip)
+{
+	int i = mock_crtc_index(flip->crtc_id, MOCK_CRTC_ID(0));
+
+	if (i < 0 || mock_fb_lookup(file, flip->fb_id, NULL) == NULL)
+		return -EINVAL;
+
+	/* No vblank events are delivered, so flips complete immediately. */
+	if (flip->flags & DRM_MODE_PAGE_FLIP_EVENT)
+		return -EINVAL;
+
+	file->crtc_fb[i] = flip->fb_id;
+	return 0;
+}
+
+static int
+mock_mode_create_dumb(struct mock_file *file,
+		      struct drm_mode_create_dumb *dumb)
+{
+	uint32_t pitch;
+	int ret;
+
+	if (dumb->width == 0 || dumb->height == 0 || dumb->bpp == 0)
+		return -EINVAL;
+
+	pitch = ALIGN((dumb->width * dumb->bpp + 7) / 8, 64);
+	ret = mock_obj_create(file, (uint64_t)pitch * dumb->height,
+			      &dumb->handle, NULL);
+	if (ret)
+		return ret;
+
+	dumb->pitch = pitch;
+	dumb->size = (uint64_t)pitch * dumb->height;
+	return 0;
+}
+
+static int
+mock_mode_map_dumb(struct mock_file *file, struct drm_mode_map_dumb *map)
+{
+	struct mock_obj *obj = mock_obj_lookup(file, map->handle);
+
+	if (obj == NULL)
+		return -ENOENT;
+
+	map->offset = obj->offset;
+	return 0;
+}
+
+/*
+ * i915
+ */
+
+static int
+mock_i915_getparam(drm_i915_getparam_t *gp)
+{
+	switch (gp->param) {
+	case I915_PARAM_CHIPSET_ID:
+		*gp->value = 0x0116; /* Sandybridge GT2 mobile */
+		return 0;
+	case I915_PARAM_HAS_GEM:
+	case I915_PARAM_HAS_EXECBUF2:
+	case I915_PARAM_HAS_BSD:
+	case I915_PARAM_HAS_BLT:
+	case I915_PARAM_HAS_RELAXED_FENCING:
+	case I915_PARAM_HAS_RELAXED_DELTA:
+	case I915_PARAM_HAS_LLC:
+	case I915_PARAM_HAS_EXEC_NO_RELOC:
+		*gp->value = 1;
+		return 0;
+	case I915_PARAM_HAS_WAIT_TIMEOUT:
+		if (unsupported_ioctls[_IOC_NR(DRM_IOCTL_I915_GEM_WAIT)])
+			return -EINVAL;
+		*gp->value = 1;
+		return 0;
+	case I915_PARAM_NUM_FENCES_AVAIL:
+		*gp->value = 16;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int
+mock_i915_execbuffer2(struct mock_file *file,
+		      struct drm_i915_gem_execbuffer2 *execbuf)
+{
+	struct drm_i915_gem_exec_object2 *exec = U642VOID(execbuf->buffers_ptr);
+	int need_relocs = 1;
+	uint32_t i, j;
+
+	if (execbuf->buffer_count == 0 ||
+	    execbuf->flags & __I915_EXEC_UNKNOWN_FLAGS)
+		return -EINVAL;
+
+	/* Validate every handle before touching anything. */
+	for (i = 0; i < execbuf->buffer_count; i++) {
+		if (exec[i].flags & __EXEC_OBJECT_UNKNOWN_FLAGS)
+			return -EINVAL;
+		if (mock_obj_lookup(file, exec[i].handle) == NULL)
+			return -ENOENT;
+	}
+
+	for (i = 0; i < execbuf->buffer_count; i++)
+		mock_obj_bind(mock_obj_lookup(file, exec[i].handle));
+
+	/* With I915_EXEC_NO_RELOC, userspace promises the relocations are
+	 * right for the offsets it passed in, so they only need looking at
+	 * if a buffer isn't there.
+	 */
+	if (execbuf->flags & I915_EXEC_NO_RELOC) {
+		need_relocs = 0;
+		for (i = 0; i < execbuf->buffer_count; i++) {
+			struct mock_obj *obj = mock_obj_lookup(file,
+							       exec[i].handle);
+
+			if (exec[i].offset != obj->gpu_offset)
+				need_relocs = 1;
+		}
+	}
+
+	for (i = 0; !need_relocs && i < execbuf->buffer_count; i++) {
+		stats.relocs += exec[i].relocation_count;
+		stats.relocs_skipped += exec[i].relocation_count;
+	}
+
+	for (i = 0; need_relocs && i < execbuf->buffer_count; i++) {
+		struct mock_obj *obj = mock_obj_lookup(file, exec[i].handle);
+		struct drm_i915_gem_relocation_entry *relocs =
+			U642VOID(exec[i].relocs_ptr);
+
+		for (j = 0; j < exec[i].relocation_count; j++) {
+			struct mock_obj *target;
+			uint32_t value;
+			int ret;
+
+			target = mock_obj_lookup(file, relocs[j].target_handle);
+			if (target == NULL)
+				return -ENOENT;
+
+			stats.relocs++;
+			if (relocs[j].presumed_offset == target->gpu_offset)
+				continue;
+
+			value = target->gpu_offset + relocs[j].delta;
+			ret = mock_obj_write(obj, relocs[j].offset,
+					     &value, sizeof(value));
+			if (ret)
+				return ret;
+			relocs[j].presumed_offset = target->gpu_offset;
+			stats.relocs_written++;
+		}
+	}
+
+	for (i = 0; i < execbuf->buffer_count; i++) {
+		struct mock_obj *obj = mock_obj_lookup(file, exec[i].handle);
+
+		exec[i].offset = obj->gpu_offset;
+		mock_obj_execute(obj);
+	}
+
+	stats.exec_objects += execbuf->buffer_count;
+	stats.execs++;
+	return 0;
+}
+
+static int
+mock_i915_gem_wait(struct mock_call *call, struct mock_file *file,
+		   struct drm_i915_gem_wait *wait)
+{
+	struct mock_obj *obj = mock_obj_lookup(file, wait->bo_handle);
+	uint64_t now = mockdrm_time_ns();
+	uint64_t remaining;
+
+	if (obj == NULL)
+		return -ENOENT;
+
+	if (obj->busy_until <= now) {
+		wait->timeout_ns = wait->timeout_ns > 0 ? wait->timeout_ns : 0;
+		return 0;
+	}
+
+	remaining = obj->busy_until - now;
+	if (wait->timeout_ns == 0)
+		return -ETIME;
+
+	/* A negative timeout waits for as long as it takes */
+	stats.stalls++;
+	if (wait->timeout_ns > 0 && (uint64_t)wait->timeout_ns < remaining) {
+		call->stall_until = now + wait->timeout_ns;
+		wait->timeout_ns = 0;
+		return -ETIME;
+	}
+
+	call->stall_until = obj->busy_until;
+	if (wait->timeout_ns > 0)
+		wait->timeout_ns -= remaining;
+	return 0;
+}
+
+static int
+mock_i915_ioctl(struct mock_call *call, struct mock_file *file,
+		unsigned int nr, void *arg)
+{
+	struct mock_obj *obj;
+
+	switch (nr) {
+	case DRM_I915_GETPARAM:
+		return mock_i915_getparam(arg);
+	case DRM_I915_GEM_GET_APERTURE: {
+		struct drm_i915_gem_get_aperture *aperture = arg;
+
+		aperture->aper_size = MOCK_APERTURE_SIZE;
+		aperture->aper_available_size = MOCK_APERTURE_SIZE;
+		return 0;
+	}
+	case DRM_I915_GEM_CREATE: {
+		struct drm_i915_gem_create *create = arg;
+
+		return mock_obj_create(file, create->size, &create->handle,
+				       NULL);
+	}
+	case DRM_I915_GEM_USERPTR:
+		return mock_obj_create_user(file, arg);
+	case DRM_I915_GEM_PWRITE: {
+		struct drm_i915_gem_pwrite *pwrite = arg;
+
+		obj = mock_obj_lookup(file, pwrite->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		if (obj->user)
+			return -EINVAL;
+		mock_obj_wait(call, obj);
+		return mock_obj_write(obj, pwrite->offset,
+				      U642VOID(pwrite->data_ptr), pwrite->size);
+	}
+	case DRM_I915_GEM_PREAD: {
+		struct drm_i915_gem_pread *pread = arg;
+
+		obj = mock_obj_lookup(file, pread->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		if (obj->user)
+			return -EINVAL;
+		mock_obj_wait(call, obj);
+		return mock_obj_read(obj, pread->offset,
+				     U642VOID(pread->data_ptr), pread->size);
+	}
+	case DRM_I915_GEM_MMAP: {
+		struct drm_i915_gem_mmap *mmap_arg = arg;
+		void *ptr;
+
+		obj = mock_obj_lookup(file, mmap_arg->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		/* Userptr objects have no shmem file to map */
+		if (obj->user)
+			return -EINVAL;
+		if (mmap_arg->offset > obj->size ||
+		    mmap_arg->size > obj->size - mmap_arg->offset)
+			return -EINVAL;
+		ptr = sys_mmap(NULL, mmap_arg->size, PROT_READ | PROT_WRITE,
+			       MAP_SHARED, backing_fd,
+			       obj->offset + mmap_arg->offset);
+		if (ptr == MAP_FAILED)
+			return -errno;
+		mmap_arg->addr_ptr = (uintptr_t)ptr;
+		return 0;
+	}
+	case DRM_I915_GEM_MMAP_GTT: {
+		struct drm_i915_gem_mmap_gtt *mmap_arg = arg;
+
+		obj = mock_obj_lookup(file, mmap_arg->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		if (obj->user)
+			return -ENODEV;
+		mmap_arg->offset = obj->offset;
+		return 0;
+	}
+	case DRM_I915_GEM_SET_DOMAIN: {
+		struct drm_i915_gem_set_domain *set_domain = arg;
+
+		obj = mock_obj_lookup(file, set_domain->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		mock_obj_wait(call, obj);
+		obj->domain = set_domain->read_domains;
+		return 0;
+	}
+	case DRM_I915_GEM_SW_FINISH: {
+		struct drm_i915_gem_sw_finish *sw_finish = arg;
+
+		return mock_obj_lookup(file, sw_finish->handle) ? 0 : -ENOENT;
+	}
+	case DRM_I915_GEM_BUSY: {
+		struct drm_i915_gem_busy *busy = arg;
+
+		obj = mock_obj_lookup(file, busy->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		busy->busy = obj->busy_until > mockdrm_time_ns();
+		return 0;
+	}
+	case DRM_I915_GEM_WAIT:
+		return mock_i915_gem_wait(call, file, arg);
+	case DRM_I915_GEM_MADVISE: {
+		struct drm_i915_gem_madvise *madv = arg;
+
+		struct mock_obj *obj = mock_obj_lookup(file, madv->handle);
+
+		if (obj == NULL)
+			return -ENOENT;
+		/* Like the kernel, a purged object stays purged */
+		if (!obj->purged)
+			obj->madv = madv->madv;
+		madv->retained = !obj->purged;
+		return 0;
+	}
+	case DRM_I915_GEM_SET_TILING: {
+		struct drm_i915_gem_set_tiling *tiling = arg;
+
+		obj = mock_obj_lookup(file, tiling->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		if (tiling->tiling_mode > I915_TILING_Y)
+			return -EINVAL;
+		obj->tiling_mode = tiling->tiling_mode;
+		obj->stride = tiling->tiling_mode == I915_TILING_NONE ?
+			0 : tiling->stride;
+		tiling->stride = obj->stride;
+		tiling->swizzle_mode = swizzle_modes[obj->tiling_mode];
+		return 0;
+	}
+	case DRM_I915_GEM_GET_TILING: {
+		struct drm_i915_gem_get_tiling *tiling = arg;
+
+		obj = mock_obj_lookup(file, tiling->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		tiling->tiling_mode = obj->tiling_mode;
+		tiling->swizzle_mode = swizzle_modes[obj->tiling_mode];
+		return 0;
+	}
+	case DRM_I915_GEM_PIN: {
+		struct drm_i915_gem_pin *pin = arg;
+
+		obj = mock_obj_lookup(file, pin->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		pin->offset = mock_obj_bind(obj);
+		return 0;
+	}
+	case DRM_I915_GEM_UNPIN:
+	case DRM_I915_GEM_THROTTLE:
+		return 0;
+	case DRM_I915_GEM_EXECBUFFER2:
+		return mock_i915_execbuffer2(file, arg);
+	case DRM_I915_GET_PIPE_FROM_CRTC_ID: {
+		struct drm_i915_get_pipe_from_crtc_id *pipe = arg;
+		int i = mock_crtc_index(pipe->crtc_id, MOCK_CRTC_ID(0));
+
+		if (i < 0)
+			return -EINVAL;
+		pipe->pipe = i;
+		return 0;
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * radeon
+ */
+
+static int
+mock_radeon_info(struct drm_radeon_info *info)
+{
+	uint32_t *value = U642VOID(info->value);
+
+	switch (info->request) {
+	case RADEON_INFO_DEVICE_ID:
+		*value = 0x6779; /* Caicos */
+		return 0;
+	case RADEON_INFO_NUM_GB_PIPES:
+	case RADEON_INFO_NUM_Z_PIPES:
+	case RADEON_INFO_ACCEL_WORKING:
+	case RADEON_INFO_ACCEL_WORKING2:
+		*value = 1;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int
+mock_radeon_cs(struct mock_file *file, struct drm_radeon_cs *cs)
+{
+	uint64_t *chunk_array = U642VOID(cs->chunks);
+	struct drm_radeon_cs_chunk *relocs = NULL;
+	uint32_t *reloc_data;
+	uint32_t i, count;
+
+	for (i = 0; i < cs->num_chunks; i++) {
+		struct drm_radeon_cs_chunk *chunk = U642VOID(chunk_array[i]);
+
+		if (chunk->chunk_id == RADEON_CHUNK_ID_RELOCS)
+			relocs = chunk;
+	}
+
+	if (relocs == NULL)
+		return 0;
+
+	/* Each reloc is { handle, read_domain, write_domain, flags } */
+	reloc_data = U642VOID(relocs->chunk_data);
+	count = relocs->length_dw / 4;
+	for (i = 0; i < count; i++) {
+		if (mock_obj_lookup(file, reloc_data[i * 4]) == NULL)
+			return -ENOENT;
+	}
+	for (i = 0; i < count; i++) {
+		struct mock_obj *obj = mock_obj_lookup(file, reloc_data[i * 4]);
+
+		mock_obj_bind(obj);
+		mock_obj_execute(obj);
+	}
+
+	stats.relocs += count;
+	stats.exec_objects += count;
+	stats.execs++;
+	return 0;
+}
+
+static int
+mock_radeon_ioctl(struct mock_call *call, struct mock_file *file,
+		  unsigned int nr, void *arg)
+{
+	struct mock_obj *obj;
+
+	switch (nr) {
+	case DRM_RADEON_INFO:
+		return mock_radeon_info(arg);
+	case DRM_RADEON_GEM_INFO: {
+		struct drm_radeon_gem_info *info = arg;
+
+		info->gart_size = MOCK_APERTURE_SIZE;
+		info->vram_size = MOCK_VRAM_SIZE;
+		info->vram_visible = MOCK_VRAM_SIZE;
+		return 0;
+	}
+	case DRM_RADEON_GEM_CREATE: {
+		struct drm_radeon_gem_create *create = arg;
+
+		return mock_obj_create(file, create->size, &create->handle,
+				       NULL);
+	}
+	case DRM_RADEON_GEM_MMAP: {
+		struct drm_radeon_gem_mmap *mmap_arg = arg;
+
+		obj = mock_obj_lookup(file, mmap_arg->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		mmap_arg->addr_ptr = obj->offset;
+		return 0;
+	}
+	case DRM_RADEON_GEM_SET_DOMAIN: {
+		struct drm_radeon_gem_set_domain *set_domain = arg;
+
+		obj = mock_obj_lookup(file, set_domain->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		mock_obj_wait(call, obj);
+		return 0;
+	}
+	case DRM_RADEON_GEM_WAIT_IDLE: {
+		struct drm_radeon_gem_wait_idle *wait = arg;
+
+		obj = mock_obj_lookup(file, wait->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		mock_obj_wait(call, obj);
+		return 0;
+	}
+	case DRM_RADEON_GEM_BUSY: {
+		struct drm_radeon_gem_busy *busy = arg;
+
+		obj = mock_obj_lookup(file, busy->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		busy->domain = RADEON_GEM_DOMAIN_GTT;
+		return obj->busy_until > mockdrm_time_ns() ? -EBUSY : 0;
+	}
+	case DRM_RADEON_GEM_SET_TILING: {
+		struct drm_radeon_gem_set_tiling *tiling = arg;
+
+		obj = mock_obj_lookup(file, tiling->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		obj->tiling_mode = tiling->tiling_flags;
+		obj->stride = tiling->pitch;
+		return 0;
+	}
+	case DRM_RADEON_GEM_GET_TILING: {
+		struct drm_radeon_gem_get_tiling *tiling = arg;
+
+		obj = mock_obj_lookup(file, tiling->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		tiling->tiling_flags = obj->tiling_mode;
+		tiling->pitch = obj->stride;
+		return 0;
+	}
+	case DRM_RADEON_CS:
+		return mock_radeon_cs(file, arg);
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * nouveau
+ */
+
+static int
+mock_nouveau_getparam(struct drm_nouveau_getparam *gp)
+{
+	switch (gp->param) {
+	case NOUVEAU_GETPARAM_CHIPSET_ID:
+		gp->value = 0x50;
+		return 0;
+	case NOUVEAU_GETPARAM_FB_SIZE:
+		gp->value = MOCK_VRAM_SIZE;
+		return 0;
+	case NOUVEAU_GETPARAM_AGP_SIZE:
+		gp->value = MOCK_APERTURE_SIZE;
+		return 0;
+	case NOUVEAU_GETPARAM_HAS_BO_USAGE:
+		gp->value = 1;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static void
+mock_nouveau_bo_info(struct mock_file *file, uint32_t handle,
+		     struct drm_nouveau_gem_info *info)
+{
+	struct mock_obj *obj = mock_obj_lookup(file, handle);
+
+	info->handle = handle;
+	info->size = obj->size;
+	info->offset = mock_obj_bind(obj);
+	info->map_handle = obj->offset;
+	info->tile_mode = obj->tiling_mode;
+	info->tile_flags = obj->stride;
+	if (info->domain == 0)
+		info->domain = obj->domain ? obj->domain :
+			NOUVEAU_GEM_DOMAIN_GART;
+}
+
+static int
+mock_nouveau_pushbuf(struct mock_file *file,
+		     struct drm_nouveau_gem_pushbuf *req)
+{
+	struct drm_nouveau_gem_pushbuf_bo *bos = U642VOID(req->buffers);
+	struct drm_nouveau_gem_pushbuf_reloc *relocs = U642VOID(req->relocs);
+	uint32_t i;
+
+	req->suffix0 = 0x00000000;
+	req->suffix1 = 0x00000000;
+	req->vram_available = MOCK_VRAM_SIZE;
+	req->gart_available = MOCK_APERTURE_SIZE;
+
+	if (req->nr_push == 0)
+		return 0;
+
+	for (i = 0; i < req->nr_buffers; i++) {
+		if (mock_obj_lookup(file, bos[i].handle) == NULL)
+			return -ENOENT;
+	}
+
+	for (i = 0; i < req->nr_buffers; i++) {
+		struct mock_obj *obj = mock_obj_lookup(file, bos[i].handle);
+		uint64_t offset = mock_obj_bind(obj);
+
+		if (!bos[i].presumed.valid ||
+		    bos[i].presumed.offset != offset) {
+			bos[i].presumed.valid = 0;
+			bos[i].presumed.offset = offset;
+			bos[i].presumed.domain = NOUVEAU_GEM_DOMAIN_GART;
+		}
+		mock_obj_execute(obj);
+	}
+
+	for (i = 0; i < req->nr_relocs; i++) {
+		struct mock_obj *obj, *target;
+		uint32_t value;
+		int ret;
+
+		if (relocs[i].reloc_bo_index >= req->nr_buffers ||
+		    relocs[i].bo_index >= req->nr_buffers)
+			return -EINVAL;
+
+		stats.relocs++;
+		if (bos[relocs[i].bo_index].presumed.valid)
+			continue;
+
+		obj = mock_obj_lookup(file, bos[relocs[i].reloc_bo_index].handle);
+		target = mock_obj_lookup(file, bos[relocs[i].bo_index].handle);
+		if (relocs[i].flags & NOUVEAU_GEM_RELOC_LOW)
+			value = target->gpu_offset + relocs[i].data;
+		else if (relocs[i].flags & NOUVEAU_GEM_RELOC_HIGH)
+			value = (target->gpu_offset + relocs[i].data) >> 32;
+		else
+			value = relocs[i].data;
+		if (relocs[i].flags & NOUVEAU_GEM_RELOC_OR)
+			value |= relocs[i].vor;
+
+		ret = mock_obj_write(obj, relocs[i].reloc_bo_offset,
+				     &value, sizeof(value));
+		if (ret)
+			return ret;
+		stats.relocs_written++;
+	}
+
+	stats.exec_objects += req->nr_buffers;
+	stats.execs++;
+	return 0;
+}
+
+static int
+mock_nouveau_ioctl(struct mock_call *call, struct mock_file *file,
+		   unsigned int nr, void *arg)
+{
+	struct mock_obj *obj;
+
+	switch (nr) {
+	case DRM_NOUVEAU_GETPARAM:
+		return mock_nouveau_getparam(arg);
+	case DRM_NOUVEAU_SETPARAM:
+		return -EINVAL;
+	case DRM_NOUVEAU_CHANNEL_ALLOC: {
+		struct drm_nouveau_channel_alloc *req = arg;
+
+		req->channel = 1;
+		req->pushbuf_domains = NOUVEAU_GEM_DOMAIN_GART;
+		req->notifier_handle = 0xd000;
+		req->nr_subchan = 0;
+		return 0;
+	}
+	case DRM_NOUVEAU_CHANNEL_FREE:
+	case DRM_NOUVEAU_GROBJ_ALLOC:
+	case DRM_NOUVEAU_GPUOBJ_FREE:
+		return 0;
+	case DRM_NOUVEAU_NOTIFIEROBJ_ALLOC: {
+		struct drm_nouveau_notifierobj_alloc *req = arg;
+
+		req->offset = 0;
+		return 0;
+	}
+	case DRM_NOUVEAU_GEM_NEW: {
+		struct drm_nouveau_gem_new *req = arg;
+		int ret;
+
+		ret = mock_obj_create(file, req->info.size, &req->info.handle,
+				      &obj);
+		if (ret)
+			return ret;
+		obj->domain = req->info.domain;
+		obj->tiling_mode = req->info.tile_mode;
+		obj->stride = req->info.tile_flags;
+		mock_nouveau_bo_info(file, req->info.handle, &req->info);
+		return 0;
+	}
+	case DRM_NOUVEAU_GEM_INFO: {
+		struct drm_nouveau_gem_info *info = arg;
+
+		if (mock_obj_lookup(file, info->handle) == NULL)
+			return -ENOENT;
+		info->domain = 0;
+		mock_nouveau_bo_info(file, info->handle, info);
+		return 0;
+	}
+	case DRM_NOUVEAU_GEM_PUSHBUF:
+		return mock_nouveau_pushbuf(file, arg);
+	case DRM_NOUVEAU_GEM_CPU_PREP: {
+		struct drm_nouveau_gem_cpu_prep *req = arg;
+
+		obj = mock_obj_lookup(file, req->handle);
+		if (obj == NULL)
+			return -ENOENT;
+		if ((req->flags & NOUVEAU_GEM_CPU_PREP_NOWAIT) &&
+		    obj->busy_until > mockdrm_time_ns())
+			return -EBUSY;
+		mock_obj_wait(call, obj);
+		return 0;
+	}
+	case DRM_NOUVEAU_GEM_CPU_FINI: {
+		struct drm_nouveau_gem_cpu_fini *req = arg;
+
+		return mock_obj_lookup(file, req->handle) ? 0 : -ENOENT;
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+static int
+mock_ioctl_locked(struct mock_call *call, struct mock_file *file,
+		  unsigned long request, void *arg)
+{
+	unsigned int nr = _IOC_NR(request);
+
+	if (nr >= DRM_COMMAND_BASE && nr < DRM_COMMAND_END) {
+		nr -= DRM_COMMAND_BASE;
+		switch (file->driver) {
+		case MOCK_I915:
+			return mock_i915_ioctl(call, file, nr, arg);
+		case MOCK_RADEON:
+			return mock_radeon_ioctl(call, file, nr, arg);
+		case MOCK_NOUVEAU:
+			return mock_nouveau_ioctl(call, file, nr, arg);
+		case MOCK_GENERIC:
+		default:
+			return -EINVAL;
+		}
+	}
+
+	switch (request) {
+	case DRM_IOCTL_VERSION:
+		return mock_version(file, arg);
+	case DRM_IOCTL_GET_MAGIC:
+		((struct drm_auth *)arg)->magic = 0x4d4f434b;
+		return 0;
+	case DRM_IOCTL_AUTH_MAGIC:
+	case DRM_IOCTL_SET_VERSION:
+	case DRM_IOCTL_SET_MASTER:
+	case DRM_IOCTL_DROP_MASTER:
+		return 0;
+	case DRM_IOCTL_GET_CAP:
+		return mock_get_cap(arg);
+	case DRM_IOCTL_GEM_CLOSE:
+		return mock_handle_del(file,
+				       ((struct drm_gem_close *)arg)->handle);
+	case DRM_IOCTL_GEM_FLINK:
+		return mock_gem_flink(file, arg);
+	case DRM_IOCTL_GEM_OPEN:
+		return mock_gem_open(file, arg);
+	case DRM_IOCTL_PRIME_HANDLE_TO_FD:
+		return mock_prime_handle_to_fd(file, arg);
+	case DRM_IOCTL_PRIME_FD_TO_HANDLE:
+		return mock_prime_fd_to_handle(file, arg);
+	case DRM_IOCTL_MODE_GETRESOURCES:
+		return mock_mode_getresources(file, arg);
+	case DRM_IOCTL_MODE_GETCRTC:
+		return mock_mode_getcrtc(file, arg);
+	case DRM_IOCTL_MODE_SETCRTC:
+		return mock_mode_setcrtc(file, arg);
+	case DRM_IOCTL_MODE_GETENCODER:
+		return mock_mode_getencoder(arg);
+	case DRM_IOCTL_MODE_GETCONNECTOR:
+		return mock_mode_getconnector(arg);
+	case DRM_IOCTL_MODE_ADDFB: {
+		struct drm_mode_fb_cmd *cmd = arg;
+
+		return mock_mode_addfb(file, &cmd->fb_id, cmd->width,
+				       cmd->height, cmd->pitch, cmd->bpp,
+				       cmd->depth, cmd->handle);
+	}
+	case DRM_IOCTL_MODE_ADDFB2: {
+		struct drm_mode_fb_cmd2 *cmd = arg;
+
+		return mock_mode_addfb(file, &cmd->fb_id, cmd->width,
+				       cmd->height, cmd->pitches[0], 32, 24,
+				       cmd->handles[0]);
+	}
+	case DRM_IOCTL_MODE_RMFB:
+		return mock_mode_rmfb(file, arg);
+	case DRM_IOCTL_MODE_GETFB:
+		return mock_mode_getfb(file, arg);
+	case DRM_IOCTL_MODE_DIRTYFB:
+		return 0;
+	case DRM_IOCTL_MODE_PAGE_FLIP:
+		return mock_mode_page_flip(file, arg);
+	case DRM_IOCTL_MODE_CREATE_DUMB:
+		return mock_mode_create_dumb(file, arg);
+	case DRM_IOCTL_MODE_MAP_DUMB:
+		return mock_mode_map_dumb(file, arg);
+	case DRM_IOCTL_MODE_DESTROY_DUMB:
+		return mock_handle_del(file,
+				       ((struct drm_mode_destroy_dumb *)arg)->handle);
+	default:
+		return -EINVAL;
+	}
+}
+
+static int
+mock_ioctl(struct mock_file *file, unsigned long request, void *arg)
+{
+	struct mock_call call = { 0 };
+	unsigned int nr = _IOC_NR(request);
+	unsigned int delay;
+	uint64_t start;
+	int ret;
+
+	start = mockdrm_time_ns();
+
+	pthread_mutex_lock(&mock_lock);
+	ioctl_counts[nr]++;
+	stats.ioctls++;
+	delay = latency_ns[nr] ? latency_ns[nr] : default_latency_ns;
+	if (unsupported_ioctls[nr])
+		ret = -EINVAL;
+	else
+		ret = mock_ioctl_locked(&call, file, request, arg);
+	stats.ioctl_ns += mockdrm_time_ns() - start;
+	pthread_mutex_unlock(&mock_lock);
+
+	if (start + delay > call.stall_until)
+		call.stall_until = start + delay;
+	mock_delay_until(call.stall_until);
+
+	if (ret) {
+		errno = -ret;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Interposed libc entry points
+ */
+
+int
+ioctl(int fd, unsigned long request, ...)
+{
+	struct mock_file *file;
+	va_list ap;
+	void *arg;
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	file = mock_file_lookup(fd);
+	if (file == NULL)
+		return sys_ioctl(fd, request, arg);
+
+	return mock_ioctl(file, request, arg);
+}
+
+static void *
+mock_mmap(void *addr, size_t length, int prot, int flags, int fd,
+	  uint64_t offset)
+{
+	/* Every mmap offset handed out by the mock device is the object's
+	 * location in the backing file.
+	 */
+	if (mock_file_lookup(fd) != NULL)
+		fd = backing_fd;
+
+	return sys_mmap(addr, length, prot, flags, fd, offset);
+}
+
+/*
+ * Dma-bufs report the filesystem they would be on, so that callers can
+ * tell whether their inodes identify them.
+ */
+static void
+mock_statfs_type(int fd, long *type)
+{
+	struct mock_obj *obj;
+	struct stat st;
+
+	if (fstat(fd, &st) != 0)
+		return;
+
+	pthread_mutex_lock(&mock_lock);
+	if (anon_dmabuf_fd >= 0 && st.st_ino == anon_dmabuf_ino) {
+		*type = MOCK_ANON_INODE_FS_MAGIC;
+	} else {
+		for (obj = dmabufs; obj != NULL; obj = obj->dmabuf_next) {
+			if (obj->dmabuf_ino == st.st_ino) {
+				*type = MOCK_DMA_BUF_MAGIC;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&mock_lock);
+}
+
+int
+fstatfs(int fd, struct statfs *buf)
+{
+	long type;
+
+	if (syscall(SYS_fstatfs, fd, buf) != 0)
+		return -1;
+	type = buf->f_type;
+	mock_statfs_type(fd, &type);
+	buf->f_type = type;
+	return 0;
+}
+
+void *
+mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+	return mock_mmap(addr, length, prot, flags, fd, offset);
+}
+
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd,
+	     int64_t offset);
+
+void *
+mmap64(void *addr, size_t length, int prot, int flags, int fd,
+       int64_t offset)
+{
+	return mock_mmap(addr, length, prot, flags, fd, offset);
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * In-process emulation of a DRM device.
+ *
+ * Linking libmockdrm.la into a test program interposes ioctl() and mmap()
+ * for every library in the process, so the unmodified libdrm code paths
+ * (drmIoctl, the driver bufmgrs, xf86drmMode) can be exercised and timed
+ * on a machine without a GPU.  File descriptors not created through
+ * mockdrm_open() are passed straight through to the kernel.
+ *
+ * Buffer objects are backed by a shared memory file, so CPU and "GTT"
+ * mappings of the same object are coherent, flink names and GEM_OPEN work
+ * across mock file descriptors, and execbuffer relocations are applied
+ * just like the kernel would.  i915 userptr objects use the client's
+ * memory instead and, as in the kernel, can't be mapped, read or written
+ * through the device.  PRIME exports are plain files standing in for the
+ * dma-buf, good for importing the object again on any mock device, and
+ * fstatfs() places them on the dma-buf filesystem.
+ */
+
+#ifndef MOCKDRM_H
+#define MOCKDRM_H
+
+#include <stdint.h>
+
+struct mockdrm_stats {
+	unsigned long ioctls;		/* ioctls handled by the mock device */
+	unsigned long objects;		/* live GEM objects */
+	uint64_t object_bytes;		/* bytes held by live GEM objects */
+	unsigned long creates;		/* GEM objects created */
+	unsigned long execs;		/* execbuffer/CS/pushbuf submissions */
+	unsigned long exec_objects;	/* buffers listed in those submissions */
+	unsigned long relocs;		/* relocation entries submitted */
+	unsigned long relocs_written;	/* relocations that had to be patched */
+	unsigned long relocs_skipped;	/* relocations not even looked at */
+	unsigned long stalls;		/* ioctls that waited for the fake GPU */
+	uint64_t ioctl_ns;		/* time spent emulating ioctls, without
+					 * added latency or stalls */
+};
+
+/**
+ * Opens a new mock device file descriptor behaving like the given kernel
+ * driver: "i915", "radeon", "nouveau", or anything else for a generic
+ * KMS device with dumb buffers only.
+ */
+int mockdrm_open(const char *driver);
+int mockdrm_close(int fd);
+int mockdrm_is_mock(int fd);
+
+/**
+ * Adds an artificial cost of \c ns nanoseconds to every call of the given
+ * ioctl request (matched on the ioctl number only).  A request of 0 sets
+ * the default for all ioctls, which can also be given through the
+ * MOCKDRM_LATENCY_NS environment variable.
+ */
+void mockdrm_set_latency(unsigned long request, unsigned int ns);
+
+/**
+ * Makes the given ioctl (matched on the ioctl number only) fail with
+ * EINVAL, as on a kernel that doesn't have it, for testing fallback
+ * paths.  The matching feature queries, such as
+ * I915_PARAM_HAS_WAIT_TIMEOUT, report it missing as well.
+ */
+void mockdrm_set_unsupported(unsigned long request, int unsupported);
+
+/**
+ * Makes later PRIME exports all share one inode on anon_inodefs, like the
+ * dma-bufs of older kernels, instead of each having its own.  Such a
+ * dma-buf can only be imported through the fd it was exported as.
+ */
+void mockdrm_set_anon_dmabufs(int anon);
+
+/**
+ * Drops the pages of every object currently marked I915_MADV_DONTNEED, as
+ * the kernel does under memory pressure.  Later madvise calls on them
+ * report them as not retained.
+ */
+void mockdrm_purge(void);
+
+/**
+ * Sets how long buffers stay busy after being submitted for execution.
+ * Defaults to MOCKDRM_GPU_TIME_NS from the environment, or 0.
+ */
+void mockdrm_set_gpu_time(unsigned int ns);
+
+/**
+ * Sets the bit 6 swizzling reported for buffers with the given i915
+ * tiling mode.  Defaults to I915_BIT_6_SWIZZLE_NONE.
+ */
+void mockdrm_set_swizzle(uint32_t tiling_mode, uint32_t swizzle_mode);
+
+unsigned long mockdrm_ioctl_count(unsigned long request);
+void mockdrm_get_stats(struct mockdrm_stats *stats);
+void mockdrm_reset_stats(void);
+
+/** Monotonic clock in nanoseconds, for benchmark loops. */
+uint64_t mockdrm_time_ns(void);
+
+#endif /* MOCKDRM_H */
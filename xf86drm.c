@@ -44,12 +44,16 @@
 #include <errno.h>
 #include <signal.h>
 #include <time.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #define stat_t struct stat
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
 #include <stdarg.h>
 
 /* Not all systems have MAP_FAILED defined */
@@ -155,17 +159,166 @@ void drmFree(void *pt)
 	free(pt);
 }
 
+/*
+ * Per-ioctl statistics, indexed by ioctl number.  The counters are only
+ * touched when statistics are enabled, either with drmSetIoctlStats() or by
+ * setting LIBDRM_IOCTL_STATS in the environment, in which case they are
+ * also printed to stderr at exit.  Updates are atomic where the compiler
+ * supports it and best-effort otherwise; no lock is ever taken.
+ */
+#define DRM_IOCTL_STATS_SIZE 256
+
+#if HAVE_LIBDRM_ATOMIC_PRIMITIVES
+#define DRM_STAT_ADD(x, v) __sync_fetch_and_add(&(x), (v))
+#else
+#define DRM_STAT_ADD(x, v) ((x) += (v))
+#endif
+
+static drmIoctlStats drm_ioctl_stats[DRM_IOCTL_STATS_SIZE];
+static int drm_ioctl_stats_enabled = -1;
+
+static int drmIoctlStatsInit(void)
+{
+    const char *env = getenv("LIBDRM_IOCTL_STATS");
+
+    drm_ioctl_stats_enabled = env && *env && strcmp(env, "0");
+    if (drm_ioctl_stats_enabled)
+	atexit(drmDumpIoctlStats);
+    return drm_ioctl_stats_enabled;
+}
+
+static uint64_t drmTimeNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void drmIoctlStatsRecord(unsigned long request, uint64_t ns,
+				int retries, int ret)
+{
+    drmIoctlStats *stats = &drm_ioctl_stats[DRM_IOCTL_NR(request) %
+					    DRM_IOCTL_STATS_SIZE];
+    uint64_t us = ns / 1000;
+    int bucket = 0;
+
+    while (us && bucket < DRM_IOCTL_STATS_BUCKETS - 1) {
+	us >>= 1;
+	bucket++;
+    }
+
+    stats->request = request;
+    DRM_STAT_ADD(stats->count, 1);
+    DRM_STAT_ADD(stats->total_ns, ns);
+    DRM_STAT_ADD(stats->histogram[bucket], 1);
+    if (retries)
+	DRM_STAT_ADD(stats->retries, retries);
+    if (ret) {
+	DRM_STAT_ADD(stats->errors, 1);
+	stats->last_errno = errno;
+    }
+    if (ns > stats->max_ns)
+	stats->max_ns = ns;
+}
+
+/**
+ * Enable or disable the collection of per-ioctl statistics by drmIoctl().
+ */
+void drmSetIoctlStats(int enable)
+{
+    drm_ioctl_stats_enabled = enable != 0;
+}
+
+/**
+ * Clear the per-ioctl statistics.
+ */
+void drmResetIoctlStats(void)
+{
+    memset(drm_ioctl_stats, 0, sizeof(drm_ioctl_stats));
+}
+
+/**
+ * Get the per-ioctl statistics.
+ *
+ * \param stats array to fill with one entry per ioctl number that was used,
+ * or NULL to only count them.
+ * \param count size of \p stats.
+ *
+ * \return the number of ioctl numbers with statistics, which may be larger
+ * than \p count.
+ */
+int drmGetIoctlStats(drmIoctlStatsPtr stats, int count)
+{
+    int i, n = 0;
+
+    for (i = 0; i < DRM_IOCTL_STATS_SIZE; i++) {
+	if (drm_ioctl_stats[i].count == 0)
+	    continue;
+	if (stats && n < count)
+	    stats[n] = drm_ioctl_stats[i];
+	n++;
+    }
+    return n;
+}
+
+/**
+ * Print the per-ioctl statistics to stderr.
+ */
+void drmDumpIoctlStats(void)
+{
+    int i, j;
+
+    fprintf(stderr, "libdrm ioctl statistics:\n");
+    fprintf(stderr, "%-10s %10s %8s %8s %12s %12s %12s  %s\n",
+	    "request", "count", "retries", "errors", "total(us)",
+	    "avg(ns)", "max(ns)", "last errno");
+    for (i = 0; i < DRM_IOCTL_STATS_SIZE; i++) {
+	drmIoctlStats *stats = &drm_ioctl_stats[i];
+
+	if (stats->count == 0)
+	    continue;
+	fprintf(stderr, "0x%08lx %10llu %8llu %8llu %12llu %12llu %12llu  %d\n",
+		stats->request,
+		(unsigned long long)stats->count,
+		(unsigned long long)stats->retries,
+		(unsigned long long)stats->errors,
+		(unsigned long long)(stats->total_ns / 1000),
+		(unsigned long long)(stats->total_ns / stats->count),
+		(unsigned long long)stats->max_ns,
+		stats->last_errno);
+	fprintf(stderr, "           latency(us):");
+	for (j = 0; j < DRM_IOCTL_STATS_BUCKETS; j++) {
+	    if (stats->histogram[j])
+		fprintf(stderr, " <%u:%llu", 1u << j,
+			(unsigned long long)stats->histogram[j]);
+	}
+	fprintf(stderr, "\n");
+    }
+}
+
 /**
  * Call ioctl, restarting if it is interupted
  */
 int
 drmIoctl(int fd, unsigned long request, void *arg)
 {
-    int	ret;
+    int	ret, retries = 0;
+    uint64_t start = 0;
 
-    do {
+    if (drm_ioctl_stats_enabled && (drm_ioctl_stats_enabled > 0 ||
+				    drmIoctlStatsInit()))
+	start = drmTimeNs();
+
+    ret = ioctl(fd, request, arg);
+    while (ret == -1 && (errno == EINTR || errno == EAGAIN)) {
+	retries++;
 	ret = ioctl(fd, request, arg);
-    } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+    }
+
+    if (start)
+	drmIoctlStatsRecord(request, drmTimeNs() - start,
+			    retries, ret);
     return ret;
 }
 
@@ -1109,6 +1262,8 @@ int drmClose(int fd)
     drmHashDelete(drmHashTable, key);
     drmFree(entry);
 
+    drmPrimeEnableHandleCache(fd, 0);
+
     return close(fd);
 }
 
@@ -2542,3 +2697,363 @@ char *drmGetDeviceNameFromFd(int fd)
 
 	return strdup(name);
 }
+
+/*
+ * PRIME import cache.
+ *
+ * The kernel hands back the same GEM handle every time a dma-buf is
+ * imported again on one fd, as long as that handle is open, and the
+ * handle keeps the dma-buf (and with it the inode) alive.  So while the
+ * handle is open, the inode of any fd for that dma-buf identifies it,
+ * and an fstat() can stand in for the import ioctl.  This only holds if
+ * every handle on the fd is closed through drmCloseBufferHandle(), or
+ * forgotten with drmPrimeForgetHandle() before being freed some other
+ * way, which is why the cache has to be asked for.
+ *
+ * It also only holds where each dma-buf has an inode of its own, on the
+ * dma-buf filesystem.  Kernels that create them on anon_inodefs give all
+ * of them the same inode, so the cache is refused there.
+ *
+ * The caches of all fds are looked up, and even reordered by a lookup,
+ * from any thread, so drmPrimeLock covers every access.  It is held over
+ * the ioctls of fds with a cache, so that a handle can't be closed
+ * between an import and its entry being added.
+ */
+struct drm_prime_entry {
+	dev_t dev;
+	ino_t ino;
+	uint32_t handle;
+};
+
+struct drm_prime_cache {
+	void *by_ino;		/* entries by dma-buf inode */
+	void *by_handle;	/* the same entries by GEM handle */
+};
+
+static pthread_mutex_t drmPrimeLock = PTHREAD_MUTEX_INITIALIZER;
+static void *drmPrimeCaches;	/* struct drm_prime_cache by DRM fd */
+
+static struct drm_prime_cache *drmPrimeGetCache(int fd)
+{
+	void *value;
+
+	if (drmPrimeCaches == NULL ||
+	    drmHashLookup(drmPrimeCaches, fd, &value) != 0)
+		return NULL;
+	return value;
+}
+
+static void drmPrimeCacheRemove(struct drm_prime_cache *cache,
+				uint32_t handle)
+{
+	struct drm_prime_entry *entry;
+	void *value;
+
+	if (drmHashLookup(cache->by_handle, handle, &value) != 0)
+		return;
+	entry = value;
+	drmHashDelete(cache->by_handle, handle);
+	drmHashDelete(cache->by_ino, (unsigned long)entry->ino);
+	drmFree(entry);
+}
+
+static void drmPrimeCacheAdd(struct drm_prime_cache *cache,
+			     const struct stat *st, uint32_t handle)
+{
+	struct drm_prime_entry *entry;
+
+	drmPrimeCacheRemove(cache, handle);
+
+	entry = drmMalloc(sizeof(*entry));
+	if (entry == NULL)
+		return;
+	entry->dev = st->st_dev;
+	entry->ino = st->st_ino;
+	entry->handle = handle;
+
+	/* Where unsigned long is shorter than ino_t, the first inode
+	 * wins its key and the others always take the ioctl.
+	 */
+	if (drmHashInsert(cache->by_ino, (unsigned long)st->st_ino,
+			  entry) != 0) {
+		drmFree(entry);
+		return;
+	}
+	if (drmHashInsert(cache->by_handle, handle, entry) != 0) {
+		drmHashDelete(cache->by_ino, (unsigned long)st->st_ino);
+		drmFree(entry);
+	}
+}
+
+/**
+ * Turns the PRIME import cache of \p fd on or off.
+ *
+ * With the cache on, drmPrimeFDToHandle() only issues the ioctl the first
+ * time a dma-buf is seen, which matters to clients importing the same
+ * buffers every frame.  In exchange, all GEM handles on \p fd must be
+ * closed with drmCloseBufferHandle(), and the cache has to be turned off
+ * before the fd is closed unless that is done with drmClose().
+ *
+ * \return zero on success, -ENOSYS if the kernel's dma-bufs can't be
+ * told apart by inode, or another negative errno value on failure.
+ */
+#define DRM_DMA_BUF_MAGIC 0x444d4142
+
+/* Exports a scratch dumb buffer to see where the kernel puts dma-bufs */
+static int drmPrimeCheckInodes(int fd)
+{
+#ifdef __linux__
+	struct drm_mode_create_dumb create;
+	struct drm_mode_destroy_dumb destroy;
+	struct drm_prime_handle prime;
+	struct statfs sfs;
+	int ret;
+
+	memset(&create, 0, sizeof(create));
+	create.width = 1;
+	create.height = 1;
+	create.bpp = 32;
+	if (drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &create))
+		return -errno;
+
+	memset(&prime, 0, sizeof(prime));
+	prime.handle = create.handle;
+	prime.flags = DRM_CLOEXEC;
+	ret = drmIoctl(fd, DRM_IOCTL_PRIME_HANDLE_TO_FD, &prime);
+	if (ret == 0) {
+		if (fstatfs(prime.fd, &sfs) != 0 ||
+		    sfs.f_type != DRM_DMA_BUF_MAGIC)
+			ret = -ENOSYS;
+		close(prime.fd);
+	} else {
+		ret = -errno;
+	}
+
+	memset(&destroy, 0, sizeof(destroy));
+	destroy.handle = create.handle;
+	drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+	return ret;
+#else
+	return -ENOSYS;
+#endif
+}
+
+static int drmPrimeCacheCreate(int fd)
+{
+	struct drm_prime_cache *cache;
+
+	if (drmPrimeCaches == NULL)
+		drmPrimeCaches = drmHashCreate();
+	if (drmPrimeCaches == NULL)
+		return -ENOMEM;
+
+	cache = drmMalloc(sizeof(*cache));
+	if (cache == NULL)
+		return -ENOMEM;
+	cache->by_ino = drmHashCreate();
+	cache->by_handle = drmHashCreate();
+	if (cache->by_ino == NULL || cache->by_handle == NULL ||
+	    drmHashInsert(drmPrimeCaches, fd, cache) != 0) {
+		if (cache->by_ino)
+			drmHashDestroy(cache->by_ino);
+		if (cache->by_handle)
+			drmHashDestroy(cache->by_handle);
+		drmFree(cache);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void drmPrimeCacheDestroy(int fd, struct drm_prime_cache *cache)
+{
+	unsigned long key;
+	void *value;
+
+	if (drmHashFirst(cache->by_handle, &key, &value) == 1) {
+		do
+			drmFree(value);
+		while (drmHashNext(cache->by_handle, &key, &value));
+	}
+	drmHashDestroy(cache->by_handle);
+	drmHashDestroy(cache->by_ino);
+	drmFree(cache);
+	drmHashDelete(drmPrimeCaches, fd);
+}
+
+int drmPrimeEnableHandleCache(int fd, int enable)
+{
+	struct drm_prime_cache *cache;
+	int ret = 0;
+
+	pthread_mutex_lock(&drmPrimeLock);
+	cache = drmPrimeGetCache(fd);
+	if (enable && cache == NULL) {
+		ret = drmPrimeCheckInodes(fd);
+		if (ret == 0)
+			ret = drmPrimeCacheCreate(fd);
+	}
+	else if (!enable && cache != NULL)
+		drmPrimeCacheDestroy(fd, cache);
+	pthread_mutex_unlock(&drmPrimeLock);
+
+	return ret;
+}
+
+int drmPrimeHandleToFD(int fd, uint32_t handle, uint32_t flags, int *prime_fd)
+{
+	struct drm_prime_cache *cache;
+	struct drm_prime_handle args;
+	struct stat st;
+	int ret;
+
+	pthread_mutex_lock(&drmPrimeLock);
+	cache = drmPrimeGetCache(fd);
+	if (cache == NULL)
+		pthread_mutex_unlock(&drmPrimeLock);
+
+	memset(&args, 0, sizeof(args));
+	args.fd = -1;
+	args.handle = handle;
+	args.flags = flags;
+	ret = drmIoctl(fd, DRM_IOCTL_PRIME_HANDLE_TO_FD, &args);
+
+	/* Importing our own export gives back the same handle */
+	if (ret == 0 && cache != NULL && fstat(args.fd, &st) == 0)
+		drmPrimeCacheAdd(cache, &st, handle);
+	if (cache != NULL)
+		pthread_mutex_unlock(&drmPrimeLock);
+	if (ret)
+		return ret;
+
+	*prime_fd = args.fd;
+	return 0;
+}
+
+int drmPrimeFDToHandle(int fd, int prime_fd, uint32_t *handle)
+{
+	struct drm_prime_cache *cache;
+	struct drm_prime_handle args;
+	struct stat st;
+	void *value;
+	int ret;
+
+	pthread_mutex_lock(&drmPrimeLock);
+	cache = drmPrimeGetCache(fd);
+	if (cache != NULL && fstat(prime_fd, &st) != 0)
+		cache = NULL;
+	if (cache == NULL)
+		pthread_mutex_unlock(&drmPrimeLock);
+
+	if (cache != NULL &&
+	    drmHashLookup(cache->by_ino, (unsigned long)st.st_ino,
+			  &value) == 0) {
+		struct drm_prime_entry *entry = value;
+
+		if (entry->ino == st.st_ino && entry->dev == st.st_dev) {
+			*handle = entry->handle;
+			pthread_mutex_unlock(&drmPrimeLock);
+			return 0;
+		}
+	}
+
+	memset(&args, 0, sizeof(args));
+	args.fd = prime_fd;
+	ret = drmIoctl(fd, DRM_IOCTL_PRIME_FD_TO_HANDLE, &args);
+
+	if (ret == 0 && cache != NULL)
+		drmPrimeCacheAdd(cache, &st, args.handle);
+	if (cache != NULL)
+		pthread_mutex_unlock(&drmPrimeLock);
+	if (ret)
+		return ret;
+
+	*handle = args.handle;
+	return 0;
+}
+
+/**
+ * Closes a GEM handle, forgetting about it in the PRIME import cache.
+ */
+int drmCloseBufferHandle(int fd, uint32_t handle)
+{
+	struct drm_prime_cache *cache;
+	struct drm_gem_close args;
+	int ret;
+
+	pthread_mutex_lock(&drmPrimeLock);
+	cache = drmPrimeGetCache(fd);
+	if (cache != NULL)
+		drmPrimeCacheRemove(cache, handle);
+	else
+		pthread_mutex_unlock(&drmPrimeLock);
+
+	memset(&args, 0, sizeof(args));
+	args.handle = handle;
+	ret = drmIoctl(fd, DRM_IOCTL_GEM_CLOSE, &args);
+
+	if (cache != NULL)
+		pthread_mutex_unlock(&drmPrimeLock);
+	return ret;
+}
+
+/**
+ * Forgets a handle in the PRIME import cache, for buffers that are about to
+ * be freed by other means than GEM_CLOSE, such as dumb buffers.
+ */
+void drmPrimeForgetHandle(int fd, uint32_t handle)
+{
+	struct drm_prime_cache *cache;
+
+	pthread_mutex_lock(&drmPrimeLock);
+	cache = drmPrimeGetCache(fd);
+	if (cache != NULL)
+		drmPrimeCacheRemove(cache, handle);
+	pthread_mutex_unlock(&drmPrimeLock);
+}
+
+/* Longest sleep between two polls of drmPollBusy() */
+#define DRM_POLL_MAX_SLEEP_NS 1000000
+
+/**
+ * Waits for a buffer by polling, for drivers or kernels without a wait
+ * ioctl that takes a timeout.
+ *
+ * \p busy is called with \p data until it stops returning -EBUSY, right
+ * away and then with the time slept in between doubling from a few
+ * microseconds to a millisecond, so short waits finish quickly and long
+ * ones cost little CPU.  A negative \p timeout_ns waits forever, zero
+ * just checks once.
+ *
+ * \return zero once \p busy returns zero, -ETIME if it still returned
+ * -EBUSY when the time ran out, or any other error it returned.
+ */
+int drmPollBusy(int (*busy)(void *data), void *data, int64_t timeout_ns)
+{
+	uint64_t start = drmTimeNs(), now;
+	uint64_t sleep_ns = 2000;
+	struct timespec ts;
+	int ret;
+
+	for (;;) {
+		ret = busy(data);
+		if (ret != -EBUSY)
+			return ret;
+
+		now = drmTimeNs();
+		if (timeout_ns >= 0) {
+			if (now - start >= (uint64_t)timeout_ns)
+				return -ETIME;
+			/* Check one last time right at the deadline */
+			if (sleep_ns > start + timeout_ns - now)
+				sleep_ns = start + timeout_ns - now;
+		}
+
+		ts.tv_sec = sleep_ns / 1000000000;
+		ts.tv_nsec = sleep_ns % 1000000000;
+		nanosleep(&ts, NULL);
+
+		sleep_ns *= 2;
+		if (sleep_ns > DRM_POLL_MAX_SLEEP_NS)
+			sleep_ns = DRM_POLL_MAX_SLEEP_NS;
+	}
+}
@@ -140,6 +140,26 @@ typedef struct _drmStats {
     } data[15];
 } drmStatsT;
 
+#define DRM_IOCTL_STATS_BUCKETS 16
+
+/**
+ * Statistics gathered by drmIoctl() for one ioctl number.
+ *
+ * \sa drmGetIoctlStats().
+ */
+typedef struct _drmIoctlStats {
+    unsigned long request;        /**< Last request code seen */
+    uint64_t      count;          /**< Number of calls */
+    uint64_t      retries;        /**< Restarts after EINTR or EAGAIN */
+    uint64_t      errors;         /**< Calls that failed */
+    int           last_errno;     /**< errno of the last failure */
+    uint64_t      total_ns;       /**< Total time spent, in nanoseconds */
+    uint64_t      max_ns;         /**< Slowest call, in nanoseconds */
+    uint64_t      histogram[DRM_IOCTL_STATS_BUCKETS]; /**< Calls per latency
+                                                          bucket: bucket i
+                                                          is below 2^i us */
+} drmIoctlStats, *drmIoctlStatsPtr;
+
 
 				/* All of these enums *MUST* match with the
                                    kernel implementation -- so do *NOT*
@@ -563,6 +583,10 @@ extern int           drmGetClient(int fd, int idx, int *auth, int *pid,
 				  int *uid, unsigned long *magic,
 				  unsigned long *iocs);
 extern int           drmGetStats(int fd, drmStatsT *stats);
+extern void          drmSetIoctlStats(int enable);
+extern void          drmResetIoctlStats(void);
+extern int           drmGetIoctlStats(drmIoctlStatsPtr stats, int count);
+extern void          drmDumpIoctlStats(void);
 extern int           drmSetInterfaceVersion(int fd, drmSetVersion *version);
 extern int           drmCommandNone(int fd, unsigned long drmCommandIndex);
 extern int           drmCommandRead(int fd, unsigned long drmCommandIndex,
@@ -686,9 +710,15 @@ extern void *drmSLCreate(void);
 extern int  drmSLDestroy(void *l);
 extern int  drmSLLookup(void *l, unsigned long key, void **value);
 extern int  drmSLInsert(void *l, unsigned long key, void *value);
+extern int  drmSLInsertBulk(void *l, int count, const unsigned long *keys,
+			    void * const *values);
 extern int  drmSLDelete(void *l, unsigned long key);
+extern int  drmSLDeleteRange(void *l, unsigned long first,
+			     unsigned long last);
 extern int  drmSLNext(void *l, unsigned long *key, void **value);
 extern int  drmSLFirst(void *l, unsigned long *key, void **value);
+extern int  drmSLFirstRange(void *l, unsigned long first, unsigned long last,
+			    unsigned long *key, void **value);
 extern void drmSLDump(void *l);
 extern int  drmSLLookupNeighbors(void *l, unsigned long key,
 				 unsigned long *prev_key, void **prev_value,
@@ -727,6 +757,18 @@ extern int drmHandleEvent(int fd, drmEventContextPtr evctx);
 
 extern char *drmGetDeviceNameFromFd(int fd);
 
+extern int drmPrimeHandleToFD(int fd, uint32_t handle, uint32_t flags,
+			      int *prime_fd);
+extern int drmPrimeFDToHandle(int fd, int prime_fd, uint32_t *handle);
+extern int drmPrimeEnableHandleCache(int fd, int enable);
+extern int drmCloseBufferHandle(int fd, uint32_t handle);
+extern void drmPrimeForgetHandle(int fd, uint32_t handle);
+extern int drmPollBusy(int (*busy)(void *data), void *data,
+		       int64_t timeout_ns);
+
+extern void drmMemcpyToWC(void *dst, const void *src, size_t size);
+extern void drmMemcpyFromWC(void *dst, const void *src, size_t size);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }
 #endif
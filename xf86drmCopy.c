@@ -0,0 +1,263 @@
+/**
+ * \file xf86drmCopy.c
+ * Copy routines for write-combined and uncached buffer mappings
+ */
+
+/*
+ * Copyright © 2026 The libdrm authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Buffer mappings through the GTT or of dumb buffers are usually
+ * write-combined or uncached.  Writes to them are fastest as full,
+ * aligned, streaming stores that don't pull the destination into the
+ * cache, and reads with plain loads go to memory one cache line at a
+ * time, which the SSE4.1 streaming load avoids by fetching whole lines
+ * into a fill buffer.
+ *
+ * The routines are picked on first use from what the CPU supports.
+ * Setting LIBDRM_COPY to "memcpy", "sse2", "avx2", "sse4.1" or "neon"
+ * restricts the choice to that one, for benchmarking.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef HAVE_X86_SIMD
+# include <immintrin.h>
+#elif defined(__ARM_NEON__) || defined(__aarch64__)
+# define HAVE_NEON 1
+# include <arm_neon.h>
+#endif
+
+#include "xf86drm.h"
+
+/* Below this, the alignment fixups cost more than streaming saves */
+#define DRM_COPY_MIN 128
+
+typedef void (*drm_copy_func)(void *dst, const void *src, size_t size);
+
+static void drm_copy_memcpy(void *dst, const void *src, size_t size)
+{
+    memcpy(dst, src, size);
+}
+
+#ifdef HAVE_X86_SIMD
+
+__attribute__((target("sse2")))
+static void drm_copy_to_wc_sse2(void *dst, const void *src, size_t size)
+{
+    char *d = dst;
+    const char *s = src;
+    size_t head = -(uintptr_t)d & 15;
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    size -= head;
+
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+	__m128i a = _mm_loadu_si128((const __m128i *)s);
+	__m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+	__m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+	__m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+
+	_mm_stream_si128((__m128i *)d, a);
+	_mm_stream_si128((__m128i *)(d + 16), b);
+	_mm_stream_si128((__m128i *)(d + 32), c);
+	_mm_stream_si128((__m128i *)(d + 48), e);
+    }
+    for (; size >= 16; size -= 16, d += 16, s += 16)
+	_mm_stream_si128((__m128i *)d,
+			 _mm_loadu_si128((const __m128i *)s));
+    memcpy(d, s, size);
+
+    /* Order the streaming stores before whatever hands the buffer over */
+    _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void drm_copy_to_wc_avx2(void *dst, const void *src, size_t size)
+{
+    char *d = dst;
+    const char *s = src;
+    size_t head = -(uintptr_t)d & 31;
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    size -= head;
+
+    for (; size >= 128; size -= 128, d += 128, s += 128) {
+	__m256i a = _mm256_loadu_si256((const __m256i *)s);
+	__m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+	__m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+	__m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+
+	_mm256_stream_si256((__m256i *)d, a);
+	_mm256_stream_si256((__m256i *)(d + 32), b);
+	_mm256_stream_si256((__m256i *)(d + 64), c);
+	_mm256_stream_si256((__m256i *)(d + 96), e);
+    }
+    for (; size >= 32; size -= 32, d += 32, s += 32)
+	_mm256_stream_si256((__m256i *)d,
+			    _mm256_loadu_si256((const __m256i *)s));
+    memcpy(d, s, size);
+
+    _mm_sfence();
+}
+
+__attribute__((target("sse4.1")))
+static void drm_copy_from_wc_sse41(void *dst, const void *src, size_t size)
+{
+    char *d = dst;
+    const char *s = src;
+    size_t head = -(uintptr_t)s & 15;
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    size -= head;
+
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+	__m128i a = _mm_stream_load_si128((__m128i *)s);
+	__m128i b = _mm_stream_load_si128((__m128i *)(s + 16));
+	__m128i c = _mm_stream_load_si128((__m128i *)(s + 32));
+	__m128i e = _mm_stream_load_si128((__m128i *)(s + 48));
+
+	_mm_storeu_si128((__m128i *)d, a);
+	_mm_storeu_si128((__m128i *)(d + 16), b);
+	_mm_storeu_si128((__m128i *)(d + 32), c);
+	_mm_storeu_si128((__m128i *)(d + 48), e);
+    }
+    for (; size >= 16; size -= 16, d += 16, s += 16)
+	_mm_storeu_si128((__m128i *)d,
+			 _mm_stream_load_si128((__m128i *)s));
+    memcpy(d, s, size);
+}
+
+#elif defined(HAVE_NEON)
+
+/* NEON has no streaming stores, but whole 64 byte bursts of quadword
+ * accesses still beat memcpy's on uncached memory.
+ */
+static void drm_copy_neon(void *dst, const void *src, size_t size)
+{
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+	uint8x16_t a = vld1q_u8(s);
+	uint8x16_t b = vld1q_u8(s + 16);
+	uint8x16_t c = vld1q_u8(s + 32);
+	uint8x16_t e = vld1q_u8(s + 48);
+
+	vst1q_u8(d, a);
+	vst1q_u8(d + 16, b);
+	vst1q_u8(d + 32, c);
+	vst1q_u8(d + 48, e);
+    }
+    memcpy(d, s, size);
+}
+
+#endif
+
+static int drm_copy_allowed(const char *name)
+{
+    const char *env = getenv("LIBDRM_COPY");
+
+    return env == NULL || *env == '\0' || strcmp(env, name) == 0;
+}
+
+static drm_copy_func drm_copy_select(int to_wc)
+{
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (to_wc) {
+	if (drm_copy_allowed("avx2") && __builtin_cpu_supports("avx2"))
+	    return drm_copy_to_wc_avx2;
+	if (drm_copy_allowed("sse2") && __builtin_cpu_supports("sse2"))
+	    return drm_copy_to_wc_sse2;
+    } else {
+	if (drm_copy_allowed("sse4.1") && __builtin_cpu_supports("sse4.1"))
+	    return drm_copy_from_wc_sse41;
+    }
+#elif defined(HAVE_NEON)
+    (void)to_wc;
+    if (drm_copy_allowed("neon"))
+	return drm_copy_neon;
+#else
+    (void)to_wc;
+#endif
+    return drm_copy_memcpy;
+}
+
+static void drm_copy_to_wc_init(void *dst, const void *src, size_t size);
+static void drm_copy_from_wc_init(void *dst, const void *src, size_t size);
+
+/* Both threads racing through the init functions store the same value */
+static drm_copy_func drm_copy_to_wc = drm_copy_to_wc_init;
+static drm_copy_func drm_copy_from_wc = drm_copy_from_wc_init;
+
+static void drm_copy_to_wc_init(void *dst, const void *src, size_t size)
+{
+    drm_copy_to_wc = drm_copy_select(1);
+    drm_copy_to_wc(dst, src, size);
+}
+
+static void drm_copy_from_wc_init(void *dst, const void *src, size_t size)
+{
+    drm_copy_from_wc = drm_copy_select(0);
+    drm_copy_from_wc(dst, src, size);
+}
+
+/**
+ * Copy into a write-combined or uncached mapping.
+ *
+ * Works on any memory, but the destination isn't left in the CPU caches,
+ * so only use it for memory the CPU isn't going to read back soon.
+ */
+void drmMemcpyToWC(void *dst, const void *src, size_t size)
+{
+    if (size < DRM_COPY_MIN)
+	memcpy(dst, src, size);
+    else
+	drm_copy_to_wc(dst, src, size);
+}
+
+/**
+ * Copy out of a write-combined or uncached mapping.
+ *
+ * Works on any memory, but is only faster than memcpy() when reading
+ * from write-combined or uncached memory.
+ */
+void drmMemcpyFromWC(void *dst, const void *src, size_t size)
+{
+    if (size < DRM_COPY_MIN)
+	memcpy(dst, src, size);
+    else
+	drm_copy_from_wc(dst, src, size);
+}
@@ -27,35 +27,39 @@
  *
  * DESCRIPTION
  *
- * This file contains a straightforward implementation of a fixed-sized
- * hash table using self-organizing linked lists [Knuth73, pp. 398-399] for
- * collision resolution.  There are two potentially interesting things
- * about this implementation:
+ * This file contains an implementation of a dynamically sized hash table
+ * using open addressing with linear probing and Robin Hood insertion
+ * [Celis86] for collision resolution.  A few points about this
+ * implementation:
  *
- * 1) The table is power-of-two sized.  Prime sized tables are more
- * traditional, but do not have a significant advantage over power-of-two
- * sized table, especially when double hashing is not used for collision
- * resolution.
+ * 1) The table is power-of-two sized and doubles when it becomes three
+ * quarters full.  Entries are stored in the slot array itself, so inserts
+ * do not allocate except when the table grows, and a lookup touches a
+ * short run of adjacent slots instead of chasing list pointers.
  *
- * 2) The hash computation uses a table of random integers [Hanson97,
- * pp. 39-41].
+ * 2) Robin Hood insertion keeps every entry at most a few slots away from
+ * its home slot, which bounds the length of unsuccessful searches.
+ * Deletion shifts the following entries back instead of leaving
+ * tombstones [Knuth73, Algorithm R], so the table never degrades under
+ * insert/delete churn.
  *
- * FUTURE ENHANCEMENTS
+ * 3) The hash computation is a multiply/xor-shift integer mixer, which
+ * spreads the low bits of page addresses and consecutive integers (the
+ * common keys) evenly over the table.
  *
- * With a table size of 512, the current implementation is sufficient for a
- * few hundred keys.  Since this is well above the expected size of the
- * tables for which this implementation was designed, the implementation of
- * dynamic hash tables was postponed until the need arises.  A common (and
- * naive) approach to dynamic hash table implementation simply creates a
- * new hash table when necessary, rehashes all the data into the new table,
- * and destroys the old table.  The approach in [Larson88] is superior in
- * two ways: 1) only a portion of the table is expanded when needed,
- * distributing the expansion cost over several insertions, and 2) portions
- * of the table can be locked, enabling a scalable thread-safe
- * implementation.
+ * An earlier version of this file used a fixed table of 512 buckets with
+ * self-organizing linked lists [Knuth73, pp. 398-399] and a table of
+ * random integers for hashing [Hanson97, pp. 39-41].  That implementation
+ * is kept in the HASH_MAIN test driver for comparison.
+ *
+ * Deleting entries while walking the table with drmHashFirst() and
+ * drmHashNext() may cause entries to be skipped.
  *
  * REFERENCES
  *
+ * [Celis86] Pedro Celis.  Robin Hood Hashing.  Ph.D. thesis, University of
+ * Waterloo, 1986.
+ *
  * [Hanson97] David R. Hanson.  C Interfaces and Implementations:
  * Techniques for Creating Reusable Software.  Reading, Massachusetts:
  * Addison-Wesley, 1997.
@@ -63,93 +67,75 @@
  * [Knuth73] Donald E. Knuth. The Art of Computer Programming.  Volume 3:
  * Sorting and Searching.  Reading, Massachusetts: Addison-Wesley, 1973.
  *
- * [Larson88] Per-Ake Larson. "Dynamic Hash Tables".  CACM 31(4), April
- * 1988, pp. 446-457.
- *
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 
+#ifndef HASH_MAIN
 #define HASH_MAIN 0
+#endif
 
 #if !HASH_MAIN
 # include "xf86drm.h"
 #endif
 
-#define HASH_MAGIC 0xdeadbeef
-#define HASH_DEBUG 0
-#define HASH_SIZE  512		/* Good for about 100 entries */
-				/* If you change this value, you probably
-                                   have to change the HashHash hashing
-                                   function! */
+#define HASH_MAGIC     0xdeadbeef
+#define HASH_DEBUG     0
+#define HASH_MIN_SIZE  16	/* Initial number of slots */
 
 #if HASH_MAIN
-#define HASH_ALLOC malloc
+#define HASH_ALLOC(size) calloc(1, size)
 #define HASH_FREE  free
-#define HASH_RANDOM_DECL
-#define HASH_RANDOM_INIT(seed)  srandom(seed)
-#define HASH_RANDOM             random()
-#define HASH_RANDOM_DESTROY
 #else
 #define HASH_ALLOC drmMalloc
 #define HASH_FREE  drmFree
-#define HASH_RANDOM_DECL        void *state
-#define HASH_RANDOM_INIT(seed)  state = drmRandomCreate(seed)
-#define HASH_RANDOM             drmRandom(state)
-#define HASH_RANDOM_DESTROY     drmRandomDestroy(state)
-
 #endif
 
-typedef struct HashBucket {
+typedef struct HashSlot {
     unsigned long     key;
     void              *value;
-    struct HashBucket *next;
-} HashBucket, *HashBucketPtr;
+    unsigned long     dist;	/* Probe distance + 1, 0 if empty */
+} HashSlot, *HashSlotPtr;
 
 typedef struct HashTable {
     unsigned long    magic;
     unsigned long    entries;
-    unsigned long    hits;	/* At top of linked list */
-    unsigned long    partials;	/* Not at top of linked list */
+    unsigned long    hits;	/* In home slot */
+    unsigned long    partials;	/* Not in home slot */
     unsigned long    misses;	/* Not in table */
-    HashBucketPtr    buckets[HASH_SIZE];
-    int              p0;
-    HashBucketPtr    p1;
+    unsigned long    size;	/* Number of slots, a power of two */
+    HashSlotPtr      slots;
+    unsigned long    p0;
 } HashTable, *HashTablePtr;
 
 #if HASH_MAIN
 extern void *drmHashCreate(void);
 extern int  drmHashDestroy(void *t);
-extern int  drmHashLookup(void *t, unsigned long key, unsigned long *value);
-extern int  drmHashInsert(void *t, unsigned long key, unsigned long value);
+extern int  drmHashLookup(void *t, unsigned long key, void **value);
+extern int  drmHashInsert(void *t, unsigned long key, void *value);
 extern int  drmHashDelete(void *t, unsigned long key);
+extern int  drmHashFirst(void *t, unsigned long *key, void **value);
+extern int  drmHashNext(void *t, unsigned long *key, void **value);
 #endif
 
-static unsigned long HashHash(unsigned long key)
+static unsigned long HashHash(unsigned long key, unsigned long size)
 {
-    unsigned long        hash = 0;
-    unsigned long        tmp  = key;
-    static int           init = 0;
-    static unsigned long scatter[256];
-    int                  i;
-
-    if (!init) {
-	HASH_RANDOM_DECL;
-	HASH_RANDOM_INIT(37);
-	for (i = 0; i < 256; i++) scatter[i] = HASH_RANDOM;
-	HASH_RANDOM_DESTROY;
-	++init;
-    }
-
-    while (tmp) {
-	hash = (hash << 1) + scatter[tmp & 0xff];
-	tmp >>= 8;
-    }
+    unsigned long hash = key;
 
-    hash %= HASH_SIZE;
+#if ULONG_MAX > 0xffffffffUL
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdUL;
+    hash ^= hash >> 33;
+#else
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bUL;
+    hash ^= hash >> 16;
+#endif
+    hash &= size - 1;
 #if HASH_DEBUG
-    printf( "Hash(%d) = %d\n", key, hash);
+    printf( "Hash(%lu) = %lu\n", key, hash);
 #endif
     return hash;
 }
@@ -157,102 +143,132 @@ static unsigned long HashHash(unsigned long key)
 void *drmHashCreate(void)
 {
     HashTablePtr table;
-    int          i;
 
     table           = HASH_ALLOC(sizeof(*table));
     if (!table) return NULL;
+    table->slots    = HASH_ALLOC(HASH_MIN_SIZE * sizeof(*table->slots));
+    if (!table->slots) {
+	HASH_FREE(table);
+	return NULL;
+    }
     table->magic    = HASH_MAGIC;
     table->entries  = 0;
     table->hits     = 0;
     table->partials = 0;
     table->misses   = 0;
-
-    for (i = 0; i < HASH_SIZE; i++) table->buckets[i] = NULL;
+    table->size     = HASH_MIN_SIZE;
     return table;
 }
 
 int drmHashDestroy(void *t)
 {
     HashTablePtr  table = (HashTablePtr)t;
-    HashBucketPtr bucket;
-    HashBucketPtr next;
-    int           i;
 
     if (table->magic != HASH_MAGIC) return -1; /* Bad magic */
 
-    for (i = 0; i < HASH_SIZE; i++) {
-	for (bucket = table->buckets[i]; bucket;) {
-	    next = bucket->next;
-	    HASH_FREE(bucket);
-	    bucket = next;
-	}
-    }
+    HASH_FREE(table->slots);
     HASH_FREE(table);
     return 0;
 }
 
-/* Find the bucket and organize the list so that this bucket is at the
-   top. */
+/* Find the slot holding key.  Entries are ordered by probe distance along
+   a run, so the search stops at the first slot whose entry is closer to
+   its home than key would be. */
 
-static HashBucketPtr HashFind(HashTablePtr table,
-			      unsigned long key, unsigned long *h)
+static HashSlotPtr HashFind(HashTablePtr table, unsigned long key)
 {
-    unsigned long hash = HashHash(key);
-    HashBucketPtr prev = NULL;
-    HashBucketPtr bucket;
-
-    if (h) *h = hash;
-
-    for (bucket = table->buckets[hash]; bucket; bucket = bucket->next) {
-	if (bucket->key == key) {
-	    if (prev) {
-				/* Organize */
-		prev->next           = bucket->next;
-		bucket->next         = table->buckets[hash];
-		table->buckets[hash] = bucket;
-		++table->partials;
-	    } else {
-		++table->hits;
-	    }
-	    return bucket;
+    unsigned long mask = table->size - 1;
+    unsigned long i    = HashHash(key, table->size);
+    unsigned long dist;
+    HashSlotPtr   slot;
+
+    for (dist = 1;; dist++, i = (i + 1) & mask) {
+	slot = &table->slots[i];
+	if (slot->dist < dist) break;
+	if (slot->key == key) {
+	    if (dist == 1) ++table->hits;
+	    else           ++table->partials;
+	    return slot;
 	}
-	prev = bucket;
     }
     ++table->misses;
     return NULL;
 }
 
+/* Place an entry known not to be in the table, displacing entries that
+   are closer to their home slot than the one being placed. */
+
+static void HashPlace(HashSlotPtr slots, unsigned long size,
+		      unsigned long key, void *value)
+{
+    unsigned long mask = size - 1;
+    unsigned long i    = HashHash(key, size);
+    HashSlot      entry, tmp;
+
+    entry.key   = key;
+    entry.value = value;
+    entry.dist  = 1;
+
+    for (;; entry.dist++, i = (i + 1) & mask) {
+	if (!slots[i].dist) {
+	    slots[i] = entry;
+	    return;
+	}
+	if (slots[i].dist < entry.dist) {
+	    tmp      = slots[i];
+	    slots[i] = entry;
+	    entry    = tmp;
+	}
+    }
+}
+
+static int HashGrow(HashTablePtr table)
+{
+    unsigned long size = table->size * 2;
+    HashSlotPtr   slots;
+    unsigned long i;
+
+    slots = HASH_ALLOC(size * sizeof(*slots));
+    if (!slots) return -1;
+
+    for (i = 0; i < table->size; i++) {
+	if (table->slots[i].dist)
+	    HashPlace(slots, size, table->slots[i].key, table->slots[i].value);
+    }
+    HASH_FREE(table->slots);
+    table->slots = slots;
+    table->size  = size;
+    return 0;
+}
+
 int drmHashLookup(void *t, unsigned long key, void **value)
 {
     HashTablePtr  table = (HashTablePtr)t;
-    HashBucketPtr bucket;
+    HashSlotPtr   slot;
 
     if (!table || table->magic != HASH_MAGIC) return -1; /* Bad magic */
 
-    bucket = HashFind(table, key, NULL);
-    if (!bucket) return 1;	/* Not found */
-    *value = bucket->value;
+    slot = HashFind(table, key);
+    if (!slot) return 1;	/* Not found */
+    *value = slot->value;
     return 0;			/* Found */
 }
 
 int drmHashInsert(void *t, unsigned long key, void *value)
 {
     HashTablePtr  table = (HashTablePtr)t;
-    HashBucketPtr bucket;
-    unsigned long hash;
 
     if (table->magic != HASH_MAGIC) return -1; /* Bad magic */
 
-    if (HashFind(table, key, &hash)) return 1; /* Already in table */
+    if (HashFind(table, key)) return 1; /* Already in table */
 
-    bucket               = HASH_ALLOC(sizeof(*bucket));
-    if (!bucket) return -1;	/* Error */
-    bucket->key          = key;
-    bucket->value        = value;
-    bucket->next         = table->buckets[hash];
-    table->buckets[hash] = bucket;
+    if ((table->entries + 1) * 4 > table->size * 3 && HashGrow(table))
+	return -1;		/* Error */
+
+    HashPlace(table->slots, table->size, key, value);
+    ++table->entries;
 #if HASH_DEBUG
-    printf("Inserted %d at %d/%p\n", key, hash, bucket);
+    printf("Inserted %lu\n", key);
 #endif
     return 0;			/* Added to table */
 }
@@ -260,17 +276,26 @@ int drmHashInsert(void *t, unsigned long key, void *value)
 int drmHashDelete(void *t, unsigned long key)
 {
     HashTablePtr  table = (HashTablePtr)t;
-    unsigned long hash;
-    HashBucketPtr bucket;
+    unsigned long mask;
+    unsigned long i, j;
+    HashSlotPtr   slot;
 
     if (table->magic != HASH_MAGIC) return -1; /* Bad magic */
 
-    bucket = HashFind(table, key, &hash);
+    slot = HashFind(table, key);
 
-    if (!bucket) return 1;	/* Not found */
+    if (!slot) return 1;	/* Not found */
 
-    table->buckets[hash] = bucket->next;
-    HASH_FREE(bucket);
+				/* Shift the rest of the run back */
+    mask = table->size - 1;
+    i    = slot - table->slots;
+    for (j = (i + 1) & mask; table->slots[j].dist > 1; j = (j + 1) & mask) {
+	table->slots[i] = table->slots[j];
+	--table->slots[i].dist;
+	i = j;
+    }
+    table->slots[i].dist = 0;
+    --table->entries;
     return 0;
 }
 
@@ -278,15 +303,14 @@ int drmHashNext(void *t, unsigned long *key, void **value)
 {
     HashTablePtr  table = (HashTablePtr)t;
 
-    while (table->p0 < HASH_SIZE) {
-	if (table->p1) {
-	    *key       = table->p1->key;
-	    *value     = table->p1->value;
-	    table->p1  = table->p1->next;
+    while (table->p0 < table->size) {
+	HashSlotPtr slot = &table->slots[table->p0++];
+
+	if (slot->dist) {
+	    *key   = slot->key;
+	    *value = slot->value;
 	    return 1;
 	}
-	table->p1 = table->buckets[table->p0];
-	++table->p0;
     }
     return 0;
 }
@@ -298,11 +322,13 @@ int drmHashFirst(void *t, unsigned long *key, void **value)
     if (table->magic != HASH_MAGIC) return -1; /* Bad magic */
 
     table->p0 = 0;
-    table->p1 = table->buckets[0];
     return drmHashNext(table, key, value);
 }
 
 #if HASH_MAIN
+#include <string.h>
+#include <sys/time.h>
+
 #define DIST_LIMIT 10
 static int dist[DIST_LIMIT];
 
@@ -312,14 +338,6 @@ static void clear_dist(void) {
     for (i = 0; i < DIST_LIMIT; i++) dist[i] = 0;
 }
 
-static int count_entries(HashBucketPtr bucket)
-{
-    int count = 0;
-
-    for (; bucket; bucket = bucket->next) ++count;
-    return count;
-}
-
 static void update_dist(int count)
 {
     if (count >= DIST_LIMIT) ++dist[DIST_LIMIT-1];
@@ -328,101 +346,328 @@ static void update_dist(int count)
 
 static void compute_dist(HashTablePtr table)
 {
-    int           i;
-    HashBucketPtr bucket;
+    unsigned long i;
 
-    printf("Entries = %ld, hits = %ld, partials = %ld, misses = %ld\n",
-	   table->entries, table->hits, table->partials, table->misses);
+    printf("Entries = %ld, slots = %ld, hits = %ld, partials = %ld,"
+	   " misses = %ld\n", table->entries, table->size,
+	   table->hits, table->partials, table->misses);
     clear_dist();
-    for (i = 0; i < HASH_SIZE; i++) {
-	bucket = table->buckets[i];
-	update_dist(count_entries(bucket));
-    }
+    for (i = 0; i < table->size; i++) update_dist(table->slots[i].dist);
+    printf("probe  slots\n");
     for (i = 0; i < DIST_LIMIT; i++) {
-	if (i != DIST_LIMIT-1) printf("%5d %10d\n", i, dist[i]);
-	else                   printf("other %10d\n", dist[i]);
+	if (i == 0)                 printf("empty %10d\n", dist[i]);
+	else if (i != DIST_LIMIT-1) printf("%5ld %10d\n", i - 1, dist[i]);
+	else                        printf("other %10d\n", dist[i]);
     }
 }
 
+static int errors;
+
 static void check_table(HashTablePtr table,
 			unsigned long key, unsigned long value)
 {
-    unsigned long retval  = 0;
-    int           retcode = drmHashLookup(table, key, &retval);
+    void *retval  = NULL;
+    int  retcode = drmHashLookup(table, key, &retval);
 
     switch (retcode) {
     case -1:
 	printf("Bad magic = 0x%08lx:"
 	       " key = %lu, expected = %lu, returned = %lu\n",
-	       table->magic, key, value, retval);
+	       table->magic, key, value, (unsigned long)retval);
+	++errors;
 	break;
     case 1:
 	printf("Not found: key = %lu, expected = %lu returned = %lu\n",
-	       key, value, retval);
+	       key, value, (unsigned long)retval);
+	++errors;
 	break;
     case 0:
-	if (value != retval)
+	if (value != (unsigned long)retval) {
 	    printf("Bad value: key = %lu, expected = %lu, returned = %lu\n",
-		   key, value, retval);
+		   key, value, (unsigned long)retval);
+	    ++errors;
+	}
 	break;
     default:
 	printf("Bad retcode = %d: key = %lu, expected = %lu, returned = %lu\n",
-	       retcode, key, value, retval);
+	       retcode, key, value, (unsigned long)retval);
+	++errors;
 	break;
     }
 }
 
-int main(void)
+static void check_walk(HashTablePtr table)
+{
+    unsigned long key, count = 0;
+    void          *value;
+    int           ret;
+
+    for (ret = drmHashFirst(table, &key, &value); ret == 1;
+	 ret = drmHashNext(table, &key, &value))
+	++count;
+    if (count != table->entries) {
+	printf("Walk found %lu of %lu entries\n", count, table->entries);
+	++errors;
+    }
+}
+
+/* The previous implementation: a fixed array of self-organizing chains,
+   hashed through a table of random integers.  Kept as a baseline for the
+   benchmark below. */
+
+#define CHAIN_SIZE 512
+#define CHAIN_BENCH_LIMIT 100000
+
+typedef struct ChainBucket {
+    unsigned long      key;
+    void               *value;
+    struct ChainBucket *next;
+} ChainBucket;
+
+typedef struct ChainTable {
+    ChainBucket *buckets[CHAIN_SIZE];
+} ChainTable;
+
+static unsigned long ChainHash(unsigned long key)
+{
+    unsigned long        hash = 0;
+    static int           init = 0;
+    static unsigned long scatter[256];
+    int                  i;
+
+    if (!init) {
+	srandom(37);
+	for (i = 0; i < 256; i++) scatter[i] = random();
+	++init;
+    }
+
+    while (key) {
+	hash = (hash << 1) + scatter[key & 0xff];
+	key >>= 8;
+    }
+    return hash % CHAIN_SIZE;
+}
+
+static ChainBucket *ChainFind(ChainTable *table, unsigned long key,
+			      unsigned long *h)
+{
+    unsigned long hash = ChainHash(key);
+    ChainBucket   *prev = NULL;
+    ChainBucket   *bucket;
+
+    if (h) *h = hash;
+
+    for (bucket = table->buckets[hash]; bucket; bucket = bucket->next) {
+	if (bucket->key == key) {
+	    if (prev) {
+		prev->next           = bucket->next;
+		bucket->next         = table->buckets[hash];
+		table->buckets[hash] = bucket;
+	    }
+	    return bucket;
+	}
+	prev = bucket;
+    }
+    return NULL;
+}
+
+static ChainTable *chain_create(void)
+{
+    return calloc(1, sizeof(ChainTable));
+}
+
+static void chain_destroy(ChainTable *table)
+{
+    ChainBucket *bucket, *next;
+    int         i;
+
+    for (i = 0; i < CHAIN_SIZE; i++) {
+	for (bucket = table->buckets[i]; bucket; bucket = next) {
+	    next = bucket->next;
+	    free(bucket);
+	}
+    }
+    free(table);
+}
+
+static int chain_lookup(ChainTable *table, unsigned long key, void **value)
+{
+    ChainBucket *bucket = ChainFind(table, key, NULL);
+
+    if (!bucket) return 1;
+    *value = bucket->value;
+    return 0;
+}
+
+static int chain_insert(ChainTable *table, unsigned long key, void *value)
+{
+    ChainBucket   *bucket;
+    unsigned long hash;
+
+    if (ChainFind(table, key, &hash)) return 1;
+
+    bucket               = malloc(sizeof(*bucket));
+    if (!bucket) return -1;
+    bucket->key          = key;
+    bucket->value        = value;
+    bucket->next         = table->buckets[hash];
+    table->buckets[hash] = bucket;
+    return 0;
+}
+
+static int chain_delete(ChainTable *table, unsigned long key)
+{
+    ChainBucket   *bucket;
+    unsigned long hash;
+
+    bucket = ChainFind(table, key, &hash);
+    if (!bucket) return 1;
+
+    table->buckets[hash] = bucket->next;
+    free(bucket);
+    return 0;
+}
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e9 + tv.tv_usec * 1e3;
+}
+
+static unsigned long *bench_keys(unsigned long n, int pages)
+{
+    unsigned long *keys = malloc(2 * n * sizeof(*keys));
+    unsigned long i;
+
+    srandom(0xbeefbeef);
+    for (i = 0; i < 2 * n; i++) {
+	if (pages) keys[i] = i * 4096;
+	else       keys[i] = ((unsigned long)random() << 16) ^ random();
+    }
+    return keys;
+}
+
+static void bench(unsigned long n, int pages)
+{
+    unsigned long *keys = bench_keys(n, pages);
+    double        start, insert, hit, miss, del;
+    HashTablePtr  table;
+    ChainTable    *chain;
+    void          *value;
+    unsigned long i;
+
+				/* keys[n..2n) are never inserted */
+    start = now();
+    table = drmHashCreate();
+    for (i = 0; i < n; i++) drmHashInsert(table, keys[i], &keys[i]);
+    insert = now();
+    for (i = 0; i < n; i++) drmHashLookup(table, keys[i], &value);
+    hit = now();
+    for (i = n; i < 2 * n; i++) drmHashLookup(table, keys[i], &value);
+    miss = now();
+    for (i = 0; i < n; i++) drmHashDelete(table, keys[i]);
+    drmHashDestroy(table);
+    del = now();
+    printf("%8lu %-6s open  %8.1f %8.1f %8.1f %8.1f\n",
+	   n, pages ? "pages" : "random",
+	   (insert - start) / n, (hit - insert) / n,
+	   (miss - hit) / n, (del - miss) / n);
+
+				/* Chains grow linearly with n */
+    if (n > CHAIN_BENCH_LIMIT) {
+	printf("%8lu %-6s chain  (skipped)\n", n, pages ? "pages" : "random");
+	free(keys);
+	return;
+    }
+
+    start = now();
+    chain = chain_create();
+    for (i = 0; i < n; i++) chain_insert(chain, keys[i], &keys[i]);
+    insert = now();
+    for (i = 0; i < n; i++) chain_lookup(chain, keys[i], &value);
+    hit = now();
+    for (i = n; i < 2 * n; i++) chain_lookup(chain, keys[i], &value);
+    miss = now();
+    for (i = 0; i < n; i++) chain_delete(chain, keys[i]);
+    chain_destroy(chain);
+    del = now();
+    printf("%8lu %-6s chain %8.1f %8.1f %8.1f %8.1f\n",
+	   n, pages ? "pages" : "random",
+	   (insert - start) / n, (hit - insert) / n,
+	   (miss - hit) / n, (del - miss) / n);
+
+    free(keys);
+}
+
+int main(int argc, char **argv)
 {
     HashTablePtr table;
+    unsigned long n;
     int          i;
 
     printf("\n***** 256 consecutive integers ****\n");
     table = drmHashCreate();
-    for (i = 0; i < 256; i++) drmHashInsert(table, i, i);
+    for (i = 0; i < 256; i++) drmHashInsert(table, i, (void *)(long)i);
     for (i = 0; i < 256; i++) check_table(table, i, i);
-    for (i = 256; i >= 0; i--) check_table(table, i, i);
+    for (i = 255; i >= 0; i--) check_table(table, i, i);
+    check_walk(table);
     compute_dist(table);
     drmHashDestroy(table);
 
     printf("\n***** 1024 consecutive integers ****\n");
     table = drmHashCreate();
-    for (i = 0; i < 1024; i++) drmHashInsert(table, i, i);
+    for (i = 0; i < 1024; i++) drmHashInsert(table, i, (void *)(long)i);
     for (i = 0; i < 1024; i++) check_table(table, i, i);
-    for (i = 1024; i >= 0; i--) check_table(table, i, i);
+    for (i = 1023; i >= 0; i--) check_table(table, i, i);
+    check_walk(table);
     compute_dist(table);
     drmHashDestroy(table);
 
     printf("\n***** 1024 consecutive page addresses (4k pages) ****\n");
     table = drmHashCreate();
-    for (i = 0; i < 1024; i++) drmHashInsert(table, i*4096, i);
+    for (i = 0; i < 1024; i++) drmHashInsert(table, i*4096, (void *)(long)i);
     for (i = 0; i < 1024; i++) check_table(table, i*4096, i);
-    for (i = 1024; i >= 0; i--) check_table(table, i*4096, i);
+    for (i = 1023; i >= 0; i--) check_table(table, i*4096, i);
+    check_walk(table);
     compute_dist(table);
     drmHashDestroy(table);
 
-    printf("\n***** 1024 random integers ****\n");
+    printf("\n***** 5000 random integers, half deleted ****\n");
     table = drmHashCreate();
     srandom(0xbeefbeef);
-    for (i = 0; i < 1024; i++) drmHashInsert(table, random(), i);
+    for (i = 0; i < 5000; i++) drmHashInsert(table, random(), (void *)(long)i);
     srandom(0xbeefbeef);
-    for (i = 0; i < 1024; i++) check_table(table, random(), i);
+    for (i = 0; i < 5000; i++) check_table(table, random(), i);
     srandom(0xbeefbeef);
-    for (i = 0; i < 1024; i++) check_table(table, random(), i);
-    compute_dist(table);
-    drmHashDestroy(table);
+    for (i = 0; i < 5000; i++) {
+	unsigned long key = random();
 
-    printf("\n***** 5000 random integers ****\n");
-    table = drmHashCreate();
-    srandom(0xbeefbeef);
-    for (i = 0; i < 5000; i++) drmHashInsert(table, random(), i);
-    srandom(0xbeefbeef);
-    for (i = 0; i < 5000; i++) check_table(table, random(), i);
+	if (i & 1) drmHashDelete(table, key);
+    }
     srandom(0xbeefbeef);
-    for (i = 0; i < 5000; i++) check_table(table, random(), i);
+    for (i = 0; i < 5000; i++) {
+	unsigned long key = random();
+	void          *value;
+
+	if (!(i & 1))                                check_table(table, key, i);
+	else if (drmHashLookup(table, key, &value) != 1) ++errors;
+    }
+    check_walk(table);
     compute_dist(table);
     drmHashDestroy(table);
 
-    return 0;
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+	printf("\n***** ns per operation ****\n");
+	printf("    keys kind   table   insert      hit     miss   delete\n");
+	for (n = 1000; n <= 1000000; n *= 10) {
+	    bench(n, 0);
+	    bench(n, 1);
+	}
+    }
+
+    printf("\n%d errors\n", errors);
+    return errors != 0;
 }
 #endif
@@ -22,14 +22,19 @@
  * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
  * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
  * DEALINGS IN THE SOFTWARE.
- * 
+ *
  * Authors: Rickard E. (Rik) Faith <faith@valinux.com>
  *
  * DESCRIPTION
  *
- * This file contains a straightforward skip list implementation.n
+ * This file contains a straightforward skip list implementation [Pugh90].
  *
- * FUTURE ENHANCEMENTS
+ * Entries are carved out of per-list arena chunks instead of being
+ * malloc'd one at a time, and freed entries are kept on per-height free
+ * lists for reuse, so entries of one list share cache lines and
+ * destroying a list only frees its chunks.  Every forward link stores the
+ * key of the entry it points to, so a search compares keys without
+ * touching the next entry until it steps onto it.
  *
  * REFERENCES
  *
@@ -40,8 +45,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 
+#ifndef SL_MAIN
 #define SL_MAIN 0
+#endif
 
 #if !SL_MAIN
 # include "xf86drm.h"
@@ -55,36 +63,48 @@
 #define SL_MAX_LEVEL   16
 #define SL_DEBUG       0
 #define SL_RANDOM_SEED 0xc01055a1LU
+#define SL_CHUNK_MIN   4096	/* First arena chunk */
+#define SL_CHUNK_MAX   65536	/* Chunks double up to this size */
 
 #if SL_MAIN
 #define SL_ALLOC malloc
 #define SL_FREE  free
-#define SL_RANDOM_DECL        static int state = 0;
-#define SL_RANDOM_INIT(seed)  if (!state) { srandom(seed); ++state; }
-#define SL_RANDOM             random()
 #else
 #define SL_ALLOC drmMalloc
 #define SL_FREE  drmFree
-#define SL_RANDOM_DECL        static void *state = NULL
-#define SL_RANDOM_INIT(seed)  if (!state) state = drmRandomCreate(seed)
-#define SL_RANDOM             drmRandom(state)
-
 #endif
 
+struct SLEntry;
+
+typedef struct SLLink {
+    unsigned long     key;	   /* Key of entry, valid if entry != NULL */
+    struct SLEntry    *entry;
+} SLLink;
+
 typedef struct SLEntry {
     unsigned long     magic;	   /* SL_ENTRY_MAGIC */
     unsigned long     key;
     void              *value;
     int               levels;
-    struct SLEntry    *forward[1]; /* variable sized array */
+    SLLink            forward[1]; /* variable sized array */
 } SLEntry, *SLEntryPtr;
 
+typedef struct SLChunk {
+    struct SLChunk    *next;
+    unsigned long     size;
+    unsigned long     used;
+} SLChunk, *SLChunkPtr;
+
 typedef struct SkipList {
     unsigned long    magic;	/* SL_LIST_MAGIC */
     int              level;
     int              count;
     SLEntryPtr       head;
     SLEntryPtr       p0;	/* Position for iteration */
+    unsigned long    p_last;	/* Last key for iteration */
+    unsigned long    seed;	/* Level generator state */
+    SLChunkPtr       chunks;	/* Arena, newest chunk first */
+    SLEntryPtr       free[SL_MAX_LEVEL + 2]; /* Freed entries by levels */
 } SkipList, *SkipListPtr;
 
 #if SL_MAIN
@@ -92,40 +112,100 @@ extern void *drmSLCreate(void);
 extern int  drmSLDestroy(void *l);
 extern int  drmSLLookup(void *l, unsigned long key, void **value);
 extern int  drmSLInsert(void *l, unsigned long key, void *value);
+extern int  drmSLInsertBulk(void *l, int count, const unsigned long *keys,
+			    void * const *values);
 extern int  drmSLDelete(void *l, unsigned long key);
+extern int  drmSLDeleteRange(void *l, unsigned long first,
+			     unsigned long last);
 extern int  drmSLNext(void *l, unsigned long *key, void **value);
 extern int  drmSLFirst(void *l, unsigned long *key, void **value);
+extern int  drmSLFirstRange(void *l, unsigned long first, unsigned long last,
+			    unsigned long *key, void **value);
 extern void drmSLDump(void *l);
 extern int  drmSLLookupNeighbors(void *l, unsigned long key,
 				 unsigned long *prev_key, void **prev_value,
 				 unsigned long *next_key, void **next_value);
 #endif
 
-static SLEntryPtr SLCreateEntry(int max_level, unsigned long key, void *value)
+static unsigned long SLEntrySize(int levels)
+{
+    unsigned long size = sizeof(SLEntry) + (levels - 1) * sizeof(SLLink);
+
+    return (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+static void *SLArenaAlloc(SkipListPtr list, unsigned long size)
+{
+    SLChunkPtr chunk = list->chunks;
+    void       *ptr;
+
+    if (!chunk || chunk->used + size > chunk->size) {
+	unsigned long chunk_size = chunk ? chunk->size * 2 : SL_CHUNK_MIN;
+
+	if (chunk_size > SL_CHUNK_MAX) chunk_size = SL_CHUNK_MAX;
+	while (chunk_size < sizeof(*chunk) + size) chunk_size *= 2;
+
+	chunk = SL_ALLOC(chunk_size);
+	if (!chunk) return NULL;
+	chunk->next  = list->chunks;
+	chunk->size  = chunk_size;
+	chunk->used  = (sizeof(*chunk) + sizeof(void *) - 1)
+		       & ~(sizeof(void *) - 1);
+	list->chunks = chunk;
+    }
+
+    ptr          = (char *)chunk + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+static SLEntryPtr SLCreateEntry(SkipListPtr list, int max_level,
+				unsigned long key, void *value)
 {
     SLEntryPtr entry;
+    int        levels;
     
     if (max_level < 0 || max_level > SL_MAX_LEVEL) max_level = SL_MAX_LEVEL;
+    levels = max_level + 1;
 
-    entry         = SL_ALLOC(sizeof(*entry)
-			     + (max_level + 1) * sizeof(entry->forward[0]));
-    if (!entry) return NULL;
+    entry = list->free[levels];
+    if (entry) {
+	list->free[levels] = entry->forward[0].entry;
+    } else {
+	entry = SLArenaAlloc(list, SLEntrySize(levels));
+	if (!entry) return NULL;
+    }
     entry->magic  = SL_ENTRY_MAGIC;
     entry->key    = key;
     entry->value  = value;
-    entry->levels = max_level + 1;
+    entry->levels = levels;
 
     return entry;
 }
 
-static int SLRandomLevel(void)
+static void SLFreeEntry(SkipListPtr list, SLEntryPtr entry)
 {
-    int level = 1;
-    SL_RANDOM_DECL;
+    entry->magic             = SL_FREED_MAGIC;
+    entry->forward[0].entry  = list->free[entry->levels];
+    list->free[entry->levels] = entry;
+}
 
-    SL_RANDOM_INIT(SL_RANDOM_SEED);
-    
-    while ((SL_RANDOM & 0x01) && level < SL_MAX_LEVEL) ++level;
+static int SLRandomLevel(SkipListPtr list)
+{
+    unsigned long bits;
+    int           level = 1;
+
+				/* xorshift32 */
+    bits  = list->seed;
+    bits ^= (bits << 13) & 0xffffffffLU;
+    bits ^= bits >> 17;
+    bits ^= (bits << 5) & 0xffffffffLU;
+    list->seed = bits;
+
+    while ((bits & 0x01) && level < SL_MAX_LEVEL) {
+	++level;
+	bits >>= 1;
+    }
     return level;
 }
 
@@ -138,10 +218,17 @@ void *drmSLCreate(void)
     if (!list) return NULL;
     list->magic    = SL_LIST_MAGIC;
     list->level    = 0;
-    list->head     = SLCreateEntry(SL_MAX_LEVEL, 0, NULL);
     list->count    = 0;
+    list->seed     = SL_RANDOM_SEED;
+    list->chunks   = NULL;
+    for (i = 0; i < SL_MAX_LEVEL + 2; i++) list->free[i] = NULL;
+    list->head     = SLCreateEntry(list, SL_MAX_LEVEL, 0, NULL);
+    if (!list->head) {
+	SL_FREE(list);
+	return NULL;
+    }
 
-    for (i = 0; i <= SL_MAX_LEVEL; i++) list->head->forward[i] = NULL;
+    for (i = 0; i <= SL_MAX_LEVEL; i++) list->head->forward[i].entry = NULL;
     
     return list;
 }
@@ -149,16 +236,14 @@ void *drmSLCreate(void)
 int drmSLDestroy(void *l)
 {
     SkipListPtr   list  = (SkipListPtr)l;
-    SLEntryPtr    entry;
-    SLEntryPtr    next;
+    SLChunkPtr    chunk;
+    SLChunkPtr    next;
 
     if (list->magic != SL_LIST_MAGIC) return -1; /* Bad magic */
 
-    for (entry = list->head; entry; entry = next) {
-	if (entry->magic != SL_ENTRY_MAGIC) return -1; /* Bad magic */
-	next         = entry->forward[0];
-	entry->magic = SL_FREED_MAGIC;
-	SL_FREE(entry);
+    for (chunk = list->chunks; chunk; chunk = next) {
+	next = chunk->next;
+	SL_FREE(chunk);
     }
 
     list->magic = SL_FREED_MAGIC;
@@ -166,21 +251,63 @@ int drmSLDestroy(void *l)
     return 0;
 }
 
+/* Search for key, filling update[] with the last entry below key at every
+   level.  With finger set, update[] must already hold entries below key
+   (from a search for a smaller key), and the search resumes from them. */
+
+static SLEntryPtr SLSearch(SkipListPtr list, unsigned long key,
+			   SLEntryPtr *update, int finger)
+{
+    SLEntryPtr    entry = list->head;
+    int           i;
+
+    for (i = list->level; i >= 0; i--) {
+	if (finger && update[i]->key > entry->key)
+	    entry = update[i];
+	while (entry->forward[i].entry && entry->forward[i].key < key)
+	    entry = entry->forward[i].entry;
+	update[i] = entry;
+    }
+
+    return entry->forward[0].entry;
+}
+
 static SLEntryPtr SLLocate(void *l, unsigned long key, SLEntryPtr *update)
 {
     SkipListPtr   list  = (SkipListPtr)l;
+
+    if (list->magic != SL_LIST_MAGIC) return NULL;
+
+    return SLSearch(list, key, update, 0);
+}
+
+/* Link a new entry after the entries in update[].  */
+
+static int SLInsertAfter(SkipListPtr list, unsigned long key, void *value,
+			 SLEntryPtr *update)
+{
     SLEntryPtr    entry;
+    int           level;
     int           i;
 
-    if (list->magic != SL_LIST_MAGIC) return NULL;
+    level = SLRandomLevel(list);
+    if (level > list->level) {
+	level = ++list->level;
+	update[level] = list->head;
+    }
 
-    for (i = list->level, entry = list->head; i >= 0; i--) {
-	while (entry->forward[i] && entry->forward[i]->key < key)
-	    entry = entry->forward[i];
-	update[i] = entry;
+    entry = SLCreateEntry(list, level, key, value);
+    if (!entry) return -1;
+
+				/* Fix up forward pointers */
+    for (i = 0; i <= level; i++) {
+	entry->forward[i]           = update[i]->forward[i];
+	update[i]->forward[i].key   = key;
+	update[i]->forward[i].entry = entry;
     }
 
-    return entry->forward[0];
+    ++list->count;
+    return 0;
 }
 
 int drmSLInsert(void *l, unsigned long key, void *value)
@@ -188,8 +315,6 @@ int drmSLInsert(void *l, unsigned long key, void *value)
     SkipListPtr   list  = (SkipListPtr)l;
     SLEntryPtr    entry;
     SLEntryPtr    update[SL_MAX_LEVEL + 1];
-    int           level;
-    int           i;
 
     if (list->magic != SL_LIST_MAGIC) return -1; /* Bad magic */
 
@@ -197,23 +322,51 @@ int drmSLInsert(void *l, unsigned long key, void *value)
 
     if (entry && entry->key == key) return 1; /* Already in list */
 
+    if (SLInsertAfter(list, key, value, update)) return -1; /* Error */
+    return 0;			/* Added to table */
+}
 
-    level = SLRandomLevel();
-    if (level > list->level) {
-	level = ++list->level;
-	update[level] = list->head;
+/* Insert count keys, with values[i] (or NULL if values is NULL) for
+   keys[i].  Runs of ascending keys continue the search from the previous
+   insertion point, so loading a sorted array is linear.  Returns the
+   number of keys added, skipping those already in the list. */
+
+int drmSLInsertBulk(void *l, int count, const unsigned long *keys,
+		    void * const *values)
+{
+    SkipListPtr   list  = (SkipListPtr)l;
+    SLEntryPtr    update[SL_MAX_LEVEL + 1];
+    SLEntryPtr    entry;
+    int           added = 0;
+    int           i;
+
+    if (list->magic != SL_LIST_MAGIC) return -1; /* Bad magic */
+
+    for (i = 0; i < count; i++) {
+				/* update[] holds entries below keys[i - 1] */
+	entry = SLSearch(list, keys[i], update, i && keys[i] > keys[i - 1]);
+
+	if (entry && entry->key == keys[i]) continue;
+
+	if (SLInsertAfter(list, keys[i], values ? values[i] : NULL, update))
+	    return -1;
+	++added;
     }
+    return added;
+}
 
-    entry = SLCreateEntry(level, key, value);
+static void SLUnlink(SkipListPtr list, SLEntryPtr entry, SLEntryPtr *update)
+{
+    int           i;
 
 				/* Fix up forward pointers */
-    for (i = 0; i <= level; i++) {
-	entry->forward[i]     = update[i]->forward[i];
-	update[i]->forward[i] = entry;
+    for (i = 0; i < entry->levels; i++) {
+	if (update[i]->forward[i].entry == entry)
+	    update[i]->forward[i] = entry->forward[i];
     }
 
-    ++list->count;
-    return 0;			/* Added to table */
+    SLFreeEntry(list, entry);
+    --list->count;
 }
 
 int drmSLDelete(void *l, unsigned long key)
@@ -221,7 +374,6 @@ int drmSLDelete(void *l, unsigned long key)
     SkipListPtr   list = (SkipListPtr)l;
     SLEntryPtr    update[SL_MAX_LEVEL + 1];
     SLEntryPtr    entry;
-    int           i;
 
     if (list->magic != SL_LIST_MAGIC) return -1; /* Bad magic */
 
@@ -229,20 +381,39 @@ int drmSLDelete(void *l, unsigned long key)
 
     if (!entry || entry->key != key) return 1; /* Not found */
 
-				/* Fix up forward pointers */
-    for (i = 0; i <= list->level; i++) {
-	if (update[i]->forward[i] == entry)
-	    update[i]->forward[i] = entry->forward[i];
-    }
-
-    entry->magic = SL_FREED_MAGIC;
-    SL_FREE(entry);
+    SLUnlink(list, entry, update);
 
-    while (list->level && !list->head->forward[list->level]) --list->level;
-    --list->count;
+    while (list->level && !list->head->forward[list->level].entry)
+	--list->level;
     return 0;
 }
 
+/* Delete every entry with first <= key <= last, returning how many were
+   deleted.  The entries are unlinked in one pass. */
+
+int drmSLDeleteRange(void *l, unsigned long first, unsigned long last)
+{
+    SkipListPtr   list = (SkipListPtr)l;
+    SLEntryPtr    update[SL_MAX_LEVEL + 1];
+    SLEntryPtr    entry;
+    SLEntryPtr    next;
+    int           deleted = 0;
+
+    if (list->magic != SL_LIST_MAGIC) return -1; /* Bad magic */
+
+    for (entry = SLLocate(list, first, update);
+	 entry && entry->key <= last;
+	 entry = next) {
+	next = entry->forward[0].entry;
+	SLUnlink(list, entry, update);
+	++deleted;
+    }
+
+    while (list->level && !list->head->forward[list->level].entry)
+	--list->level;
+    return deleted;
+}
+
 int drmSLLookup(void *l, unsigned long key, void **value)
 {
     SkipListPtr   list = (SkipListPtr)l;
@@ -269,14 +440,18 @@ int drmSLLookupNeighbors(void *l, unsigned long key,
 
     *prev_key   = *next_key   = key;
     *prev_value = *next_value = NULL;
+
+    if (list->magic != SL_LIST_MAGIC) return 0;
+
+    SLLocate(list, key, update);
 	
     if (update[0]) {
 	*prev_key   = update[0]->key;
 	*prev_value = update[0]->value;
 	++retcode;
-	if (update[0]->forward[0]) {
-	    *next_key   = update[0]->forward[0]->key;
-	    *next_value = update[0]->forward[0]->value;
+	if (update[0]->forward[0].entry) {
+	    *next_key   = update[0]->forward[0].key;
+	    *next_value = update[0]->forward[0].entry->value;
 	    ++retcode;
 	}
     }
@@ -292,8 +467,8 @@ int drmSLNext(void *l, unsigned long *key, void **value)
 
     entry    = list->p0;
 
-    if (entry) {
-	list->p0 = entry->forward[0];
+    if (entry && entry->key <= list->p_last) {
+	list->p0 = entry->forward[0].entry;
 	*key     = entry->key;
 	*value   = entry->value;
 	return 1;
@@ -308,7 +483,24 @@ int drmSLFirst(void *l, unsigned long *key, void **value)
     
     if (list->magic != SL_LIST_MAGIC) return -1; /* Bad magic */
     
-    list->p0 = list->head->forward[0];
+    list->p0     = list->head->forward[0].entry;
+    list->p_last = ULONG_MAX;
+    return drmSLNext(list, key, value);
+}
+
+/* Like drmSLFirst(), but drmSLNext() will only return entries with
+   first <= key <= last. */
+
+int drmSLFirstRange(void *l, unsigned long first, unsigned long last,
+		    unsigned long *key, void **value)
+{
+    SkipListPtr   list = (SkipListPtr)l;
+    SLEntryPtr    update[SL_MAX_LEVEL + 1];
+    
+    if (list->magic != SL_LIST_MAGIC) return -1; /* Bad magic */
+    
+    list->p0     = SLLocate(list, first, update);
+    list->p_last = last;
     return drmSLNext(list, key, value);
 }
 
@@ -326,7 +518,7 @@ void drmSLDump(void *l)
     }
 
     printf("Level = %d, count = %d\n", list->level, list->count);
-    for (entry = list->head; entry; entry = entry->forward[0]) {
+    for (entry = list->head; entry; entry = entry->forward[0].entry) {
 	if (entry->magic != SL_ENTRY_MAGIC) {
 	    printf("Bad magic: 0x%08lx (expected 0x%08lx)\n",
 		   list->magic, SL_ENTRY_MAGIC);
@@ -334,14 +526,14 @@ void drmSLDump(void *l)
 	printf("\nEntry %p <0x%08lx, %p> has %2d levels\n",
 	       entry, entry->key, entry->value, entry->levels);
 	for (i = 0; i < entry->levels; i++) {
-	    if (entry->forward[i]) {
+	    if (entry->forward[i].entry) {
 		printf("   %2d: %p <0x%08lx, %p>\n",
 		       i,
-		       entry->forward[i],
-		       entry->forward[i]->key,
-		       entry->forward[i]->value);
+		       entry->forward[i].entry,
+		       entry->forward[i].key,
+		       entry->forward[i].entry->value);
 	    } else {
-		printf("   %2d: %p\n", i, entry->forward[i]);
+		printf("   %2d: %p\n", i, entry->forward[i].entry);
 	    }
 	}
     }
@@ -360,26 +552,39 @@ static void print(SkipListPtr list)
     }
 }
 
+static double elapsed(struct timeval *start, struct timeval *stop, int ops)
+{
+    return (double)(stop->tv_sec * 1000000 + stop->tv_usec
+		    - start->tv_sec * 1000000 - start->tv_usec) * 1000 / ops;
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+    unsigned long x = *(const unsigned long *)a;
+    unsigned long y = *(const unsigned long *)b;
+
+    return x < y ? -1 : x > y;
+}
+
 static double do_time(int size, int iter)
 {
     SkipListPtr    list;
     int            i, j;
-    unsigned long  keys[1000000];
+    static unsigned long keys[1000000];
     unsigned long  previous;
     unsigned long  key;
     void           *value;
     struct timeval start, stop;
-    double         usec;
-    SL_RANDOM_DECL;
+    double         insert, lookup, bulk, walk, destroy;
 
-    SL_RANDOM_INIT(12345);
+    srandom(12345);
+    for (i = 0; i < size; i++) keys[i] = random();
     
+    gettimeofday(&start, NULL);
     list = drmSLCreate();
-
-    for (i = 0; i < size; i++) {
-	keys[i] = SL_RANDOM;
-	drmSLInsert(list, keys[i], NULL);
-    }
+    for (i = 0; i < size; i++) drmSLInsert(list, keys[i], NULL);
+    gettimeofday(&stop, NULL);
+    insert = elapsed(&start, &stop, size);
 
     previous = 0;
     if (drmSLFirst(list, &key, &value)) {
@@ -399,15 +604,39 @@ static double do_time(int size, int iter)
 	}
     }
     gettimeofday(&stop, NULL);
-    
-    usec = (double)(stop.tv_sec * 1000000 + stop.tv_usec
-		    - start.tv_sec * 1000000 - start.tv_usec) / (size * iter);
-    
-    printf("%0.2f microseconds for list length %d\n", usec, size);
+    lookup = elapsed(&start, &stop, size * iter);
 
+    gettimeofday(&start, NULL);
+    for (j = 0; j < iter; j++) {
+	for (i = drmSLFirstRange(list, 0, ULONG_MAX, &key, &value);
+	     i == 1; i = drmSLNext(list, &key, &value))
+	    ;
+    }
+    gettimeofday(&stop, NULL);
+    walk = elapsed(&start, &stop, size * iter);
+
+    gettimeofday(&start, NULL);
+    drmSLDestroy(list);
+    gettimeofday(&stop, NULL);
+    destroy = elapsed(&start, &stop, size);
+
+    qsort(keys, size, sizeof(keys[0]), compare_keys);
+    gettimeofday(&start, NULL);
+    list = drmSLCreate();
+    if (drmSLInsertBulk(list, size, keys, NULL) != size)
+	printf("Bulk insert lost keys\n");
+    gettimeofday(&stop, NULL);
+    bulk = elapsed(&start, &stop, size);
+    for (i = 0; i < size; i++) {
+	if (drmSLLookup(list, keys[i], &value))
+	    printf("Error %lu %d\n", keys[i], i);
+    }
     drmSLDestroy(list);
+
+    printf("%7d %8.1f %8.1f %8.1f %8.1f %8.1f\n",
+	   size, insert, lookup, bulk, destroy, walk);
     
-    return usec;
+    return lookup;
 }
 
 static void print_neighbors(void *list, unsigned long key)
@@ -425,9 +654,23 @@ static void print_neighbors(void *list, unsigned long key)
 	   key, retval, prev_key, next_key);
 }
 
+static void print_range(void *list, unsigned long first, unsigned long last)
+{
+    unsigned long key;
+    void          *value;
+    int           ret;
+
+    printf("Range %lu..%lu:", first, last);
+    for (ret = drmSLFirstRange(list, first, last, &key, &value); ret == 1;
+	 ret = drmSLNext(list, &key, &value))
+	printf(" %lu", key);
+    printf("\n");
+}
+
 int main(void)
 {
     SkipListPtr    list;
+    unsigned long  keys[] = { 10, 20, 30, 40, 50, 60, 5 };
     double         usec, usec2, usec3, usec4;
 
     list = drmSLCreate();
@@ -455,20 +698,29 @@ int main(void)
     print(list);
     printf("\n==============================\n\n");
 
+    printf("Bulk insert: %d added\n",
+	   drmSLInsertBulk(list, sizeof(keys) / sizeof(keys[0]), keys, NULL));
+    print_range(list, 0, ULONG_MAX);
+    print_range(list, 20, 50);
+    print_range(list, 55, 100);
+    printf("Deleted %d in 20..123\n", drmSLDeleteRange(list, 20, 123));
+    print(list);
+    printf("\n==============================\n\n");
+
     drmSLDump(list);
     drmSLDestroy(list);
     printf("\n==============================\n\n");
 
+    printf("ns per operation\n");
+    printf("   size   insert   lookup     bulk  destroy     walk\n");
     usec  = do_time(100, 10000);
     usec2 = do_time(1000, 500);
+    usec3 = do_time(10000, 50);
+    usec4 = do_time(100000, 4);
     printf("Table size increased by %0.2f, search time increased by %0.2f\n",
 	   1000.0/100.0, usec2 / usec);
-    
-    usec3 = do_time(10000, 50);
     printf("Table size increased by %0.2f, search time increased by %0.2f\n",
 	   10000.0/100.0, usec3 / usec);
-    
-    usec4 = do_time(100000, 4);
     printf("Table size increased by %0.2f, search time increased by %0.2f\n",
 	   100000.0/100.0, usec4 / usec);
 